@@ -131,6 +131,34 @@ int ctkDICOMDatabaseTest2( int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  //
+  // Test the search index
+  //
+
+  QString seriesUID = database.seriesForFile(dicomFilePath);
+  QStringList foundSeries = database.search("cor fas", "Series");
+  if (foundSeries.size() != 1 || foundSeries[0] != seriesUID)
+    {
+    std::cerr << "ctkDICOMDatabase: search did not find the series by description prefix" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (database.search("cor fas", "Studies") != QStringList() << database.studyForSeries(seriesUID))
+    {
+    std::cerr << "ctkDICOMDatabase: search did not find the study of the matching series" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!database.search("nosuchword", "Series").isEmpty())
+    {
+    std::cerr << "ctkDICOMDatabase: search found a series that does not match" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (!database.rebuildSearchIndex()
+    || database.search("cor fas", "Series") != foundSeries)
+    {
+    std::cerr << "ctkDICOMDatabase: search failed after rebuilding the index" << std::endl;
+    return EXIT_FAILURE;
+    }
+
 
   //
   // Test the tag cache
@@ -184,6 +212,88 @@ int ctkDICOMDatabaseTest2( int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  //
+  // Test the in-memory tag cache
+  //
+
+  database.resetInMemoryTagCacheCounters();
+  database.instanceValue(instanceUID, tag);
+  if (database.inMemoryTagCacheHitCount() != 1 || database.inMemoryTagCacheMissCount() != 0)
+    {
+    std::cerr << "ctkDICOMDatabase: in-memory tag cache should have returned the value, hits: "
+              << database.inMemoryTagCacheHitCount() << ", misses: "
+              << database.inMemoryTagCacheMissCount() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.removeCachedTags(instanceUID);
+  if (database.cachedTag(instanceUID, tag) != QString(""))
+    {
+    std::cerr << "ctkDICOMDatabase: removed tag should not be found in the in-memory tag cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // reads the value from the file and stores it in the cache
+  database.instanceValue(instanceUID, tag);
+  database.clearInMemoryTagCache();
+  QMap<QString, QMap<QString, QString> > cachedTagsForSeries =
+    database.cachedTagsForSeries(database.seriesForFile(dicomFilePath), QStringList() << tag);
+  if (cachedTagsForSeries.size() != 1 || cachedTagsForSeries[instanceUID][tag] != knownSeriesDescription)
+    {
+    std::cerr << "ctkDICOMDatabase: cachedTagsForSeries returned invalid values" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.resetInMemoryTagCacheCounters();
+  if (database.cachedTag(instanceUID, tag) != knownSeriesDescription
+    || database.inMemoryTagCacheHitCount() != 1)
+    {
+    std::cerr << "ctkDICOMDatabase: cachedTagsForSeries should populate the in-memory tag cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Test bulk retrieval of instance values of a series
+  // (instance number is not in the tag cache, so it is read from the file)
+  //
+
+  QString instanceNumberTag("0020,0013");
+  QMap<QString, QStringList> instanceValues = database.instanceValues(
+    database.seriesForFile(dicomFilePath), QStringList() << tag << instanceNumberTag);
+  if (instanceValues.size() != 1 || instanceValues[instanceUID].size() != 2
+    || instanceValues[instanceUID][0] != knownSeriesDescription
+    || instanceValues[instanceUID][1] != database.fileValue(dicomFilePath, instanceNumberTag))
+    {
+    std::cerr << "ctkDICOMDatabase: instanceValues returned invalid values" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Test conversion to and from the compact tag cache format
+  //
+
+  database.setUseCompactTagCache(true);
+  database.clearInMemoryTagCache();
+  if (database.cachedTag(instanceUID, tag) != knownSeriesDescription)
+    {
+    std::cerr << "ctkDICOMDatabase: cached tag is lost after conversion to compact tag cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QMap<QString, QString> cachedTags;
+  database.getCachedTags(instanceUID, cachedTags);
+  if (cachedTags[tag] != knownSeriesDescription || cachedTags[instanceNumberTag] != instanceValues[instanceUID][1])
+    {
+    std::cerr << "ctkDICOMDatabase: getCachedTags returned invalid values from compact tag cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.setUseCompactTagCache(false);
+  database.clearInMemoryTagCache();
+  if (database.cachedTag(instanceUID, tag) != knownSeriesDescription)
+    {
+    std::cerr << "ctkDICOMDatabase: cached tag is lost after conversion from compact tag cache" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   // now update the database
   database.updateSchema();
 
@@ -204,6 +314,53 @@ int ctkDICOMDatabaseTest2( int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  //
+  // Test storing the file in the database folder by hard link
+  // (falls back to a copy if links are not supported)
+  //
+
+  database.initializeDatabase();
+  database.setImportStoragePolicy(ctkDICOMDatabase::HardLinkFiles);
+  if (database.importStoragePolicy() != ctkDICOMDatabase::HardLinkFiles)
+    {
+    std::cerr << "ctkDICOMDatabase: failed to set import storage policy" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.insert(dicomFilePath, true, false);
+  QString storedFile = database.fileForInstance(instanceUID);
+  if (storedFile.isEmpty() || storedFile == dicomFilePath
+    || !QFileInfo(storedFile).exists() || !QFileInfo(dicomFilePath).exists()
+    || QFileInfo(storedFile).size() != QFileInfo(dicomFilePath).size())
+    {
+    std::cerr << "ctkDICOMDatabase: file was not stored in the database folder: "
+              << qPrintable(storedFile) << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.setImportStoragePolicy(ctkDICOMDatabase::CopyFiles);
+
+  //
+  // Test bulk removal
+  //
+
+  QString storedSeriesUID = database.seriesForFile(storedFile);
+  if (!database.removeSeriesList(QStringList() << storedSeriesUID << "1.2.3.no.such.series", true))
+    {
+    std::cerr << "ctkDICOMDatabase::removeSeriesList() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (database.seriesCount() != 0 || database.studiesCount() != 0 || database.patientsCount() != 0
+    || !database.fileForInstance(instanceUID).isEmpty())
+    {
+    std::cerr << "ctkDICOMDatabase: removed series, study or patient is still in the database" << std::endl;
+    return EXIT_FAILURE;
+    }
+  database.waitForFileRemoval();
+  if (QFileInfo(storedFile).exists() || !QFileInfo(dicomFilePath).exists())
+    {
+    std::cerr << "ctkDICOMDatabase: stored file of removed series was not deleted" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   database.closeDatabase();
   database.initializeDatabase();
 
@@ -0,0 +1,126 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QThread>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+class ctkDICOMDatabaseTest8ReaderThread : public QThread
+{
+public:
+  ctkDICOMDatabaseTest8ReaderThread(ctkDICOMDatabase* database, const QString& instanceUID)
+    : Database(database)
+    , InstanceUID(instanceUID)
+  {
+  }
+
+  virtual void run()
+  {
+    this->FoundFile = this->Database->fileForInstance(this->InstanceUID);
+    this->PatientsName = this->Database->instanceValue(this->InstanceUID, "0010,0010");
+  }
+
+  ctkDICOMDatabase* Database;
+  QString InstanceUID;
+  QString FoundFile;
+  QString PatientsName;
+};
+
+}
+
+int ctkDICOMDatabaseTest8( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMDatabaseTest8: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QString dicomFilePath(argv[1]);
+
+  ctkDICOMDatabase database;
+  database.setUseWriteAheadLogging(true);
+  if (!database.useWriteAheadLogging())
+    {
+    std::cerr << "ctkDICOMDatabase::setUseWriteAheadLogging() failed." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QDir databaseDirectory = QDir::temp();
+  databaseDirectory.remove("ctkDICOMDatabase.sql");
+  databaseDirectory.remove("ctkDICOMTagCache.sql");
+
+  QFileInfo databaseFile(databaseDirectory, QString("database.test"));
+  database.openDatabase(databaseFile.absoluteFilePath());
+
+  bool res = database.initializeDatabase();
+  if (!res)
+    {
+    std::cerr << "ctkDICOMDatabase::initializeDatabase() failed." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.insert(dicomFilePath, false, false);
+  QString instanceUID("1.2.840.113619.2.135.3596.6358736.4843.1115808177.83");
+  QString patientsName = database.instanceValue(instanceUID, "0010,0010");
+
+  //
+  // Read from another thread, which uses its own read-only connection
+  //
+  ctkDICOMDatabaseTest8ReaderThread readerThread(&database, instanceUID);
+  readerThread.start();
+  readerThread.wait();
+
+  if (readerThread.FoundFile != dicomFilePath)
+    {
+    std::cerr << "ctkDICOMDatabase::fileForInstance() failed in reader thread: got "
+              << qPrintable(readerThread.FoundFile) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  if (patientsName.isEmpty() || readerThread.PatientsName != patientsName)
+    {
+    std::cerr << "ctkDICOMDatabase::instanceValue() failed in reader thread: expected "
+              << qPrintable(patientsName) << ", got "
+              << qPrintable(readerThread.PatientsName) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //
+  // Close and clean up
+  //
+  database.closeDatabase();
+
+  return EXIT_SUCCESS;
+}
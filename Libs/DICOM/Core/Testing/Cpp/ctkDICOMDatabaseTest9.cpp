@@ -0,0 +1,112 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QTemporaryDir>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+#include <dcmtk/dcmdata/dcfilefo.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+int ctkDICOMDatabaseTest9( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+    {
+    std::cerr << "ctkDICOMDatabaseTest9: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  QTemporaryDir temporaryDirectory;
+
+  //
+  // Copy of the file with an element after the pixel data
+  //
+  QString dicomFilePath = temporaryDirectory.path() + "/trailing.dcm";
+  const QString trailingValue("CTK TEST");
+  DcmFileFormat fileFormat;
+  if (fileFormat.loadFile(argv[1]).bad() ||
+      fileFormat.getDataset()->putAndInsertString(DcmTag(0x7fe1, 0x0010, EVR_LO), trailingValue.toLatin1().constData()).bad() ||
+      fileFormat.saveFile(dicomFilePath.toUtf8().constData(), EXS_LittleEndianExplicit).bad())
+    {
+    std::cerr << "Failed to write " << qPrintable(dicomFilePath) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  ctkDICOMDatabase database;
+  database.openDatabase(temporaryDirectory.path() + "/ctkDICOM.sql");
+  database.setTagsToPrecache(QStringList() << "0010,0010" << "7fe1,0010");
+
+  //
+  // Batch insert of the header only, as done by the indexer
+  //
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+  indexingResult.dataset->InitializeFromFileHeader(dicomFilePath);
+  indexingResult.filePath = dicomFilePath;
+  indexingResult.copyFile = false;
+  indexingResult.overwriteExistingDataset = false;
+  if (!indexingResult.dataset->IsInitialized())
+    {
+    std::cerr << "ctkDICOMItem::InitializeFromFileHeader() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  QString instanceUID = indexingResult.dataset->GetElementAsString(DCM_SOPInstanceUID);
+  QString patientsName = indexingResult.dataset->GetElementAsString(DCM_PatientName);
+  database.insert(QList<ctkDICOMDatabase::IndexingResult>() << indexingResult);
+
+  if (database.fileForInstance(instanceUID) != dicomFilePath)
+    {
+    std::cerr << "ctkDICOMDatabase::insert() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Tags before the pixel data are cached from the header
+  if (patientsName.isEmpty() || database.cachedTag(instanceUID, "0010,0010") != patientsName)
+    {
+    std::cerr << "ctkDICOMDatabase: tag before pixel data is not cached" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Tags after the pixel data are not in the header, they must be read from the file
+  QString value = database.instanceValue(instanceUID, "7fe1,0010");
+  if (value != trailingValue)
+    {
+    std::cerr << "ctkDICOMDatabase::instanceValue() failed for tag after pixel data: expected "
+              << qPrintable(trailingValue) << ", got " << qPrintable(value) << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  database.closeDatabase();
+
+  return EXIT_SUCCESS;
+}
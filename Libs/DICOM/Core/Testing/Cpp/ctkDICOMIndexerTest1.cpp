@@ -21,10 +21,17 @@
 // Qt includes
 #include <QCoreApplication>
 #include <QDir>
+#include <QDirIterator>
+#include <QSet>
+#include <QTemporaryDir>
 
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMIndexer.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
 
 // STD includes
 #include <iostream>
@@ -57,5 +64,92 @@ int ctkDICOMIndexerTest1( int argc, char * argv [] )
   // ensure all concurrent inserts are complete
   indexer.waitForImportFinished();
 
+  // Test indexing with multiple parser threads. The indexer opens the database
+  // again in its worker thread, therefore it must be stored in a file.
+  QTemporaryDir tempDirectory;
+  ctkDICOMDatabase parallelDatabase;
+  parallelDatabase.openDatabase(tempDirectory.filePath("ctkDICOMParallel.sql"));
+  ctkDICOMIndexer parallelIndexer;
+  parallelIndexer.setNumberOfParserThreads(4);
+  if (parallelIndexer.numberOfParserThreads() != 4)
+    {
+    std::cerr << "ctkDICOMIndexer::setNumberOfParserThreads() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  parallelIndexer.addDirectory(&parallelDatabase, dicomDir, false);
+  parallelIndexer.waitForImportFinished();
+
+  // All instances and series of the input must be indexed exactly once
+  QSet<QString> expectedInstanceUIDs;
+  QSet<QString> expectedSeriesUIDs;
+  QDirIterator it(dicomDir, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext())
+    {
+    ctkDICOMItem dataset;
+    dataset.InitializeFromFile(it.next());
+    if (!dataset.IsInitialized())
+      {
+      continue;
+      }
+    QString sopInstanceUID = dataset.GetElementAsString(DCM_SOPInstanceUID);
+    QString seriesInstanceUID = dataset.GetElementAsString(DCM_SeriesInstanceUID);
+    if (sopInstanceUID.isEmpty() || seriesInstanceUID.isEmpty()
+      || dataset.GetElementAsString(DCM_StudyInstanceUID).isEmpty())
+      {
+      continue;
+      }
+    expectedInstanceUIDs.insert(sopInstanceUID);
+    expectedSeriesUIDs.insert(seriesInstanceUID);
+    }
+  if (parallelDatabase.imagesCount() != expectedInstanceUIDs.size())
+    {
+    std::cerr << "ctkDICOMIndexer with 4 parser threads indexed " << parallelDatabase.imagesCount()
+              << " instances instead of " << expectedInstanceUIDs.size() << std::endl;
+    return EXIT_FAILURE;
+    }
+  if (parallelDatabase.seriesCount() != expectedSeriesUIDs.size())
+    {
+    std::cerr << "ctkDICOMIndexer with 4 parser threads indexed " << parallelDatabase.seriesCount()
+              << " series instead of " << expectedSeriesUIDs.size() << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Test incremental re-scan
+  ctkDICOMDatabase rescanDatabase;
+  rescanDatabase.openDatabase(tempDirectory.filePath("ctkDICOM.sql"));
+  ctkDICOMIndexer rescanIndexer;
+  rescanIndexer.setDatabase(&rescanDatabase);
+  rescanIndexer.rescanDirectory(dicomDir);
+  int imagesCount = rescanDatabase.imagesCount();
+  if (imagesCount == 0)
+    {
+    std::cerr << "ctkDICOMIndexer::rescanDirectory() failed: no images were added" << std::endl;
+    return EXIT_FAILURE;
+    }
+  // Nothing changed, so nothing is added
+  rescanIndexer.rescanDirectory(dicomDir);
+  if (rescanDatabase.imagesCount() != imagesCount)
+    {
+    std::cerr << "ctkDICOMIndexer::rescanDirectory() failed: image count changed from "
+              << imagesCount << " to " << rescanDatabase.imagesCount() << std::endl;
+    return EXIT_FAILURE;
+    }
+  // Re-initialized database must not keep the scan state
+  rescanDatabase.initializeDatabase();
+  rescanIndexer.rescanDirectory(dicomDir);
+  if (rescanDatabase.imagesCount() != imagesCount)
+    {
+    std::cerr << "ctkDICOMIndexer::rescanDirectory() failed after database initialization" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  rescanIndexer.setWatchDirectoriesEnabled(true);
+  if (!rescanIndexer.isWatchDirectoriesEnabled())
+    {
+    std::cerr << "ctkDICOMIndexer::setWatchDirectoriesEnabled() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+  rescanIndexer.setWatchDirectoriesEnabled(false);
+
   return EXIT_SUCCESS;
 }
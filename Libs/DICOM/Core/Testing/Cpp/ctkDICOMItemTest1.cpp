@@ -31,6 +31,12 @@ int ctkDICOMItemTest1( int argc, char * argv [] )
   ctkDICOMItem dataset;
   dataset.InitializeFromItem(0);
   dataset.InitializeFromFile(QString());
+  dataset.InitializeFromFileHeader(QString());
+  if (dataset.IsInitialized())
+    {
+    std::cerr << "ctkDICOMItem::InitializeFromFileHeader() succeeded with empty filename" << std::endl;
+    return EXIT_FAILURE;
+    }
   try
     {
     dataset.Serialize();
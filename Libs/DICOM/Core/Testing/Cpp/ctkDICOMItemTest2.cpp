@@ -0,0 +1,172 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+/// Item that keeps its string serialization in memory
+class ctkDICOMItemTest2Item : public ctkDICOMItem
+{
+public:
+  QString StoredSerialization;
+
+protected:
+  virtual QString GetStoredSerialization()
+  {
+    return this->StoredSerialization;
+  }
+  virtual void SetStoredSerialization(QString serializedDataset)
+  {
+    this->StoredSerialization = serializedDataset;
+  }
+};
+
+//----------------------------------------------------------------------------
+bool checkItem(const ctkDICOMItem& item, const ctkDICOMItem& expectedItem, const char* method)
+{
+  if (!item.IsInitialized()
+    || item.GetElementAsString(DCM_SOPInstanceUID) != expectedItem.GetElementAsString(DCM_SOPInstanceUID)
+    || item.GetElementAsString(DCM_PatientName) != expectedItem.GetElementAsString(DCM_PatientName)
+    || item.GetElementAsInteger(DCM_Rows) != expectedItem.GetElementAsInteger(DCM_Rows))
+  {
+    std::cerr << method << " failed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+int ctkDICOMItemTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMItemTest2: missing dicom filePath argument" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem item;
+  item.InitializeFromFile(argv[1]);
+  if (!item.IsInitialized() || item.GetElementAsString(DCM_SOPInstanceUID).isEmpty())
+  {
+    std::cerr << "ctkDICOMItem::InitializeFromFile() failed: " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Byte array
+  QByteArray byteArray = item.SerializeToByteArray();
+  ctkDICOMItem byteArrayItem;
+  if (byteArray.isEmpty() || !byteArrayItem.DeserializeFromByteArray(byteArray)
+    || !checkItem(byteArrayItem, item, "ctkDICOMItem::DeserializeFromByteArray()"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // String (base64), must contain the same data as the byte array
+  ctkDICOMItemTest2Item stringItem;
+  stringItem.InitializeFromFile(argv[1]);
+  stringItem.Serialize();
+  if (QByteArray::fromBase64(stringItem.StoredSerialization.toLatin1()) != byteArray)
+  {
+    std::cerr << "ctkDICOMItem::Serialize() and SerializeToByteArray() are different" << std::endl;
+    return EXIT_FAILURE;
+  }
+  ctkDICOMItemTest2Item deserializedStringItem;
+  deserializedStringItem.StoredSerialization = stringItem.StoredSerialization;
+  deserializedStringItem.Deserialize();
+  if (!checkItem(deserializedStringItem, item, "ctkDICOMItem::Deserialize()"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // QDataStream
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadWrite);
+  QDataStream outStream(&buffer);
+  outStream << item << item;
+  buffer.seek(0);
+  QDataStream inStream(&buffer);
+  ctkDICOMItem streamItem1;
+  ctkDICOMItem streamItem2;
+  inStream >> streamItem1 >> streamItem2;
+  if (inStream.status() != QDataStream::Ok
+    || !checkItem(streamItem1, item, "QDataStream operator>>")
+    || !checkItem(streamItem2, item, "QDataStream operator>>"))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Swap
+  ctkDICOMItem movedItem;
+  movedItem.Swap(streamItem1);
+  if (!checkItem(movedItem, item, "ctkDICOMItem::Swap()") || streamItem1.IsInitialized())
+  {
+    std::cerr << "ctkDICOMItem::Swap() failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Benchmark of the string and binary serializations
+  const int iterationCount = 100;
+  QTime timer;
+  timer.start();
+  for (int i = 0; i < iterationCount; ++i)
+  {
+    stringItem.Serialize();
+    ctkDICOMItemTest2Item benchmarkItem;
+    benchmarkItem.StoredSerialization = stringItem.StoredSerialization;
+    benchmarkItem.Deserialize();
+  }
+  int stringElapsed = timer.elapsed();
+  timer.start();
+  for (int i = 0; i < iterationCount; ++i)
+  {
+    QByteArray benchmarkArray = item.SerializeToByteArray();
+    ctkDICOMItem benchmarkItem;
+    benchmarkItem.DeserializeFromByteArray(benchmarkArray);
+  }
+  int byteArrayElapsed = timer.elapsed();
+  std::cout << "Serialization of " << iterationCount << " datasets:" << std::endl
+            << "  string: " << stringElapsed << " ms, "
+            << stringItem.StoredSerialization.size() * sizeof(QChar) << " bytes" << std::endl
+            << "  binary: " << byteArrayElapsed << " ms, "
+            << byteArray.size() << " bytes" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -23,6 +23,7 @@
 #include <QDebug>
 #include <QFileInfo>
 #include <QSqlQuery>
+#include <QTime>
 
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
@@ -88,6 +89,35 @@ int ctkDICOMModelTest1( int argc, char * argv [] )
     qDebug() << model.rowCount() << model.columnCount();
     qDebug() << model.index(0,0);
 
+    // Asynchronous fetch must give the same rows
+    int rowCount = model.rowCount();
+    model.setAsynchronousFetch(true);
+    model.setDatabase(myCTK.database());
+    QTime timer;
+    timer.start();
+    while (model.isFetching() && timer.elapsed() < 10000)
+      {
+      QCoreApplication::processEvents();
+      }
+    if (model.isFetching() || model.rowCount() != rowCount)
+      {
+      std::cerr << "Asynchronous fetch failed: " << model.rowCount()
+                << " rows, expected " << rowCount << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (rowCount > 0 && model.index(0, 0).data(ctkDICOMModel::UIDRole).toString().isEmpty())
+      {
+      std::cerr << "Asynchronous fetch returned invalid rows" << std::endl;
+      return EXIT_FAILURE;
+      }
+    model.fetchMore(model.index(0, 0));
+    model.cancelFetch();
+    if (model.isFetching())
+      {
+      std::cerr << "ctkDICOMModel::cancelFetch() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+
     return EXIT_SUCCESS;
   }
   catch (std::exception e)
@@ -42,6 +42,7 @@ int ctkDICOMQueryTest1( int argc, char * argv [] )
       !query.calledAETitle().isEmpty() ||
       !query.host().isEmpty() ||
       query.port() != 0 ||
+      query.maximumNumberOfAssociations() != 1 ||
       !query.filters().isEmpty() ||
       !query.studyInstanceUIDQueried().isEmpty())
     {
@@ -86,6 +87,22 @@ int ctkDICOMQueryTest1( int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  query.setMaximumNumberOfAssociations(4);
+  if (query.maximumNumberOfAssociations() != 4)
+    {
+    std::cerr << "ctkDICOMQuery::setMaximumNumberOfAssociations() failed: "
+              << query.maximumNumberOfAssociations() << std::endl;
+    return EXIT_FAILURE;
+    }
+  query.setMaximumNumberOfAssociations(0);
+  if (query.maximumNumberOfAssociations() != 1)
+    {
+    std::cerr << "ctkDICOMQuery::setMaximumNumberOfAssociations() with invalid value failed: "
+              << query.maximumNumberOfAssociations() << std::endl;
+    return EXIT_FAILURE;
+    }
+  query.setMaximumNumberOfAssociations(4);
+
   QMap<QString,QVariant> filters;
   filters["Name"] = QString("JohnDoe");
   filters["StartDate"] = QString("20090101");
@@ -79,6 +79,18 @@ int ctkDICOMRetrieveTest1( int argc, char * argv [] )
     return EXIT_FAILURE;
     }
 
+  if (!retrieve.isBackgroundStorageEnabled())
+    {
+    std::cerr << "ctkDICOMRetrieve::isBackgroundStorageEnabled() default value is not true" << std::endl;
+    return EXIT_FAILURE;
+    }
+  retrieve.setBackgroundStorageEnabled(false);
+  if (retrieve.isBackgroundStorageEnabled())
+    {
+    std::cerr << "ctkDICOMRetrieve::setBackgroundStorageEnabled() failed" << std::endl;
+    return EXIT_FAILURE;
+    }
+
   retrieve.setPort(80);
   if (retrieve.port() != 80)
     {
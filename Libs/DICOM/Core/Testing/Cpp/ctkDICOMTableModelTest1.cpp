@@ -0,0 +1,250 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QSet>
+#include <QSqlQuery>
+#include <QTime>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMTableModel.h"
+#include "ctkModelTester.h"
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+bool checkRows(ctkDICOMTableModel& model, int expectedRowCount, int sortColumn)
+{
+  if (model.rowCount() != expectedRowCount)
+  {
+    std::cerr << "Invalid row count: " << model.rowCount() << ", expected " << expectedRowCount << std::endl;
+    return false;
+  }
+  // Rows read page by page must match the rows returned by a single query
+  QStringList uids = model.columnValues(0);
+  QStringList sortValues = model.columnValues(sortColumn);
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+  QSet<QString> uniqueUids(uids.begin(), uids.end());
+  #else
+  QSet<QString> uniqueUids = uids.toSet();
+  #endif
+  if (uids.size() != expectedRowCount || uniqueUids.size() != expectedRowCount)
+  {
+    std::cerr << "Invalid column values" << std::endl;
+    return false;
+  }
+  for (int row = 0; row < model.rowCount(); ++row)
+  {
+    if (model.value(row, 0).toString() != uids[row])
+    {
+      std::cerr << "Invalid value in row " << row << ": " << qPrintable(model.value(row, 0).toString())
+        << ", expected " << qPrintable(uids[row]) << std::endl;
+      return false;
+    }
+    if (row > 0 && sortValues[row - 1] > sortValues[row])
+    {
+      std::cerr << "Rows are not sorted at row " << row << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTableModelTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc <= 2)
+  {
+    std::cerr << "Usage: ctkDICOMTableModelTest1 <scratch.db> <dumpfile.sql>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMDatabase database(argv[1]);
+  if (!database.initializeDatabase(argv[2]))
+  {
+    std::cerr << "Error when initializing the database: " << argv[2]
+              << " error: " << qPrintable(database.lastError()) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  QSqlQuery countQuery(database.database());
+  if (!countQuery.exec("SELECT COUNT(DISTINCT Series.SeriesInstanceUID) FROM Patients, Studies, Series "
+    "WHERE Patients.UID = Studies.PatientsUID AND Studies.StudyInstanceUID = Series.StudyInstanceUID")
+    || !countQuery.next())
+  {
+    std::cerr << "Failed to count series" << std::endl;
+    return EXIT_FAILURE;
+  }
+  int seriesCount = countQuery.value(0).toInt();
+  countQuery.finish();
+
+  ctkDICOMTableModel model;
+  ctkModelTester tester;
+  tester.setThrowOnError(false);
+  tester.setModel(&model);
+
+  model.setDatabase(&database);
+  model.setTableName("Series");
+  model.setPageSize(4);
+  model.setMaximumCachedPageCount(2);
+  model.setBackgroundFetch(false);
+  if (!model.select() || model.columnCount() == 0)
+  {
+    std::cerr << "ctkDICOMTableModel::select() failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (model.headerData(0, Qt::Horizontal).toString() != "SeriesInstanceUID")
+  {
+    std::cerr << "Invalid header: " << qPrintable(model.headerData(0, Qt::Horizontal).toString()) << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!checkRows(model, seriesCount, 0))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Sorting (pages are fetched by keyset pagination when they are read in order)
+  int descriptionColumn = -1;
+  for (int column = 0; column < model.columnCount(); ++column)
+  {
+    if (model.headerData(column, Qt::Horizontal).toString() == "SeriesDescription")
+    {
+      descriptionColumn = column;
+    }
+  }
+  model.sort(descriptionColumn, Qt::AscendingOrder);
+  if (!checkRows(model, seriesCount, descriptionColumn))
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Filtering
+  QString description = model.value(seriesCount - 1, descriptionColumn).toString();
+  model.setFilterText(description.left(3).toLower());
+  model.select();
+  if (model.rowCount() == 0 || model.rowCount() > seriesCount || model.unfilteredRowCount() != seriesCount)
+  {
+    std::cerr << "Invalid row count with filter: " << model.rowCount() << std::endl;
+    return EXIT_FAILURE;
+  }
+  model.setFilterText("*no such series*");
+  model.select();
+  if (model.rowCount() != 0 || model.unfilteredRowCount() != seriesCount)
+  {
+    std::cerr << "Invalid row count with filter that matches no rows: " << model.rowCount() << std::endl;
+    return EXIT_FAILURE;
+  }
+  model.setFilterText(QString());
+
+  // Conditions
+  QString studyInstanceUID = model.value(0, 1).toString();
+  QHash<QString, QStringList> conditions;
+  conditions["Studies.StudyInstanceUID"] = QStringList() << studyInstanceUID;
+  model.setConditions(conditions);
+  model.select();
+  if (model.rowCount() == 0 || model.rowCount() > seriesCount)
+  {
+    std::cerr << "Invalid row count with condition: " << model.rowCount() << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int row = 0; row < model.rowCount(); ++row)
+  {
+    if (model.value(row, 1).toString() != studyInstanceUID)
+    {
+      std::cerr << "Row does not match the condition: " << row << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  model.setConditions(QHash<QString, QStringList>());
+
+  // Subquery conditions (rows of another model)
+  ctkDICOMTableModel studiesModel;
+  studiesModel.setDatabase(&database);
+  studiesModel.setTableName("Studies");
+  studiesModel.setBackgroundFetch(false);
+  studiesModel.setConditions(conditions);
+  studiesModel.select();
+  QVariantList studiesBindValues;
+  QString studiesQuery = studiesModel.columnValuesQuery(0, studiesBindValues);
+  QHash<QString, QPair<QString, QVariantList> > subqueryConditions;
+  subqueryConditions["Series.StudyInstanceUID"] = qMakePair(studiesQuery, studiesBindValues);
+  model.setSubqueryConditions(subqueryConditions);
+  model.select();
+  if (studiesModel.rowCount() != 1 || model.rowCount() == 0 || model.rowCount() > seriesCount)
+  {
+    std::cerr << "Invalid row count with subquery condition: " << model.rowCount() << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (int row = 0; row < model.rowCount(); ++row)
+  {
+    if (model.value(row, 1).toString() != studyInstanceUID)
+    {
+      std::cerr << "Row does not match the subquery condition: " << row << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  model.setSubqueryConditions(QHash<QString, QPair<QString, QVariantList> >());
+
+  // Background fetch (rows are counted in the background, too)
+  model.setBackgroundFetch(true);
+  model.select();
+  QTime timer;
+  timer.start();
+  while (model.rowCount() != seriesCount && timer.elapsed() < 10000)
+  {
+    QCoreApplication::processEvents();
+  }
+  if (model.rowCount() != seriesCount)
+  {
+    std::cerr << "Rows were not counted in the background: " << model.rowCount() << std::endl;
+    return EXIT_FAILURE;
+  }
+  int lastRow = model.rowCount() - 1;
+  model.data(model.index(lastRow, 0));
+  timer.start();
+  while (!model.isRowFetched(lastRow) && timer.elapsed() < 10000)
+  {
+    QCoreApplication::processEvents();
+  }
+  if (!model.isRowFetched(lastRow) || !model.data(model.index(lastRow, 0)).isValid())
+  {
+    std::cerr << "Page was not fetched in the background" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  model.clear();
+  if (model.rowCount() != 0 || model.columnCount() != 0)
+  {
+    std::cerr << "ctkDICOMTableModel::clear() failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
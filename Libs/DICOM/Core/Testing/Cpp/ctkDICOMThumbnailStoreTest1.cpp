@@ -0,0 +1,242 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+// ctkDICOMCore includes
+#include "ctkDICOMThumbnailStore.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+//-----------------------------------------------------------------------------
+int ctkDICOMThumbnailStoreTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QTemporaryDir temporaryDirectory;
+  QString thumbnailsDirectory = temporaryDirectory.path() + "/thumbs";
+
+  // 2x2 RGB tile
+  QByteArray pixels("\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c", 12);
+  {
+    ctkDICOMThumbnailStore store(thumbnailsDirectory);
+    if (store.contains("study", "series", "image1"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::contains() failed on empty store" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (store.setThumbnail("study", "series", "image1", ctkDICOMThumbnailStore::RGB888, 2, 3, pixels))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::setThumbnail() accepted invalid data size" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!store.setThumbnail("study", "series", "image1", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels) ||
+        !store.setThumbnail("study", "series", "image2", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels) ||
+        !store.setThumbnail("study", "series", "image1", ctkDICOMThumbnailStore::Grayscale8, 2, 2, pixels.left(4)))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::setThumbnail() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!store.removeThumbnail("study", "series", "image2") ||
+        store.contains("study", "series", "image2"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::removeThumbnail() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!QFile::exists(store.seriesFilePath("study", "series")))
+      {
+      std::cerr << "ctkDICOMThumbnailStore did not create the series file" << std::endl;
+      return EXIT_FAILURE;
+      }
+  }
+
+  // Read the series file with a new store
+  {
+    ctkDICOMThumbnailStore store(thumbnailsDirectory);
+    ctkDICOMThumbnailStore::TileFormat format = ctkDICOMThumbnailStore::InvalidFormat;
+    int width = 0;
+    int height = 0;
+    QByteArray storedPixels = store.thumbnail("study", "series", "image1", &format, &width, &height);
+    if (storedPixels != pixels.left(4) || format != ctkDICOMThumbnailStore::Grayscale8 ||
+        width != 2 || height != 2 || !store.thumbnailTime("study", "series", "image1").isValid())
+      {
+      std::cerr << "ctkDICOMThumbnailStore::thumbnail() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (store.contains("study", "series", "image2"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore: removed thumbnail is back" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!store.compactSeries("study", "series") ||
+        store.thumbnail("study", "series", "image1") != pixels.left(4))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::compactSeries() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+  }
+
+  // Another store reads the series file while it is replaced by a compacted file
+  {
+    ctkDICOMThumbnailStore writer(thumbnailsDirectory);
+    ctkDICOMThumbnailStore reader(thumbnailsDirectory);
+    if (!writer.setThumbnail("study", "series3", "image1", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels) ||
+        !writer.setThumbnail("study", "series3", "image2", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels) ||
+        !reader.contains("study", "series3", "image1"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore: thumbnail not found by another store" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!writer.removeThumbnail("study", "series3", "image2") ||
+        !writer.compactSeries("study", "series3") ||
+        !writer.setThumbnail("study", "series3", "image3", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::compactSeries() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!reader.contains("study", "series3", "image3") ||
+        reader.thumbnail("study", "series3", "image3") != pixels ||
+        reader.contains("study", "series3", "image2"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore: compacted series file not read by another store" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!writer.removeSeries("study", "series3"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::removeSeries() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+  }
+
+  // Records appended by another store are kept when appending
+  {
+    ctkDICOMThumbnailStore writer1(thumbnailsDirectory);
+    ctkDICOMThumbnailStore writer2(thumbnailsDirectory);
+    if (!writer1.setThumbnail("study", "series5", "image1", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels) ||
+        !writer2.setThumbnail("study", "series5", "image2", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels) ||
+        !writer1.setThumbnail("study", "series5", "image3", ctkDICOMThumbnailStore::RGB888, 2, 2, pixels))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::setThumbnail() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    ctkDICOMThumbnailStore reader(thumbnailsDirectory);
+    if (!reader.contains("study", "series5", "image1") ||
+        reader.thumbnail("study", "series5", "image2") != pixels ||
+        !reader.contains("study", "series5", "image3") ||
+        !writer2.contains("study", "series5", "image3"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore: record appended by another store was lost" << std::endl;
+      return EXIT_FAILURE;
+      }
+  }
+
+  // Migration of thumbnail files, only the PNG header is read
+  QByteArray png("\x89PNG\r\n\x1a\n\0\0\0\x0dIHDR", 16);
+  uchar size[8];
+  qToBigEndian<quint32>(16, size);
+  qToBigEndian<quint32>(8, size + 4);
+  png.append(reinterpret_cast<const char*>(size), 8);
+  QDir().mkpath(thumbnailsDirectory + "/study/series2");
+  QFile pngFile(thumbnailsDirectory + "/study/series2/1.2.3.png");
+  if (!pngFile.open(QIODevice::WriteOnly) || pngFile.write(png) != png.size())
+    {
+    std::cerr << "Failed to write thumbnail file" << std::endl;
+    return EXIT_FAILURE;
+    }
+  pngFile.close();
+  {
+    // Thumbnail files are read without being migrated
+    ctkDICOMThumbnailStore store(thumbnailsDirectory);
+    store.setUseShortStoragePath(false);
+    if (!store.contains("study", "series2", "1.2.3") ||
+        store.thumbnail("study", "series2", "1.2.3") != png ||
+        !pngFile.exists() || QFile::exists(store.seriesFilePath("study", "series2")))
+      {
+      std::cerr << "ctkDICOMThumbnailStore: thumbnail file not read as is" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (store.migrateThumbnailFiles() != 1 || pngFile.exists())
+      {
+      std::cerr << "ctkDICOMThumbnailStore::migrateThumbnailFiles() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    ctkDICOMThumbnailStore::TileFormat format = ctkDICOMThumbnailStore::InvalidFormat;
+    int width = 0;
+    int height = 0;
+    if (store.thumbnail("study", "series2", "1.2.3", &format, &width, &height) != png ||
+        format != ctkDICOMThumbnailStore::PNG || width != 16 || height != 8)
+      {
+      std::cerr << "ctkDICOMThumbnailStore: migrated thumbnail is invalid" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (!store.removeSeries("study", "series2") ||
+        QFile::exists(store.seriesFilePath("study", "series2")) ||
+        !store.contains("study", "series", "image1"))
+      {
+      std::cerr << "ctkDICOMThumbnailStore::removeSeries() failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+  }
+
+  // Migration of thumbnail files named by hashes of the UIDs (default layout of the database)
+  QString hashedSeriesDirectory = thumbnailsDirectory + "/"
+    + QString(QCryptographicHash::hash("study", QCryptographicHash::Md5).toHex()).left(8) + "/"
+    + QString(QCryptographicHash::hash("series4", QCryptographicHash::Md5).toHex()).left(8);
+  QDir().mkpath(hashedSeriesDirectory);
+  QFile hashedPngFile(hashedSeriesDirectory + "/"
+    + QString(QCryptographicHash::hash("1.2.4", QCryptographicHash::Md5).toHex()) + ".png");
+  if (!hashedPngFile.open(QIODevice::WriteOnly) || hashedPngFile.write(png) != png.size())
+    {
+    std::cerr << "Failed to write thumbnail file" << std::endl;
+    return EXIT_FAILURE;
+    }
+  hashedPngFile.close();
+  {
+    ctkDICOMThumbnailStore store(thumbnailsDirectory);
+    if (!store.contains("study", "series4", "1.2.4") ||
+        store.thumbnail("study", "series4", "1.2.4") != png)
+      {
+      std::cerr << "ctkDICOMThumbnailStore: hashed thumbnail file not found" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (store.migrateThumbnailFiles() != 0 || !hashedPngFile.exists())
+      {
+      std::cerr << "ctkDICOMThumbnailStore::migrateThumbnailFiles() migrated hashed file names" << std::endl;
+      return EXIT_FAILURE;
+      }
+    if (store.migrateThumbnailFiles("study", "series4", QStringList() << "1.2.4") != 1 ||
+        hashedPngFile.exists() ||
+        store.thumbnail("study", "series4", "1.2.4") != png)
+      {
+      std::cerr << "ctkDICOMThumbnailStore::migrateThumbnailFiles() failed for an instance list" << std::endl;
+      return EXIT_FAILURE;
+      }
+  }
+
+  return EXIT_SUCCESS;
+}
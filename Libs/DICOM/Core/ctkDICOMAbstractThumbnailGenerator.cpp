@@ -62,3 +62,16 @@ ctkDICOMAbstractThumbnailGenerator::ctkDICOMAbstractThumbnailGenerator(QObject*
 ctkDICOMAbstractThumbnailGenerator::~ctkDICOMAbstractThumbnailGenerator()
 {
 }
+
+//------------------------------------------------------------------------------
+bool ctkDICOMAbstractThumbnailGenerator::generateStoredThumbnail(DicomImage* dcmImage,
+  ctkDICOMThumbnailStore* store, const QString& studyInstanceUID,
+  const QString& seriesInstanceUID, const QString& sopInstanceUID)
+{
+  Q_UNUSED(dcmImage);
+  Q_UNUSED(store);
+  Q_UNUSED(studyInstanceUID);
+  Q_UNUSED(seriesInstanceUID);
+  Q_UNUSED(sopInstanceUID);
+  return false;
+}
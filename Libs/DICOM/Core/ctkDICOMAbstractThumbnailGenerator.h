@@ -28,6 +28,7 @@
 #include "ctkDICOMCoreExport.h"
 
 class ctkDICOMAbstractThumbnailGeneratorPrivate;
+class ctkDICOMThumbnailStore;
 class DicomImage;
 
 /// \ingroup DICOM_Core
@@ -45,6 +46,12 @@ public:
 
   virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path ) = 0;
 
+  /// Generate the thumbnail of an instance into a thumbnail store.
+  /// The default implementation returns false, the thumbnail is then
+  /// saved in a file with generateThumbnail(DicomImage*, QString).
+  virtual bool generateStoredThumbnail(DicomImage* dcmImage, ctkDICOMThumbnailStore* store,
+    const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID);
+
 protected:
   QScopedPointer<ctkDICOMAbstractThumbnailGeneratorPrivate> d_ptr;
 
@@ -21,23 +21,45 @@
 #include <stdexcept>
 
 // Qt includes
+#include <QAtomicInt>
+#include <QCache>
+#include <QDataStream>
 #include <QDate>
 #include <QDebug>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QMetaObject>
+#include <QMutex>
+#include <QRunnable>
 #include <QSet>
+#include <QSharedPointer>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
 #include <QUuid>
 #include <QVariant>
+#include <QWaitCondition>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 // ctkDICOM includes
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMAbstractThumbnailGenerator.h"
 #include "ctkDICOMItem.h"
+#include "ctkDICOMThumbnailStore.h"
 
 #include "ctkLogger.h"
 #include "ctkUtils.h"
@@ -72,6 +94,370 @@ static QString ValueIsEmptyString("__VALUE_IS_EMPTY_STRING__");
 static QString ValueIsNotStored("__VALUE_IS_NOT_STORED__");
 /// Separator character for table and field names to be used in display rules manager
 static QString TableFieldSeparator(":");
+/// Maximum number of values in an SQL "IN (...)" list.
+/// SQLite limits the number of bound parameters in a query (999 by default).
+static int SQL_IN_LIST_MAXIMUM_SIZE = 500;
+/// Default maximum number of tag values stored in the in-memory tag cache
+static int IN_MEMORY_TAG_CACHE_DEFAULT_MAXIMUM_SIZE = 100000;
+/// Table that stores one row for each cached tag (SOPInstanceUID, Tag, Value)
+static QString TagCacheTableName("TagCache");
+/// Table that stores one row for each instance, containing all its cached tags in a packed blob
+static QString CompactTagCacheTableName("TagCacheInstances");
+/// Version of the packed blob format used in the compact tag cache
+static quint8 CompactTagCacheFormatVersion = 1;
+/// Default number of threads storing files in the database folder
+static int FILE_TRANSFER_DEFAULT_THREAD_COUNT = 4;
+
+//------------------------------------------------------------------------------
+/// Used for making read connection names unique, even if a database object
+/// or a thread is created at the same address (or with the same id) as a previous one.
+static QAtomicInt DatabaseInstanceCounter;
+static QAtomicInt ReadConnectionThreadCounter;
+
+//------------------------------------------------------------------------------
+/// Series whose files are being deleted in the background, shared by all database objects
+/// (the indexer inserts through its own database object). Files of these series must not be
+/// stored until the removal is finished, otherwise the removal could delete the new files.
+static QMutex SeriesFileRemovalMutex;
+static QWaitCondition SeriesFileRemovalFinished;
+static QHash<QString, int> SeriesFileRemovalPendingCounts;
+
+//------------------------------------------------------------------------------
+static void beginSeriesFileRemoval(const QString& seriesInstanceUID)
+{
+  QMutexLocker locker(&SeriesFileRemovalMutex);
+  ++SeriesFileRemovalPendingCounts[seriesInstanceUID];
+}
+
+//------------------------------------------------------------------------------
+static void endSeriesFileRemoval(const QString& seriesInstanceUID)
+{
+  QMutexLocker locker(&SeriesFileRemovalMutex);
+  if (--SeriesFileRemovalPendingCounts[seriesInstanceUID] <= 0)
+  {
+    SeriesFileRemovalPendingCounts.remove(seriesInstanceUID);
+  }
+  SeriesFileRemovalFinished.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+static void waitForSeriesFileRemoval(const QString& seriesInstanceUID)
+{
+  QMutexLocker locker(&SeriesFileRemovalMutex);
+  while (SeriesFileRemovalPendingCounts.contains(seriesInstanceUID))
+  {
+    SeriesFileRemovalFinished.wait(&SeriesFileRemovalMutex);
+  }
+}
+
+//------------------------------------------------------------------------------
+/// Read-only database connections that were opened in a thread.
+/// Connections are only used and removed by the thread that opened them:
+/// a connection is replaced when its database has been closed or reopened since
+/// it was opened, and all the connections are removed when the thread finishes.
+class ctkDICOMDatabaseThreadReadConnections
+{
+public:
+  ctkDICOMDatabaseThreadReadConnections()
+    : ThreadNumber(ReadConnectionThreadCounter.fetchAndAddOrdered(1))
+  {
+  }
+  ~ctkDICOMDatabaseThreadReadConnections()
+  {
+    foreach(const QString& connectionName, this->Connections.values())
+    {
+      QSqlDatabase::removeDatabase(connectionName);
+    }
+  }
+  int ThreadNumber;
+  /// Connection name for each database connection key (see threadReadConnection)
+  QHash<QString, QString> Connections;
+};
+
+static QThreadStorage<ctkDICOMDatabaseThreadReadConnections*> ThreadReadConnections;
+
+//------------------------------------------------------------------------------
+/// Reads tag values of a DICOM file, used for reading multiple files in parallel.
+/// Values are computed the same way as in ctkDICOMDatabase::fileValue, before they are stored in the tag cache.
+class ctkDICOMDatabaseTagValuesReaderTask : public QRunnable
+{
+public:
+  ctkDICOMDatabaseTagValuesReaderTask(const QString& filePath, const QList<DcmTagKey>& tagKeys,
+    const QList<bool>& tagsExcludedFromStorage, bool readHeaderOnly, QStringList* values)
+    : FilePath(filePath)
+    , TagKeys(tagKeys)
+    , TagsExcludedFromStorage(tagsExcludedFromStorage)
+    , ReadHeaderOnly(readHeaderOnly)
+    , Values(values)
+  {
+  }
+
+  virtual void run()
+  {
+    ctkDICOMItem dataset;
+    if (this->ReadHeaderOnly)
+    {
+      dataset.InitializeFromFileHeader(this->FilePath);
+    }
+    else
+    {
+      dataset.InitializeFromFile(this->FilePath);
+    }
+    if (!dataset.IsInitialized())
+    {
+      logger.error("File " + this->FilePath + " could not be initialized.");
+      return;
+    }
+    for (int tagIndex = 0; tagIndex < this->TagKeys.size(); ++tagIndex)
+    {
+      const DcmTagKey& tagKey = this->TagKeys[tagIndex];
+      if (this->TagsExcludedFromStorage[tagIndex])
+      {
+        (*this->Values) << (dataset.TagExists(tagKey) ? ValueIsNotStored : TagNotInInstance);
+      }
+      else
+      {
+        (*this->Values) << dataset.GetAllElementValuesAsString(tagKey);
+      }
+    }
+  }
+
+protected:
+  QString FilePath;
+  QList<DcmTagKey> TagKeys;
+  QList<bool> TagsExcludedFromStorage;
+  bool ReadHeaderOnly;
+  QStringList* Values;
+};
+
+//------------------------------------------------------------------------------
+/// Create a hard link. Only supported on Unix systems.
+static bool linkFile(const QString& sourcePath, const QString& destinationPath)
+{
+#if defined(Q_OS_UNIX)
+  return ::link(QFile::encodeName(sourcePath).constData(), QFile::encodeName(destinationPath).constData()) == 0;
+#else
+  Q_UNUSED(sourcePath);
+  Q_UNUSED(destinationPath);
+  return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/// Create a copy-on-write clone of a file. Only supported on Linux file systems
+/// that implement FICLONE (Btrfs, XFS, ...).
+static bool cloneFile(const QString& sourcePath, const QString& destinationPath)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+  int sourceFile = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY);
+  if (sourceFile < 0)
+  {
+    return false;
+  }
+  int destinationFile = ::open(QFile::encodeName(destinationPath).constData(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (destinationFile < 0)
+  {
+    ::close(sourceFile);
+    return false;
+  }
+  bool success = (::ioctl(destinationFile, FICLONE, sourceFile) == 0);
+  ::close(destinationFile);
+  ::close(sourceFile);
+  if (!success)
+  {
+    QFile::remove(destinationPath);
+  }
+  return success;
+#else
+  Q_UNUSED(sourcePath);
+  Q_UNUSED(destinationPath);
+  return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/// Store a file in the database folder using the requested policy.
+/// Methods that are not available fall back to the next one: move, hard link, reflink, copy.
+/// If a moved file cannot be renamed then the original file is removed after it is stored.
+static bool storeFileInDatabaseFolder(const QString& sourcePath, const QString& destinationPath,
+  ctkDICOMDatabase::ImportStoragePolicy policy)
+{
+  QFileInfo sourceInfo(sourcePath);
+  QFileInfo destinationInfo(destinationPath);
+  if (destinationInfo.exists())
+  {
+    if (sourceInfo.canonicalFilePath() == destinationInfo.canonicalFilePath())
+    {
+      // the file is already in the database folder
+      return true;
+    }
+    // replace the previously stored version
+    QFile::remove(destinationPath);
+  }
+  switch (policy)
+  {
+    case ctkDICOMDatabase::MoveFiles:
+      // QDir::rename does not copy the file if it cannot be renamed (e.g., across devices)
+      if (QDir().rename(sourcePath, destinationPath))
+      {
+        return true;
+      }
+      if (!storeFileInDatabaseFolder(sourcePath, destinationPath, ctkDICOMDatabase::HardLinkFiles))
+      {
+        return false;
+      }
+      if (!QFile::remove(sourcePath))
+      {
+        logger.warn("Failed to remove moved file: " + sourcePath);
+      }
+      return true;
+    case ctkDICOMDatabase::HardLinkFiles:
+      if (linkFile(sourcePath, destinationPath))
+      {
+        return true;
+      }
+      // fall through
+    case ctkDICOMDatabase::ReflinkFiles:
+      if (cloneFile(sourcePath, destinationPath))
+      {
+        return true;
+      }
+      // fall through
+    case ctkDICOMDatabase::CopyFiles:
+    default:
+      return QFile::copy(sourcePath, destinationPath);
+  }
+}
+
+//------------------------------------------------------------------------------
+/// Stores a file in the database folder, used for storing multiple files in parallel.
+/// SOP instance UID is added to the failed list if the file could not be stored.
+class ctkDICOMDatabaseFileTransferTask : public QRunnable
+{
+public:
+  ctkDICOMDatabaseFileTransferTask(const QString& sourcePath, const QString& destinationPath,
+    const QString& sopInstanceUID, ctkDICOMDatabase::ImportStoragePolicy policy,
+    QMutex* failedMutex, QStringList* failedSOPInstanceUIDs)
+    : SourcePath(sourcePath)
+    , DestinationPath(destinationPath)
+    , SOPInstanceUID(sopInstanceUID)
+    , Policy(policy)
+    , FailedMutex(failedMutex)
+    , FailedSOPInstanceUIDs(failedSOPInstanceUIDs)
+  {
+  }
+
+  virtual void run()
+  {
+    if (storeFileInDatabaseFolder(this->SourcePath, this->DestinationPath, this->Policy))
+    {
+      return;
+    }
+    logger.error("Error storing file: " + this->SourcePath + " to: " + this->DestinationPath);
+    QMutexLocker locker(this->FailedMutex);
+    (*this->FailedSOPInstanceUIDs) << this->SOPInstanceUID;
+  }
+
+protected:
+  QString SourcePath;
+  QString DestinationPath;
+  QString SOPInstanceUID;
+  ctkDICOMDatabase::ImportStoragePolicy Policy;
+  QMutex* FailedMutex;
+  QStringList* FailedSOPInstanceUIDs;
+};
+
+//------------------------------------------------------------------------------
+/// Progress of a removal, shared by the tasks deleting its files
+struct ctkDICOMDatabaseFileRemovalState
+{
+  int FileCount;
+  QAtomicInt RemovedFileCount;
+  QAtomicInt RemainingTaskCount;
+};
+
+//------------------------------------------------------------------------------
+/// Deletes the files and thumbnails of a removed series, used for deleting multiple series in parallel.
+/// Progress is reported by queued signals of the database.
+class ctkDICOMDatabaseFileRemovalTask : public QRunnable
+{
+public:
+  ctkDICOMDatabaseFileRemovalTask(ctkDICOMDatabase* database, QSharedPointer<ctkDICOMDatabaseFileRemovalState> state,
+    ctkDICOMThumbnailStore* thumbnailStore, const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QStringList& filePaths, const QStringList& thumbnailPaths, int instanceCount)
+    : Database(database)
+    , State(state)
+    , ThumbnailStore(thumbnailStore)
+    , StudyInstanceUID(studyInstanceUID)
+    , SeriesInstanceUID(seriesInstanceUID)
+    , FilePaths(filePaths)
+    , ThumbnailPaths(thumbnailPaths)
+    , InstanceCount(instanceCount)
+  {
+  }
+
+  virtual void run()
+  {
+    QStringList foldersToRemove;
+    foreach (const QString& filePath, this->FilePaths)
+    {
+      if (!QFile::remove(filePath))
+      {
+        logger.warn("Failed to remove file " + filePath);
+        continue;
+      }
+      QString fileFolder = QFileInfo(filePath).absolutePath();
+      if (foldersToRemove.isEmpty() || foldersToRemove.last() != fileFolder)
+      {
+        foldersToRemove << fileFolder;
+      }
+    }
+    foreach (const QString& thumbnailPath, this->ThumbnailPaths)
+    {
+      if (!QFile::exists(thumbnailPath))
+      {
+        continue;
+      }
+      if (!QFile::remove(thumbnailPath))
+      {
+        logger.warn("Failed to remove thumbnail " + thumbnailPath);
+      }
+      QString fileFolder = QFileInfo(thumbnailPath).absolutePath();
+      if (foldersToRemove.isEmpty() || foldersToRemove.last() != fileFolder)
+      {
+        foldersToRemove << fileFolder;
+      }
+    }
+    this->ThumbnailStore->removeSeries(this->StudyInstanceUID, this->SeriesInstanceUID);
+
+    // Delete all empty folders that are left after removing DICOM files
+    // (folders that still contain files, for example of series removed by other tasks, are not removed)
+    foreach (const QString& folderToRemove, foldersToRemove)
+    {
+      QDir().rmpath(folderToRemove);
+    }
+
+    int removedFileCount = this->State->RemovedFileCount.fetchAndAddOrdered(this->InstanceCount) + this->InstanceCount;
+    endSeriesFileRemoval(this->SeriesInstanceUID);
+
+    QMetaObject::invokeMethod(this->Database, "fileRemovalProgress", Qt::QueuedConnection,
+      Q_ARG(int, removedFileCount), Q_ARG(int, this->State->FileCount));
+    if (!this->State->RemainingTaskCount.deref())
+    {
+      QMetaObject::invokeMethod(this->Database, "fileRemovalFinished", Qt::QueuedConnection);
+    }
+  }
+
+protected:
+  ctkDICOMDatabase* Database;
+  QSharedPointer<ctkDICOMDatabaseFileRemovalState> State;
+  ctkDICOMThumbnailStore* ThumbnailStore;
+  QString StudyInstanceUID;
+  QString SeriesInstanceUID;
+  QStringList FilePaths;
+  QStringList ThumbnailPaths;
+  int InstanceCount;
+};
 
 //------------------------------------------------------------------------------
 class ctkDICOMDatabasePrivate
@@ -99,6 +485,20 @@ public:
   /// If the original file is available then that will be inserted. If not then a file is created from the dataset object.
   bool storeDatasetFile(const ctkDICOMItem& dataset, const QString& originalFilePath,
     const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID, QString& storedFilePath);
+  /// Path of the file of an instance in the database folder. The folder is created if needed.
+  QString storedDatasetFilePath(const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID);
+
+  ctkDICOMDatabase::ImportStoragePolicy ImportStoragePolicy;
+  /// Threads storing files of indexing results in the database folder
+  QThreadPool FileTransferThreadPool;
+  /// Threads deleting files of removed series
+  QThreadPool FileRemovalThreadPool;
+
+  /// Remove all the series whose column (Series.SeriesInstanceUID, Series.StudyInstanceUID
+  /// or Studies.PatientsUID) is in the uids list, and the studies and patients that are left
+  /// without series. Database rows are deleted by set-based statements in a single transaction,
+  /// files are deleted in the background by the file removal threads.
+  bool removeSeriesWhere(const QString& column, const QStringList& uids, bool clearCachedTags);
 
   /// Helper function that generates folders for storing an instance in the database.
   /// Folders are based on UIDs, but may be shortened.
@@ -108,6 +508,16 @@ public:
   /// Returns false in case of an error
   bool indexingStatusForFile(const QString& filePath, const QString& sopInstanceUID, bool& datasetInDatabase, bool& datasetUpToDate, QString& databaseFilename);
 
+  /// Returns true if the dataset stored in the database is the file at filePath
+  /// and the file has not been modified since it has been inserted.
+  bool isDatasetUpToDate(const QString& filePath, const QString& insertTimestamp, const QString& databaseFilename);
+
+  /// Get insert timestamp and filename of instances that are already in the database.
+  /// Instances are looked up in chunks, using a few queries instead of one query per instance.
+  /// Returns false in case of an error
+  bool insertedInstances(const QStringList& sopInstanceUIDs,
+    QMap<QString, QPair<QString, QString> >& insertTimestampAndFilenameForInstance);
+
   /// Retrieve thumbnail from file and store in database folder.
   bool storeThumbnailFile(const QString& originalFilePath,
     const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID);
@@ -149,6 +559,17 @@ public:
   /// Get all Filename values from table
   QStringList filenames(QString table);
 
+  /// Get cached tags of multiple instances, using a few queries instead of one query per instance.
+  /// Values are returned the same way as in ctkDICOMDatabase::getCachedTags.
+  /// If tags list is not empty then only those tags are retrieved.
+  /// If storeInMemory is true then the retrieved values are also added to the in-memory tag cache.
+  void getCachedTagsForInstances(const QStringList& sopInstanceUIDs,
+    QMap<QString /*SOPInstanceUID*/, QMap<QString /*Tag*/, QString /*Value*/> >& cachedTagsForInstances,
+    const QStringList& tags = QStringList(), bool storeInMemory = false);
+
+  /// Set DisplayedFieldsUpdatedTimestamp of the listed instances to the current time using a single statement
+  bool setDisplayedFieldsUpdatedTimestamp(const QStringList& sopInstanceUIDs);
+
   QVector<QMap<QString /*DisplayField*/, QString /*Value*/> > displayedFieldsVectorPatient; // The index in the vector is the internal patient UID
   /// Calculate count (number of objects in interest) for each series in the displayed fields container
   /// \param displayedFieldsMapSeries (SeriesInstanceUID -> (DisplayField -> Value) )
@@ -165,6 +586,23 @@ public:
 
   int rowCount(const QString& tableName);
 
+  /// Full-text search index of the patient, study and series fields that users search in.
+  /// It contains a row for each series (with the same rowid as the series) in a virtual table.
+  /// FTS5 module is used if it is available in the SQLite library, FTS4 otherwise.
+  /// SearchIndexModule is empty if the index is not available.
+  QString SearchIndexModule;
+  /// Create the search index table if it does not exist yet and fill it if it is created
+  bool initializeSearchIndex();
+  /// Remove all rows from the index and add the current content of the database
+  bool fillSearchIndex(const QString& condition = QString(), const QVariant& conditionValue = QVariant());
+  /// Update the search index rows of the series that match the condition
+  /// (a column of Series or Studies compared to conditionValue)
+  bool updateSearchIndex(const QString& condition, const QVariant& conditionValue);
+  /// Remove the search index rows of the series that match the condition
+  bool removeFromSearchIndex(const QString& condition, const QVariant& conditionValue);
+  /// Build an FTS query matching all the words of text as prefixes
+  QString searchIndexMatchExpression(const QString& text)const;
+
   /// Convert an internal path (absolute or relative to database folder) to an absolute path.
   QString absolutePathFromInternal(const QString& filename);
   /// Convert an absolute path to an internal path (absolute if outside database folder, relative if inside database folder).
@@ -180,6 +618,7 @@ public:
   bool UseShortStoragePath;
 
   ctkDICOMAbstractThumbnailGenerator* ThumbnailGenerator;
+  ctkDICOMThumbnailStore ThumbnailStore;
 
   ctkDICOMDisplayedFieldGenerator DisplayedFieldGenerator;
 
@@ -210,8 +649,60 @@ public:
   QStringList TagsToPrecache;
   QStringList TagsToExcludeFromStorage;
   bool openTagCacheDatabase();
+
+  /// If true then the cached tags of an instance are stored packed in a single row
+  /// of the compact tag cache table, otherwise each tag is stored in a separate row.
+  bool UseCompactTagCache;
+  QString tagCacheTableName(bool compactFormat) const;
+  /// Read values from the tag cache (values are returned as they are stored in the database).
+  /// If tags is not empty then only the specified tags are returned.
+  bool readCachedTags(QSqlDatabase& database, bool compactFormat, const QStringList& sopInstanceUIDs,
+    const QStringList& tags, QMap<QString /*SOPInstanceUID*/, QMap<QString /*Tag*/, QString /*Value*/> >& storedValuesForInstances);
+  /// Write values to the tag cache (replacing previously stored values of the same tags)
+  bool writeCachedTags(bool compactFormat,
+    const QMap<QString /*SOPInstanceUID*/, QMap<QString /*Tag*/, QString /*Value*/> >& storedValuesForInstances);
+  /// Pack values to a blob: format version, then tag key (group and element as 32-bit integer)
+  /// and length-prefixed UTF-8 value for each tag
+  QByteArray packCachedTags(const QMap<QString, QString>& values);
+  /// Unpack values from a blob. If tagKeys is not empty then only the specified tags are returned.
+  bool unpackCachedTags(const QByteArray& packedValues, const QSet<quint32>& tagKeys, QMap<QString, QString>& values);
+  /// Convert existing tag cache that is stored in the other format
+  bool migrateTagCache();
+  /// Set UseCompactTagCache according to the tag cache table that exists in the
+  /// tag cache database. If there is no tag cache table yet then the format is not changed.
+  void detectTagCacheFormat();
+
+  /// Enable write-ahead logging journal mode for the connection
+  bool enableWriteAheadLogging(QSqlDatabase& database);
+  bool UseWriteAheadLogging;
+  /// Thread that opened the database. Main connections can only be used from this thread.
+  QThread* DatabaseThread;
+  /// Number of this database object, unique in the application
+  int InstanceNumber;
+  /// Incremented when the database is opened or closed, read connections
+  /// that were opened before are not used anymore.
+  QAtomicInt ReadConnectionGeneration;
+  /// Return a connection that can be used for reading from the database in the current thread.
+  /// Returns the main connection if write-ahead logging is disabled or if called from the thread
+  /// that opened the database, otherwise a read-only connection of the current thread.
+  QSqlDatabase readDatabase();
+  QSqlDatabase readTagCacheDatabase();
+  QSqlDatabase threadReadConnection(const QSqlDatabase& mainConnection, const QString& databaseFilename);
+
   void precacheTags(const ctkDICOMItem& dataset, const QString sopInstanceUID);
 
+  /// In-memory least recently used cache in front of the tag cache database.
+  /// Each item contains the cached tag values (as returned by cachedTag) of an instance,
+  /// the cost of the item is the number of tag values.
+  QCache<QString /*SOPInstanceUID*/, QHash<QString /*Tag*/, QString /*Value*/> > InMemoryTagCache;
+  int InMemoryTagCacheHitCount;
+  int InMemoryTagCacheMissCount;
+  mutable QMutex InMemoryTagCacheMutex;
+  /// Returns true and sets value if the tag value is found in the in-memory cache.
+  bool inMemoryCachedTag(const QString& sopInstanceUID, const QString& tag, QString& value);
+  void setInMemoryCachedTag(const QString& sopInstanceUID, const QString& tag, const QString& value);
+  void removeInMemoryCachedTags(const QString& sopInstanceUID);
+
   // Return true if a new item is inserted
   bool insertPatientStudySeries(const ctkDICOMItem& dataset, const QString& patientID, const QString& patientsName);
   bool insertPatient(const ctkDICOMItem& dataset, int& databasePatientID);
@@ -230,6 +721,17 @@ ctkDICOMDatabasePrivate::ctkDICOMDatabasePrivate(ctkDICOMDatabase& o): q_ptr(&o)
   this->TagCacheVerified = false;
   this->DisplayedFieldsTableAvailable = false;
   this->UseShortStoragePath = true;
+  this->UseWriteAheadLogging = false;
+  this->DatabaseThread = NULL;
+  this->InstanceNumber = DatabaseInstanceCounter.fetchAndAddOrdered(1);
+  this->SearchIndexModule = QString();
+  this->InMemoryTagCache.setMaxCost(IN_MEMORY_TAG_CACHE_DEFAULT_MAXIMUM_SIZE);
+  this->InMemoryTagCacheHitCount = 0;
+  this->InMemoryTagCacheMissCount = 0;
+  this->UseCompactTagCache = false;
+  this->ImportStoragePolicy = ctkDICOMDatabase::CopyFiles;
+  this->FileTransferThreadPool.setMaxThreadCount(FILE_TRANSFER_DEFAULT_THREAD_COUNT);
+  this->FileRemovalThreadPool.setMaxThreadCount(FILE_TRANSFER_DEFAULT_THREAD_COUNT);
   this->resetLastInsertedValues();
 }
 
@@ -615,6 +1117,7 @@ bool ctkDICOMDatabasePrivate::insertSeries(const ctkDICOMItem& dataset, QString
     else
     {
       this->InsertedSeriesUIDsCache.insert(seriesInstanceUID);
+      this->updateSearchIndex("Series.SeriesInstanceUID", seriesInstanceUID);
     }
 
     return true;
@@ -653,69 +1156,487 @@ bool ctkDICOMDatabasePrivate::openTagCacheDatabase()
   pragmaSyncQuery.exec("PRAGMA synchronous = OFF");
   pragmaSyncQuery.finish();
 
+  if (this->UseWriteAheadLogging)
+  {
+    this->enableWriteAheadLogging(this->TagCacheDatabase);
+  }
+
   return true;
 }
 
 //------------------------------------------------------------------------------
-void ctkDICOMDatabasePrivate::precacheTags(const ctkDICOMItem& dataset, const QString sopInstanceUID)
+QString ctkDICOMDatabasePrivate::tagCacheTableName(bool compactFormat) const
 {
-  Q_Q(ctkDICOMDatabase);
+  return compactFormat ? CompactTagCacheTableName : TagCacheTableName;
+}
 
-  QStringList sopInstanceUIDs, tags, values;
-  foreach (const QString &tag, this->TagsToPrecache)
-    {
-    unsigned short group, element;
-    q->tagToGroupElement(tag, group, element);
-    DcmTagKey tagKey(group, element);
-    QString value;
-    if (this->TagsToExcludeFromStorage.contains(tag))
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::readCachedTags(QSqlDatabase& database, bool compactFormat,
+  const QStringList& sopInstanceUIDs, const QStringList& tags, QMap<QString, QMap<QString, QString> >& storedValuesForInstances)
+{
+  Q_Q(ctkDICOMDatabase);
+  QString tagCondition;
+  QSet<quint32> tagKeys;
+  if (!tags.isEmpty())
+  {
+    if (compactFormat)
     {
-      if (dataset.TagExists(tagKey))
+      foreach(const QString& tag, tags)
       {
-        value = ValueIsNotStored;
+        unsigned short group, element;
+        if (q->tagToGroupElement(tag, group, element))
+        {
+          tagKeys.insert((static_cast<quint32>(group) << 16) | element);
+        }
       }
-      else
+    }
+    else
+    {
+      QStringList tagPlaceholders;
+      for (int i = 0; i < tags.size(); ++i)
       {
-        value = TagNotInInstance;
+        tagPlaceholders << "?";
       }
+      tagCondition = QString(" AND Tag IN (%1)").arg(tagPlaceholders.join(","));
+    }
+  }
+  bool success = true;
+  for (int chunkStart = 0; chunkStart < sopInstanceUIDs.size(); chunkStart += SQL_IN_LIST_MAXIMUM_SIZE)
+  {
+    QStringList chunk = sopInstanceUIDs.mid(chunkStart, SQL_IN_LIST_MAXIMUM_SIZE);
+    QStringList placeholders;
+    for (int i = 0; i < chunk.size(); ++i)
+    {
+      placeholders << "?";
+    }
+    QSqlQuery selectValues(database);
+    selectValues.setForwardOnly(true);
+    if (compactFormat)
+    {
+      selectValues.prepare(QString("SELECT SOPInstanceUID, Tags FROM %1 WHERE SOPInstanceUID IN (%2)")
+        .arg(CompactTagCacheTableName).arg(placeholders.join(",")));
     }
     else
     {
-      value = dataset.GetAllElementValuesAsString(tagKey);
+      selectValues.prepare(QString("SELECT SOPInstanceUID, Tag, Value FROM %1 WHERE SOPInstanceUID IN (%2)%3")
+        .arg(TagCacheTableName).arg(placeholders.join(",")).arg(tagCondition));
     }
-    sopInstanceUIDs << sopInstanceUID;
-    tags << tag;
-    values << value;
+    foreach(const QString& sopInstanceUID, chunk)
+    {
+      selectValues.addBindValue(sopInstanceUID);
     }
-
-  this->TagCacheDatabase.transaction();
-  q->cacheTags(sopInstanceUIDs, tags, values);
-  this->TagCacheDatabase.commit();
+    if (!compactFormat)
+    {
+      foreach(const QString& tag, tags)
+      {
+        selectValues.addBindValue(tag);
+      }
+    }
+    if (!this->loggedExec(selectValues))
+    {
+      success = false;
+      continue;
+    }
+    while (selectValues.next())
+    {
+      if (compactFormat)
+      {
+        if (!this->unpackCachedTags(selectValues.value(1).toByteArray(), tagKeys,
+          storedValuesForInstances[selectValues.value(0).toString()]))
+        {
+          logger.warn("Invalid compact tag cache entry for SOP Instance UID = " + selectValues.value(0).toString());
+        }
+      }
+      else
+      {
+        storedValuesForInstances[selectValues.value(0).toString()].insert(
+          selectValues.value(1).toString(), selectValues.value(2).toString());
+      }
+    }
+  }
+  return success;
 }
 
 //------------------------------------------------------------------------------
-bool ctkDICOMDatabasePrivate::removeImage(const QString& sopInstanceUID)
+bool ctkDICOMDatabasePrivate::writeCachedTags(bool compactFormat,
+  const QMap<QString, QMap<QString, QString> >& storedValuesForInstances)
 {
-  Q_Q(ctkDICOMDatabase);
-  QSqlQuery deleteFile(Database);
-  deleteFile.prepare("DELETE FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
-  deleteFile.bindValue(":sopInstanceUID", sopInstanceUID);
-  bool success = deleteFile.exec();
-  if (!success)
+  if (storedValuesForInstances.isEmpty())
   {
-    logger.error("SQLITE ERROR deleting old image row: " + deleteFile.lastError().driverText());
+    return true;
   }
-  return success;
+  QSqlQuery insertTags(this->TagCacheDatabase);
+  if (compactFormat)
+  {
+    // Other tags that are already stored for the instances must be preserved
+    QMap<QString, QMap<QString, QString> > mergedValuesForInstances;
+    this->readCachedTags(this->TagCacheDatabase, true, storedValuesForInstances.keys(), QStringList(), mergedValuesForInstances);
+    QVariantList sopInstanceUIDs;
+    QVariantList packedValues;
+    for (QMap<QString, QMap<QString, QString> >::const_iterator instanceIt = storedValuesForInstances.constBegin();
+      instanceIt != storedValuesForInstances.constEnd(); ++instanceIt)
+    {
+      QMap<QString, QString>& mergedValues = mergedValuesForInstances[instanceIt.key()];
+      for (QMap<QString, QString>::const_iterator tagIt = instanceIt->constBegin(); tagIt != instanceIt->constEnd(); ++tagIt)
+      {
+        mergedValues.insert(tagIt.key(), tagIt.value());
+      }
+      sopInstanceUIDs << instanceIt.key();
+      packedValues << this->packCachedTags(mergedValues);
+    }
+    insertTags.prepare(QString("INSERT OR REPLACE INTO %1 VALUES(?,?)").arg(CompactTagCacheTableName));
+    insertTags.addBindValue(sopInstanceUIDs);
+    insertTags.addBindValue(packedValues);
+  }
+  else
+  {
+    QVariantList sopInstanceUIDs;
+    QVariantList tags;
+    QVariantList values;
+    for (QMap<QString, QMap<QString, QString> >::const_iterator instanceIt = storedValuesForInstances.constBegin();
+      instanceIt != storedValuesForInstances.constEnd(); ++instanceIt)
+    {
+      for (QMap<QString, QString>::const_iterator tagIt = instanceIt->constBegin(); tagIt != instanceIt->constEnd(); ++tagIt)
+      {
+        sopInstanceUIDs << instanceIt.key();
+        tags << tagIt.key();
+        values << tagIt.value();
+      }
+    }
+    insertTags.prepare(QString("INSERT OR REPLACE INTO %1 VALUES(?,?,?)").arg(TagCacheTableName));
+    insertTags.addBindValue(sopInstanceUIDs);
+    insertTags.addBindValue(tags);
+    insertTags.addBindValue(values);
+  }
+  return this->loggedExecBatch(insertTags);
 }
 
 //------------------------------------------------------------------------------
-QString ctkDICOMDatabasePrivate::internalStoragePath(const QString& studyInstanceUID,
-  const QString& seriesInstanceUID, const QString& sopInstanceUID)
+QByteArray ctkDICOMDatabasePrivate::packCachedTags(const QMap<QString, QString>& values)
 {
-  QString studyComponent;
-  QString seriesComponent;
-  QString instanceComponent;
-  if (this->UseShortStoragePath)
+  Q_Q(ctkDICOMDatabase);
+  QByteArray packedValues;
+  QDataStream stream(&packedValues, QIODevice::WriteOnly);
+  stream << CompactTagCacheFormatVersion;
+  for (QMap<QString, QString>::const_iterator tagIt = values.constBegin(); tagIt != values.constEnd(); ++tagIt)
+  {
+    unsigned short group, element;
+    if (!q->tagToGroupElement(tagIt.key(), group, element))
+    {
+      logger.warn("Tag " + tagIt.key() + " cannot be stored in the compact tag cache");
+      continue;
+    }
+    stream << ((static_cast<quint32>(group) << 16) | element) << tagIt.value().toUtf8();
+  }
+  return packedValues;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::unpackCachedTags(const QByteArray& packedValues,
+  const QSet<quint32>& tagKeys, QMap<QString, QString>& values)
+{
+  Q_Q(ctkDICOMDatabase);
+  QDataStream stream(packedValues);
+  quint8 formatVersion = 0;
+  stream >> formatVersion;
+  if (formatVersion != CompactTagCacheFormatVersion)
+  {
+    return false;
+  }
+  while (!stream.atEnd())
+  {
+    quint32 tagKey = 0;
+    QByteArray value;
+    stream >> tagKey >> value;
+    if (stream.status() != QDataStream::Ok)
+    {
+      return false;
+    }
+    if (!tagKeys.isEmpty() && !tagKeys.contains(tagKey))
+    {
+      continue;
+    }
+    values.insert(q->groupElementToTag(static_cast<unsigned short>(tagKey >> 16), static_cast<unsigned short>(tagKey & 0xffff)),
+      QString::fromUtf8(value));
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::migrateTagCache()
+{
+  if (!this->openTagCacheDatabase())
+  {
+    return false;
+  }
+  QString sourceTableName = this->tagCacheTableName(!this->UseCompactTagCache);
+  QString targetTableName = this->tagCacheTableName(this->UseCompactTagCache);
+  QStringList tables = this->TagCacheDatabase.tables();
+  if (!tables.contains(sourceTableName))
+  {
+    // nothing to migrate
+    return true;
+  }
+  logger.info(QString("Migrating tag cache from table %1 to %2").arg(sourceTableName).arg(targetTableName));
+
+  this->TagCacheDatabase.transaction();
+  bool success = true;
+  if (!tables.contains(targetTableName))
+  {
+    QSqlQuery createTargetTable(this->TagCacheDatabase);
+    success = this->loggedExec(createTargetTable, this->UseCompactTagCache
+      ? QString("CREATE TABLE %1 (SOPInstanceUID PRIMARY KEY, Tags BLOB)").arg(targetTableName)
+      : QString("CREATE TABLE %1 (SOPInstanceUID, Tag, Value, PRIMARY KEY (SOPInstanceUID, Tag))").arg(targetTableName));
+  }
+
+  // Copy all cached tags, a group of instances at a time
+  QSqlQuery sourceQuery(this->TagCacheDatabase);
+  sourceQuery.setForwardOnly(true);
+  if (success)
+  {
+    success = this->loggedExec(sourceQuery, QString("SELECT DISTINCT SOPInstanceUID FROM %1").arg(sourceTableName));
+  }
+  QStringList sopInstanceUIDs;
+  while (success && sourceQuery.next())
+  {
+    sopInstanceUIDs << sourceQuery.value(0).toString();
+  }
+  sourceQuery.finish();
+  for (int chunkStart = 0; success && chunkStart < sopInstanceUIDs.size(); chunkStart += SQL_IN_LIST_MAXIMUM_SIZE)
+  {
+    QMap<QString, QMap<QString, QString> > storedValuesForInstances;
+    success = this->readCachedTags(this->TagCacheDatabase, !this->UseCompactTagCache,
+      sopInstanceUIDs.mid(chunkStart, SQL_IN_LIST_MAXIMUM_SIZE), QStringList(), storedValuesForInstances)
+      && this->writeCachedTags(this->UseCompactTagCache, storedValuesForInstances);
+  }
+
+  if (success)
+  {
+    QSqlQuery dropSourceTable(this->TagCacheDatabase);
+    success = this->loggedExec(dropSourceTable, QString("DROP TABLE %1").arg(sourceTableName));
+  }
+  if (!success)
+  {
+    logger.error("Failed to migrate tag cache from table " + sourceTableName);
+    this->TagCacheDatabase.rollback();
+    return false;
+  }
+  this->TagCacheDatabase.commit();
+  this->TagCacheVerified = false;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::detectTagCacheFormat()
+{
+  if (!this->openTagCacheDatabase())
+  {
+    return;
+  }
+  QStringList tables = this->TagCacheDatabase.tables();
+  if (tables.contains(this->tagCacheTableName(true)))
+  {
+    this->UseCompactTagCache = true;
+  }
+  else if (tables.contains(this->tagCacheTableName(false)))
+  {
+    this->UseCompactTagCache = false;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::enableWriteAheadLogging(QSqlDatabase& database)
+{
+  QSqlQuery journalModeQuery(database);
+  if (!this->loggedExec(journalModeQuery, "PRAGMA journal_mode = WAL"))
+  {
+    return false;
+  }
+  // The journal mode is not changed if it is not supported (e.g., for in-memory databases)
+  QString journalMode;
+  if (journalModeQuery.next())
+  {
+    journalMode = journalModeQuery.value(0).toString();
+  }
+  journalModeQuery.finish();
+  if (journalMode.compare("wal", Qt::CaseInsensitive) != 0)
+  {
+    logger.warn(QString("Failed to enable write-ahead logging for %1, journal mode is %2")
+      .arg(database.databaseName()).arg(journalMode));
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+QSqlDatabase ctkDICOMDatabasePrivate::readDatabase()
+{
+  return this->threadReadConnection(this->Database, this->DatabaseFileName);
+}
+
+//------------------------------------------------------------------------------
+QSqlDatabase ctkDICOMDatabasePrivate::readTagCacheDatabase()
+{
+  return this->threadReadConnection(this->TagCacheDatabase, this->TagCacheDatabaseFilename);
+}
+
+//------------------------------------------------------------------------------
+QSqlDatabase ctkDICOMDatabasePrivate::threadReadConnection(const QSqlDatabase& mainConnection, const QString& databaseFilename)
+{
+  Q_Q(ctkDICOMDatabase);
+  if (!this->UseWriteAheadLogging || q->isInMemory() || !mainConnection.isOpen()
+    || QThread::currentThread() == this->DatabaseThread)
+  {
+    return mainConnection;
+  }
+
+  if (!ThreadReadConnections.hasLocalData())
+  {
+    ThreadReadConnections.setLocalData(new ctkDICOMDatabaseThreadReadConnections);
+  }
+  ctkDICOMDatabaseThreadReadConnections* threadConnections = ThreadReadConnections.localData();
+  QString connectionKey = QString("%1_%2").arg(mainConnection.connectionName()).arg(this->InstanceNumber);
+  QString connectionName = QString("%1Read_%2_%3_%4").arg(mainConnection.connectionName())
+    .arg(this->InstanceNumber).arg(this->ReadConnectionGeneration.fetchAndAddOrdered(0))
+    .arg(threadConnections->ThreadNumber);
+  QHash<QString, QString>::iterator previousConnectionIt = threadConnections->Connections.find(connectionKey);
+  if (previousConnectionIt != threadConnections->Connections.end())
+  {
+    if (previousConnectionIt.value() == connectionName)
+    {
+      return QSqlDatabase::database(connectionName);
+    }
+    // database was closed since this connection was opened
+    QSqlDatabase::removeDatabase(previousConnectionIt.value());
+    threadConnections->Connections.erase(previousConnectionIt);
+  }
+
+  QSqlDatabase connection = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+  connection.setDatabaseName(databaseFilename);
+  connection.setConnectOptions("QSQLITE_OPEN_READONLY");
+  if (!connection.open())
+  {
+    logger.error(QString("Failed to open read connection to %1: %2")
+      .arg(databaseFilename).arg(connection.lastError().text()));
+  }
+
+  // Removed by this thread when the database is reopened or when the thread finishes
+  threadConnections->Connections[connectionKey] = connectionName;
+
+  return connection;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::inMemoryCachedTag(const QString& sopInstanceUID, const QString& tag, QString& value)
+{
+  QMutexLocker locker(&this->InMemoryTagCacheMutex);
+  QHash<QString, QString>* cachedTags = this->InMemoryTagCache.object(sopInstanceUID);
+  if (cachedTags)
+  {
+    QHash<QString, QString>::const_iterator cachedTagIt = cachedTags->constFind(tag);
+    if (cachedTagIt != cachedTags->constEnd())
+    {
+      value = cachedTagIt.value();
+      this->InMemoryTagCacheHitCount++;
+      return true;
+    }
+  }
+  this->InMemoryTagCacheMissCount++;
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::setInMemoryCachedTag(const QString& sopInstanceUID, const QString& tag, const QString& value)
+{
+  QMutexLocker locker(&this->InMemoryTagCacheMutex);
+  if (this->InMemoryTagCache.maxCost() <= 0)
+  {
+    return;
+  }
+  // Take out the item and insert it again to update its cost
+  QHash<QString, QString>* cachedTags = this->InMemoryTagCache.take(sopInstanceUID);
+  if (!cachedTags)
+  {
+    cachedTags = new QHash<QString, QString>;
+  }
+  cachedTags->insert(tag, value);
+  // QCache takes ownership of the item (and deletes it if it cannot be inserted)
+  this->InMemoryTagCache.insert(sopInstanceUID, cachedTags, cachedTags->size());
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::removeInMemoryCachedTags(const QString& sopInstanceUID)
+{
+  QMutexLocker locker(&this->InMemoryTagCacheMutex);
+  this->InMemoryTagCache.remove(sopInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::precacheTags(const ctkDICOMItem& dataset, const QString sopInstanceUID)
+{
+  Q_Q(ctkDICOMDatabase);
+
+  QStringList sopInstanceUIDs, tags, values;
+  foreach (const QString &tag, this->TagsToPrecache)
+    {
+    unsigned short group, element;
+    q->tagToGroupElement(tag, group, element);
+    DcmTagKey tagKey(group, element);
+    bool excludedFromStorage = this->TagsToExcludeFromStorage.contains(tag);
+    if (dataset.IsPixelDataSkipped() && !(tagKey < DCM_PixelData || (tagKey == DCM_PixelData && excludedFromStorage)))
+    {
+      // Not read from the file, it is not cached so that it is read from the file when requested
+      continue;
+    }
+    QString value;
+    if (excludedFromStorage)
+    {
+      if (dataset.TagExists(tagKey))
+      {
+        value = ValueIsNotStored;
+      }
+      else
+      {
+        value = TagNotInInstance;
+      }
+    }
+    else
+    {
+      value = dataset.GetAllElementValuesAsString(tagKey);
+    }
+    sopInstanceUIDs << sopInstanceUID;
+    tags << tag;
+    values << value;
+    }
+
+  this->TagCacheDatabase.transaction();
+  q->cacheTags(sopInstanceUIDs, tags, values);
+  this->TagCacheDatabase.commit();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::removeImage(const QString& sopInstanceUID)
+{
+  Q_Q(ctkDICOMDatabase);
+  QSqlQuery deleteFile(Database);
+  deleteFile.prepare("DELETE FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
+  deleteFile.bindValue(":sopInstanceUID", sopInstanceUID);
+  bool success = deleteFile.exec();
+  if (!success)
+  {
+    logger.error("SQLITE ERROR deleting old image row: " + deleteFile.lastError().driverText());
+  }
+  return success;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::internalStoragePath(const QString& studyInstanceUID,
+  const QString& seriesInstanceUID, const QString& sopInstanceUID)
+{
+  QString studyComponent;
+  QString seriesComponent;
+  QString instanceComponent;
+  if (this->UseShortStoragePath)
   {
     // MD5 hash is chosen because it is short (its hex digest is 16 characters) and we do not need cryptographically strong hash.
     // It is not a problem if clash occurs in study or series folders (it would just mean that multiple studies or series would be stored in a folder),
@@ -750,14 +1671,7 @@ bool ctkDICOMDatabasePrivate::storeDatasetFile(const ctkDICOMItem& dataset, cons
     return false;
   }
 
-  storedFilePath = q->databaseDirectory() + "/dicom/"
-    + this->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".dcm";
-
-  QDir destinationDir(QFileInfo(storedFilePath).dir());
-  if (!destinationDir.exists())
-  {
-    destinationDir.mkpath(".");
-  }
+  storedFilePath = this->storedDatasetFilePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
 
   if (originalFilePath.isEmpty())
   {
@@ -774,17 +1688,38 @@ bool ctkDICOMDatabasePrivate::storeDatasetFile(const ctkDICOMItem& dataset, cons
   else
   {
     // we're inserting an existing file
-    QFile currentFile(originalFilePath);
-    currentFile.copy(storedFilePath);
     if (this->LoggedExecVerbose)
     {
-      logger.debug("Copy file from: " + originalFilePath + " to: " + storedFilePath);
+      logger.debug("Store file from: " + originalFilePath + " to: " + storedFilePath);
+    }
+    if (!storeFileInDatabaseFolder(originalFilePath, storedFilePath, this->ImportStoragePolicy))
+    {
+      logger.error("Error storing file: " + originalFilePath + " to: " + storedFilePath);
+      return false;
     }
   }
 
   return true;
 }
 
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::storedDatasetFilePath(const QString& studyInstanceUID,
+  const QString& seriesInstanceUID, const QString& sopInstanceUID)
+{
+  Q_Q(ctkDICOMDatabase);
+  // the series may be re-imported while its previous files are still being deleted
+  waitForSeriesFileRemoval(seriesInstanceUID);
+  QString storedFilePath = q->databaseDirectory() + "/dicom/"
+    + this->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".dcm";
+
+  QDir destinationDir(QFileInfo(storedFilePath).dir());
+  if (!destinationDir.exists())
+  {
+    destinationDir.mkpath(".");
+  }
+  return storedFilePath;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabasePrivate::indexingStatusForFile(const QString& filePath, const QString& sopInstanceUID,
   bool& datasetInDatabase, bool& datasetUpToDate, QString& databaseFilename)
@@ -815,22 +1750,59 @@ bool ctkDICOMDatabasePrivate::indexingStatusForFile(const QString& filePath, con
   // The SOP instance UID exists in the database. In theory, new SOP instance UID must be generated if
   // a file is modified, but some software may not respect this, so check if the file was modified.
   databaseFilename = fileExistsQuery.value(1).toString();
+  datasetUpToDate = this->isDatasetUpToDate(filePath, fileExistsQuery.value(0).toString(), databaseFilename);
+
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::isDatasetUpToDate(const QString& filePath,
+  const QString& insertTimestamp, const QString& databaseFilename)
+{
   QFileInfo databaseFileInfo(databaseFilename);
-  if (!databaseFileInfo.isRelative())
+  if (databaseFileInfo.isRelative())
   {
-    // database stores a link to an external file, if it is the same filename and the file has not changed
-    // since insertion date then it means that the dataset is up-to-date
-    QDateTime fileLastModified(databaseFileInfo.lastModified());
-    QDateTime databaseInsertTimestamp(QDateTime::fromString(fileExistsQuery.value(0).toString(), Qt::ISODate));
-    // Compare QFileInfo objects instead of path strings to ensure equivalent file names
-    // (such as same file name in uppercase/lowercase on Windows) are considered as equal.
-    if (databaseFileInfo == QFileInfo(filePath) && fileLastModified < databaseInsertTimestamp)
+    // copy of the file is stored in the database folder
+    return false;
+  }
+  // database stores a link to an external file, if it is the same filename and the file has not changed
+  // since insertion date then it means that the dataset is up-to-date
+  QDateTime fileLastModified(databaseFileInfo.lastModified());
+  QDateTime databaseInsertTimestamp(QDateTime::fromString(insertTimestamp, Qt::ISODate));
+  // Compare QFileInfo objects instead of path strings to ensure equivalent file names
+  // (such as same file name in uppercase/lowercase on Windows) are considered as equal.
+  return (databaseFileInfo == QFileInfo(filePath) && fileLastModified < databaseInsertTimestamp);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::insertedInstances(const QStringList& sopInstanceUIDs,
+  QMap<QString, QPair<QString, QString> >& insertTimestampAndFilenameForInstance)
+{
+  for (int chunkStart = 0; chunkStart < sopInstanceUIDs.size(); chunkStart += SQL_IN_LIST_MAXIMUM_SIZE)
+  {
+    QStringList chunk = sopInstanceUIDs.mid(chunkStart, SQL_IN_LIST_MAXIMUM_SIZE);
+    QStringList placeholders;
+    for (int i = 0; i < chunk.size(); ++i)
+    {
+      placeholders << "?";
+    }
+    QSqlQuery insertedInstancesQuery(this->Database);
+    insertedInstancesQuery.prepare(QString("SELECT SOPInstanceUID, InsertTimestamp, Filename FROM Images WHERE SOPInstanceUID IN (%1)")
+      .arg(placeholders.join(",")));
+    foreach(const QString& sopInstanceUID, chunk)
+    {
+      insertedInstancesQuery.addBindValue(sopInstanceUID);
+    }
+    if (!this->loggedExec(insertedInstancesQuery))
     {
-      // this file is already added and database is up-to-date
-      datasetUpToDate = true;
+      return false;
+    }
+    while (insertedInstancesQuery.next())
+    {
+      insertTimestampAndFilenameForInstance[insertedInstancesQuery.value(0).toString()] =
+        qMakePair(insertedInstancesQuery.value(1).toString(), insertedInstancesQuery.value(2).toString());
     }
   }
-
   return true;
 }
 
@@ -913,21 +1885,39 @@ bool ctkDICOMDatabasePrivate::storeThumbnailFile(const QString& originalFilePath
   {
     return false;
   }
+  // the thumbnails of the series are deleted when its removal finishes
+  waitForSeriesFileRemoval(seriesInstanceUID);
   // Create thumbnail here
+  QDateTime originalFileTime = QFileInfo(originalFilePath).lastModified();
+  ctkDICOMThumbnailStore* thumbnailStore = q->thumbnailStore();
+  QDateTime storedThumbnailTime = thumbnailStore->thumbnailTime(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+  if (storedThumbnailTime.isValid() && storedThumbnailTime > originalFileTime)
+  {
+    // thumbnail already exists and up-to-date
+    return true;
+  }
   QString thumbnailPath = q->databaseDirectory() +
     "/thumbs/" + this->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".png";
   QFileInfo thumbnailInfo(thumbnailPath);
-  if (thumbnailInfo.exists() && (thumbnailInfo.lastModified() > QFileInfo(originalFilePath).lastModified()))
+  if (thumbnailInfo.exists() && (thumbnailInfo.lastModified() > originalFileTime))
   {
     // thumbnail already exists and up-to-date
     return true;
   }
+  // Only the first frame is shown in the thumbnail, partial access avoids decompressing all frames
+  DicomImage dcmImage(QDir::toNativeSeparators(originalFilePath).toUtf8(),
+    CIF_UsePartialAccessToPixelData, 0, 1);
+  if (this->ThumbnailGenerator->generateStoredThumbnail(&dcmImage, thumbnailStore,
+    studyInstanceUID, seriesInstanceUID, sopInstanceUID))
+  {
+    return true;
+  }
+  // The generator can only write thumbnail files
   QDir destinationDir(thumbnailInfo.dir());
   if (!destinationDir.exists())
   {
     destinationDir.mkpath(".");
   }
-  DicomImage dcmImage(QDir::toNativeSeparators(originalFilePath).toUtf8());
   return this->ThumbnailGenerator->generateThumbnail(&dcmImage, thumbnailPath);
 }
 
@@ -1100,19 +2090,75 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
   Q_D(ctkDICOMDatabase);
   bool databaseWasChanged = false;
 
+  QTime timeProbe;
+  timeProbe.start();
+
   d->TagCacheDatabase.transaction();
   d->Database.transaction();
 
-  QDir databaseDirectory(this->databaseDirectory());
+  // Get all instances of the batch that are already in the database, using a few queries
+  QStringList sopInstanceUIDs;
   foreach(const ctkDICOMDatabase::IndexingResult & indexingResult, indexingResults)
   {
+    sopInstanceUIDs << indexingResult.dataset->GetElementAsString(DCM_SOPInstanceUID);
+  }
+  QMap<QString, QPair<QString, QString> > insertTimestampAndFilenameForInstance;
+  if (!d->insertedInstances(sopInstanceUIDs, insertTimestampAndFilenameForInstance))
+  {
+    logger.error("Failed to get list of instances that are already in the database");
+  }
+
+  // If an instance occurs multiple times in the batch then only its last occurrence is inserted,
+  // otherwise files of the same instance would be stored in parallel to the same location.
+  QMap<QString, int> lastResultIndexForInstance;
+  for (int resultIndex = 0; resultIndex < sopInstanceUIDs.size(); ++resultIndex)
+  {
+    lastResultIndexForInstance[sopInstanceUIDs[resultIndex]] = resultIndex;
+  }
+
+  // Statements are prepared only once for the whole batch
+  QSqlQuery removeImageStatement(d->Database);
+  removeImageStatement.prepare("DELETE FROM Images WHERE SOPInstanceUID == ?");
+  QSqlQuery insertImageStatement(d->Database);
+  insertImageStatement.prepare("INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ? )");
+
+  // Tags to precache are parsed only once for the whole batch
+  QList<DcmTagKey> tagKeysToPrecache;
+  QList<bool> tagsToPrecacheExcludedFromStorage;
+  foreach(const QString & tag, d->TagsToPrecache)
+  {
+    unsigned short group, element;
+    this->tagToGroupElement(tag, group, element);
+    tagKeysToPrecache << DcmTagKey(group, element);
+    tagsToPrecacheExcludedFromStorage << d->TagsToExcludeFromStorage.contains(tag);
+  }
+
+  // Tag cache values are collected and inserted at once at the end of the batch
+  QMap<QString /*SOPInstanceUID*/, QMap<QString /*Tag*/, QString /*Value*/> > tagCacheValuesForInstances;
+  int cachedTagCount = 0;
+
+  // Instances whose file could not be stored in the database folder
+  QMutex failedFileTransferMutex;
+  QStringList failedFileTransferSOPInstanceUIDs;
+  // Added instances are only reported when their files are stored
+  QStringList addedSOPInstanceUIDs;
+
+  QDir databaseDirectory(this->databaseDirectory());
+  int insertedInstanceCount = 0;
+  for (int resultIndex = 0; resultIndex < indexingResults.size(); ++resultIndex)
+  {
+    const ctkDICOMDatabase::IndexingResult& indexingResult = indexingResults[resultIndex];
     const ctkDICOMItem& dataset = *indexingResult.dataset.data();
     QString filePath = indexingResult.filePath;
     bool generateThumbnail = false; // thumbnail will be generated when needed, don't slow down import with that
     bool storeFile = indexingResult.copyFile;
 
     // Check to see if the file has already been loaded
-    QString sopInstanceUID(dataset.GetElementAsString(DCM_SOPInstanceUID));
+    const QString& sopInstanceUID = sopInstanceUIDs[resultIndex];
+    if (!sopInstanceUID.isEmpty() && lastResultIndexForInstance[sopInstanceUID] != resultIndex)
+    {
+      continue;
+    }
     bool datasetInDatabase = false;
     bool datasetUpToDate = false;
     if (indexingResult.overwriteExistingDataset)
@@ -1125,11 +2171,12 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
     {
       // there is no exact file match, but there may be still a different file in the database
       // for the same SOP instance UID
-      QString databaseFilename;
-      if (!d->indexingStatusForFile(filePath, sopInstanceUID, datasetInDatabase, datasetUpToDate, databaseFilename))
+      QMap<QString, QPair<QString, QString> >::const_iterator insertedInstanceIt =
+        insertTimestampAndFilenameForInstance.constFind(sopInstanceUID);
+      if (insertedInstanceIt != insertTimestampAndFilenameForInstance.constEnd())
       {
-        // error occurred, message is already logged
-        continue;
+        datasetInDatabase = true;
+        datasetUpToDate = d->isDatasetUpToDate(filePath, insertedInstanceIt->first, insertedInstanceIt->second);
       }
     }
 
@@ -1140,11 +2187,13 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
         continue;
       }
       // File is updated, delete record and re-index
-      if (!d->removeImage(sopInstanceUID))
+      removeImageStatement.bindValue(0, sopInstanceUID);
+      if (!d->loggedExec(removeImageStatement))
       {
         logger.error("Failed to insert file into database (cannot update pre-existing item): " + filePath);
         continue;
       }
+      insertTimestampAndFilenameForInstance.remove(sopInstanceUID);
     }
 
     // Verify that minimum required fields are present
@@ -1159,12 +2208,25 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
     QString storedFilePath = filePath;
     if (storeFile && !seriesInstanceUID.isEmpty() && !this->isInMemory())
     {
-      if (!d->storeDatasetFile(dataset, filePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID, storedFilePath))
+      if (filePath.isEmpty() || sopInstanceUID.isEmpty())
       {
-        continue;
+        if (!d->storeDatasetFile(dataset, filePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID, storedFilePath))
+        {
+          continue;
+        }
+      }
+      else
+      {
+        // Files are stored in parallel while the database is updated. Instances whose file
+        // could not be stored are removed before the transaction is committed.
+        storedFilePath = d->storedDatasetFilePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+        d->FileTransferThreadPool.start(new ctkDICOMDatabaseFileTransferTask(filePath, storedFilePath,
+          sopInstanceUID, d->ImportStoragePolicy, &failedFileTransferMutex, &failedFileTransferSOPInstanceUIDs));
       }
     }
 
+    // Patients, studies, and series that are already inserted are cached in memory,
+    // so database is only queried for the first instance of each series.
     if (d->insertPatientStudySeries(dataset, patientID, patientsName))
     {
       databaseWasChanged = true;
@@ -1172,17 +2234,18 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
 
     if (!storedFilePath.isEmpty() && !seriesInstanceUID.isEmpty())
     {
-      // Insert all pre-cached fields into tag cache
-      QSqlQuery insertTags(d->TagCacheDatabase);
-      insertTags.prepare("INSERT OR REPLACE INTO TagCache VALUES(?,?,?)");
-      insertTags.bindValue(0, sopInstanceUID);
-      foreach(const QString & tag, d->TagsToPrecache)
+      // Collect all pre-cached fields for the tag cache
+      for (int tagIndex = 0; tagIndex < tagKeysToPrecache.size(); ++tagIndex)
       {
-        unsigned short group, element;
-        this->tagToGroupElement(tag, group, element);
-        DcmTagKey tagKey(group, element);
+        const DcmTagKey& tagKey = tagKeysToPrecache[tagIndex];
+        if (dataset.IsPixelDataSkipped() && !(tagKey < DCM_PixelData
+          || (tagKey == DCM_PixelData && tagsToPrecacheExcludedFromStorage[tagIndex])))
+        {
+          // Not read from the file, it is not cached so that it is read from the file when requested
+          continue;
+        }
         QString value;
-        if (d->TagsToExcludeFromStorage.contains(tag))
+        if (tagsToPrecacheExcludedFromStorage[tagIndex])
         {
           if (dataset.TagExists(tagKey))
           {
@@ -1197,16 +2260,8 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
         {
           value = dataset.GetAllElementValuesAsString(tagKey);
         }
-        insertTags.bindValue(1, tag);
-        if (value.isEmpty())
-        {
-          insertTags.bindValue(2, TagNotInInstance);
-        }
-        else
-        {
-          insertTags.bindValue(2, value);
-        }
-        insertTags.exec();
+        tagCacheValuesForInstances[sopInstanceUID].insert(d->TagsToPrecache[tagIndex], value.isEmpty() ? TagNotInInstance : value);
+        cachedTagCount++;
       }
 
       // Get filename that will be stored in the database.
@@ -1214,7 +2269,7 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
       QString storedFilePathInDatabase;
       if (storeFile)
       {
-        storedFilePathInDatabase = QDir(this->databaseDirectory()).relativeFilePath(storedFilePath);
+        storedFilePathInDatabase = databaseDirectory.relativeFilePath(storedFilePath);
       }
       else
       {
@@ -1222,18 +2277,17 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
       }
 
       // Insert image files
-      QSqlQuery insertImageStatement(d->Database);
-      insertImageStatement.prepare("INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ? )");
-      insertImageStatement.addBindValue(sopInstanceUID);
-      insertImageStatement.addBindValue(storedFilePathInDatabase);
-      insertImageStatement.addBindValue(seriesInstanceUID);
-      insertImageStatement.addBindValue(QDateTime::currentDateTime());
+      QDateTime insertTimestamp = QDateTime::currentDateTime();
+      insertImageStatement.bindValue(0, sopInstanceUID);
+      insertImageStatement.bindValue(1, storedFilePathInDatabase);
+      insertImageStatement.bindValue(2, seriesInstanceUID);
+      insertImageStatement.bindValue(3, insertTimestamp);
       insertImageStatement.exec();
-      emit instanceAdded(sopInstanceUID);
-      if (d->LoggedExecVerbose)
-      {
-        qDebug() << "Instance Added";
-      }
+      // Remember the inserted instance, in case the same instance occurs again in this batch
+      insertTimestampAndFilenameForInstance[sopInstanceUID] =
+        qMakePair(insertTimestamp.toString(Qt::ISODate), storedFilePathInDatabase);
+      insertedInstanceCount++;
+      addedSOPInstanceUIDs << sopInstanceUID;
       databaseWasChanged = true;
 
       if (generateThumbnail)
@@ -1243,15 +2297,133 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
     }
   }
 
-  d->Database.commit();
-  d->TagCacheDatabase.commit();
+  d->FileTransferThreadPool.waitForDone();
+  foreach(const QString& sopInstanceUID, failedFileTransferSOPInstanceUIDs)
+  {
+    removeImageStatement.bindValue(0, sopInstanceUID);
+    d->loggedExec(removeImageStatement);
+    tagCacheValuesForInstances.remove(sopInstanceUID);
+    addedSOPInstanceUIDs.removeAll(sopInstanceUID);
+    insertedInstanceCount--;
+  }
+
+  if (!tagCacheValuesForInstances.isEmpty())
+  {
+    d->writeCachedTags(d->UseCompactTagCache, tagCacheValuesForInstances);
+    // Cached tags of re-inserted instances may have changed
+    foreach(const QString& sopInstanceUID, tagCacheValuesForInstances.keys())
+    {
+      d->removeInMemoryCachedTags(sopInstanceUID);
+    }
+  }
+
+  d->Database.commit();
+  d->TagCacheDatabase.commit();
+
+  foreach(const QString& sopInstanceUID, addedSOPInstanceUIDs)
+  {
+    emit instanceAdded(sopInstanceUID);
+    if (d->LoggedExecVerbose)
+    {
+      qDebug() << "Instance Added";
+    }
+  }
+
+  double elapsedTimeInSeconds = timeProbe.elapsed() / 1000.0;
+  if (elapsedTimeInSeconds > 0.0)
+  {
+    logger.debug(QString("DICOM database has inserted %1 instances and %2 cached tags [%3s, %4 instances/s, %5 cached tags/s]")
+      .arg(insertedInstanceCount).arg(cachedTagCount)
+      .arg(QString::number(elapsedTimeInSeconds, 'f', 2))
+      .arg(QString::number(insertedInstanceCount / elapsedTimeInSeconds, 'f', 0))
+      .arg(QString::number(cachedTagCount / elapsedTimeInSeconds, 'f', 0)));
+  }
+
+  if (databaseWasChanged && this->isInMemory())
+  {
+    emit this->databaseChanged();
+  }
+}
+
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::generateThumbnailForInstance(const QString& sopInstanceUID)
+{
+  Q_D(ctkDICOMDatabase);
+  if (!d->ThumbnailGenerator)
+  {
+    return false;
+  }
+  QString filePath = this->fileForInstance(sopInstanceUID);
+  if (filePath.isEmpty())
+  {
+    return false;
+  }
+  QString seriesInstanceUID = this->seriesForFile(filePath);
+  QString studyInstanceUID = this->studyForSeries(seriesInstanceUID);
+  return d->storeThumbnailFile(filePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::getCachedTagsForInstances(const QStringList& sopInstanceUIDs,
+  QMap<QString, QMap<QString, QString> >& cachedTagsForInstances, const QStringList& tags, bool storeInMemory)
+{
+  QSqlDatabase tagCacheDatabase = this->readTagCacheDatabase();
+  QMap<QString, QMap<QString, QString> > storedValuesForInstances;
+  this->readCachedTags(tagCacheDatabase, this->UseCompactTagCache, sopInstanceUIDs, tags, storedValuesForInstances);
+  for (QMap<QString, QMap<QString, QString> >::const_iterator instanceIt = storedValuesForInstances.constBegin();
+    instanceIt != storedValuesForInstances.constEnd(); ++instanceIt)
+  {
+    QMap<QString, QString>& cachedTags = cachedTagsForInstances[instanceIt.key()];
+    for (QMap<QString, QString>::const_iterator tagIt = instanceIt->constBegin(); tagIt != instanceIt->constEnd(); ++tagIt)
+    {
+      QString value = tagIt.value();
+      if (storeInMemory)
+      {
+        this->setInMemoryCachedTag(instanceIt.key(), tagIt.key(), value.isEmpty() ? ValueIsEmptyString : value);
+      }
+      if (value == TagNotInInstance || value == ValueIsEmptyString || value == ValueIsNotStored)
+      {
+        value = QString("");
+      }
+      cachedTags.insert(tagIt.key(), value);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::setDisplayedFieldsUpdatedTimestamp(const QStringList& sopInstanceUIDs)
+{
+  // Collect the instances in a temporary table so that all of them can be updated by one statement
+  QSqlQuery createTableQuery(this->Database);
+  if (!this->loggedExec(createTableQuery,
+    "CREATE TEMPORARY TABLE IF NOT EXISTS DisplayedFieldsUpdatedImages (SOPInstanceUID VARCHAR(64) PRIMARY KEY)"))
+  {
+    return false;
+  }
+  QSqlQuery clearTableQuery(this->Database);
+  this->loggedExec(clearTableQuery, "DELETE FROM DisplayedFieldsUpdatedImages");
 
-  if (databaseWasChanged && this->isInMemory())
+  QSqlQuery insertQuery(this->Database);
+  insertQuery.prepare("INSERT OR IGNORE INTO DisplayedFieldsUpdatedImages VALUES (?)");
+  QVariantList sopInstanceUIDValues;
+  foreach(const QString& sopInstanceUID, sopInstanceUIDs)
   {
-    emit this->databaseChanged();
+    sopInstanceUIDValues << sopInstanceUID;
   }
-}
+  insertQuery.addBindValue(sopInstanceUIDValues);
+  if (!this->loggedExecBatch(insertQuery))
+  {
+    return false;
+  }
+
+  QSqlQuery updateQuery(this->Database);
+  bool success = this->loggedExec(updateQuery, "UPDATE Images SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP "
+    "WHERE SOPInstanceUID IN (SELECT SOPInstanceUID FROM DisplayedFieldsUpdatedImages)");
 
+  this->loggedExec(clearTableQuery, "DELETE FROM DisplayedFieldsUpdatedImages");
+  return success;
+}
 
 //------------------------------------------------------------------------------
 QString ctkDICOMDatabasePrivate::getDisplayPatientFieldsKey(const QString& patientID,
@@ -1299,13 +2471,10 @@ QString ctkDICOMDatabasePrivate::getDisplayPatientFieldsKey(const QString& patie
 //------------------------------------------------------------------------------
 QString ctkDICOMDatabasePrivate::getDisplayStudyFieldsKey(QString studyInstanceUID, QMap<QString, QMap<QString, QString> > &displayedFieldsMapStudy)
 {
-  // Look for the study in the displayed fields cache first
-  foreach (QString currentStudyInstanceUid, displayedFieldsMapStudy.keys())
+  // Look for the study in the displayed fields cache first (studies are stored by StudyInstanceUID)
+  if (displayedFieldsMapStudy.contains(studyInstanceUID))
   {
-    if ( !displayedFieldsMapStudy[currentStudyInstanceUid]["StudyInstanceUID"].compare(studyInstanceUID) )
-    {
-      return studyInstanceUID;
-    }
+    return studyInstanceUID;
   }
 
   // Look for the study in the display database
@@ -1340,13 +2509,10 @@ QString ctkDICOMDatabasePrivate::getDisplayStudyFieldsKey(QString studyInstanceU
 //------------------------------------------------------------------------------
 QString ctkDICOMDatabasePrivate::getDisplaySeriesFieldsKey(QString seriesInstanceUID, QMap<QString, QMap<QString, QString> > &displayedFieldsMapSeries)
 {
-  // Look for the series in the displayed fields cache first
-  foreach (QString currentSeriesInstanceUid, displayedFieldsMapSeries.keys())
+  // Look for the series in the displayed fields cache first (series are stored by SeriesInstanceUID)
+  if (displayedFieldsMapSeries.contains(seriesInstanceUID))
   {
-    if ( !displayedFieldsMapSeries[currentSeriesInstanceUid]["SeriesInstanceUID"].compare(seriesInstanceUID) )
-    {
-      return seriesInstanceUID;
-    }
+    return seriesInstanceUID;
   }
 
   // Look for the series in the display database
@@ -1541,6 +2707,12 @@ bool ctkDICOMDatabasePrivate::applyDisplayedFieldsChanges( QMap<QString, QMap<QS
     }
   } // For each series in displayedFieldsMapSeries
 
+  // Displayed patient name is included in the search index
+  foreach (int patientUID, patientCompositeIdToPatientUidMap)
+  {
+    this->updateSearchIndex("Studies.PatientsUID", patientUID);
+  }
+
   return true;
 }
 
@@ -1657,7 +2829,168 @@ QString ctkDICOMDatabasePrivate::internalPathFromAbsolute(const QString& filenam
 CTK_GET_CPP(ctkDICOMDatabase, bool, isDisplayedFieldsTableAvailable, DisplayedFieldsTableAvailable);
 CTK_GET_CPP(ctkDICOMDatabase, bool, useShortStoragePath, UseShortStoragePath);
 CTK_SET_CPP(ctkDICOMDatabase, bool, setUseShortStoragePath, UseShortStoragePath);
+CTK_GET_CPP(ctkDICOMDatabase, bool, useWriteAheadLogging, UseWriteAheadLogging);
+CTK_SET_CPP(ctkDICOMDatabase, bool, setUseWriteAheadLogging, UseWriteAheadLogging);
+CTK_GET_CPP(ctkDICOMDatabase, bool, useCompactTagCache, UseCompactTagCache);
+CTK_GET_CPP(ctkDICOMDatabase, ctkDICOMDatabase::ImportStoragePolicy, importStoragePolicy, ImportStoragePolicy);
+CTK_SET_CPP(ctkDICOMDatabase, ctkDICOMDatabase::ImportStoragePolicy, setImportStoragePolicy, ImportStoragePolicy);
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::fileTransferThreadCount()const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->FileTransferThreadPool.maxThreadCount();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setFileTransferThreadCount(int count)
+{
+  Q_D(ctkDICOMDatabase);
+  d->FileTransferThreadPool.setMaxThreadCount(qMax(1, count));
+  d->FileRemovalThreadPool.setMaxThreadCount(qMax(1, count));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setUseCompactTagCache(bool useCompact)
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->UseCompactTagCache == useCompact)
+  {
+    return;
+  }
+  d->UseCompactTagCache = useCompact;
+  d->TagCacheVerified = false;
+  if (this->isOpen())
+  {
+    // convert existing tag cache to the new format
+    d->migrateTagCache();
+    if (!this->tagCacheExists())
+    {
+      this->initializeTagCache();
+    }
+  }
+}
+
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::initializeSearchIndex()
+{
+  this->SearchIndexModule = QString();
+  if (!this->Database.isOpen() || !this->Database.tables().contains("Series"))
+  {
+    return false;
+  }
+  // Patient, study and series UIDs are stored for returning search results only
+  QString columns = "PatientsUID, StudyInstanceUID, SeriesInstanceUID, "
+    "PatientsName, PatientID, AccessionNumber, StudyDescription, SeriesDescription";
+  if (this->Database.tables().contains("SearchIndex"))
+  {
+    QSqlQuery moduleQuery(this->Database);
+    if (moduleQuery.exec("SELECT sql FROM sqlite_master WHERE name = 'SearchIndex'") && moduleQuery.next())
+    {
+      this->SearchIndexModule = moduleQuery.value(0).toString().contains("fts5", Qt::CaseInsensitive) ? "fts5" : "fts4";
+    }
+    return !this->SearchIndexModule.isEmpty();
+  }
+
+  QSqlQuery createIndex(this->Database);
+  if (createIndex.exec("CREATE VIRTUAL TABLE SearchIndex USING fts5("
+    "PatientsUID UNINDEXED, StudyInstanceUID UNINDEXED, SeriesInstanceUID UNINDEXED, "
+    "PatientsName, PatientID, AccessionNumber, StudyDescription, SeriesDescription, "
+    "prefix='2 3');"))
+  {
+    this->SearchIndexModule = "fts5";
+  }
+  else if (createIndex.exec("CREATE VIRTUAL TABLE SearchIndex USING fts4(" + columns + ", "
+    "notindexed=PatientsUID, notindexed=StudyInstanceUID, notindexed=SeriesInstanceUID, "
+    "prefix=\"2,3\");"))
+  {
+    this->SearchIndexModule = "fts4";
+  }
+  else
+  {
+    logger.warn("Full-text search index is not available: " + createIndex.lastError().text());
+    return false;
+  }
+  return this->fillSearchIndex();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::fillSearchIndex(const QString& condition, const QVariant& conditionValue)
+{
+  if (this->SearchIndexModule.isEmpty())
+  {
+    return false;
+  }
+  // Both the raw and the displayed patient name are indexed so that any of them can be searched
+  QString statement = "INSERT INTO SearchIndex ( rowid, PatientsUID, StudyInstanceUID, SeriesInstanceUID, "
+    "PatientsName, PatientID, AccessionNumber, StudyDescription, SeriesDescription ) "
+    "SELECT Series.rowid, Patients.UID, Studies.StudyInstanceUID, Series.SeriesInstanceUID, "
+    "TRIM(COALESCE(Patients.PatientsName, '') || ' ' || COALESCE(Patients.DisplayedPatientsName, '')), "
+    "Patients.PatientID, Studies.AccessionNumber, Studies.StudyDescription, Series.SeriesDescription "
+    "FROM Patients, Studies, Series "
+    "WHERE Patients.UID = Studies.PatientsUID AND Studies.StudyInstanceUID = Series.StudyInstanceUID";
+  QSqlQuery fillIndex(this->Database);
+  if (condition.isEmpty())
+  {
+    this->loggedExec(fillIndex, "DELETE FROM SearchIndex;");
+    return this->loggedExec(fillIndex, statement + ";");
+  }
+  fillIndex.prepare(statement + " AND " + condition + " = ? ;");
+  fillIndex.addBindValue(conditionValue);
+  return this->loggedExec(fillIndex);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::updateSearchIndex(const QString& condition, const QVariant& conditionValue)
+{
+  if (this->SearchIndexModule.isEmpty())
+  {
+    return false;
+  }
+  if (!this->removeFromSearchIndex(condition, conditionValue))
+  {
+    return false;
+  }
+  return this->fillSearchIndex(condition, conditionValue);
+}
 
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::removeFromSearchIndex(const QString& condition, const QVariant& conditionValue)
+{
+  if (this->SearchIndexModule.isEmpty())
+  {
+    return false;
+  }
+  // Rows are looked up by rowid, which is much faster than matching a column of the virtual table
+  QSqlQuery removeRows(this->Database);
+  removeRows.prepare("DELETE FROM SearchIndex WHERE rowid IN ( SELECT Series.rowid FROM Studies, Series "
+    "WHERE Studies.StudyInstanceUID = Series.StudyInstanceUID AND " + condition + " = ? );");
+  removeRows.addBindValue(conditionValue);
+  return this->loggedExec(removeRows);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::searchIndexMatchExpression(const QString& text)const
+{
+  QStringList terms;
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+  QStringList words = text.simplified().split(' ', Qt::SkipEmptyParts);
+  #else
+  QStringList words = text.simplified().split(' ', QString::SkipEmptyParts);
+  #endif
+  foreach (QString word, words)
+  {
+    word.remove('"');
+    if (word.isEmpty())
+    {
+      continue;
+    }
+    // Quoted so that punctuation in the word is not interpreted as query syntax
+    terms << (this->SearchIndexModule == "fts5" ? QString("\"%1\"*") : QString("\"%1*\"")).arg(word);
+  }
+  return terms.join(" ");
+}
 
 //------------------------------------------------------------------------------
 // ctkDICOMDatabase methods
@@ -1694,6 +3027,7 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
   Q_D(ctkDICOMDatabase);
   bool wasOpen = this->isOpen();
   d->DatabaseFileName = databaseFile;
+  d->ReadConnectionGeneration.fetchAndAddOrdered(1);
   QString verifiedConnectionName = connectionName;
   if (verifiedConnectionName.isEmpty())
   {
@@ -1716,6 +3050,13 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
   pragmaSyncQuery.exec("PRAGMA synchronous = OFF");
   pragmaSyncQuery.finish();
 
+  d->DatabaseThread = QThread::currentThread();
+  this->clearInMemoryTagCache();
+  if (d->UseWriteAheadLogging && !this->isInMemory())
+  {
+    d->enableWriteAheadLogging(d->Database);
+  }
+
   if ( d->Database.tables().empty() )
   {
     if (!this->initializeDatabase())
@@ -1732,6 +3073,8 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
 
   d->DisplayedFieldsTableAvailable = d->Database.tables().contains("ColumnDisplayProperties");
 
+  d->initializeSearchIndex();
+
   if (!isInMemory())
   {
     QFileSystemWatcher* watcher = new QFileSystemWatcher(QStringList(databaseFile),this);
@@ -1742,6 +3085,8 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
   QFileInfo fileInfo(d->DatabaseFileName);
   d->TagCacheDatabaseFilename = QString( fileInfo.dir().path() + "/ctkDICOMTagCache.sql" );
   d->TagCacheVerified = false;
+  // use the format of the existing tag cache, it is only converted on request
+  d->detectTagCacheFormat();
   if ( !this->tagCacheExists() )
   {
     this->initializeTagCache();
@@ -1754,6 +3099,9 @@ void ctkDICOMDatabase::openDatabase(const QString databaseFile, const QString& c
   tags.removeDuplicates();
   this->setTagsToPrecache(tags);
 
+  // Point the thumbnail store to the new database directory
+  this->thumbnailStore();
+
   emit opened();
 }
 
@@ -1797,6 +3145,53 @@ ctkDICOMAbstractThumbnailGenerator* ctkDICOMDatabase::thumbnailGenerator(){
   return d->ThumbnailGenerator;
 }
 
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailStore* ctkDICOMDatabase::thumbnailStore()
+{
+  Q_D(ctkDICOMDatabase);
+  // Thumbnails are not stored for in-memory databases
+  d->ThumbnailStore.setDirectory(this->isInMemory() ? QString() : this->databaseDirectory() + "/thumbs");
+  // thumbnail files of the former layout are stored like the DICOM files
+  d->ThumbnailStore.setUseShortStoragePath(d->UseShortStoragePath);
+  return &d->ThumbnailStore;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::migrateThumbnailFiles()
+{
+  Q_D(ctkDICOMDatabase);
+  ctkDICOMThumbnailStore* thumbnailStore = this->thumbnailStore();
+  if (thumbnailStore->directory().isEmpty())
+  {
+    return 0;
+  }
+  // File names of the thumbnails may be hashes of the UIDs, instances are listed by series
+  QSqlQuery instancesQuery(d->Database);
+  if (!d->loggedExec(instancesQuery, "SELECT Series.StudyInstanceUID, Images.SeriesInstanceUID, Images.SOPInstanceUID "
+    "FROM Images JOIN Series ON Images.SeriesInstanceUID = Series.SeriesInstanceUID "
+    "ORDER BY Images.SeriesInstanceUID;"))
+  {
+    return 0;
+  }
+  int migratedCount = 0;
+  QString studyInstanceUID;
+  QString seriesInstanceUID;
+  QStringList sopInstanceUIDs;
+  while (instancesQuery.next())
+  {
+    if (instancesQuery.value(1).toString() != seriesInstanceUID)
+    {
+      migratedCount += thumbnailStore->migrateThumbnailFiles(studyInstanceUID, seriesInstanceUID, sopInstanceUIDs);
+      studyInstanceUID = instancesQuery.value(0).toString();
+      seriesInstanceUID = instancesQuery.value(1).toString();
+      sopInstanceUIDs.clear();
+    }
+    sopInstanceUIDs << instancesQuery.value(2).toString();
+  }
+  migratedCount += thumbnailStore->migrateThumbnailFiles(studyInstanceUID, seriesInstanceUID, sopInstanceUIDs);
+  return migratedCount;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabase::initializeDatabase(const char* sqlFileName/* = ":/dicom/dicom-schema.sql" */)
 {
@@ -1808,7 +3203,16 @@ bool ctkDICOMDatabase::initializeDatabase(const char* sqlFileName/* = ":/dicom/d
   // old schema should be loaded for testing.
   QSqlQuery dropSchemaInfo(d->Database);
   d->loggedExec( dropSchemaInfo, QString("DROP TABLE IF EXISTS 'SchemaInfo';") );
+  // Directory scan state of the indexer describes files that are already in the database,
+  // therefore it must be removed to allow adding the same files again.
+  QSqlQuery dropScanState(d->Database);
+  d->loggedExec( dropScanState, QString("DROP TABLE IF EXISTS 'DirectoryScanState';") );
+  d->loggedExec( dropScanState, QString("DROP TABLE IF EXISTS 'FileScanState';") );
+  // Search index is created again for the new tables
+  QSqlQuery dropSearchIndex(d->Database);
+  d->loggedExec( dropSearchIndex, QString("DROP TABLE IF EXISTS 'SearchIndex';") );
   const bool r = d->executeScript(sqlFileName);
+  d->initializeSearchIndex();
   emit databaseChanged();
   return r;
 }
@@ -1932,8 +3336,14 @@ void ctkDICOMDatabase::closeDatabase()
 {
   Q_D(ctkDICOMDatabase);
   bool wasOpen = this->isOpen();
+  // files of removed series are deleted relative to the database folder
+  this->waitForFileRemoval();
+  // Read connections of other threads are removed by those threads
+  d->ReadConnectionGeneration.fetchAndAddOrdered(1);
+  this->clearInMemoryTagCache();
   d->Database.close();
   d->TagCacheDatabase.close();
+  d->ThumbnailStore.close();
   if (wasOpen)
   {
     emit closed();
@@ -1948,7 +3358,7 @@ void ctkDICOMDatabase::closeDatabase()
 QStringList ctkDICOMDatabase::patients()
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT UID FROM Patients" );
   query.exec();
   QStringList result;
@@ -1963,7 +3373,7 @@ QStringList ctkDICOMDatabase::patients()
 QStringList ctkDICOMDatabase::studiesForPatient(QString dbPatientID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT StudyInstanceUID FROM Studies WHERE PatientsUID = ?" );
   query.addBindValue( dbPatientID );
   query.exec();
@@ -1979,7 +3389,7 @@ QStringList ctkDICOMDatabase::studiesForPatient(QString dbPatientID)
 QString ctkDICOMDatabase::studyForSeries(QString seriesUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT StudyInstanceUID FROM Series WHERE SeriesInstanceUID= ?" );
   query.addBindValue( seriesUID );
   query.exec();
@@ -1995,7 +3405,7 @@ QString ctkDICOMDatabase::studyForSeries(QString seriesUID)
 QString ctkDICOMDatabase::patientForStudy(QString studyUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT PatientsUID FROM Studies WHERE StudyInstanceUID= ?" );
   query.addBindValue( studyUID );
   query.exec();
@@ -2016,7 +3426,7 @@ QHash<QString,QString> ctkDICOMDatabase::descriptionsForFile(QString fileName)
   QString studyUID(this->studyForSeries(seriesUID));
   QString patientID(this->patientForStudy(studyUID));
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesDescription FROM Series WHERE SeriesInstanceUID= ?" );
   query.addBindValue( seriesUID );
   query.exec();
@@ -2049,7 +3459,7 @@ QString ctkDICOMDatabase::descriptionForSeries(const QString seriesUID)
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesDescription FROM Series WHERE SeriesInstanceUID= ?" );
   query.addBindValue( seriesUID );
   query.exec();
@@ -2068,7 +3478,7 @@ QString ctkDICOMDatabase::descriptionForStudy(const QString studyUID)
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT StudyDescription FROM Studies WHERE StudyInstanceUID= ?" );
   query.addBindValue( studyUID );
   query.exec();
@@ -2087,7 +3497,7 @@ QString ctkDICOMDatabase::nameForPatient(const QString patientUID)
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT PatientsName FROM Patients WHERE UID= ?" );
   query.addBindValue( patientUID );
   query.exec();
@@ -2106,7 +3516,7 @@ QString ctkDICOMDatabase::displayedNameForPatient(const QString patientUID)
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT DisplayedPatientsName FROM Patients WHERE UID= ?" );
   query.addBindValue( patientUID );
   query.exec();
@@ -2125,7 +3535,7 @@ QString ctkDICOMDatabase::fieldForPatient(const QString field, const QString pat
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   QString queryStr = QString("SELECT %1 FROM Patients WHERE UID= ?" ).arg(field);
   query.prepare(queryStr);
   query.addBindValue( patientUID );
@@ -2145,7 +3555,7 @@ QString ctkDICOMDatabase::fieldForStudy(const QString field, const QString study
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   QString queryStr = QString("SELECT %1 FROM Studies WHERE StudyInstanceUID= ?" ).arg(field);
   query.prepare(queryStr);
   query.addBindValue( studyInstanceUID );
@@ -2165,7 +3575,7 @@ QString ctkDICOMDatabase::fieldForSeries(const QString field, const QString seri
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   QString queryStr = QString("SELECT %1 FROM Series WHERE SeriesInstanceUID= ?" ).arg(field);
   query.prepare(queryStr);
   query.addBindValue( seriesInstanceUID );
@@ -2233,7 +3643,7 @@ QStringList ctkDICOMDatabase::seriesFieldNames() const
 QStringList ctkDICOMDatabase::seriesForStudy(QString studyUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesInstanceUID FROM Series WHERE StudyInstanceUID=?");
   query.addBindValue( studyUID );
   query.exec();
@@ -2249,7 +3659,7 @@ QStringList ctkDICOMDatabase::seriesForStudy(QString studyUID)
 QStringList ctkDICOMDatabase::instancesForSeries(const QString seriesUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT SOPInstanceUID FROM Images WHERE SeriesInstanceUID= ?");
   query.addBindValue(seriesUID);
   query.exec();
@@ -2266,7 +3676,7 @@ QStringList ctkDICOMDatabase::instancesForSeries(const QString seriesUID)
 QStringList ctkDICOMDatabase::filesForSeries(QString seriesUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT Filename FROM Images WHERE SeriesInstanceUID=?");
   query.addBindValue(seriesUID);
   query.exec();
@@ -2282,7 +3692,7 @@ QStringList ctkDICOMDatabase::filesForSeries(QString seriesUID)
 QString ctkDICOMDatabase::fileForInstance(QString sopInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT Filename FROM Images WHERE SOPInstanceUID=?");
   query.addBindValue(sopInstanceUID);
   query.exec();
@@ -2298,7 +3708,7 @@ QString ctkDICOMDatabase::fileForInstance(QString sopInstanceUID)
 QString ctkDICOMDatabase::seriesForFile(QString fileName)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesInstanceUID FROM Images WHERE Filename=?");
   query.addBindValue(d->internalPathFromAbsolute(fileName));
   query.exec();
@@ -2314,7 +3724,7 @@ QString ctkDICOMDatabase::seriesForFile(QString fileName)
 QString ctkDICOMDatabase::instanceForFile(QString fileName)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SOPInstanceUID FROM Images WHERE Filename=?");
   query.addBindValue(d->internalPathFromAbsolute(fileName));
   query.exec();
@@ -2330,7 +3740,7 @@ QString ctkDICOMDatabase::instanceForFile(QString fileName)
 QDateTime ctkDICOMDatabase::insertDateTimeForInstance(QString sopInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT InsertTimestamp FROM Images WHERE SOPInstanceUID=?");
   query.addBindValue(sopInstanceUID);
   query.exec();
@@ -2529,15 +3939,23 @@ QString ctkDICOMDatabase::fileValue(const QString fileName, const unsigned short
     return value;
   }
 
+  DcmTagKey tagKey(group, element);
   ctkDICOMItem dataset;
-  dataset.InitializeFromFile(fileName);
+  if (tagKey < DCM_PixelData || (tagKey == DCM_PixelData && d->TagsToExcludeFromStorage.contains(tag)))
+  {
+    // no need to read pixel data (and elements after it)
+    dataset.InitializeFromFileHeader(fileName);
+  }
+  else
+  {
+    dataset.InitializeFromFile(fileName);
+  }
   if (!dataset.IsInitialized())
   {
     logger.error( "File " + fileName + " could not be initialized.");
     return "";
   }
 
-  DcmTagKey tagKey(group, element);
   if (d->TagsToExcludeFromStorage.contains(tag))
   {
     if (dataset.TagExists(tagKey))
@@ -2557,6 +3975,134 @@ QString ctkDICOMDatabase::fileValue(const QString fileName, const unsigned short
   return value;
 }
 
+//------------------------------------------------------------------------------
+QMap<QString, QStringList> ctkDICOMDatabase::instanceValues(const QString& seriesInstanceUID, const QStringList& tags)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QStringList> valuesForInstances;
+
+  // Get instances of the series
+  QStringList sopInstanceUIDs;
+  QStringList filePaths;
+  QSqlQuery instancesQuery(d->readDatabase());
+  instancesQuery.prepare("SELECT SOPInstanceUID, Filename FROM Images WHERE SeriesInstanceUID = ?");
+  instancesQuery.addBindValue(seriesInstanceUID);
+  if (!d->loggedExec(instancesQuery))
+  {
+    return valuesForInstances;
+  }
+  while (instancesQuery.next())
+  {
+    sopInstanceUIDs << instancesQuery.value(0).toString();
+    filePaths << d->absolutePathFromInternal(instancesQuery.value(1).toString());
+  }
+  if (sopInstanceUIDs.isEmpty() || tags.isEmpty())
+  {
+    return valuesForInstances;
+  }
+
+  // Get as many values as possible from the tag cache
+  QMap<QString, QMap<QString, QString> > cachedTagsForInstances;
+  if (this->tagCacheExists())
+  {
+    d->getCachedTagsForInstances(sopInstanceUIDs, cachedTagsForInstances, tags, true);
+  }
+
+  QList<int> instanceIndicesToRead;
+  for (int instanceIndex = 0; instanceIndex < sopInstanceUIDs.size(); ++instanceIndex)
+  {
+    const QMap<QString, QString>& cachedTags = cachedTagsForInstances[sopInstanceUIDs[instanceIndex]];
+    QStringList values;
+    bool allTagsCached = true;
+    foreach(const QString& tag, tags)
+    {
+      QMap<QString, QString>::const_iterator cachedTagIt = cachedTags.constFind(tag);
+      if (cachedTagIt == cachedTags.constEnd())
+      {
+        allTagsCached = false;
+        break;
+      }
+      values << cachedTagIt.value();
+    }
+    if (allTagsCached)
+    {
+      valuesForInstances[sopInstanceUIDs[instanceIndex]] = values;
+    }
+    else
+    {
+      instanceIndicesToRead << instanceIndex;
+    }
+  }
+  if (instanceIndicesToRead.isEmpty())
+  {
+    return valuesForInstances;
+  }
+
+  // Read missing values from files in parallel
+  QList<DcmTagKey> tagKeys;
+  QList<bool> tagsExcludedFromStorage;
+  bool readHeaderOnly = true;
+  foreach(const QString& tag, tags)
+  {
+    unsigned short group, element;
+    this->tagToGroupElement(tag, group, element);
+    DcmTagKey tagKey(group, element);
+    tagKeys << tagKey;
+    tagsExcludedFromStorage << d->TagsToExcludeFromStorage.contains(tag);
+    if (!(tagKey < DCM_PixelData || (tagKey == DCM_PixelData && tagsExcludedFromStorage.last())))
+    {
+      readHeaderOnly = false;
+    }
+  }
+  QVector<QStringList> valuesReadFromFiles(instanceIndicesToRead.size());
+  QThreadPool readerPool;
+  readerPool.setMaxThreadCount(QThread::idealThreadCount());
+  for (int readIndex = 0; readIndex < instanceIndicesToRead.size(); ++readIndex)
+  {
+    readerPool.start(new ctkDICOMDatabaseTagValuesReaderTask(filePaths[instanceIndicesToRead[readIndex]],
+      tagKeys, tagsExcludedFromStorage, readHeaderOnly, &valuesReadFromFiles[readIndex]));
+  }
+  readerPool.waitForDone();
+
+  // Back-fill the tag cache in one transaction
+  QStringList sopInstanceUIDsToCache, tagsToCache, valuesToCache;
+  for (int readIndex = 0; readIndex < instanceIndicesToRead.size(); ++readIndex)
+  {
+    const QString& sopInstanceUID = sopInstanceUIDs[instanceIndicesToRead[readIndex]];
+    const QStringList& values = valuesReadFromFiles[readIndex];
+    QStringList valuesForInstance;
+    for (int tagIndex = 0; tagIndex < tags.size(); ++tagIndex)
+    {
+      if (values.isEmpty())
+      {
+        // file could not be read, message is already logged
+        valuesForInstance << QString();
+        continue;
+      }
+      const QString& value = values[tagIndex];
+      sopInstanceUIDsToCache << sopInstanceUID;
+      tagsToCache << tags[tagIndex];
+      valuesToCache << value;
+      if (value == TagNotInInstance || value == ValueIsEmptyString || value == ValueIsNotStored)
+      {
+        valuesForInstance << QString();
+      }
+      else
+      {
+        valuesForInstance << value;
+      }
+    }
+    valuesForInstances[sopInstanceUID] = valuesForInstance;
+  }
+  // The tag cache can only be written using the connection of the thread that opened the database
+  if (!sopInstanceUIDsToCache.isEmpty() && QThread::currentThread() == d->DatabaseThread)
+  {
+    this->cacheTags(sopInstanceUIDsToCache, tagsToCache, valuesToCache);
+  }
+
+  return valuesForInstances;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabase::instanceValueExists(const QString sopInstanceUID, const QString tag)
 {
@@ -2646,15 +4192,23 @@ bool ctkDICOMDatabase::fileValueExists(const QString fileName, const unsigned sh
     return true;
   }
 
+  DcmTagKey tagKey(group, element);
   ctkDICOMItem dataset;
-  dataset.InitializeFromFile(fileName);
+  if (tagKey < DCM_PixelData || (tagKey == DCM_PixelData && d->TagsToExcludeFromStorage.contains(tag)))
+  {
+    // no need to read pixel data (and elements after it)
+    dataset.InitializeFromFileHeader(fileName);
+  }
+  else
+  {
+    dataset.InitializeFromFile(fileName);
+  }
   if (!dataset.IsInitialized())
   {
     logger.error("File " + fileName + " could not be initialized.");
     return false;
   }
 
-  DcmTagKey tagKey(group, element);
   if (d->TagsToExcludeFromStorage.contains(tag))
   {
     if (dataset.TagExists(tagKey))
@@ -2866,114 +4420,187 @@ bool ctkDICOMDatabase::isInMemory() const
 }
 
 //------------------------------------------------------------------------------
-bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID, bool clearCachedTags/*=true*/)
+bool ctkDICOMDatabasePrivate::removeSeriesWhere(const QString& column, const QStringList& uids, bool clearCachedTags)
 {
-  Q_D(ctkDICOMDatabase);
-
-  // get all images from series
-  QSqlQuery fileExistsQuery(d->Database);
-  fileExistsQuery.prepare("SELECT Filename, SOPInstanceUID, StudyInstanceUID FROM Images,Series WHERE Series.SeriesInstanceUID = Images.SeriesInstanceUID AND Images.SeriesInstanceUID = :seriesID");
-  fileExistsQuery.bindValue(":seriesID", seriesInstanceUID);
-  bool success = fileExistsQuery.exec();
-  if (!success)
+  Q_Q(ctkDICOMDatabase);
+  if (uids.isEmpty())
   {
-    logger.error("SQLITE ERROR: " + fileExistsQuery.lastError().driverText());
-    return false;
+    return true;
   }
 
-  QList< QPair<QString, QString> > removeList;
-  QStringList removeTagCacheSOPInstanceUIDs;
-  while (fileExistsQuery.next())
+  this->Database.transaction();
+
+  // Collect the series to remove in a temporary table, so that all the following
+  // statements can select rows by a join instead of running once for each UID
+  QSqlQuery removedSeries(this->Database);
+  bool success = this->loggedExec(removedSeries, "CREATE TEMP TABLE IF NOT EXISTS RemovedSeries ( "
+      "SeriesInstanceUID VARCHAR(64) PRIMARY KEY, StudyInstanceUID VARCHAR(64), PatientsUID INT );")
+    && this->loggedExec(removedSeries, "DELETE FROM RemovedSeries;");
+  if (success)
   {
-    QString dbFilePath = fileExistsQuery.value(fileExistsQuery.record().indexOf("Filename")).toString();
-    QString studyInstanceUID = fileExistsQuery.value(fileExistsQuery.record().indexOf("StudyInstanceUID")).toString();
-    QString sopInstanceUID = fileExistsQuery.value(fileExistsQuery.record().indexOf("SOPInstanceUID")).toString();
-    QString thumbnailPath = "thumbs/" + d->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".png";
-    removeList << qMakePair(dbFilePath, thumbnailPath);
-    if (clearCachedTags)
+    removedSeries.prepare(QString("INSERT OR IGNORE INTO RemovedSeries "
+      "SELECT Series.SeriesInstanceUID, Series.StudyInstanceUID, Studies.PatientsUID "
+      "FROM Series LEFT JOIN Studies ON Series.StudyInstanceUID = Studies.StudyInstanceUID "
+      "WHERE %1 = ? ;").arg(column));
+    QVariantList uidValues;
+    foreach (const QString& uid, uids)
     {
-      removeTagCacheSOPInstanceUIDs << sopInstanceUID;
+      uidValues << uid;
     }
+    removedSeries.addBindValue(uidValues);
+    success = this->loggedExecBatch(removedSeries);
   }
 
-  QSqlQuery fileRemove(d->Database);
-  fileRemove.prepare("DELETE FROM Images WHERE SeriesInstanceUID == :seriesID");
-  fileRemove.bindValue(":seriesID", seriesInstanceUID);
-  logger.debug("SQLITE: removing seriesInstanceUID " + seriesInstanceUID);
-  success = fileRemove.exec();
-  if (!success)
+  // Files and thumbnails of the removed series, grouped by series
+  QList<QStringList> seriesFilePaths;
+  QList<QStringList> seriesThumbnailPaths;
+  QList<int> seriesInstanceCounts;
+  QList<QPair<QString, QString> > seriesUIDs;
+  QStringList removedSOPInstanceUIDs;
+  if (success)
   {
-    logger.error("SQLITE ERROR: could not remove seriesInstanceUID " + seriesInstanceUID);
-    logger.error("SQLITE ERROR: " + fileRemove.lastError().driverText());
+    QSqlQuery filesQuery(this->Database);
+    success = this->loggedExec(filesQuery, "SELECT Images.Filename, Images.SOPInstanceUID, "
+      "RemovedSeries.StudyInstanceUID, RemovedSeries.SeriesInstanceUID "
+      "FROM RemovedSeries LEFT JOIN Images ON Images.SeriesInstanceUID = RemovedSeries.SeriesInstanceUID "
+      "ORDER BY RemovedSeries.SeriesInstanceUID;");
+    while (success && filesQuery.next())
+    {
+      QString filename = filesQuery.value(0).toString();
+      QString sopInstanceUID = filesQuery.value(1).toString();
+      QString studyInstanceUID = filesQuery.value(2).toString();
+      QString seriesInstanceUID = filesQuery.value(3).toString();
+      if (seriesUIDs.isEmpty() || seriesUIDs.last().second != seriesInstanceUID)
+      {
+        seriesUIDs << qMakePair(studyInstanceUID, seriesInstanceUID);
+        seriesFilePaths << QStringList();
+        seriesThumbnailPaths << QStringList();
+        seriesInstanceCounts << 0;
+      }
+      if (sopInstanceUID.isEmpty())
+      {
+        // series without images
+        continue;
+      }
+      removedSOPInstanceUIDs << sopInstanceUID;
+      ++seriesInstanceCounts.last();
+      // only files that are stored below the database folder are deleted
+      if (QFileInfo(filename).isRelative())
+      {
+        seriesFilePaths.last() << this->absolutePathFromInternal(filename);
+      }
+      seriesThumbnailPaths.last() << this->absolutePathFromInternal(
+        "thumbs/" + this->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".png");
+    }
   }
 
-  if (!removeTagCacheSOPInstanceUIDs.isEmpty())
+  if (success)
   {
-    d->TagCacheDatabase.transaction();
-    // Remove values from tag cache (may be important for patient confidentiality)
-    foreach(QString sopInstanceUID, removeTagCacheSOPInstanceUIDs)
+    QSqlQuery removeRows(this->Database);
+    if (!this->SearchIndexModule.isEmpty())
     {
-      removeCachedTags(sopInstanceUID);
+      success = this->loggedExec(removeRows, "DELETE FROM SearchIndex WHERE rowid IN ( SELECT Series.rowid FROM Series "
+        "WHERE Series.SeriesInstanceUID IN ( SELECT SeriesInstanceUID FROM RemovedSeries ) );");
     }
-    d->TagCacheDatabase.commit();
+    success = success
+      && this->loggedExec(removeRows, "DELETE FROM Images WHERE SeriesInstanceUID IN ( SELECT SeriesInstanceUID FROM RemovedSeries );")
+      && this->loggedExec(removeRows, "DELETE FROM Series WHERE SeriesInstanceUID IN ( SELECT SeriesInstanceUID FROM RemovedSeries );")
+      && this->loggedExec(removeRows, "DELETE FROM Studies WHERE StudyInstanceUID IN ( SELECT StudyInstanceUID FROM RemovedSeries ) "
+        "AND NOT EXISTS ( SELECT 1 FROM Series WHERE Series.StudyInstanceUID = Studies.StudyInstanceUID );")
+      && this->loggedExec(removeRows, "DELETE FROM Patients WHERE UID IN ( SELECT PatientsUID FROM RemovedSeries ) "
+        "AND NOT EXISTS ( SELECT 1 FROM Studies WHERE Studies.PatientsUID = Patients.UID );")
+      && this->loggedExec(removeRows, "DELETE FROM RemovedSeries;");
+  }
+
+  if (!success)
+  {
+    logger.error("Failed to remove series from the database");
+    this->Database.rollback();
+    return false;
   }
+  this->Database.commit();
+  this->resetLastInsertedValues();
 
-  QPair<QString,QString> fileToRemove;
-  QStringList foldersToRemove;
-  foreach (fileToRemove, removeList)
+  // Values of instances that no longer exist must not be served from memory
+  foreach (const QString& sopInstanceUID, removedSOPInstanceUIDs)
   {
-    QString dbFilePath = fileToRemove.first;
-    QString thumbnailPath = fileToRemove.second;
+    this->removeInMemoryCachedTags(sopInstanceUID);
+  }
 
-    // check that the file is below our internal storage
-    if (QFileInfo(dbFilePath).isRelative())
-    {
-      QString absPath = d->absolutePathFromInternal(dbFilePath);
-      if (QFile(absPath).remove())
-      {
-        if (d->LoggedExecVerbose)
-        {
-          logger.debug("Removed file " + absPath);
-        }
-        QString fileFolder = QFileInfo(absPath).absoluteDir().path();
-        if (foldersToRemove.isEmpty() || foldersToRemove.last() != fileFolder)
-        {
-          foldersToRemove << fileFolder;
-        }
-      }
-      else
-      {
-        logger.warn("Failed to remove file " + absPath);
-      }
-    }
-    // Remove thumbnail (if exists)
-    QFile thumbnailFile(d->absolutePathFromInternal(thumbnailPath));
-    if (thumbnailFile.exists())
+  if (clearCachedTags && !removedSOPInstanceUIDs.isEmpty() && q->tagCacheExists())
+  {
+    // Remove values from tag cache (may be important for patient confidentiality)
+    this->TagCacheDatabase.transaction();
+    QSqlQuery removeCachedTags(this->TagCacheDatabase);
+    removeCachedTags.prepare(QString("DELETE FROM %1 WHERE SOPInstanceUID = ? ;").arg(this->tagCacheTableName(this->UseCompactTagCache)));
+    QVariantList sopInstanceUIDValues;
+    foreach (const QString& sopInstanceUID, removedSOPInstanceUIDs)
     {
-      if (!thumbnailFile.remove())
-      {
-      logger.warn("Failed to remove thumbnail " + thumbnailFile.fileName());
-      }
-      QString fileFolder = QFileInfo(thumbnailFile).absoluteDir().path();
-      if (foldersToRemove.isEmpty() || foldersToRemove.last() != fileFolder)
-      {
-        foldersToRemove << fileFolder;
-      }
+      sopInstanceUIDValues << sopInstanceUID;
     }
+    removeCachedTags.addBindValue(sopInstanceUIDValues);
+    this->loggedExecBatch(removeCachedTags);
+    this->TagCacheDatabase.commit();
   }
 
-  // Delete all empty folders that are left after removing DICOM files
-  // (folders that still contain files are not removed)
-  foreach (QString folderToRemove, foldersToRemove)
+  if (seriesUIDs.isEmpty())
   {
-    QDir().rmpath(folderToRemove);
+    return true;
   }
 
-  this->cleanup();
+  // Delete files in the background
+  QSharedPointer<ctkDICOMDatabaseFileRemovalState> removalState(new ctkDICOMDatabaseFileRemovalState);
+  removalState->FileCount = removedSOPInstanceUIDs.size();
+  removalState->RemovedFileCount = 0;
+  removalState->RemainingTaskCount = seriesUIDs.size();
+  emit q->fileRemovalStarted(removalState->FileCount);
+  ctkDICOMThumbnailStore* thumbnailStore = q->thumbnailStore();
+  for (int seriesIndex = 0; seriesIndex < seriesUIDs.size(); ++seriesIndex)
+  {
+    beginSeriesFileRemoval(seriesUIDs[seriesIndex].second);
+    this->FileRemovalThreadPool.start(new ctkDICOMDatabaseFileRemovalTask(q, removalState, thumbnailStore,
+      seriesUIDs[seriesIndex].first, seriesUIDs[seriesIndex].second,
+      seriesFilePaths[seriesIndex], seriesThumbnailPaths[seriesIndex], seriesInstanceCounts[seriesIndex]));
+  }
+  return true;
+}
 
-  d->resetLastInsertedValues();
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID, bool clearCachedTags/*=true*/)
+{
+  Q_D(ctkDICOMDatabase);
+  bool success = d->removeSeriesWhere("Series.SeriesInstanceUID", QStringList() << seriesInstanceUID, clearCachedTags);
+  // files are removed by the time the method returns
+  this->waitForFileRemoval();
+  return success;
+}
 
-  return true;
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeSeriesList(const QStringList& seriesInstanceUIDs, bool clearCachedTags/*=true*/)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->removeSeriesWhere("Series.SeriesInstanceUID", seriesInstanceUIDs, clearCachedTags);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeStudyList(const QStringList& studyInstanceUIDs, bool clearCachedTags/*=true*/)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->removeSeriesWhere("Series.StudyInstanceUID", studyInstanceUIDs, clearCachedTags);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removePatientList(const QStringList& patientUIDs, bool clearCachedTags/*=true*/)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->removeSeriesWhere("Studies.PatientsUID", patientUIDs, clearCachedTags);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::waitForFileRemoval()
+{
+  Q_D(ctkDICOMDatabase);
+  d->FileRemovalThreadPool.waitForDone();
 }
 
 //------------------------------------------------------------------------------
@@ -2989,6 +4616,8 @@ bool ctkDICOMDatabase::cleanup(bool vacuum/*=false*/)
     seriesCleanup.exec("VACUUM;");
     QSqlQuery tagcacheCleanup(d->TagCacheDatabase);
     seriesCleanup.exec("VACUUM;");
+    // Vacuum may change the rowid of series, which is used as rowid in the search index
+    d->fillSearchIndex();
   }
   d->resetLastInsertedValues();
   return true;
@@ -2998,54 +4627,18 @@ bool ctkDICOMDatabase::cleanup(bool vacuum/*=false*/)
 bool ctkDICOMDatabase::removeStudy(const QString& studyInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
-
-  QSqlQuery seriesForStudy( d->Database );
-  seriesForStudy.prepare("SELECT SeriesInstanceUID FROM Series WHERE StudyInstanceUID = :studyID");
-  seriesForStudy.bindValue(":studyID", studyInstanceUID);
-  bool success = seriesForStudy.exec();
-  if (!success)
-  {
-    logger.error("SQLITE ERROR: " + seriesForStudy.lastError().driverText());
-    return false;
-  }
-  bool result = true;
-  while ( seriesForStudy.next() )
-  {
-    QString seriesInstanceUID = seriesForStudy.value(seriesForStudy.record().indexOf("SeriesInstanceUID")).toString();
-    if ( ! this->removeSeries(seriesInstanceUID) )
-    {
-      result = false;
-    }
-  }
-  d->resetLastInsertedValues();
-  return result;
+  bool success = d->removeSeriesWhere("Series.StudyInstanceUID", QStringList() << studyInstanceUID, true);
+  this->waitForFileRemoval();
+  return success;
 }
 
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabase::removePatient(const QString& patientID)
 {
   Q_D(ctkDICOMDatabase);
-
-  QSqlQuery studiesForPatient( d->Database );
-  studiesForPatient.prepare("SELECT StudyInstanceUID FROM Studies WHERE PatientsUID = :patientsID");
-  studiesForPatient.bindValue(":patientsID", patientID);
-  bool success = studiesForPatient.exec();
-  if (!success)
-  {
-    logger.error("SQLITE ERROR: " + studiesForPatient.lastError().driverText());
-    return false;
-  }
-  bool result = true;
-  while ( studiesForPatient.next() )
-  {
-    QString studyInstanceUID = studiesForPatient.value(studiesForPatient.record().indexOf("StudyInstanceUID")).toString();
-    if ( ! this->removeStudy(studyInstanceUID) )
-    {
-      result = false;
-    }
-  }
-  d->resetLastInsertedValues();
-  return result;
+  bool success = d->removeSeriesWhere("Studies.PatientsUID", QStringList() << patientID, true);
+  this->waitForFileRemoval();
+  return success;
 }
 
 ///
@@ -3074,7 +4667,7 @@ bool ctkDICOMDatabase::tagCacheExists()
 
   // check that the table exists
   QSqlQuery cacheExists( d->TagCacheDatabase );
-  cacheExists.prepare("SELECT * FROM TagCache LIMIT 1");
+  cacheExists.prepare(QString("SELECT * FROM %1 LIMIT 1").arg(d->tagCacheTableName(d->UseCompactTagCache)));
   bool success = d->loggedExec(cacheExists);
   if (success)
   {
@@ -3090,20 +4683,41 @@ bool ctkDICOMDatabase::initializeTagCache()
 {
   Q_D(ctkDICOMDatabase);
 
-  // First, drop any existing table
-  if ( this->tagCacheExists() )
+  // First, drop any existing table (in any format)
+  if (!d->openTagCacheDatabase())
+  {
+    return false;
+  }
+  QStringList existingTables = d->TagCacheDatabase.tables();
+  QStringList tagCacheTableNames;
+  tagCacheTableNames << d->tagCacheTableName(false) << d->tagCacheTableName(true);
+  foreach(const QString& tableName, tagCacheTableNames)
   {
-    qDebug() << "TagCacheDatabase drop existing table\n";
-    QSqlQuery dropCacheTable( d->TagCacheDatabase );
-    dropCacheTable.prepare( "DROP TABLE TagCache" );
-    d->loggedExec(dropCacheTable);
+    if (existingTables.contains(tableName))
+    {
+      qDebug() << "TagCacheDatabase drop existing table" << tableName << "\n";
+      QSqlQuery dropCacheTable( d->TagCacheDatabase );
+      dropCacheTable.prepare( QString("DROP TABLE %1").arg(tableName) );
+      d->loggedExec(dropCacheTable);
+    }
   }
+  d->TagCacheVerified = false;
+
+  this->clearInMemoryTagCache();
 
   // now create a table
   qDebug() << "TagCacheDatabase adding table\n";
   QSqlQuery createCacheTable( d->TagCacheDatabase );
-  createCacheTable.prepare(
-    "CREATE TABLE TagCache (SOPInstanceUID, Tag, Value, PRIMARY KEY (SOPInstanceUID, Tag))" );
+  if (d->UseCompactTagCache)
+  {
+    createCacheTable.prepare(QString(
+      "CREATE TABLE %1 (SOPInstanceUID PRIMARY KEY, Tags BLOB)").arg(d->tagCacheTableName(true)));
+  }
+  else
+  {
+    createCacheTable.prepare(QString(
+      "CREATE TABLE %1 (SOPInstanceUID, Tag, Value, PRIMARY KEY (SOPInstanceUID, Tag))").arg(d->tagCacheTableName(false)));
+  }
   bool success = d->loggedExec(createCacheTable);
   if (!success)
   {
@@ -3118,6 +4732,11 @@ bool ctkDICOMDatabase::initializeTagCache()
 QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString tag)
 {
   Q_D(ctkDICOMDatabase);
+  QString result;
+  if (d->inMemoryCachedTag(sopInstanceUID, tag, result))
+  {
+    return result;
+  }
   if ( !this->tagCacheExists() )
   {
     if ( !this->initializeTagCache() )
@@ -3125,19 +4744,20 @@ QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString
       return( "" );
     }
   }
-  QSqlQuery selectValue( d->TagCacheDatabase );
-  selectValue.prepare( "SELECT Value FROM TagCache WHERE SOPInstanceUID = :sopInstanceUID AND Tag = :tag" );
-  selectValue.bindValue(":sopInstanceUID",sopInstanceUID);
-  selectValue.bindValue(":tag",tag);
-  d->loggedExec(selectValue);
-  QString result("");
-  if (selectValue.next())
+  QSqlDatabase tagCacheDatabase = d->readTagCacheDatabase();
+  QMap<QString, QMap<QString, QString> > storedValuesForInstances;
+  d->readCachedTags(tagCacheDatabase, d->UseCompactTagCache,
+    QStringList() << sopInstanceUID, QStringList() << tag, storedValuesForInstances);
+  result = QString("");
+  const QMap<QString, QString>& storedValues = storedValuesForInstances[sopInstanceUID];
+  if (storedValues.contains(tag))
   {
-    result = selectValue.value(0).toString();
+    result = storedValues[tag];
     if (result == QString(""))
     {
       result = ValueIsEmptyString;
     }
+    d->setInMemoryCachedTag(sopInstanceUID, tag, result);
   }
   return( result );
 }
@@ -3155,16 +4775,17 @@ void ctkDICOMDatabase::getCachedTags(const QString sopInstanceUID, QMap<QString,
       return;
     }
   }
-  QSqlQuery selectValue( d->TagCacheDatabase );
-  selectValue.prepare( "SELECT Tag, Value FROM TagCache WHERE SOPInstanceUID = :sopInstanceUID" );
-  selectValue.bindValue(":sopInstanceUID",sopInstanceUID);
-  d->loggedExec(selectValue);
-  QString tag;
-  QString value;
-  while (selectValue.next())
-  {
-    tag = selectValue.value(0).toString();
-    value = selectValue.value(1).toString();
+  QSqlDatabase tagCacheDatabase = d->readTagCacheDatabase();
+  QMap<QString, QMap<QString, QString> > storedValuesForInstances;
+  d->readCachedTags(tagCacheDatabase, d->UseCompactTagCache,
+    QStringList() << sopInstanceUID, QStringList(), storedValuesForInstances);
+  const QMap<QString, QString>& storedValues = storedValuesForInstances[sopInstanceUID];
+  for (QMap<QString, QString>::const_iterator storedValueIt = storedValues.constBegin();
+    storedValueIt != storedValues.constEnd(); ++storedValueIt)
+  {
+    QString tag = storedValueIt.key();
+    QString value = storedValueIt.value();
+    d->setInMemoryCachedTag(sopInstanceUID, tag, value.isEmpty() ? ValueIsEmptyString : value);
     if (value == TagNotInInstance || value == ValueIsEmptyString || value == ValueIsNotStored)
     {
       value = QString("");
@@ -3202,39 +4823,29 @@ bool ctkDICOMDatabase::cacheTags(const QStringList sopInstanceUIDs, const QStrin
       }
     }
 
-  d->TagCacheDatabase.transaction();
+  QMap<QString, QMap<QString, QString> > storedValuesForInstances;
+  for (int i = 0; i<itemCount; ++i)
+  {
+    // replace empty strings with special flag string
+    storedValuesForInstances[sopInstanceUIDs[i]].insert(tags[i], values[i].isEmpty() ? TagNotInInstance : values[i]);
+  }
 
-  QSqlQuery insertTags(d->TagCacheDatabase);
-  insertTags.prepare( "INSERT OR REPLACE INTO TagCache VALUES(?,?,?)" );
+  d->TagCacheDatabase.transaction();
+  bool success = d->writeCachedTags(d->UseCompactTagCache, storedValuesForInstances);
+  d->TagCacheDatabase.commit();
 
-  QStringList::const_iterator sopInstanceUIDsIt = sopInstanceUIDs.begin();
-  QStringList::const_iterator tagsIt = tags.begin();
-  QStringList::const_iterator valuesIt = values.begin();
-  bool success = true;
-  for (int i = 0; i<itemCount; ++i)
+  if (success)
   {
-    insertTags.bindValue(0, *sopInstanceUIDsIt);
-    insertTags.bindValue(1, *tagsIt);
-    if (valuesIt->isEmpty())
-    {
-      // replace empty strings with special flag string
-      insertTags.bindValue(2, TagNotInInstance);
-    }
-    else
-    {
-      insertTags.bindValue(2, *valuesIt);
-    }
-    if (!insertTags.exec())
+    for (QMap<QString, QMap<QString, QString> >::const_iterator instanceIt = storedValuesForInstances.constBegin();
+      instanceIt != storedValuesForInstances.constEnd(); ++instanceIt)
     {
-      success = false;
+      for (QMap<QString, QString>::const_iterator tagIt = instanceIt->constBegin(); tagIt != instanceIt->constEnd(); ++tagIt)
+      {
+        d->setInMemoryCachedTag(instanceIt.key(), tagIt.key(), tagIt.value());
+      }
     }
-    ++sopInstanceUIDsIt;
-    ++tagsIt;
-    ++valuesIt;
   }
 
-  d->TagCacheDatabase.commit();
-
   return success;
 }
 
@@ -3242,12 +4853,13 @@ bool ctkDICOMDatabase::cacheTags(const QStringList sopInstanceUIDs, const QStrin
 void ctkDICOMDatabase::removeCachedTags(const QString sopInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
+  d->removeInMemoryCachedTags(sopInstanceUID);
   if (!this->tagCacheExists())
   {
     return;
   }
   QSqlQuery deleteFile(d->TagCacheDatabase);
-  deleteFile.prepare("DELETE FROM TagCache WHERE SOPInstanceUID == :sopInstanceUID");
+  deleteFile.prepare(QString("DELETE FROM %1 WHERE SOPInstanceUID == :sopInstanceUID").arg(d->tagCacheTableName(d->UseCompactTagCache)));
   deleteFile.bindValue(":sopInstanceUID", sopInstanceUID);
   bool success = deleteFile.exec();
   if (!success)
@@ -3256,16 +4868,93 @@ void ctkDICOMDatabase::removeCachedTags(const QString sopInstanceUID)
   }
 }
 
+//------------------------------------------------------------------------------
+QMap<QString, QMap<QString, QString> > ctkDICOMDatabase::cachedTagsForSeries(const QString& seriesInstanceUID, const QStringList& tags/*=QStringList()*/)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QMap<QString, QString> > cachedTagsForInstances;
+  if (!this->tagCacheExists())
+  {
+    return cachedTagsForInstances;
+  }
+  d->getCachedTagsForInstances(this->instancesForSeries(seriesInstanceUID), cachedTagsForInstances, tags, true);
+  return cachedTagsForInstances;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setMaximumInMemoryCachedTagCount(int count)
+{
+  Q_D(ctkDICOMDatabase);
+  QMutexLocker locker(&d->InMemoryTagCacheMutex);
+  d->InMemoryTagCache.setMaxCost(qMax(0, count));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::maximumInMemoryCachedTagCount() const
+{
+  Q_D(const ctkDICOMDatabase);
+  QMutexLocker locker(&d->InMemoryTagCacheMutex);
+  return d->InMemoryTagCache.maxCost();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::clearInMemoryTagCache()
+{
+  Q_D(ctkDICOMDatabase);
+  QMutexLocker locker(&d->InMemoryTagCacheMutex);
+  d->InMemoryTagCache.clear();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::inMemoryTagCacheHitCount() const
+{
+  Q_D(const ctkDICOMDatabase);
+  QMutexLocker locker(&d->InMemoryTagCacheMutex);
+  return d->InMemoryTagCacheHitCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::inMemoryTagCacheMissCount() const
+{
+  Q_D(const ctkDICOMDatabase);
+  QMutexLocker locker(&d->InMemoryTagCacheMutex);
+  return d->InMemoryTagCacheMissCount;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::resetInMemoryTagCacheCounters()
+{
+  Q_D(ctkDICOMDatabase);
+  QMutexLocker locker(&d->InMemoryTagCacheMutex);
+  d->InMemoryTagCacheHitCount = 0;
+  d->InMemoryTagCacheMissCount = 0;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMDatabase::updateDisplayedFields()
 {
   Q_D(ctkDICOMDatabase);
 
+  QTime timeProbe;
+  timeProbe.start();
+
   // Get the files for which the displayed fields have not been created yet (DisplayedFieldsUpdatedTimestamp is NULL)
   //TODO: handle cases when the values actually changed; now we only cover insertion and schema update
   QSqlQuery newFilesQuery(d->Database);
+  newFilesQuery.setForwardOnly(true);
   d->loggedExec(newFilesQuery,QString("SELECT SOPInstanceUID, SeriesInstanceUID FROM Images WHERE DisplayedFieldsUpdatedTimestamp IS NULL;"));
 
+  // Group new instances by series, as patient, study, and series only need to be looked up once for each series
+  QStringList newSOPInstanceUIDs;
+  QMap<QString /*SeriesInstanceUID*/, QStringList /*SOPInstanceUIDs*/> newInstancesForSeries;
+  while (newFilesQuery.next())
+  {
+    QString sopInstanceUID = newFilesQuery.value(0).toString();
+    newSOPInstanceUIDs << sopInstanceUID;
+    newInstancesForSeries[newFilesQuery.value(1).toString()] << sopInstanceUID;
+  }
+  newFilesQuery.finish();
+
   // Populate displayed fields maps from the current display tables
   QMap<QString /*SeriesInstanceUID*/, QMap<QString /*DisplayField*/, QString /*Value*/> > displayedFieldsMapSeries;
   QMap<QString /*StudyInstanceUID*/, QMap<QString /*DisplayField*/, QString /*Value*/> > displayedFieldsMapStudy;
@@ -3276,65 +4965,92 @@ void ctkDICOMDatabase::updateDisplayedFields()
   int progressValue = 0;
   emit displayedFieldsUpdateProgress(++progressValue);
 
-  // Get display names for newly added files and add them into the display tables
-  while (newFilesQuery.next())
+  if (!this->tagCacheExists())
   {
-    QString sopInstanceUID = newFilesQuery.value(0).toString();
-    QString seriesInstanceUID = newFilesQuery.value(1).toString();
-    QMap<QString, QString> cachedTags;
-    this->getCachedTags(sopInstanceUID, cachedTags);
+    this->initializeTagCache();
+  }
 
-    // Patient
-    QString patientsName = cachedTags[ctkDICOMItem::TagKeyStripped(DCM_PatientName)];
-    QString patientID = cachedTags[ctkDICOMItem::TagKeyStripped(DCM_PatientID)];
-    QString studyInstanceUID = cachedTags[ctkDICOMItem::TagKeyStripped(DCM_StudyInstanceUID)];
-    if (!d->uidsForDataSet(patientsName, patientID, studyInstanceUID))
+  // Get display names for newly added files and add them into the display tables.
+  // Cached tags are loaded in bulk for a group of series at a time.
+  QStringList newSeriesInstanceUIDs = newInstancesForSeries.keys();
+  int seriesIndex = 0;
+  while (seriesIndex < newSeriesInstanceUIDs.size())
+  {
+    QStringList seriesInstanceUIDsInBatch;
+    QStringList sopInstanceUIDsInBatch;
+    while (seriesIndex < newSeriesInstanceUIDs.size() && sopInstanceUIDsInBatch.size() < SQL_IN_LIST_MAXIMUM_SIZE)
     {
-      // error occurred, message is already logged
-      continue;
+      seriesInstanceUIDsInBatch << newSeriesInstanceUIDs[seriesIndex];
+      sopInstanceUIDsInBatch << newInstancesForSeries[newSeriesInstanceUIDs[seriesIndex]];
+      ++seriesIndex;
     }
-    QString patientsBirthDate = cachedTags[ctkDICOMItem::TagKeyStripped(DCM_PatientBirthDate)];
+    QMap<QString /*SOPInstanceUID*/, QMap<QString /*Tag*/, QString /*Value*/> > cachedTagsForInstances;
+    d->getCachedTagsForInstances(sopInstanceUIDsInBatch, cachedTagsForInstances);
 
-    QString compositeId = d->getDisplayPatientFieldsKey(patientID, patientsName, patientsBirthDate, displayedFieldsMapPatient);
-    if (compositeId.isEmpty())
+    foreach(const QString& seriesInstanceUID, seriesInstanceUIDsInBatch)
     {
-      logger.error("Failed to find patient for SOP Instance UID = " + sopInstanceUID);
-      continue;
-    }
-    QMap<QString, QString> displayedFieldsForCurrentPatient = displayedFieldsMapPatient[compositeId];
+      const QStringList& sopInstanceUIDsInSeries = newInstancesForSeries[seriesInstanceUID];
 
-    // Study
-    QString displayedFieldsKeyForCurrentStudy = d->getDisplayStudyFieldsKey(
-      cachedTags[ctkDICOMItem::TagKeyStripped(DCM_StudyInstanceUID)],
-      displayedFieldsMapStudy );
-    if (displayedFieldsKeyForCurrentStudy.isEmpty())
-    {
-      logger.error("Failed to find study for SOP Instance UID = " + sopInstanceUID);
-      continue;
-    }
-    QMap<QString, QString> displayedFieldsForCurrentStudy = displayedFieldsMapStudy[ displayedFieldsKeyForCurrentStudy ];
-    displayedFieldsForCurrentStudy["PatientCompositeID"] = compositeId;
+      // Patient and study are determined from the first instance of the series that has all the required fields
+      QString patientsName, patientID, studyInstanceUID, patientsBirthDate;
+      bool uidsFound = false;
+      foreach(const QString& sopInstanceUID, sopInstanceUIDsInSeries)
+      {
+        const QMap<QString, QString>& cachedTags = cachedTagsForInstances[sopInstanceUID];
+        patientsName = cachedTags.value(ctkDICOMItem::TagKeyStripped(DCM_PatientName));
+        patientID = cachedTags.value(ctkDICOMItem::TagKeyStripped(DCM_PatientID));
+        studyInstanceUID = cachedTags.value(ctkDICOMItem::TagKeyStripped(DCM_StudyInstanceUID));
+        if (d->uidsForDataSet(patientsName, patientID, studyInstanceUID))
+        {
+          patientsBirthDate = cachedTags.value(ctkDICOMItem::TagKeyStripped(DCM_PatientBirthDate));
+          uidsFound = true;
+          break;
+        }
+      }
+      if (!uidsFound)
+      {
+        // error occurred, message is already logged
+        continue;
+      }
 
-    // Series
-    QString displayedFieldsKeyForCurrentSeries = d->getDisplaySeriesFieldsKey(
-      seriesInstanceUID,
-      displayedFieldsMapSeries );
-    if (displayedFieldsKeyForCurrentSeries.isEmpty())
-    {
-      logger.error("Failed to find series for SOP Instance UID = " + sopInstanceUID);
-      continue;
-    }
-    QMap<QString, QString> displayedFieldsForCurrentSeries = displayedFieldsMapSeries[ displayedFieldsKeyForCurrentSeries ];
+      // Patient
+      QString compositeId = d->getDisplayPatientFieldsKey(patientID, patientsName, patientsBirthDate, displayedFieldsMapPatient);
+      if (compositeId.isEmpty())
+      {
+        logger.error("Failed to find patient for Series Instance UID = " + seriesInstanceUID);
+        continue;
+      }
+
+      // Study
+      QString displayedFieldsKeyForCurrentStudy = d->getDisplayStudyFieldsKey(studyInstanceUID, displayedFieldsMapStudy);
+      if (displayedFieldsKeyForCurrentStudy.isEmpty())
+      {
+        logger.error("Failed to find study for Series Instance UID = " + seriesInstanceUID);
+        continue;
+      }
+
+      // Series
+      QString displayedFieldsKeyForCurrentSeries = d->getDisplaySeriesFieldsKey(seriesInstanceUID, displayedFieldsMapSeries);
+      if (displayedFieldsKeyForCurrentSeries.isEmpty())
+      {
+        logger.error("Failed to find series for Series Instance UID = " + seriesInstanceUID);
+        continue;
+      }
 
-    // Do the update of the displayed fields using the roles
-    d->DisplayedFieldGenerator.updateDisplayedFieldsForInstance(sopInstanceUID, cachedTags,
-      displayedFieldsForCurrentSeries, displayedFieldsForCurrentStudy, displayedFieldsForCurrentPatient);
+      // Maps are not modified while the fields of this series are updated, so references remain valid
+      QMap<QString, QString>& displayedFieldsForCurrentPatient = displayedFieldsMapPatient[compositeId];
+      QMap<QString, QString>& displayedFieldsForCurrentStudy = displayedFieldsMapStudy[displayedFieldsKeyForCurrentStudy];
+      QMap<QString, QString>& displayedFieldsForCurrentSeries = displayedFieldsMapSeries[displayedFieldsKeyForCurrentSeries];
+      displayedFieldsForCurrentStudy["PatientCompositeID"] = compositeId;
 
-    // Set updated fields to the series / study / patient displayed fields maps
-    displayedFieldsMapSeries[ displayedFieldsKeyForCurrentSeries ] = displayedFieldsForCurrentSeries;
-    displayedFieldsMapStudy[ displayedFieldsKeyForCurrentStudy ] = displayedFieldsForCurrentStudy;
-    displayedFieldsMapPatient[ compositeId ] = displayedFieldsForCurrentPatient;
-  } // For each instance
+      // Do the update of the displayed fields using the roles
+      foreach(const QString& sopInstanceUID, sopInstanceUIDsInSeries)
+      {
+        d->DisplayedFieldGenerator.updateDisplayedFieldsForInstance(sopInstanceUID, cachedTagsForInstances[sopInstanceUID],
+          displayedFieldsForCurrentSeries, displayedFieldsForCurrentStudy, displayedFieldsForCurrentPatient);
+      }
+    } // For each series in batch
+  } // For each batch
 
   emit displayedFieldsUpdateProgress(++progressValue);
 
@@ -3360,20 +5076,16 @@ void ctkDICOMDatabase::updateDisplayedFields()
     if (d->applyDisplayedFieldsChanges(displayedFieldsMapSeries, displayedFieldsMapStudy, displayedFieldsMapPatient))
     {
       // Update image timestamp
-      newFilesQuery.first();
-      newFilesQuery.previous(); // Need to go one before the first record
-      while (newFilesQuery.next())
-      {
-        QSqlQuery updateDisplayedFieldsUpdatedTimestampStatement(d->Database);
-        QString updateDisplayedFieldsUpdatedTimestampStatementString =
-          QString("UPDATE IMAGES SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP WHERE SOPInstanceUID='%1';").arg(newFilesQuery.value(0).toString());
-        d->loggedExec(updateDisplayedFieldsUpdatedTimestampStatement, updateDisplayedFieldsUpdatedTimestampStatementString);
-      }
+      d->setDisplayedFieldsUpdatedTimestamp(newSOPInstanceUIDs);
     }
 
     d->Database.commit();
   }
 
+  logger.debug(QString("DICOM database has updated displayed fields of %1 instances in %2 series [%3s]")
+    .arg(newSOPInstanceUIDs.size()).arg(newInstancesForSeries.size())
+    .arg(QString::number(timeProbe.elapsed() / 1000.0, 'f', 2)));
+
   emit displayedFieldsUpdated();
   emit databaseChanged();
 }
@@ -3553,3 +5265,142 @@ void ctkDICOMDatabase::setFormatForField(QString table, QString field, QString f
 
   emit databaseChanged();
 }
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::isSearchIndexAvailable() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return !d->SearchIndexModule.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::rebuildSearchIndex()
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->SearchIndexModule.isEmpty())
+  {
+    return d->initializeSearchIndex();
+  }
+  return d->fillSearchIndex();
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::search(const QString& text, const QString& table, int maximumCount)
+{
+  Q_D(ctkDICOMDatabase);
+  QString uidColumn;
+  if (table == "Patients")
+  {
+    uidColumn = "PatientsUID";
+  }
+  else if (table == "Studies")
+  {
+    uidColumn = "StudyInstanceUID";
+  }
+  else if (table == "Series")
+  {
+    uidColumn = "SeriesInstanceUID";
+  }
+  else
+  {
+    logger.error("Search failed: invalid table name " + table);
+    return QStringList();
+  }
+  if (text.trimmed().isEmpty())
+  {
+    return QStringList();
+  }
+
+  QSqlQuery query(d->readDatabase());
+  if (!d->SearchIndexModule.isEmpty())
+  {
+    // A patient or study matches as well as its best matching series.
+    // FTS4 does not compute a rank, matches are returned in index order.
+    QString score = (d->SearchIndexModule == "fts5" ? "rank" : "0");
+    query.prepare(QString("SELECT %1 FROM ( SELECT %1, %2 AS Score FROM SearchIndex WHERE SearchIndex MATCH ? ) "
+      "GROUP BY %1 ORDER BY MIN(Score) LIMIT ? ;").arg(uidColumn).arg(score));
+    query.addBindValue(d->searchIndexMatchExpression(text));
+  }
+  else
+  {
+    // No full-text search in the SQLite library, all the rows are scanned
+    QStringList fields = QStringList() << "Patients.PatientsName" << "Patients.DisplayedPatientsName"
+      << "Patients.PatientID" << "Studies.AccessionNumber" << "Studies.StudyDescription" << "Series.SeriesDescription";
+    QStringList wordConditions;
+    QVariantList bindValues;
+    #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    QStringList words = text.simplified().split(' ', Qt::SkipEmptyParts);
+    #else
+    QStringList words = text.simplified().split(' ', QString::SkipEmptyParts);
+    #endif
+    foreach (const QString& word, words)
+    {
+      QStringList fieldConditions;
+      foreach (const QString& field, fields)
+      {
+        fieldConditions << field + " LIKE ?";
+        bindValues << QString("%" + word + "%");
+      }
+      wordConditions << "( " + fieldConditions.join(" OR ") + " )";
+    }
+    query.prepare(QString("SELECT DISTINCT %1 FROM ( SELECT Patients.UID AS PatientsUID, Studies.StudyInstanceUID, Series.SeriesInstanceUID "
+      "FROM Patients, Studies, Series "
+      "WHERE Patients.UID = Studies.PatientsUID AND Studies.StudyInstanceUID = Series.StudyInstanceUID AND %2 ) LIMIT ? ;")
+      .arg(uidColumn).arg(wordConditions.join(" AND ")));
+    foreach (const QVariant& bindValue, bindValues)
+    {
+      query.addBindValue(bindValue);
+    }
+  }
+  query.addBindValue(maximumCount);
+  QStringList result;
+  if (!d->loggedExec(query))
+  {
+    return result;
+  }
+  while (query.next())
+  {
+    result << query.value(0).toString();
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::createDisplayedFieldIndexes(QString table)
+{
+  Q_D(ctkDICOMDatabase);
+
+  if (!this->isOpen() || !this->isDisplayedFieldsTableAvailable())
+  {
+    return false;
+  }
+
+  QSqlQuery query(d->Database);
+  query.prepare("SELECT FieldName FROM ColumnDisplayProperties WHERE TableName = ? AND Visibility != 0 ;");
+  query.addBindValue(table);
+  if (!d->loggedExec(query))
+  {
+    return false;
+  }
+  QStringList fields;
+  while (query.next())
+  {
+    fields << query.value(0).toString();
+  }
+  query.finish();
+
+  QSqlRecord tableRecord = d->Database.record(table);
+  bool success = true;
+  foreach (const QString& field, fields)
+  {
+    if (!tableRecord.contains(field))
+    {
+      // displayed field is not stored in this table
+      continue;
+    }
+    QSqlQuery createIndexQuery(d->Database);
+    success = d->loggedExec(createIndexQuery, QString("CREATE INDEX IF NOT EXISTS '%1%2DisplayedIndex' ON '%1' ('%2');")
+      .arg(table).arg(field)) && success;
+  }
+  return success;
+}
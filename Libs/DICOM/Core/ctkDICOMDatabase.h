@@ -33,6 +33,7 @@ class QDateTime;
 class ctkDICOMDatabasePrivate;
 class DcmDataset;
 class ctkDICOMAbstractThumbnailGenerator;
+class ctkDICOMThumbnailStore;
 
 /// \ingroup DICOM_Core
 ///
@@ -48,11 +49,13 @@ class ctkDICOMAbstractThumbnailGenerator;
 /// a directoy for each study, containing a directory for each series, containing
 /// a file for each object. The corresponding UIDs are used as filenames.
 /// Thumbnais for each image can be created; if so, they are stored in a directory
-/// parallel to "dicom" directory called "thumbs".
+/// parallel to "dicom" directory called "thumbs", packed in one file per series
+/// (see ctkDICOMThumbnailStore).
 class CTK_DICOM_CORE_EXPORT ctkDICOMDatabase : public QObject
 {
 
   Q_OBJECT
+  Q_ENUMS(ImportStoragePolicy)
   Q_PROPERTY(bool isOpen READ isOpen)
   Q_PROPERTY(bool isInMemory READ isInMemory)
   Q_PROPERTY(QString lastError READ lastError)
@@ -64,6 +67,13 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMDatabase : public QObject
   Q_PROPERTY(QStringList studyFieldNames READ studyFieldNames)
   Q_PROPERTY(QStringList seriesFieldNames READ seriesFieldNames)
   Q_PROPERTY(bool useShortStoragePath READ useShortStoragePath WRITE setUseShortStoragePath)
+  Q_PROPERTY(bool useWriteAheadLogging READ useWriteAheadLogging WRITE setUseWriteAheadLogging)
+  Q_PROPERTY(bool useCompactTagCache READ useCompactTagCache WRITE setUseCompactTagCache)
+  Q_PROPERTY(ctkDICOMDatabase::ImportStoragePolicy importStoragePolicy READ importStoragePolicy WRITE setImportStoragePolicy)
+  Q_PROPERTY(int fileTransferThreadCount READ fileTransferThreadCount WRITE setFileTransferThreadCount)
+  Q_PROPERTY(int maximumInMemoryCachedTagCount READ maximumInMemoryCachedTagCount WRITE setMaximumInMemoryCachedTagCount)
+  Q_PROPERTY(int inMemoryTagCacheHitCount READ inMemoryTagCacheHitCount)
+  Q_PROPERTY(int inMemoryTagCacheMissCount READ inMemoryTagCacheMissCount)
 
 public:
   struct IndexingResult
@@ -74,6 +84,24 @@ public:
     bool overwriteExistingDataset;
   };
 
+  /// Defines how files are stored in the database folder when they are inserted with storeFile/copyFile enabled.
+  /// If the requested method is not available (e.g., the database is on a different
+  /// file system or the file system does not support it) then the next one is tried,
+  /// up to copying the file.
+  enum ImportStoragePolicy
+  {
+    /// Copy the file content (default)
+    CopyFiles = 0,
+    /// Create a hard link to the original file (no copy, falls back to reflink then copy).
+    /// The stored file shares its content with the original file: modifying the original
+    /// file modifies the stored file.
+    HardLinkFiles,
+    /// Copy-on-write clone of the file (Linux FICLONE, e.g., on Btrfs or XFS), falls back to copy
+    ReflinkFiles,
+    /// Move the original file into the database folder
+    MoveFiles
+  };
+
   explicit ctkDICOMDatabase(QObject *parent = 0);
   explicit ctkDICOMDatabase(QString databaseFile);
   virtual ~ctkDICOMDatabase();
@@ -103,6 +131,15 @@ public:
   Q_INVOKABLE void setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator* generator);
   /// Get thumbnail generator object
   Q_INVOKABLE ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator();
+  /// Store of the thumbnails, located in the "thumbs" subfolder of the database directory.
+  /// Thumbnails are generated into the store if the thumbnail generator supports it
+  /// (see ctkDICOMAbstractThumbnailGenerator::generateStoredThumbnail), otherwise
+  /// as files in the "thumbs" folder.
+  ctkDICOMThumbnailStore* thumbnailStore();
+  /// Move the thumbnail files of the former layout (one PNG file per instance)
+  /// of all the instances into the thumbnail store.
+  /// Returns the number of migrated thumbnails.
+  Q_INVOKABLE int migrateThumbnailFiles();
 
   /// Open the SQLite database in @param databaseFile . If the file does not
   /// exist, a new database is created and initialized with the
@@ -250,6 +287,12 @@ public:
 
   Q_INVOKABLE void insert(const QList<ctkDICOMDatabase::IndexingResult>& indexingResults);
 
+  /// Generate the thumbnail of an instance of the database, unless it is up-to-date.
+  /// The batch insert does not generate thumbnails, this allows generating them
+  /// afterwards for some of the inserted instances.
+  /// Returns false if the instance is not in the database or no thumbnail was generated.
+  Q_INVOKABLE bool generateThumbnailForInstance(const QString& sopInstanceUID);
+
   /// When a DICOM file is stored in the database (insert is called with storeFile=true) then
   /// path is constructed from study, series, and SOP instance UID.
   /// If useShortStoragePath is false then the full UIDs are used as subfolder and file name.
@@ -261,6 +304,38 @@ public:
   void setUseShortStoragePath(bool useShort);
   bool useShortStoragePath()const;
 
+  /// If useWriteAheadLogging is true then the database and the tag cache are opened in
+  /// write-ahead logging (WAL) journal mode. In this mode readers do not block the writer
+  /// and the writer does not block readers, therefore browsing the database remains responsive
+  /// while the indexer commits large batches. Queries made from a thread other than the one
+  /// that opened the database then use a separate read-only connection for each thread.
+  /// The journal mode is stored in the database file. Disabled by default and ignored for
+  /// in-memory databases. Must be set before the database is opened.
+  void setUseWriteAheadLogging(bool useWAL);
+  bool useWriteAheadLogging()const;
+
+  /// If useCompactTagCache is true then all cached tags of an instance are stored in a single row
+  /// of the tag cache database, packed into a binary blob (numeric tag keys and length-prefixed values).
+  /// This makes the tag cache much smaller and faster for large databases than the default format,
+  /// which stores each cached tag in a separate row.
+  /// When the database is opened, the format of its existing tag cache is used (this property
+  /// is updated accordingly) and the requested format only applies to a new tag cache.
+  /// Changing this property while the database is open converts the existing tag cache.
+  /// Disabled by default.
+  void setUseCompactTagCache(bool useCompact);
+  bool useCompactTagCache()const;
+
+  /// How inserted files are stored in the database folder. CopyFiles by default.
+  void setImportStoragePolicy(ctkDICOMDatabase::ImportStoragePolicy policy);
+  ctkDICOMDatabase::ImportStoragePolicy importStoragePolicy()const;
+
+  /// Number of threads that store files in the database folder when a list
+  /// of indexing results is inserted. Copying in parallel is much faster than
+  /// copying one file at a time when importing from another device. Default is 4.
+  /// The same number of threads is used for deleting files of removed series.
+  void setFileTransferThreadCount(int count);
+  int fileTransferThreadCount()const;
+
   /// Update the fields in the database that are used for displaying information
   /// from information stored in the tag-cache.
   /// Displayed fields are useful if the raw DICOM tags are not human readable, or
@@ -293,8 +368,22 @@ public:
   /// By default clearCachedTags is disabled because it significantly increases deletion time
   /// on large databases.
   Q_INVOKABLE bool removeSeries(const QString& seriesInstanceUID, bool clearCachedTags=false);
+  /// Remove a study or patient, including the cached tags of its instances.
   Q_INVOKABLE bool removeStudy(const QString& studyInstanceUID);
   Q_INVOKABLE bool removePatient(const QString& patientID);
+  /// Remove multiple series, studies or patients (specified by their UID in the Patients table) at once.
+  /// Database rows are removed by a few set-based statements in a single transaction before the
+  /// method returns. Files and thumbnails are deleted in the background by a pool of threads,
+  /// progress is reported by fileRemovalStarted(), fileRemovalProgress() and fileRemovalFinished().
+  /// Files of a series that is inserted again are stored only after its previous files are deleted.
+  /// Studies and patients that have no series left are removed as well.
+  /// Cached tags of the instances are removed from the database only if clearCachedTags is true,
+  /// values cached in memory are always discarded.
+  Q_INVOKABLE bool removeSeriesList(const QStringList& seriesInstanceUIDs, bool clearCachedTags=true);
+  Q_INVOKABLE bool removeStudyList(const QStringList& studyInstanceUIDs, bool clearCachedTags=true);
+  Q_INVOKABLE bool removePatientList(const QStringList& patientUIDs, bool clearCachedTags=true);
+  /// Wait until all files of removed series are deleted
+  Q_INVOKABLE void waitForFileRemoval();
   /// Remove all patients, studies, series, which do not have associated images.
   /// If vacuum is set to true then the whole database content is attempted to
   /// cleaned from remnants of all previously deleted data from the file.
@@ -312,6 +401,17 @@ public:
   Q_INVOKABLE QString instanceValue (const QString sopInstanceUID, const unsigned short group, const unsigned short element);
   Q_INVOKABLE QString fileValue (const QString fileName, const QString tag);
   Q_INVOKABLE QString fileValue (const QString fileName, const unsigned short group, const unsigned short element);
+
+  /// \brief Access element values for all instances of a series
+  /// Values are retrieved from the tag cache using a few queries. Files of instances
+  /// that have tags missing from the tag cache are parsed in parallel (only up to the pixel data,
+  /// if possible) and the missing values are added to the tag cache in one transaction.
+  /// @param seriesInstanceUID The series to get the instance values of
+  /// @param tags List of group,element tags in zero-filled hex (such as "0020,0032")
+  /// @Returns map from SOP instance UID to list of values, in the same order as in tags.
+  ///   A value is empty string if the element is missing or excluded from storage.
+  QMap<QString, QStringList> instanceValues(const QString& seriesInstanceUID, const QStringList& tags);
+
   Q_INVOKABLE bool tagToGroupElement (const QString tag, unsigned short& group, unsigned short& element);
   Q_INVOKABLE QString groupElementToTag (const unsigned short& group, const unsigned short& element);
 
@@ -350,6 +450,26 @@ public:
   Q_INVOKABLE bool cacheTags (const QStringList sopInstanceUIDs, const QStringList tags, const QStringList values);
   /// Remove all tags corresponding to a SOP instance UID
   void removeCachedTags(const QString sopInstanceUID);
+  /// Return cached tags and values of all instances of a series (SOPInstanceUID -> (tag -> value)),
+  /// using a few queries instead of one query per instance. Values are returned the same way as
+  /// in getCachedTags. If tags is not empty then only the specified tags are retrieved.
+  /// Retrieved values are also stored in the in-memory tag cache, so subsequent cachedTag and
+  /// instanceValue calls for this series do not need to query the database.
+  QMap<QString, QMap<QString, QString> > cachedTagsForSeries(const QString& seriesInstanceUID,
+    const QStringList& tags = QStringList());
+
+  /// Cached tag values are kept in a bounded in-memory cache in front of the tag cache database.
+  /// Least recently used instances are removed from the cache when more than the maximum
+  /// number of tag values are stored. Set to 0 to disable the in-memory cache. Default is 100000.
+  void setMaximumInMemoryCachedTagCount(int count);
+  int maximumInMemoryCachedTagCount() const;
+  /// Remove all values from the in-memory tag cache.
+  /// Needs to be called if the tag cache is modified by another database object.
+  Q_INVOKABLE void clearInMemoryTagCache();
+  /// Number of cachedTag lookups that were found (hit) or not found (miss) in the in-memory cache
+  int inMemoryTagCacheHitCount() const;
+  int inMemoryTagCacheMissCount() const;
+  Q_INVOKABLE void resetInMemoryTagCacheCounters();
 
   /// Get displayed name of a given field
   Q_INVOKABLE QString displayedNameForField(QString table, QString field) const;
@@ -374,6 +494,26 @@ public:
   /// Set format of a given field
   Q_INVOKABLE void setFormatForField(QString table, QString field, QString format);
 
+  /// Search in the patient name (raw and displayed), patient ID, accession number,
+  /// study description and series description using the full-text search index.
+  /// Each word of text must match the beginning of a word in any of these fields.
+  /// Returns the UIDs of the matching rows of table (Patients, Studies or Series),
+  /// best matches first, at most maximumCount items.
+  /// If the SQLite library has no full-text search module then all the rows are scanned
+  /// and words can match anywhere in the fields.
+  Q_INVOKABLE QStringList search(const QString& text, const QString& table = QString("Studies"), int maximumCount = 100);
+  /// Return true if the full-text search index is available.
+  /// The index is created when the database is opened and it is updated when
+  /// series are inserted or removed and when displayed fields are updated.
+  Q_INVOKABLE bool isSearchIndexAvailable() const;
+  /// Fill the search index again from the content of the database
+  Q_INVOKABLE bool rebuildSearchIndex();
+
+  /// Create an index for each visible field of a table (as defined in ColumnDisplayProperties)
+  /// so that the table can be sorted by any displayed column without a full table scan.
+  /// Indexes that already exist are not created again.
+  Q_INVOKABLE bool createDisplayedFieldIndexes(QString table);
+
 Q_SIGNALS:
 
   /// Things inserted to database.
@@ -424,6 +564,13 @@ Q_SIGNALS:
   /// Indicate displayed fields update finished
   void displayedFieldsUpdated();
 
+  /// Indicate that files of removed series are being deleted in the background (int is number of files)
+  void fileRemovalStarted(int);
+  /// Indicate progress in deleting files (number of deleted files, total number of files)
+  void fileRemovalProgress(int, int);
+  /// Indicate that all files of a removal are deleted
+  void fileRemovalFinished();
+
 protected:
   QScopedPointer<ctkDICOMDatabasePrivate> d_ptr;
 
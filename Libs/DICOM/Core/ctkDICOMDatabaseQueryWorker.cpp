@@ -0,0 +1,215 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabaseQueryWorker_p.h"
+#include "ctkLogger.h"
+
+static ctkLogger logger("org.commontk.dicom.DICOMDatabaseQueryWorker");
+
+//------------------------------------------------------------------------------
+// ctkDICOMDatabaseQueryExecutor methods
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabaseQueryExecutor::ctkDICOMDatabaseQueryExecutor(const QString& databaseFilename, QAtomicInt& generation)
+  : DatabaseFilename(databaseFilename)
+  , Generation(generation)
+{
+  this->ConnectionName = QString("ctkDICOMDatabaseQueryWorker%1").arg(reinterpret_cast<quintptr>(this));
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabaseQueryExecutor::~ctkDICOMDatabaseQueryExecutor()
+{
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabaseQueryExecutor::openConnection()
+{
+  if (QSqlDatabase::contains(this->ConnectionName))
+  {
+    return QSqlDatabase::database(this->ConnectionName).isOpen();
+  }
+  QSqlDatabase connection = QSqlDatabase::addDatabase("QSQLITE", this->ConnectionName);
+  connection.setDatabaseName(this->DatabaseFilename);
+  connection.setConnectOptions("QSQLITE_OPEN_READONLY");
+  if (!connection.open())
+  {
+    logger.error(QString("Failed to open query worker connection to %1: %2")
+      .arg(this->DatabaseFilename).arg(connection.lastError().text()));
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabaseQueryExecutor::closeConnection()
+{
+  if (!QSqlDatabase::contains(this->ConnectionName))
+  {
+    return;
+  }
+  {
+    QSqlDatabase connection = QSqlDatabase::database(this->ConnectionName, false);
+    connection.close();
+  }
+  QSqlDatabase::removeDatabase(this->ConnectionName);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabaseQueryExecutor::execute(int requestId, int generation,
+  const QString& queryString, const QVariantList& bindValues, int chunkRowCount)
+{
+  if (generation != this->Generation.fetchAndAddOrdered(0))
+  {
+    // request was cancelled while it was waiting in the queue
+    return;
+  }
+
+  QVariantList rows;
+  if (!this->openConnection())
+  {
+    emit executed(requestId, generation, false, rows);
+    return;
+  }
+
+  bool success = false;
+  {
+    QSqlQuery query(QSqlDatabase::database(this->ConnectionName));
+    query.setForwardOnly(true);
+    query.prepare(queryString);
+    foreach (const QVariant& bindValue, bindValues)
+    {
+      query.addBindValue(bindValue);
+    }
+    success = query.exec();
+    if (success)
+    {
+      int columnCount = query.record().count();
+      while (query.next())
+      {
+        QVariantList row;
+        for (int column = 0; column < columnCount; ++column)
+        {
+          row << query.value(column);
+        }
+        rows << QVariant(row);
+        if (chunkRowCount > 0 && rows.size() >= chunkRowCount)
+        {
+          if (generation != this->Generation.fetchAndAddOrdered(0))
+          {
+            // request was cancelled while it was executed
+            return;
+          }
+          emit rowsFetched(requestId, generation, rows);
+          rows.clear();
+        }
+      }
+    }
+    else
+    {
+      logger.error(QString("Query worker failed to execute %1: %2")
+        .arg(queryString).arg(query.lastError().text()));
+    }
+  }
+  emit executed(requestId, generation, success, rows);
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMDatabaseQueryWorker methods
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabaseQueryWorker::ctkDICOMDatabaseQueryWorker(const QString& databaseFilename, QObject* parent)
+  : QObject(parent)
+  , DatabaseFilename(databaseFilename)
+  , Generation(0)
+  , LastRequestId(0)
+{
+  this->Executor = new ctkDICOMDatabaseQueryExecutor(databaseFilename, this->Generation);
+  this->Executor->moveToThread(&this->Thread);
+
+  QObject::connect(this, SIGNAL(executeRequested(int,int,QString,QVariantList,int)),
+    this->Executor, SLOT(execute(int,int,QString,QVariantList,int)));
+  QObject::connect(this->Executor, SIGNAL(executed(int,int,bool,QVariantList)),
+    this, SLOT(onExecuted(int,int,bool,QVariantList)));
+  QObject::connect(this->Executor, SIGNAL(rowsFetched(int,int,QVariantList)),
+    this, SLOT(onRowsFetched(int,int,QVariantList)));
+  // finished() is emitted by the worker thread itself, so the connection is removed by the thread that used it
+  QObject::connect(&this->Thread, SIGNAL(finished()),
+    this->Executor, SLOT(closeConnection()), Qt::DirectConnection);
+
+  this->Thread.start();
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabaseQueryWorker::~ctkDICOMDatabaseQueryWorker()
+{
+  this->cancel();
+  this->Thread.quit();
+  this->Thread.wait();
+  delete this->Executor;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabaseQueryWorker::databaseFilename()const
+{
+  return this->DatabaseFilename;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabaseQueryWorker::execute(const QString& queryString, const QVariantList& bindValues, int chunkRowCount)
+{
+  int requestId = ++this->LastRequestId;
+  emit executeRequested(requestId, this->Generation.fetchAndAddOrdered(0), queryString, bindValues, chunkRowCount);
+  return requestId;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabaseQueryWorker::cancel()
+{
+  this->Generation.fetchAndAddOrdered(1);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabaseQueryWorker::onExecuted(int requestId, int generation, bool success, const QVariantList& rows)
+{
+  if (generation != this->Generation.fetchAndAddOrdered(0))
+  {
+    // request was cancelled while it was executed
+    return;
+  }
+  emit executed(requestId, success, rows);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabaseQueryWorker::onRowsFetched(int requestId, int generation, const QVariantList& rows)
+{
+  if (generation != this->Generation.fetchAndAddOrdered(0))
+  {
+    return;
+  }
+  emit rowsFetched(requestId, rows);
+}
@@ -0,0 +1,118 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMDatabaseQueryWorker_p_h
+#define __ctkDICOMDatabaseQueryWorker_p_h
+
+// Qt includes
+#include <QAtomicInt>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVariant>
+
+class ctkDICOMDatabaseQueryExecutor;
+
+//------------------------------------------------------------------------------
+/// \ingroup DICOM_Core
+///
+/// Executes read-only SQL queries on a database file in a background thread.
+///
+/// The worker owns a thread and a read-only connection to the database file
+/// that is only used by that thread. Results are sent back as queued signals,
+/// so they are received in the thread of the worker object.
+/// Requests are identified by an id. cancel() discards the results of all the
+/// requests that were made before, including those that are not executed yet,
+/// and stops the request that is being executed at the next chunk of rows.
+class ctkDICOMDatabaseQueryWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit ctkDICOMDatabaseQueryWorker(const QString& databaseFilename, QObject* parent = 0);
+  virtual ~ctkDICOMDatabaseQueryWorker();
+
+  QString databaseFilename()const;
+
+  /// Queue a query. Bind values are bound to the positional placeholders
+  /// of the query in order. Returns the id of the request.
+  /// If chunkRowCount is positive then rows are sent by rowsFetched() as soon as
+  /// chunkRowCount rows are read, and executed() only contains the remaining rows.
+  int execute(const QString& queryString, const QVariantList& bindValues = QVariantList(), int chunkRowCount = 0);
+
+  /// Discard the results of all the requests made so far
+  void cancel();
+
+Q_SIGNALS:
+  /// Emitted when a request is executed. Each item of rows is a QVariantList
+  /// containing the values of a row. If the query failed then success is false.
+  void executed(int requestId, bool success, const QVariantList& rows);
+  /// Emitted for each chunk of rows of a request that is being executed
+  void rowsFetched(int requestId, const QVariantList& rows);
+
+  /// Internal signal used for sending requests to the executor
+  void executeRequested(int requestId, int generation, const QString& queryString,
+    const QVariantList& bindValues, int chunkRowCount);
+
+protected Q_SLOTS:
+  void onExecuted(int requestId, int generation, bool success, const QVariantList& rows);
+  void onRowsFetched(int requestId, int generation, const QVariantList& rows);
+
+protected:
+  QString DatabaseFilename;
+  QThread Thread;
+  ctkDICOMDatabaseQueryExecutor* Executor;
+  /// Incremented when requests are cancelled. Shared with the executor.
+  QAtomicInt Generation;
+  int LastRequestId;
+
+private:
+  Q_DISABLE_COPY(ctkDICOMDatabaseQueryWorker);
+};
+
+//------------------------------------------------------------------------------
+/// Object living in the thread of a ctkDICOMDatabaseQueryWorker that executes the queries
+class ctkDICOMDatabaseQueryExecutor : public QObject
+{
+  Q_OBJECT
+
+public:
+  ctkDICOMDatabaseQueryExecutor(const QString& databaseFilename, QAtomicInt& generation);
+  virtual ~ctkDICOMDatabaseQueryExecutor();
+
+public Q_SLOTS:
+  void execute(int requestId, int generation, const QString& queryString,
+    const QVariantList& bindValues, int chunkRowCount);
+  /// Close and remove the connection. Must be called from the thread of the executor.
+  void closeConnection();
+
+Q_SIGNALS:
+  void executed(int requestId, int generation, bool success, const QVariantList& rows);
+  void rowsFetched(int requestId, int generation, const QVariantList& rows);
+
+protected:
+  bool openConnection();
+
+  QString DatabaseFilename;
+  QString ConnectionName;
+  QAtomicInt& Generation;
+};
+
+#endif
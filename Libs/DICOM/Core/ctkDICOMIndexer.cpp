@@ -29,6 +29,7 @@
 #include <QFile>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QThreadPool>
 #include <QDebug>
 
 // ctkDICOM includes
@@ -49,6 +50,11 @@
 #include <dcmtk/dcmimgle/dcmimage.h>  /* for class DicomImage */
 #include <dcmtk/dcmimage/diregist.h>  /* include support for color images */
 
+// STD includes
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
 
 //------------------------------------------------------------------------------
 static ctkLogger logger("org.commontk.dicom.DICOMIndexer" );
@@ -57,7 +63,374 @@ static ctkLogger logger("org.commontk.dicom.DICOMIndexer" );
 /// Increasing cache size increases maximum memory usage, very low cache size
 /// slows down database insertion.
 static int REQUEST_RESULTS_CACHE_MAXIMUM_SIZE = 5000;
+
+/// How many files may be queued for parsing per parser thread.
+/// Limits memory usage when parsing is faster than writing into the database.
+static int PARSER_QUEUE_SIZE_PER_THREAD = 100;
+
+/// Maximum time to keep parsing results before inserting them into the database.
+/// Makes the first results visible soon when a large directory is indexed.
+static int REQUEST_RESULTS_MAXIMUM_DELAY_MSEC = 3000;
+
+/// Maximum number of files that are found ahead of parsing.
+/// Files are found while all the parser threads are busy.
+static int FOUND_FILES_MAXIMUM_SIZE = 10000;
+
+/// Maximum number of files that are found in one step while enumerating a directory tree
+static int FILES_PER_ENUMERATION_STEP = 100;
+
+/// Time to wait after a change in a watched directory before it is re-scanned.
+/// Copying a series into a folder generates many change notifications.
+static int WATCHED_DIRECTORY_RESCAN_DELAY_MSEC = 2000;
+
+/// Maximum number of watched directories. Each watched directory uses
+/// an operating system resource (e.g., an inotify watch on Linux), which are
+/// limited per user. Root directories are always watched, subdirectories
+/// only up to this limit.
+static int WATCHED_DIRECTORIES_MAXIMUM_COUNT = 2000;
+//------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerPrivateDirectoryScanState methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerPrivateDirectoryScanState::ctkDICOMIndexerPrivateDirectoryScanState(const QSqlDatabase& database)
+: Database(database)
+, FileFilters(QDir::Files)
+, DirectoryFilters(QDir::Dirs | QDir::NoDotAndDotDot)
+{
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivateDirectoryScanState::initialize()
+{
+  QSqlQuery query(this->Database);
+  if (!query.exec("CREATE TABLE IF NOT EXISTS DirectoryScanState ("
+    "Path TEXT PRIMARY KEY NOT NULL, ParentPath TEXT, ModifiedTime INTEGER)")
+    || !query.exec("CREATE INDEX IF NOT EXISTS DirectoryScanStateParentIndex ON DirectoryScanState (ParentPath)")
+    || !query.exec("CREATE TABLE IF NOT EXISTS FileScanState ("
+    "Path TEXT PRIMARY KEY NOT NULL, DirectoryPath TEXT, Size INTEGER, ModifiedTime INTEGER, Inode INTEGER)")
+    || !query.exec("CREATE INDEX IF NOT EXISTS FileScanStateDirectoryIndex ON FileScanState (DirectoryPath)"))
+  {
+    logger.error("Failed to create directory scan state tables: " + query.lastError().text());
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerPrivateDirectoryScanState::FileState ctkDICOMIndexerPrivateDirectoryScanState::currentFileState(const QFileInfo& fileInfo)
+{
+  FileState state;
+  state.Size = fileInfo.size();
+  state.ModifiedTime = fileInfo.lastModified().toMSecsSinceEpoch();
+#ifdef Q_OS_UNIX
+  struct stat fileStat;
+  if (::stat(QFile::encodeName(fileInfo.absoluteFilePath()).constData(), &fileStat) == 0)
+  {
+    state.Inode = static_cast<quint64>(fileStat.st_ino);
+  }
+#endif
+  return state;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivateDirectoryScanState::startScan(const QString& directoryPath, bool includeHidden)
+{
+  this->FileFilters = QDir::Files;
+  // Symbolic links to directories are not followed, same as in a full directory scan
+  this->DirectoryFilters = QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks;
+  if (includeHidden)
+  {
+    this->FileFilters |= QDir::Hidden;
+    this->DirectoryFilters |= QDir::Hidden;
+  }
+
+  this->DirectoryQuery = QSqlQuery(this->Database);
+  this->DirectoryQuery.prepare("SELECT ModifiedTime FROM DirectoryScanState WHERE Path = :path");
+  this->SubdirectoriesQuery = QSqlQuery(this->Database);
+  this->SubdirectoriesQuery.prepare("SELECT Path FROM DirectoryScanState WHERE ParentPath = :path");
+  this->FilesQuery = QSqlQuery(this->Database);
+  this->FilesQuery.prepare("SELECT Path, Size, ModifiedTime, Inode FROM FileScanState WHERE DirectoryPath = :path");
+
+  this->DirectoriesToScan.clear();
+  this->DirectoriesToScan << QDir(directoryPath).absolutePath();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivateDirectoryScanState::scanNextDirectory(QStringList& changedFiles)
+{
+  if (this->DirectoriesToScan.isEmpty())
+  {
+    return false;
+  }
+
+  QString currentDirectoryPath = this->DirectoriesToScan.takeLast();
+  qint64 modifiedTime = QFileInfo(currentDirectoryPath).lastModified().toMSecsSinceEpoch();
+
+  this->DirectoryQuery.bindValue(":path", currentDirectoryPath);
+  this->DirectoryQuery.exec();
+  bool scannedBefore = this->DirectoryQuery.next();
+  bool unchanged = scannedBefore && this->DirectoryQuery.value(0).toLongLong() == modifiedTime;
+  this->DirectoryQuery.finish();
+
+  QStringList previousSubdirectories;
+  if (scannedBefore)
+  {
+    this->SubdirectoriesQuery.bindValue(":path", currentDirectoryPath);
+    this->SubdirectoriesQuery.exec();
+    while (this->SubdirectoriesQuery.next())
+    {
+      previousSubdirectories << this->SubdirectoriesQuery.value(0).toString();
+    }
+  }
+
+  if (unchanged)
+  {
+    // No entries were added, removed, or renamed in this directory
+    this->DirectoriesToScan << previousSubdirectories;
+    return true;
+  }
+
+  QMap<QString, FileState> previousFiles;
+  if (scannedBefore)
+  {
+    this->FilesQuery.bindValue(":path", currentDirectoryPath);
+    this->FilesQuery.exec();
+    while (this->FilesQuery.next())
+    {
+      FileState fileState;
+      fileState.Size = this->FilesQuery.value(1).toLongLong();
+      fileState.ModifiedTime = this->FilesQuery.value(2).toLongLong();
+      fileState.Inode = this->FilesQuery.value(3).toULongLong();
+      previousFiles[this->FilesQuery.value(0).toString()] = fileState;
+    }
+  }
+
+  QDir directory(currentDirectoryPath);
+  DirectoryState directoryState;
+  directoryState.ParentPath = QFileInfo(currentDirectoryPath).absolutePath();
+  directoryState.ModifiedTime = modifiedTime;
+  foreach(const QFileInfo& fileInfo, directory.entryInfoList(this->FileFilters))
+  {
+    QString filePath = fileInfo.absoluteFilePath();
+    FileState fileState = currentFileState(fileInfo);
+    QMap<QString, FileState>::const_iterator previousFileIt = previousFiles.constFind(filePath);
+    if (previousFileIt == previousFiles.constEnd() || previousFileIt.value() != fileState)
+    {
+      changedFiles << filePath;
+    }
+    directoryState.Files[filePath] = fileState;
+  }
+  this->ChangedDirectories[currentDirectoryPath] = directoryState;
+
+  QStringList subdirectories;
+  foreach(const QFileInfo& subdirectoryInfo, directory.entryInfoList(this->DirectoryFilters))
+  {
+    subdirectories << subdirectoryInfo.absoluteFilePath();
+  }
+  foreach(const QString& previousSubdirectory, previousSubdirectories)
+  {
+    if (!subdirectories.contains(previousSubdirectory))
+    {
+      this->RemovedDirectories << previousSubdirectory;
+    }
+  }
+  this->DirectoriesToScan << subdirectories;
+  return true;
+}
+
 //------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivateDirectoryScanState::commit()
+{
+  if (this->ChangedDirectories.isEmpty() && this->RemovedDirectories.isEmpty())
+  {
+    return true;
+  }
+
+  this->Database.transaction();
+
+  // Subdirectories are selected by a range of paths instead of LIKE, which would
+  // treat '_' and '%' in directory names as wildcards ('0' follows '/' in ASCII).
+  QSqlQuery removeDirectoriesQuery(this->Database);
+  removeDirectoriesQuery.prepare("DELETE FROM DirectoryScanState WHERE Path = :path "
+    "OR (Path >= :subdirectoriesBegin AND Path < :subdirectoriesEnd)");
+  QSqlQuery removeFilesQuery(this->Database);
+  removeFilesQuery.prepare("DELETE FROM FileScanState WHERE DirectoryPath = :path "
+    "OR (DirectoryPath >= :subdirectoriesBegin AND DirectoryPath < :subdirectoriesEnd)");
+  bool success = true;
+  foreach(const QString& directoryPath, this->RemovedDirectories)
+  {
+    removeDirectoriesQuery.bindValue(":path", directoryPath);
+    removeDirectoriesQuery.bindValue(":subdirectoriesBegin", directoryPath + "/");
+    removeDirectoriesQuery.bindValue(":subdirectoriesEnd", directoryPath + "0");
+    removeFilesQuery.bindValue(":path", directoryPath);
+    removeFilesQuery.bindValue(":subdirectoriesBegin", directoryPath + "/");
+    removeFilesQuery.bindValue(":subdirectoriesEnd", directoryPath + "0");
+    success = success && removeDirectoriesQuery.exec() && removeFilesQuery.exec();
+  }
+
+  QSqlQuery insertDirectoryQuery(this->Database);
+  insertDirectoryQuery.prepare("INSERT OR REPLACE INTO DirectoryScanState (Path, ParentPath, ModifiedTime) VALUES (:path, :parentPath, :modifiedTime)");
+  QSqlQuery clearFilesQuery(this->Database);
+  clearFilesQuery.prepare("DELETE FROM FileScanState WHERE DirectoryPath = :path");
+  QSqlQuery insertFileQuery(this->Database);
+  insertFileQuery.prepare("INSERT OR REPLACE INTO FileScanState (Path, DirectoryPath, Size, ModifiedTime, Inode) VALUES (:path, :directoryPath, :size, :modifiedTime, :inode)");
+  for (QMap<QString, DirectoryState>::const_iterator directoryIt = this->ChangedDirectories.constBegin();
+    success && directoryIt != this->ChangedDirectories.constEnd(); ++directoryIt)
+  {
+    insertDirectoryQuery.bindValue(":path", directoryIt.key());
+    insertDirectoryQuery.bindValue(":parentPath", directoryIt.value().ParentPath);
+    insertDirectoryQuery.bindValue(":modifiedTime", directoryIt.value().ModifiedTime);
+    clearFilesQuery.bindValue(":path", directoryIt.key());
+    success = insertDirectoryQuery.exec() && clearFilesQuery.exec();
+    for (QMap<QString, FileState>::const_iterator fileIt = directoryIt.value().Files.constBegin();
+      success && fileIt != directoryIt.value().Files.constEnd(); ++fileIt)
+    {
+      insertFileQuery.bindValue(":path", fileIt.key());
+      insertFileQuery.bindValue(":directoryPath", directoryIt.key());
+      insertFileQuery.bindValue(":size", fileIt.value().Size);
+      insertFileQuery.bindValue(":modifiedTime", fileIt.value().ModifiedTime);
+      insertFileQuery.bindValue(":inode", fileIt.value().Inode);
+      success = insertFileQuery.exec();
+    }
+  }
+
+  if (!success)
+  {
+    logger.error("Failed to store directory scan state: " + this->Database.lastError().text());
+    this->Database.rollback();
+    return false;
+  }
+  this->Database.commit();
+  this->ChangedDirectories.clear();
+  this->RemovedDirectories.clear();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMIndexerPrivateDirectoryScanState::scannedDirectories(const QString& rootDirectoryPath)
+{
+  QStringList directories;
+  QSqlQuery query(this->Database);
+  // range of paths of the subdirectories, see commit()
+  query.prepare("SELECT Path FROM DirectoryScanState WHERE Path = :path "
+    "OR (Path >= :subdirectoriesBegin AND Path < :subdirectoriesEnd)");
+  QString rootPath = QDir(rootDirectoryPath).absolutePath();
+  query.bindValue(":path", rootPath);
+  query.bindValue(":subdirectoriesBegin", rootPath + "/");
+  query.bindValue(":subdirectoriesEnd", rootPath + "0");
+  if (!query.exec())
+  {
+    return directories;
+  }
+  while (query.next())
+  {
+    directories << query.value(0).toString();
+  }
+  return directories;
+}
+
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerPrivateFileEnumerator methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerPrivateFileEnumerator::ctkDICOMIndexerPrivateFileEnumerator(
+  const DICOMIndexingQueue::IndexingRequest& request, ctkDICOMIndexerPrivateDirectoryScanState* scanState)
+: ScanState(scanState)
+, Complete(false)
+{
+  if (request.inputFolderPath.isEmpty())
+  {
+    this->Complete = true;
+  }
+  else if (this->ScanState)
+  {
+    this->ScanState->startScan(request.inputFolderPath, request.includeHidden);
+  }
+  else
+  {
+    QDir::Filters filters = QDir::Files;
+    if (request.includeHidden)
+    {
+      filters |= QDir::Hidden;
+    }
+    this->DirectoryIterator.reset(new QDirIterator(request.inputFolderPath, filters, QDirIterator::Subdirectories));
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivateFileEnumerator::findNextFiles(QStringList& files)
+{
+  if (this->Complete)
+  {
+    return false;
+  }
+  if (this->ScanState)
+  {
+    this->Complete = !this->ScanState->scanNextDirectory(files);
+  }
+  else
+  {
+    for (int i = 0; i < FILES_PER_ENUMERATION_STEP && this->DirectoryIterator->hasNext(); ++i)
+    {
+      files << this->DirectoryIterator->next();
+    }
+    this->Complete = !this->DirectoryIterator->hasNext();
+  }
+  return !this->Complete;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivateFileEnumerator::isComplete() const
+{
+  return this->Complete;
+}
+
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerPrivateParserTask methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerPrivateParserTask::ctkDICOMIndexerPrivateParserTask(DICOMIndexingQueue* queue, QSemaphore* freeParserSlots,
+  const QString& filePath, bool copyFile, bool overwriteExistingDataset)
+: RequestQueue(queue)
+, FreeParserSlots(freeParserSlots)
+, FilePath(filePath)
+, CopyFile(copyFile)
+, OverwriteExistingDataset(overwriteExistingDataset)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerPrivateParserTask::~ctkDICOMIndexerPrivateParserTask()
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivateParserTask::run()
+{
+  if (!this->RequestQueue->isStopRequested())
+  {
+    ctkDICOMDatabase::IndexingResult indexingResult;
+    indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+    indexingResult.dataset->InitializeFromFileHeader(this->FilePath);
+    if (indexingResult.dataset->IsInitialized())
+    {
+      indexingResult.filePath = this->FilePath;
+      indexingResult.copyFile = this->CopyFile;
+      indexingResult.overwriteExistingDataset = this->OverwriteExistingDataset;
+      this->RequestQueue->pushIndexingResult(indexingResult);
+    }
+    else
+    {
+      logger.warn(QString("Could not read DICOM file:") + this->FilePath);
+    }
+  }
+  this->FreeParserSlots->release();
+}
 
 
 //------------------------------------------------------------------------------
@@ -70,6 +443,7 @@ ctkDICOMIndexerPrivateWorker::ctkDICOMIndexerPrivateWorker(DICOMIndexingQueue* q
 , TimePercentageIndexing(95.0)
 , RemainingRequestCount(0)
 , CompletedRequestCount(0)
+, ModifiedTimeForFilepathLoaded(false)
 {
 }
 
@@ -84,6 +458,8 @@ void ctkDICOMIndexerPrivateWorker::start()
 {
   emit updatingDatabase(true);
   ctkDICOMDatabase database;
+  database.setImportStoragePolicy(this->RequestQueue->importStoragePolicy());
+  database.setFileTransferThreadCount(this->RequestQueue->fileTransferThreadCount());
   database.openDatabase(this->RequestQueue->databaseFilename());
   database.setTagsToPrecache(this->RequestQueue->tagsToPrecache());
   database.setTagsToExcludeFromStorage(this->RequestQueue->tagsToExcludeFromStorage());
@@ -101,8 +477,9 @@ void ctkDICOMIndexerPrivateWorker::start()
   {
     emit progressStep("Parsing DICOM files");
     emit progress(0);
-    // Make a local copy to avoid the need of frequent locking
-    this->RequestQueue->modifiedTimeForFilepath(this->ModifiedTimeForFilepath);
+    // Database may have been changed since the last run
+    this->ModifiedTimeForFilepath.clear();
+    this->ModifiedTimeForFilepathLoaded = false;
     this->CompletedRequestCount = 0;
     do
     {
@@ -150,36 +527,67 @@ void ctkDICOMIndexerPrivateWorker::start()
 //------------------------------------------------------------------------------
 void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::IndexingRequest& indexingRequest, ctkDICOMDatabase& database)
 {
-  if (!indexingRequest.inputFolderPath.isEmpty())
-  {
-    QDir::Filters filters = QDir::Files;
-    if (indexingRequest.includeHidden)
-    {
-      filters |= QDir::Hidden;
-    }
-    QDirIterator it(indexingRequest.inputFolderPath, filters, QDirIterator::Subdirectories);
-    while (it.hasNext())
-    {
-      indexingRequest.inputFilesPath << it.next();
-    }
-  }
-
   QTime timeProbe;
   timeProbe.start();
 
-  int currentFileIndex = 0;
+  ctkDICOMIndexerPrivateDirectoryScanState scanState(database.database());
+  bool incremental = indexingRequest.incremental && !indexingRequest.inputFolderPath.isEmpty() && scanState.initialize();
+
+  // Incremental scan only finds new and changed files, therefore there is no need
+  // to look up already indexed files (which requires reading all the images from the database).
+  if (!incremental && !this->ModifiedTimeForFilepathLoaded)
+  {
+    database.allFilesModifiedTimes(this->ModifiedTimeForFilepath);
+    this->ModifiedTimeForFilepathLoaded = true;
+  }
+
+  // Files are found step by step (producer stage) and they are submitted for parsing
+  // as soon as they are found, so the first results are available before the whole
+  // directory tree is enumerated. Files are parsed by a pool of parser threads,
+  // while this thread writes the parsing results into the database
+  // (SQLite only supports a single writer).
+  ctkDICOMIndexerPrivateFileEnumerator fileEnumerator(indexingRequest, incremental ? &scanState : nullptr);
+  QStringList foundFiles = indexingRequest.inputFilesPath;
+  indexingRequest.inputFilesPath.clear();
+  int foundFileCount = foundFiles.size();
+
+  int numberOfParserThreads = qMax(1, this->RequestQueue->numberOfParserThreads());
+  QThreadPool parserPool;
+  parserPool.setMaxThreadCount(numberOfParserThreads);
+  QSemaphore freeParserSlots(numberOfParserThreads * PARSER_QUEUE_SIZE_PER_THREAD);
+
+  QTime lastWriteTimeProbe;
+  lastWriteTimeProbe.start();
+
+  int processedFileCount = 0;
   int alreadyAddedFileCount = 0;
   QStringList alreadyAddedFiles;
-  foreach(const QString& filePath, indexingRequest.inputFilesPath)
+  while (!this->RequestQueue->isStopRequested())
   {
-    int percent = int(this->TimePercentageIndexing * (this->CompletedRequestCount + double(currentFileIndex++) / double(indexingRequest.inputFilesPath.size()))
+    if (foundFiles.isEmpty())
+    {
+      if (fileEnumerator.isComplete())
+      {
+        break;
+      }
+      fileEnumerator.findNextFiles(foundFiles);
+      foundFileCount += foundFiles.size();
+      continue;
+    }
+
+    QString filePath = foundFiles.takeFirst();
+    processedFileCount++;
+
+    // Progress is based on the number of files found so far,
+    // therefore it may not be linear while files are still being found.
+    int percent = int(this->TimePercentageIndexing * (this->CompletedRequestCount + double(processedFileCount) / double(foundFileCount))
       / double(this->CompletedRequestCount + this->RemainingRequestCount + 1));
     emit this->progress(percent);
     emit progressDetail(filePath);
 
     QDateTime fileModifiedTime = QFileInfo(filePath).lastModified();
     bool datasetAlreadyInDatabase = this->ModifiedTimeForFilepath.contains(filePath);
-    if (datasetAlreadyInDatabase && this->ModifiedTimeForFilepath[filePath] >= fileModifiedTime)
+    if (!incremental && datasetAlreadyInDatabase && this->ModifiedTimeForFilepath[filePath] >= fileModifiedTime)
     {
       alreadyAddedFileCount++;
       if (alreadyAddedFileCount < 10)
@@ -190,52 +598,62 @@ void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::In
     }
     this->ModifiedTimeForFilepath[filePath] = fileModifiedTime;
 
-    ctkDICOMDatabase::IndexingResult indexingResult;
-    indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
-    indexingResult.dataset->InitializeFromFile(filePath);
-    if (indexingResult.dataset->IsInitialized())
+    // Wait until a parser slot becomes available. While all parsers are busy,
+    // more files are found (up to a limit, to keep memory usage bounded).
+    while (!freeParserSlots.tryAcquire())
     {
-      indexingResult.filePath = filePath;
-      indexingResult.copyFile = indexingRequest.copyFile;
-      indexingResult.overwriteExistingDataset = datasetAlreadyInDatabase;
-      int resultsCount = this->RequestQueue->pushIndexingResult(indexingResult);
-      if (resultsCount >= REQUEST_RESULTS_CACHE_MAXIMUM_SIZE)
+      if (fileEnumerator.isComplete() || foundFiles.size() >= FOUND_FILES_MAXIMUM_SIZE)
       {
-        emit progressStep("Updating database fields");
-        this->writeIndexingResultsToDatabase(database);
-        emit progressStep("Parsing DICOM files");
+        freeParserSlots.acquire();
+        break;
       }
+      int previousFoundFilesCount = foundFiles.size();
+      fileEnumerator.findNextFiles(foundFiles);
+      foundFileCount += foundFiles.size() - previousFoundFilesCount;
     }
-    else
-    {
-      logger.warn(QString("Could not read DICOM file:") + filePath);
-    }
-
-    if (this->RequestQueue->isStopRequested())
+    parserPool.start(new ctkDICOMIndexerPrivateParserTask(this->RequestQueue, &freeParserSlots,
+      filePath, indexingRequest.copyFile, datasetAlreadyInDatabase));
+
+    // Parsers keep running while parsing results are written into the database.
+    // The first results are written soon, to make them visible to the user.
+    int resultsCount = this->RequestQueue->indexingResultsCount();
+    if (resultsCount >= REQUEST_RESULTS_CACHE_MAXIMUM_SIZE
+      || (resultsCount > 0 && lastWriteTimeProbe.elapsed() > REQUEST_RESULTS_MAXIMUM_DELAY_MSEC))
     {
-      break;
+      emit progressStep("Updating database fields");
+      this->writeIndexingResultsToDatabase(database);
+      emit progressStep("Parsing DICOM files");
+      lastWriteTimeProbe.restart();
     }
   }
 
+  // Wait for all the submitted files to be parsed
+  parserPool.waitForDone();
+
   if (alreadyAddedFileCount > 0)
   {
     logger.debug(QString("Skipped %1 files that were already in the database: %2...").arg(
       alreadyAddedFileCount).arg(alreadyAddedFiles.join(", ")));
   }
 
-  if (this->RequestQueue->isIndexingRequestsEmpty())
+  // Scan state is only stored if all changed files are added to the database,
+  // otherwise files that are not yet written would be skipped in the next scan.
+  if (this->RequestQueue->isIndexingRequestsEmpty() || incremental)
   {
     emit progressStep("Updating database fields");
     this->writeIndexingResultsToDatabase(database);
     emit progressStep("Parsing DICOM files");
   }
+  if (incremental && fileEnumerator.isComplete() && !this->RequestQueue->isStopRequested())
+  {
+    scanState.commit();
+  }
 
   float elapsedTimeInSeconds = timeProbe.elapsed() / 1000.0;
-  qDebug() << QString("DICOM indexer has successfully processed %1 files [%2s]")
-    .arg(currentFileIndex).arg(QString::number(elapsedTimeInSeconds, 'f', 2));
+  qDebug() << QString("DICOM indexer has successfully processed %1 of %2 found files [%3s]")
+    .arg(processedFileCount).arg(foundFileCount).arg(QString::number(elapsedTimeInSeconds, 'f', 2));
 }
 
-
 //------------------------------------------------------------------------------
 void ctkDICOMIndexerPrivateWorker::writeIndexingResultsToDatabase(ctkDICOMDatabase& database)
 {
@@ -255,6 +673,10 @@ void ctkDICOMIndexerPrivateWorker::writeIndexingResultsToDatabase(ctkDICOMDataba
   this->NumberOfInstancesToInsert = 0;
   this->NumberOfInstancesInserted = 0;
 
+  // Make the committed batch visible in the browser while indexing continues
+  database.updateDisplayedFields();
+  emit databaseUpdated();
+
   float elapsedTimeInSeconds = timeProbe.elapsed() / 1000.0;
   qDebug() << QString("DICOM indexer has successfully inserted %1 files [%2s]")
     .arg(indexingResults.count()).arg(QString::number(elapsedTimeInSeconds, 'f', 2));
@@ -269,7 +691,12 @@ ctkDICOMIndexerPrivate::ctkDICOMIndexerPrivate(ctkDICOMIndexer& o)
   : q_ptr(&o)
   , Database(nullptr)
   , BackgroundImportEnabled(false)
+  , DirectoryWatcher(nullptr)
 {
+  this->ChangedWatchedDirectoriesTimer.setSingleShot(true);
+  this->ChangedWatchedDirectoriesTimer.setInterval(WATCHED_DIRECTORY_RESCAN_DELAY_MSEC);
+  connect(&this->ChangedWatchedDirectoriesTimer, &QTimer::timeout, this, &ctkDICOMIndexerPrivate::rescanChangedWatchedDirectories);
+
   ctkDICOMIndexerPrivateWorker* worker = new ctkDICOMIndexerPrivateWorker(&this->RequestQueue);
   worker->moveToThread(&this->WorkerThread);
   
@@ -281,6 +708,8 @@ ctkDICOMIndexerPrivate::ctkDICOMIndexerPrivate(ctkDICOMIndexer& o)
   connect(worker, &ctkDICOMIndexerPrivateWorker::progressDetail, q_ptr, &ctkDICOMIndexer::progressDetail);
   connect(worker, &ctkDICOMIndexerPrivateWorker::progressStep, q_ptr, &ctkDICOMIndexer::progressStep);
   connect(worker, &ctkDICOMIndexerPrivateWorker::updatingDatabase, q_ptr, &ctkDICOMIndexer::updatingDatabase);
+  connect(worker, &ctkDICOMIndexerPrivateWorker::databaseUpdated, this, &ctkDICOMIndexerPrivate::onWorkerDatabaseUpdated);
+  connect(worker, &ctkDICOMIndexerPrivateWorker::indexingComplete, this, &ctkDICOMIndexerPrivate::onWorkerIndexingComplete);
   connect(worker, &ctkDICOMIndexerPrivateWorker::indexingComplete, q_ptr, &ctkDICOMIndexer::indexingComplete);
 
   this->WorkerThread.start();
@@ -296,6 +725,161 @@ ctkDICOMIndexerPrivate::~ctkDICOMIndexerPrivate()
   q->setDatabase(nullptr);
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onWorkerDatabaseUpdated()
+{
+  if (this->Database)
+  {
+    // The worker wrote to the database using its own connection
+    this->Database->clearInMemoryTagCache();
+    emit this->Database->databaseChanged();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onWorkerIndexingComplete()
+{
+  // The worker updated the tag cache using its own database connection,
+  // therefore values in the in-memory tag cache may be outdated.
+  if (this->Database)
+  {
+    this->Database->clearInMemoryTagCache();
+  }
+  // Watch subdirectories that have been found while scanning
+  this->updateWatchedDirectories();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::updateWatchedDirectories()
+{
+  if (!this->DirectoryWatcher)
+  {
+    return;
+  }
+  QStringList rootDirectories;
+  QStringList directories;
+  if (this->Database && this->Database->isOpen())
+  {
+    // Scan state tables are created by the worker, if they do not exist yet
+    // then no subdirectories have been scanned.
+    ctkDICOMIndexerPrivateDirectoryScanState scanState(this->Database->database());
+    QSqlQuery query(this->Database->database());
+    if (query.exec("SELECT Dirname FROM Directories"))
+    {
+      while (query.next())
+      {
+        QString rootDirectory = QDir(query.value(0).toString()).absolutePath();
+        if (!QDir(rootDirectory).exists())
+        {
+          continue;
+        }
+        rootDirectories << rootDirectory;
+        directories << rootDirectory;
+      }
+    }
+    int skippedDirectoryCount = 0;
+    foreach(const QString& rootDirectory, rootDirectories)
+    {
+      foreach(const QString& directory, scanState.scannedDirectories(rootDirectory))
+      {
+        if (directory == rootDirectory)
+        {
+          continue;
+        }
+        if (directories.size() < WATCHED_DIRECTORIES_MAXIMUM_COUNT)
+        {
+          directories << directory;
+        }
+        else
+        {
+          skippedDirectoryCount++;
+        }
+      }
+    }
+    if (skippedDirectoryCount > 0)
+    {
+      logger.warn(QString("Changes are not detected in %1 subdirectories, maximum number of watched directories is %2")
+        .arg(skippedDirectoryCount).arg(WATCHED_DIRECTORIES_MAXIMUM_COUNT));
+    }
+  }
+
+  QStringList watchedDirectories = this->DirectoryWatcher->directories();
+  QStringList directoriesToRemove;
+  foreach(const QString& watchedDirectory, watchedDirectories)
+  {
+    if (!directories.contains(watchedDirectory))
+    {
+      directoriesToRemove << watchedDirectory;
+    }
+  }
+  if (!directoriesToRemove.isEmpty())
+  {
+    this->DirectoryWatcher->removePaths(directoriesToRemove);
+  }
+  QStringList directoriesToAdd;
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+  QSet<QString> uniqueDirectories(directories.begin(), directories.end());
+  #else
+  QSet<QString> uniqueDirectories = directories.toSet();
+  #endif
+  foreach(const QString& directory, uniqueDirectories)
+  {
+    if (!watchedDirectories.contains(directory) && QFileInfo(directory).isDir())
+    {
+      directoriesToAdd << directory;
+    }
+  }
+  if (!directoriesToAdd.isEmpty())
+  {
+    this->DirectoryWatcher->addPaths(directoriesToAdd);
+  }
+
+  // Changes may have happened while the directory was not watched
+  foreach(const QString& rootDirectory, rootDirectories)
+  {
+    if (!watchedDirectories.contains(rootDirectory))
+    {
+      this->ChangedWatchedDirectories.insert(rootDirectory);
+    }
+  }
+  if (!this->ChangedWatchedDirectories.isEmpty())
+  {
+    this->ChangedWatchedDirectoriesTimer.start();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onWatchedDirectoryChanged(const QString& directoryPath)
+{
+  this->ChangedWatchedDirectories.insert(directoryPath);
+  // Restarting the timer delays re-scan until changes stop for a while
+  this->ChangedWatchedDirectoriesTimer.start();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::rescanChangedWatchedDirectories()
+{
+  if (!this->DirectoryWatcher || !this->Database)
+  {
+    this->ChangedWatchedDirectories.clear();
+    return;
+  }
+  foreach(const QString& directoryPath, this->ChangedWatchedDirectories)
+  {
+    if (!QFileInfo(directoryPath).isDir())
+    {
+      // Removed directories are cleaned up when their parent directory is re-scanned
+      continue;
+    }
+    DICOMIndexingQueue::IndexingRequest request;
+    request.inputFolderPath = directoryPath;
+    request.incremental = true;
+    // Re-scan is always performed in the background to not block the application
+    this->pushIndexingRequest(request);
+  }
+  this->ChangedWatchedDirectories.clear();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMIndexerPrivate::pushIndexingRequest(const DICOMIndexingQueue::IndexingRequest& request)
 {
@@ -305,9 +889,8 @@ void ctkDICOMIndexerPrivate::pushIndexingRequest(const DICOMIndexingQueue::Index
   {
     // Start background indexing
     this->RequestQueue.setIndexing(true);
-    QMap<QString, QDateTime> modifiedTimeForFilepath;
-    this->Database->allFilesModifiedTimes(modifiedTimeForFilepath);
-    this->RequestQueue.setModifiedTimeForFilepath(modifiedTimeForFilepath);
+    this->RequestQueue.setImportStoragePolicy(this->Database->importStoragePolicy());
+    this->RequestQueue.setFileTransferThreadCount(this->Database->fileTransferThreadCount());
     emit startWorker();
   }
 }
@@ -361,6 +944,7 @@ void ctkDICOMIndexer::setDatabase(ctkDICOMDatabase* database)
     d->RequestQueue.setTagsToPrecache(QStringList());
     d->RequestQueue.setTagsToExcludeFromStorage(QStringList());
   }
+  d->updateWatchedDirectories();
 }
 
 //------------------------------------------------------------------------------
@@ -466,6 +1050,59 @@ void ctkDICOMIndexer::addDirectory(const QString& directoryName, bool copyFile/*
   }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::rescanDirectory(const QString& directoryName, bool copyFile/*=false*/, bool includeHidden/*=true*/)
+{
+  Q_D(ctkDICOMIndexer);
+  DICOMIndexingQueue::IndexingRequest request;
+  request.inputFolderPath = directoryName;
+  request.includeHidden = includeHidden;
+  request.copyFile = copyFile;
+  request.incremental = true;
+  d->pushIndexingRequest(request);
+  if (!d->BackgroundImportEnabled)
+  {
+    this->waitForImportFinished();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setWatchDirectoriesEnabled(bool enabled)
+{
+  Q_D(ctkDICOMIndexer);
+  if (enabled == (d->DirectoryWatcher != nullptr))
+  {
+    return;
+  }
+  if (enabled)
+  {
+    d->DirectoryWatcher = new QFileSystemWatcher(d);
+    connect(d->DirectoryWatcher, &QFileSystemWatcher::directoryChanged, d, &ctkDICOMIndexerPrivate::onWatchedDirectoryChanged);
+    d->updateWatchedDirectories();
+  }
+  else
+  {
+    d->ChangedWatchedDirectoriesTimer.stop();
+    d->ChangedWatchedDirectories.clear();
+    delete d->DirectoryWatcher;
+    d->DirectoryWatcher = nullptr;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexer::isWatchDirectoriesEnabled() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->DirectoryWatcher != nullptr;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::updateWatchedDirectories()
+{
+  Q_D(ctkDICOMIndexer);
+  d->updateWatchedDirectories();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMIndexer::addListOfFiles(ctkDICOMDatabase* db, const QStringList& listOfFiles, bool copyFile/*=false*/)
 {
@@ -619,6 +1256,20 @@ bool ctkDICOMIndexer::isImporting()
   return d->RequestQueue.isIndexing();
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setNumberOfParserThreads(int count)
+{
+  Q_D(ctkDICOMIndexer);
+  d->RequestQueue.setNumberOfParserThreads(qMax(1, count));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexer::numberOfParserThreads() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->RequestQueue.numberOfParserThreads();
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMIndexer::cancel()
 {
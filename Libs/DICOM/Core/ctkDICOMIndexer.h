@@ -39,6 +39,8 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMIndexer : public QObject
   Q_OBJECT
   Q_PROPERTY(bool backgroundImportEnabled READ isBackgroundImportEnabled WRITE setBackgroundImportEnabled)
   Q_PROPERTY(bool importing READ isImporting)
+  Q_PROPERTY(int numberOfParserThreads READ numberOfParserThreads WRITE setNumberOfParserThreads)
+  Q_PROPERTY(bool watchDirectories READ isWatchDirectoriesEnabled WRITE setWatchDirectoriesEnabled)
 
 public:
   explicit ctkDICOMIndexer(QObject *parent = 0);
@@ -57,6 +59,13 @@ public:
   /// Returns with true if background importing is currently in progress.
   bool isImporting();
 
+  /// Number of threads that are used for parsing DICOM files during indexing.
+  /// Parsing results are written into the database by a single thread,
+  /// therefore order of insertion may differ from the order of input files.
+  /// Takes effect when the next indexing request is started. Default is 1.
+  void setNumberOfParserThreads(int count);
+  int numberOfParserThreads() const;
+
   ///
   /// \brief Adds directory to database and optionally copies files to
   /// destinationDirectory.
@@ -72,6 +81,29 @@ public:
   /// Kept for backward compatibility
   Q_INVOKABLE void addDirectory(ctkDICOMDatabase* db, const QString& directoryName, bool copyFile = false, bool includeHidden = true);
 
+  ///
+  /// \brief Re-scans a directory and adds new and changed files to the database.
+  ///
+  /// State of scanned directories (modified time of each directory and
+  /// size, modified time, inode of each file) is stored in the database.
+  /// Directories that have not changed since the last re-scan are not listed again,
+  /// only their subdirectories are checked, and only files in changed directories
+  /// are compared to their stored state. This makes re-scanning large, mostly
+  /// unchanged folders much faster than addDirectory.
+  /// Since a directory modified time only changes when entries are added, removed,
+  /// or renamed, files that are modified in place in an unchanged directory
+  /// are not detected. Use addDirectory to process all files.
+  ///
+  Q_INVOKABLE void rescanDirectory(const QString& directoryName, bool copyFile = false, bool includeHidden = true);
+
+  /// If enabled, directories listed in the Directories table of the database
+  /// (and all their subdirectories) are watched for changes and changed directories
+  /// are re-scanned in the background using rescanDirectory.
+  /// Directories are re-scanned when they are first watched, too.
+  /// Disabled by default.
+  void setWatchDirectoriesEnabled(bool enabled);
+  bool isWatchDirectoriesEnabled() const;
+
   ///
   /// \brief Adds directory to database by using DICOMDIR and optionally copies files to
   /// destinationDirectory.
@@ -129,6 +161,10 @@ public Q_SLOTS:
   /// Stop indexing (all completed indexing results will be added to the database)
   void cancel();
 
+  /// Update list of watched directories from the Directories table of the database.
+  /// Needs to be called when the Directories table is modified while watching is enabled.
+  void updateWatchedDirectories();
+
 protected Q_SLOTS:
   void databaseFilenameChanged();
   void tagsToPrecacheChanged();
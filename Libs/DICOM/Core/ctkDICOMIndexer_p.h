@@ -21,12 +21,21 @@
 #ifndef CTKDICOMINDEXERPRIVATE_H
 #define CTKDICOMINDEXERPRIVATE_H
 
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QObject>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTimer>
 
+#include "ctkDICOMDatabase.h"
 #include "ctkDICOMIndexer.h"
 #include "ctkDICOMItem.h"
 
-class ctkDICOMDatabase;
 class ctkDataset;
 
 class DICOMIndexingQueue
@@ -34,6 +43,13 @@ class DICOMIndexingQueue
 public:
   struct IndexingRequest
   {
+    IndexingRequest()
+      : includeHidden(true)
+      , copyFile(false)
+      , incremental(false)
+    {
+    }
+
     /// Either inputFolderPath or inputFilesPath is used
     QString inputFolderPath;
     QStringList inputFilesPath;
@@ -43,10 +59,16 @@ public:
     /// Make a copy of the indexed file into the database.
     /// If false then only a link to the existing file is added.
     bool copyFile;
+    /// If inputFolderPath is specified, incremental is used to decide if
+    /// only directories that changed since the last scan are processed.
+    bool incremental;
   };
 
   DICOMIndexingQueue()
-    : IsIndexing(false)
+    : NumberOfParserThreads(1)
+    , ImportStoragePolicy(ctkDICOMDatabase::CopyFiles)
+    , FileTransferThreadCount(1)
+    , IsIndexing(false)
     , StopRequested(false)
     , Mutex(QMutex::Recursive)
   {
@@ -92,6 +114,42 @@ public:
     this->TagsToExcludeFromStorage = tags;
   }
 
+  ctkDICOMDatabase::ImportStoragePolicy importStoragePolicy() const
+  {
+    QMutexLocker locker(&this->Mutex);
+    return this->ImportStoragePolicy;
+  }
+
+  void setImportStoragePolicy(ctkDICOMDatabase::ImportStoragePolicy policy)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->ImportStoragePolicy = policy;
+  }
+
+  int fileTransferThreadCount() const
+  {
+    QMutexLocker locker(&this->Mutex);
+    return this->FileTransferThreadCount;
+  }
+
+  void setFileTransferThreadCount(int count)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->FileTransferThreadCount = count;
+  }
+
+  int numberOfParserThreads() const
+  {
+    QMutexLocker locker(&this->Mutex);
+    return this->NumberOfParserThreads;
+  }
+
+  void setNumberOfParserThreads(int count)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->NumberOfParserThreads = count;
+  }
+
   void clear()
   {
     QMutexLocker locker(&this->Mutex);
@@ -136,18 +194,6 @@ public:
     return this->IndexingResults.size();
   }
 
-  void modifiedTimeForFilepath(QMap<QString, QDateTime>& timesForPaths)
-  {
-    QMutexLocker locker(&this->Mutex);
-    timesForPaths = this->ModifiedTimeForFilepath;
-  }
-
-  void setModifiedTimeForFilepath(const QMap<QString, QDateTime>& timesForPaths)
-  {
-    QMutexLocker locker(&this->Mutex);
-    this->ModifiedTimeForFilepath = timesForPaths;
-  }
-
   void setIndexing(bool indexing)
   {
     QMutexLocker locker(&this->Mutex);
@@ -183,9 +229,6 @@ public:
   }
 
 protected:
-  // List of already indexed file paths and oldest file modified time in the database
-  QMap<QString, QDateTime> ModifiedTimeForFilepath;
-
   QList<IndexingRequest> IndexingRequests;
   QList<ctkDICOMDatabase::IndexingResult> IndexingResults;
 
@@ -193,6 +236,11 @@ protected:
   QStringList TagsToPrecache;
   QStringList TagsToExcludeFromStorage;
 
+  int NumberOfParserThreads;
+  /// File storage settings of the database, used by the worker's database connection
+  ctkDICOMDatabase::ImportStoragePolicy ImportStoragePolicy;
+  int FileTransferThreadCount;
+
   bool IsIndexing;
   bool StopRequested;
 
@@ -200,6 +248,124 @@ protected:
 };
 
 
+/// Persistent state of scanned directories, used for incremental re-scanning.
+/// For each scanned directory its modified time is stored, and for each file
+/// its size, modified time and inode. If the modified time of a directory
+/// is unchanged then the list of its entries is unchanged, too, therefore
+/// the directory is not listed again, only its subdirectories are visited.
+/// The state is stored in the DirectoryScanState and FileScanState tables of the database.
+class ctkDICOMIndexerPrivateDirectoryScanState
+{
+public:
+  struct FileState
+  {
+    FileState()
+      : Size(-1)
+      , ModifiedTime(-1)
+      , Inode(0)
+    {
+    }
+    bool operator==(const FileState& other) const
+    {
+      return this->Size == other.Size && this->ModifiedTime == other.ModifiedTime && this->Inode == other.Inode;
+    }
+    bool operator!=(const FileState& other) const
+    {
+      return !(*this == other);
+    }
+    qint64 Size;
+    /// Milliseconds since epoch
+    qint64 ModifiedTime;
+    /// Zero if not available on the current platform
+    quint64 Inode;
+  };
+
+  ctkDICOMIndexerPrivateDirectoryScanState(const QSqlDatabase& database);
+
+  /// Create state tables in the database if they do not exist yet
+  bool initialize();
+
+  /// Start finding new and changed files in directoryPath and all its subdirectories
+  void startScan(const QString& directoryPath, bool includeHidden);
+
+  /// Scan the next directory and append its new and changed files to changedFiles.
+  /// Found state is kept in memory until commit() is called.
+  /// Returns false if all directories have been scanned.
+  bool scanNextDirectory(QStringList& changedFiles);
+
+  /// Write state found by scanNextDirectory() into the database
+  bool commit();
+
+  /// Returns all directories below rootDirectoryPath that have been scanned already
+  QStringList scannedDirectories(const QString& rootDirectoryPath);
+
+  static FileState currentFileState(const QFileInfo& fileInfo);
+
+protected:
+  struct DirectoryState
+  {
+    QString ParentPath;
+    qint64 ModifiedTime;
+    QMap<QString, FileState> Files;
+  };
+
+  QSqlDatabase Database;
+  QSqlQuery DirectoryQuery;
+  QSqlQuery SubdirectoriesQuery;
+  QSqlQuery FilesQuery;
+  QDir::Filters FileFilters;
+  QDir::Filters DirectoryFilters;
+  QStringList DirectoriesToScan;
+  QMap<QString, DirectoryState> ChangedDirectories;
+  QStringList RemovedDirectories;
+};
+
+
+/// Finds the files of an indexing request step by step, so that parsing of
+/// the first files can start before the whole directory tree is enumerated.
+/// Files listed in the request are not returned, only files found in inputFolderPath.
+class ctkDICOMIndexerPrivateFileEnumerator
+{
+public:
+  /// If scanState is specified then only new and changed files are found (incremental scan).
+  ctkDICOMIndexerPrivateFileEnumerator(const DICOMIndexingQueue::IndexingRequest& request,
+    ctkDICOMIndexerPrivateDirectoryScanState* scanState);
+
+  /// Append next found files to files.
+  /// Returns false if all files have been found.
+  bool findNextFiles(QStringList& files);
+
+  bool isComplete() const;
+
+protected:
+  QScopedPointer<QDirIterator> DirectoryIterator;
+  ctkDICOMIndexerPrivateDirectoryScanState* ScanState;
+  bool Complete;
+};
+
+
+/// Parses a single DICOM file in a parser thread and pushes the result into
+/// the indexing queue. Results are written into the database by the
+/// ctkDICOMIndexerPrivateWorker, which is the only thread that writes the database.
+class ctkDICOMIndexerPrivateParserTask : public QRunnable
+{
+public:
+  ctkDICOMIndexerPrivateParserTask(DICOMIndexingQueue* queue, QSemaphore* freeParserSlots,
+    const QString& filePath, bool copyFile, bool overwriteExistingDataset);
+  virtual ~ctkDICOMIndexerPrivateParserTask();
+
+  virtual void run();
+
+private:
+  DICOMIndexingQueue* RequestQueue;
+  /// Released when parsing is completed, to let the worker submit more files
+  QSemaphore* FreeParserSlots;
+  QString FilePath;
+  bool CopyFile;
+  bool OverwriteExistingDataset;
+};
+
+
 class ctkDICOMIndexerPrivateWorker : public QObject
 {
   Q_OBJECT
@@ -216,6 +382,8 @@ Q_SIGNALS:
   void progressDetail(QString);
   void progressStep(QString);
   void updatingDatabase(bool);
+  /// Emitted when a batch of results has been committed to the database
+  void databaseUpdated();
   void indexingComplete(int, int, int, int);
 
 private:
@@ -233,8 +401,10 @@ private:
   int CompletedRequestCount; // the current request in progress is not included
 
   // List of already indexed file paths and oldest file modified time in the database.
-  // Cached here to avoid locking/unlocking a mutex each time a file is looked up.
+  // Only loaded when a full (not incremental) indexing request is processed,
+  // because reading it requires going through all the images in the database.
   QMap<QString, QDateTime> ModifiedTimeForFilepath;
+  bool ModifiedTimeForFilepathLoaded;
 };
 
 
@@ -254,16 +424,34 @@ public:
 
   void pushIndexingRequest(const DICOMIndexingQueue::IndexingRequest& request);
 
+  /// Watch directories of the Directories table and their scanned subdirectories.
+  /// Directories that were not watched before are re-scanned.
+  void updateWatchedDirectories();
+
 Q_SIGNALS:
   void startWorker();
 
-//public Q_SLOTS:
+public Q_SLOTS:
+  /// Called when the worker committed a batch of results to the database
+  void onWorkerDatabaseUpdated();
+  /// Called when the worker finished writing to the database
+  void onWorkerIndexingComplete();
+
+  void onWatchedDirectoryChanged(const QString& directoryPath);
+  void rescanChangedWatchedDirectories();
 
 public:
   DICOMIndexingQueue RequestQueue;
   QThread WorkerThread;
   ctkDICOMDatabase* Database;
   bool BackgroundImportEnabled;
+
+  /// Only created if watching of directories is enabled
+  QFileSystemWatcher* DirectoryWatcher;
+  /// Changes are collected for a short time to avoid re-scanning
+  /// a directory for each file that is written into it.
+  QSet<QString> ChangedWatchedDirectories;
+  QTimer ChangedWatchedDirectoriesTimer;
 };
 
 
@@ -25,6 +25,7 @@
 #include <dcmtk/dcmdata/dctk.h>
 #include <dcmtk/dcmdata/dcostrmb.h>
 #include <dcmtk/dcmdata/dcistrmb.h>
+#include <dcmtk/dcmdata/dcistrmf.h>
 
 #include <stdexcept>
 
@@ -33,7 +34,7 @@ class ctkDICOMItemPrivate
 {
   public:
 
-    ctkDICOMItemPrivate() : m_DcmItem(0), m_TakeOwnership(true) {}
+    ctkDICOMItemPrivate() : m_DcmItem(0), m_TakeOwnership(true), m_PixelDataSkipped(false) {}
 
     QString m_SpecificCharacterSet;
 
@@ -42,6 +43,10 @@ class ctkDICOMItemPrivate
 
     DcmItem* m_DcmItem;
     bool m_TakeOwnership;
+
+    /// Set if the item was initialized from the file header and parsing
+    /// was stopped at pixel data (so pixel data is not in m_DcmItem).
+    bool m_PixelDataSkipped;
 };
 
 
@@ -69,6 +74,8 @@ void ctkDICOMItem::InitializeFromItem(DcmItem *dataset, bool takeOwnership)
 {
   Q_D(ctkDICOMItem);
 
+  d->m_PixelDataSkipped = false;
+
   if(d->m_DcmItem != dataset)
   {
     if (d->m_TakeOwnership)
@@ -129,42 +136,120 @@ void ctkDICOMItem::InitializeFromFile(const QString& filename,
   InitializeFromItem(dataset, true);
 }
 
-void ctkDICOMItem::Serialize()
+void ctkDICOMItem::InitializeFromFileHeader(const QString& filename, const Uint32 maxReadLength)
 {
   Q_D(ctkDICOMItem);
+
+  DcmFileFormat fileformat;
+  bool pixelDataSkipped = false;
+#if OFFIS_DCMTK_VERSION_NUMBER >= 362
+  DcmInputFileStream fileStream(filename.toUtf8().data());
+  OFCondition status = fileStream.status();
+  if (status.good())
+  {
+    fileformat.transferInit();
+    status = fileformat.readUntilTag(fileStream, EXS_Unknown, EGL_noChange, maxReadLength, DCM_PixelData);
+    fileformat.transferEnd();
+    // If parsing stopped before the end of the file then it stopped at pixel data
+    pixelDataSkipped = status.good() && !fileStream.eos();
+  }
+#else
+  OFCondition status = fileformat.loadFile(filename.toUtf8().data(), EXS_Unknown, EGL_noChange, maxReadLength);
+#endif
+  DcmDataset* dataset = fileformat.getAndRemoveDataset();
+
+  if (!status.good())
+  {
+    qDebug() << "Could not load " << filename << "\nDCMTK says: " << status.text();
+    delete dataset;
+    return;
+  }
+
+  InitializeFromItem(dataset, true);
+  d->m_PixelDataSkipped = pixelDataSkipped;
+}
+
+void ctkDICOMItem::Serialize()
+{
+  // the base64 encoding prevents errors from encoding conversions made by QString or the database
+  this->SetStoredSerialization( QString::fromLatin1(this->SerializeToByteArray().toBase64()) );
+}
+
+QByteArray ctkDICOMItem::SerializeToByteArray() const
+{
+  Q_D(const ctkDICOMItem);
   EnsureDcmDataSetIsInitialized();
 
-  // store content of current DcmDataset (our parent) as QByteArray into m_ctkDICOMItem
-  Uint32 buffersize = 1024*1024; // reserve 1MB
-  char* writebuffer = new char[buffersize];
+  // Preallocate the whole array, the dataset is written into it in chunks
+  // (DcmOutputBufferStream asks for flushing each time the chunk buffer is full).
+  QByteArray byteArray;
+  Uint32 datasetLength = d->m_DcmItem->calcElementLength(EXS_LittleEndianImplicit, EET_UndefinedLength);
+  if (datasetLength != DCM_UndefinedLength)
+  {
+    byteArray.reserve(static_cast<int>(datasetLength));
+  }
 
-  // write into buffer
+  const Uint32 buffersize = 64*1024;
+  char* writebuffer = new char[buffersize];
   DcmOutputBufferStream dcmbuffer(writebuffer, buffersize);
+
+  OFCondition condition;
   d->m_DcmItem->transferInit();
-  OFCondition condition = d->m_DcmItem->write(dcmbuffer, EXS_LittleEndianImplicit, EET_UndefinedLength, NULL );
+  do
+  {
+    condition = d->m_DcmItem->write(dcmbuffer, EXS_LittleEndianImplicit, EET_UndefinedLength, NULL);
+    void* readbuffer = NULL;
+    offile_off_t length = 0;
+    dcmbuffer.flushBuffer(readbuffer, length);
+    byteArray.append(static_cast<const char*>(readbuffer), static_cast<int>(length));
+  }
+  while (condition == EC_StreamNotifyClient);
   d->m_DcmItem->transferEnd();
+
+  delete[] writebuffer;
+
   if ( condition.bad() )
   {
     std::cerr << "Could not DcmDataset::write(..): " << condition.text() << std::endl;
+    return QByteArray();
   }
+  return byteArray;
+}
 
-  // get written contents of buffer
-  offile_off_t datasetsize = 0;
-  void* readbuffer = NULL;
-  dcmbuffer.flushBuffer(readbuffer, datasetsize);
-
-  //std::cerr << "** " << (void*)this << " ctkDICOMItem: Serializing Dataset into " << datasetsize << " bytes" << std::endl;
+bool ctkDICOMItem::DeserializeFromByteArray(const QByteArray& buffer)
+{
+  Q_D(ctkDICOMItem);
 
-  // construct Qt type from that contents
-  QByteArray qtArray = QByteArray::fromRawData( static_cast<const char*>(readbuffer), datasetsize );
-  //std::cerr << "** Buffer size: " << qtArray.size() << std::endl;
-  QString stringbuffer = QString::fromLatin1(qtArray.toBase64());
+  DcmDataset* dataset = new DcmDataset();
+  OFCondition condition = EC_Normal;
+  if (!buffer.isEmpty())
+  {
+    // constData() does not detach, the dataset is read from the shared buffer
+    DcmInputBufferStream dcmbuffer;
+    dcmbuffer.setBuffer(buffer.constData(), buffer.size());
+    dcmbuffer.setEos();
+
+    dataset->transferInit();
+    condition = dataset->read(dcmbuffer, EXS_LittleEndianImplicit);
+    dataset->transferEnd();
+  }
 
-  //std::cerr << "** String of size " << stringbuffer.size() << " looks like this:\n" << stringbuffer.toStdString() << std::endl << std::endl;
+  // do this in all cases, even when reading reported an error
+  d->m_DICOMDataSetInitialized = false;
+  d->m_SpecificCharacterSet.clear();
+  this->InitializeFromItem(dataset, true);
 
-  this->SetStoredSerialization( stringbuffer );
+  if ( condition.bad() )
+  {
+    std::cerr << "Could not DcmDataset::read(..): " << condition.text() << std::endl;
+    return false;
+  }
+  return true;
+}
 
-  delete[] writebuffer;
+void ctkDICOMItem::Swap(ctkDICOMItem& other)
+{
+  this->d_ptr.swap(other.d_ptr);
 }
 
 void ctkDICOMItem::MarkForInitialization()
@@ -177,6 +262,11 @@ bool ctkDICOMItem::IsInitialized() const
   Q_D(const ctkDICOMItem);
   return d->m_DICOMDataSetInitialized;
 }
+bool ctkDICOMItem::IsPixelDataSkipped() const
+{
+  Q_D(const ctkDICOMItem);
+  return d->m_PixelDataSkipped;
+}
 void ctkDICOMItem::EnsureDcmDataSetIsInitialized() const
 {
   if ( ! this->IsInitialized() )
@@ -205,40 +295,7 @@ void ctkDICOMItem::Deserialize()
     return; // TODO nicer: hold three states: newly created / loaded but not initialized / restored from DB
   }
 
-
-  //std::cerr << "** " << (void*)this << " ctkDICOMItem: Deserialize Dataset from string of size " << stringbuffer.size() << "\n" << stringbuffer.toStdString() << std::endl;
-
-  QByteArray qtArray = QByteArray::fromBase64( stringbuffer.toLatin1() );
-  //std::cerr << "** " << (void*)this << " ctkDICOMItem: Deserialize Dataset from byte array of size " << qtArray.size() << std::endl;
-
-  DcmInputBufferStream dcmbuffer;
-  dcmbuffer.setBuffer( qtArray.data(), qtArray.size() );
-  //std::cerr << "** Buffer state: " << dcmbuffer.status().code() << " " <<  dcmbuffer.good() << " " << dcmbuffer.eos() << " tell " << dcmbuffer.tell() << " avail " << dcmbuffer.avail() << std::endl;
-
-  DcmDataset dataset;
-  dataset.transferInit();
-  //std::cerr << "** Dataset state: " << dataset.transferState() << std::endl << std::endl;
-  OFCondition condition = dataset.read( dcmbuffer, EXS_LittleEndianImplicit );
-  dataset.transferEnd();
-
-  // do this in all cases, even when reading reported an error
-  this->InitializeFromItem(&dataset);
-
-  if ( condition.bad() )
-  {
-    std::cerr << "** Condition code of Dataset::read() is "
-              << condition.code() << std::endl;
-    std::cerr << "** Buffer state: " << dcmbuffer.status().code()
-              << " " <<  dcmbuffer.good()
-              << " " << dcmbuffer.eos()
-              << " tell " << dcmbuffer.tell()
-              << " avail " << dcmbuffer.avail() << std::endl;
-    std::cerr << "** Dataset state: "
-              << static_cast<int>(dataset.transferState()) << std::endl;
-    std::cerr << "Could not DcmDataset::read(..): "
-              << condition.text() << std::endl;
-    //throw std::invalid_argument( std::string("Could not DcmDataset::read(..): ") + condition.text() );
-  }
+  this->DeserializeFromByteArray( QByteArray::fromBase64( stringbuffer.toLatin1() ) );
 }
 
 DcmItem& ctkDICOMItem::GetDcmItem() const
@@ -263,7 +320,12 @@ OFCondition ctkDICOMItem::findAndGetOFString(const DcmTag& tag, OFString& value,
 
 bool ctkDICOMItem::TagExists(const DcmTag& tag) const
 {
+  Q_D(const ctkDICOMItem);
   EnsureDcmDataSetIsInitialized();
+  if (d->m_PixelDataSkipped && tag == DCM_PixelData)
+  {
+    return true;
+  }
   // this one const_cast allows us to declare quite a lot of methods nicely with const
   return GetDcmItem().tagExists(tag, true);
 }
@@ -357,6 +419,10 @@ QString ctkDICOMItem::Decode( const DcmTag& tag, const OFString& raw ) const
     //std::cout << "Decode from encoding " << d->m_SpecificCharacterSet.toStdString() << std::endl;
     static QMap<QString, QTextDecoder*> decoders;
     static QMap<QString, QString> qtEncodingNamesForDICOMEncodingNames;
+    // The static maps and the decoders are shared between all items,
+    // which may be decoded in multiple threads at the same time.
+    static QMutex decodersMutex;
+    QMutexLocker decodersLocker(&decodersMutex);
 
     if (qtEncodingNamesForDICOMEncodingNames.isEmpty())
     {
@@ -1016,3 +1082,20 @@ bool ctkDICOMItem::SaveToFile(const QString& filePath) const
   return status.good();
 }
 
+
+QDataStream& operator<<(QDataStream& stream, const ctkDICOMItem& item)
+{
+  stream << item.SerializeToByteArray();
+  return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, ctkDICOMItem& item)
+{
+  QByteArray buffer;
+  stream >> buffer;
+  if (stream.status() == QDataStream::Ok && !item.DeserializeFromByteArray(buffer))
+  {
+    stream.setStatus(QDataStream::ReadCorruptData);
+  }
+  return stream;
+}
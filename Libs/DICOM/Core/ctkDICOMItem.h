@@ -59,6 +59,8 @@ class ctkDICOMItemPrivate;
 ///  A subclass could possibly want to store the internal DcmDataset.
 ///  For this purpose, the internal DcmDataset is serialized into a memory buffer using DcmDataset::write(..). This buffer
 ///  is stored in a base64 encoded string. For deserialization we decode the string and use DcmDataset::read(..).
+///  When no string is needed (e.g. for passing items between threads or processes), the memory buffer can be
+///  used directly with SerializeToByteArray() / DeserializeFromByteArray() or the QDataStream operators.
 class ctkDICOMItem;
 
 typedef ctkDICOMItem ctkDICOMItem;
@@ -93,6 +95,18 @@ public:
                     const Uint32 maxReadLength = DCM_MaxReadLength,
                     const E_FileReadMode readMode = ERM_autoDetect);
 
+    ///
+    /// \brief For initialization from the header of a file, for example during indexing.
+    ///
+    /// Parsing stops at PixelData (7FE0,0010), therefore pixel data (and any element after it)
+    /// is not read from the file. Element values longer than maxReadLength are not loaded
+    /// into memory, they are only read from the file when they are accessed.
+    /// TagExists() still reports pixel data as present if parsing was stopped at it.
+    /// If the DCMTK version does not support stopping at a tag then only
+    /// reading of long element values is skipped.
+    ///
+    virtual void InitializeFromFileHeader(const QString& filename,
+                    const Uint32 maxReadLength = DCM_MaxReadLength);
 
 
     /// \brief Save dataset to file
@@ -114,6 +128,28 @@ public:
     /// the internal DcmDataset is created using DcmDataset::read(..).
     void Deserialize();
 
+    /// \brief Return a binary representation of the object.
+    ///
+    /// The internal DcmDataset is written into the returned buffer using DcmDataset::write(..),
+    /// with the same transfer syntax as Serialize() but without the base64 encoding.
+    /// The returned QByteArray is implicitly shared, so it can be passed to other threads
+    /// (e.g. in queued signals) without copying the data.
+    /// Returns an empty array if the dataset could not be written.
+    QByteArray SerializeToByteArray() const;
+
+    /// \brief Restore the object from a binary representation created by SerializeToByteArray().
+    ///
+    /// The dataset is read directly from the buffer of the array, which is not copied.
+    /// The object takes ownership of the new internal DcmDataset.
+    /// \returns false if the dataset could not be read.
+    bool DeserializeFromByteArray(const QByteArray& buffer);
+
+    /// \brief Exchange the internal dataset and state with another object.
+    ///
+    /// This can be used for moving a dataset into another object without copying it,
+    /// e.g. into an empty object: target.Swap(source);
+    void Swap(ctkDICOMItem& other);
+
 
     /// \brief To be called from InitializeData, flags status as dirty.
     ///
@@ -125,6 +161,12 @@ public:
     /// \brief Is this dataset initialized ?
     bool IsInitialized() const;
 
+    /// \brief Did InitializeFromFileHeader stop parsing at pixel data ?
+    ///
+    /// If true then the elements after PixelData (7FE0,0010) may be in the file
+    /// but they are not in the dataset.
+    bool IsPixelDataSkipped() const;
+
     ///
     /// \brief Called by all Get/Set methods to initialize DcmDataSet if needed.
     ///
@@ -270,5 +312,13 @@ private:
   Q_DECLARE_PRIVATE(ctkDICOMItem);
 };
 
+/// \ingroup DICOM_Core
+/// Write the binary representation of the item (see ctkDICOMItem::SerializeToByteArray())
+CTK_DICOM_CORE_EXPORT QDataStream& operator<<(QDataStream& stream, const ctkDICOMItem& item);
+/// \ingroup DICOM_Core
+/// Read an item written by operator<<. The status of the stream is set to
+/// QDataStream::ReadCorruptData if the dataset could not be read.
+CTK_DICOM_CORE_EXPORT QDataStream& operator>>(QDataStream& stream, ctkDICOMItem& item);
+
 #endif
 
@@ -19,6 +19,7 @@
 =========================================================================*/
 
 // Qt includes
+#include <QHash>
 #include <QStringList>
 #include <QSqlDriver>
 #include <QSqlError>
@@ -33,12 +34,16 @@
 #include "dcmtk/dcmdata/dcvrpn.h"
 
 // ctkDICOMCore includes
+#include "ctkDICOMDatabaseQueryWorker_p.h"
 #include "ctkDICOMModel.h"
 #include "ctkLogger.h"
 
 static ctkLogger logger ( "org.commontk.dicom.DICOMModel" );
 struct Node;
 
+// Number of rows sent by the query worker at once in asynchronous mode
+static const int ASYNCHRONOUS_FETCH_CHUNK_ROW_COUNT = 64;
+
 Q_DECLARE_METATYPE(Qt::CheckState);
 Q_DECLARE_METATYPE(QStringList);
 
@@ -65,6 +70,14 @@ public:
   QVariant value(const QModelIndex& indexValue, int row, int field)const;
   QString  generateQuery(const QString& fields, const QString& table, const QString& conditions = QString())const;
   void updateQueries(Node* node)const;
+  int fieldIndex(Node* node, const QString& fieldName)const;
+  QModelIndex indexFromNode(Node* node)const;
+
+  /// Asynchronous fetch is used only if a worker could be created for the database
+  bool isAsynchronous()const;
+  void updateWorker();
+  void cancelFetches();
+  void appendRows(Node* node, const QVariantList& rows);
 
   Node*        RootNode;
   QSqlDatabase DataBase;
@@ -74,6 +87,11 @@ public:
 
   ctkDICOMModel::IndexType StartLevel;
   ctkDICOMModel::IndexType EndLevel;
+
+  bool AsynchronousFetch;
+  QScopedPointer<ctkDICOMDatabaseQueryWorker> Worker;
+  /// Nodes whose rows are being fetched by the worker, by request id
+  QHash<int, Node*> FetchRequests;
 };
 
 //------------------------------------------------------------------------------
@@ -94,6 +112,13 @@ struct Node
   QVector<Node*>                  Children;
   int                             Row;
   QSqlQuery                       Query;
+  QString                         QueryString;
+  QVariantList                    BindValues;
+  QStringList                     FieldNames;
+  // rows received from the query worker in asynchronous mode
+  QList<QVariantList>             Rows;
+  int                             RequestedRowCount;
+  int                             ReceivedRowCount;
   QString                         UID;
   int                             RowCount;
   bool                            AtEnd;
@@ -107,11 +132,13 @@ ctkDICOMModelPrivate::ctkDICOMModelPrivate(ctkDICOMModel& o):q_ptr(&o)
   this->RootNode     = 0;
   this->StartLevel = ctkDICOMModel::RootType;
   this->EndLevel = ctkDICOMModel::ImageType;
+  this->AsynchronousFetch = false;
 }
 
 //------------------------------------------------------------------------------
 ctkDICOMModelPrivate::~ctkDICOMModelPrivate()
 {
+  this->Worker.reset();
   delete this->RootNode;
   this->RootNode = 0;
 }
@@ -249,6 +276,8 @@ Node* ctkDICOMModelPrivate::createNode(int row, const QModelIndex& parentValue)c
     }
 
   node->RowCount = 0;
+  node->RequestedRowCount = 0;
+  node->ReceivedRowCount = 0;
   node->AtEnd = false;
   node->Fetching = false;
 
@@ -276,6 +305,11 @@ QVariant ctkDICOMModelPrivate::value(Node* parentNode, int row, int column) cons
     return QVariant();
     }
 
+  if (this->isAsynchronous())
+    {
+    return parentNode->Rows[row].value(column);
+    }
+
   if (!parentNode->Query.seek(row))
     {
     qDebug() << parentNode->Query.lastError();
@@ -307,68 +341,199 @@ QString ctkDICOMModelPrivate::generateQuery(const QString& fields, const QString
 void ctkDICOMModelPrivate::updateQueries(Node* node)const
 {
   // are you kidding me, it should be virtualized here :-)
+  // Search parameters and UIDs are bound to the placeholders of the query,
+  // they are never inserted in the query string.
+  QString fields;
   QString query;
   QString condition;
+  QVariantList bindValues;
   switch(node->Type)
     {
     default:
       Q_ASSERT(node->Type == ctkDICOMModel::RootType);
       break;
     case ctkDICOMModel::RootType:
-      //query = QString("SELECT  FROM ");
-      if(this->SearchParameters["Name"].toString() != ""){
-        condition.append("PatientsName LIKE \"%" + this->SearchParameters["Name"].toString() + "%\"");
-      }
-      query = this->generateQuery("UID as UID, PatientsName as Name, PatientsAge as Age, PatientsBirthDate as Date, PatientID as \"Subject ID\"","Patients", condition);
+      if(this->SearchParameters["Name"].toString() != "")
+        {
+        condition.append("PatientsName LIKE ?");
+        bindValues << QString("%" + this->SearchParameters["Name"].toString() + "%");
+        }
+      fields = "UID as UID, PatientsName as Name, PatientsAge as Age, PatientsBirthDate as Date, PatientID as \"Subject ID\"";
+      query = this->generateQuery(fields, "Patients", condition);
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Root: query is: " + query );
       break;
     case ctkDICOMModel::PatientType:
-      //query = QString("SELECT  FROM Studies WHERE PatientsUID='%1'").arg(node->UID);
       if(this->SearchParameters["Study"].toString() != "")
         {
-        condition.append("StudyDescription LIKE \"%" + this->SearchParameters["Study"].toString() + "%\"" + " AND ");
+        condition.append("StudyDescription LIKE ? AND ");
+        bindValues << QString("%" + this->SearchParameters["Study"].toString() + "%");
         }
       if(this->SearchParameters["Modalities"].value<QStringList>().count() > 0)
         {
-        condition.append("ModalitiesInStudy IN (\"" + this->SearchParameters["Modalities"].value<QStringList>().join("\",\"") + "\") AND ");
+        QStringList modalities = this->SearchParameters["Modalities"].value<QStringList>();
+        QStringList placeholders;
+        foreach(const QString& modality, modalities)
+          {
+          placeholders << "?";
+          bindValues << modality;
+          }
+        condition.append("ModalitiesInStudy IN (" + placeholders.join(",") + ") AND ");
         }
       if(this->SearchParameters["StartDate"].toString() != "" &&
          this->SearchParameters["EndDate"].toString() != "")
         {
-          condition.append(" ( StudyDate BETWEEN \'" + QDate::fromString(this->SearchParameters["StartDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd")
-                           + "\' AND \'" + QDate::fromString(this->SearchParameters["EndDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd") + "\' ) AND ");
+        condition.append(" ( StudyDate BETWEEN ? AND ? ) AND ");
+        bindValues << QDate::fromString(this->SearchParameters["StartDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd")
+                   << QDate::fromString(this->SearchParameters["EndDate"].toString(), "yyyyMMdd").toString("yyyy-MM-dd");
         }
-      query = this->generateQuery("StudyInstanceUID as UID, StudyDescription as Name, ModalitiesInStudy as Scan, StudyDate as Date, AccessionNumber as Number, InstitutionName as Institution, ReferringPhysician as Referrer, PerformingPhysiciansName as Performer", "Studies", condition + QString("PatientsUID='%1'").arg(node->UID));
+      fields = "StudyInstanceUID as UID, StudyDescription as Name, ModalitiesInStudy as Scan, StudyDate as Date, AccessionNumber as Number, InstitutionName as Institution, ReferringPhysician as Referrer, PerformingPhysiciansName as Performer";
+      query = this->generateQuery(fields, "Studies", condition + QString("PatientsUID=?"));
+      bindValues << node->UID;
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Patient: query is: " + query );
       break;
     case ctkDICOMModel::StudyType:
-      //query = QString("SELECT SeriesInstanceUID as UID, SeriesDescription as Name, BodyPartExamined as Scan, SeriesDate as Date, AcquisitionNumber as Number FROM Series WHERE StudyInstanceUID='%1'").arg(node->UID);
       if(this->SearchParameters["Series"].toString() != "")
         {
-        condition.append("SeriesDescription LIKE \"%" + this->SearchParameters["Series"].toString() + "%\"" + " AND ");
+        condition.append("SeriesDescription LIKE ? AND ");
+        bindValues << QString("%" + this->SearchParameters["Series"].toString() + "%");
         }
-      query = this->generateQuery("SeriesInstanceUID as UID, SeriesDescription as Name, Modality as Age, SeriesNumber as Scan, BodyPartExamined as \"Subject ID\", SeriesDate as Date, AcquisitionNumber as Number","Series",condition + QString("StudyInstanceUID='%1'").arg(node->UID));
+      fields = "SeriesInstanceUID as UID, SeriesDescription as Name, Modality as Age, SeriesNumber as Scan, BodyPartExamined as \"Subject ID\", SeriesDate as Date, AcquisitionNumber as Number";
+      query = this->generateQuery(fields, "Series", condition + QString("StudyInstanceUID=?"));
+      bindValues << node->UID;
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Study: query is: " + query );
       break;
     case ctkDICOMModel::SeriesType:
       if(this->SearchParameters["ID"].toString() != "")
         {
-        condition.append("SOPInstanceUID LIKE \"%" + this->SearchParameters["ID"].toString() + "%\"" + " AND ");
+        condition.append("SOPInstanceUID LIKE ? AND ");
+        bindValues << QString("%" + this->SearchParameters["ID"].toString() + "%");
         }
-      //query = QString("SELECT Filename as UID, Filename as Name, SeriesInstanceUID as Date FROM Images WHERE SeriesInstanceUID='%1'").arg(node->UID);
-      query = this->generateQuery("SOPInstanceUID as UID, Filename as Name, SeriesInstanceUID as Date", "Images", condition + QString("SeriesInstanceUID='%1'").arg(node->UID));
+      fields = "SOPInstanceUID as UID, Filename as Name, SeriesInstanceUID as Date";
+      query = this->generateQuery(fields, "Images", condition + QString("SeriesInstanceUID=?"));
+      bindValues << node->UID;
       logger.debug ( "ctkDICOMModelPrivate::updateQueries for Series: query is: " + query );
       break;
     case ctkDICOMModel::ImageType:
       break;
     }
-  node->Query = QSqlQuery(query, this->DataBase);
+  node->QueryString = query;
+  node->BindValues = bindValues;
+  node->FieldNames.clear();
+  #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+  QStringList fieldList = fields.split(",", Qt::SkipEmptyParts);
+  #else
+  QStringList fieldList = fields.split(",", QString::SkipEmptyParts);
+  #endif
+  foreach(const QString& field, fieldList)
+    {
+    QString fieldName = field.section(" as ", -1).trimmed();
+    fieldName.remove('"');
+    node->FieldNames << fieldName;
+    }
+  // in asynchronous mode, rows are fetched by the worker when they are needed
+  if (!this->isAsynchronous())
+    {
+    node->Query = QSqlQuery(this->DataBase);
+    if (!query.isEmpty())
+      {
+      node->Query.prepare(query);
+      foreach(const QVariant& bindValue, bindValues)
+        {
+        node->Query.addBindValue(bindValue);
+        }
+      if (!node->Query.exec())
+        {
+        logger.error("ctkDICOMModelPrivate::updateQueries failed: " + node->Query.lastError().text());
+        }
+      }
+    }
   foreach(Node* child, node->Children)
     {
     this->updateQueries(child);
     }
 }
 
+//------------------------------------------------------------------------------
+int ctkDICOMModelPrivate::fieldIndex(Node* node, const QString& fieldName)const
+{
+  return node->FieldNames.indexOf(fieldName);
+}
+
+//------------------------------------------------------------------------------
+QModelIndex ctkDICOMModelPrivate::indexFromNode(Node* node)const
+{
+  Q_Q(const ctkDICOMModel);
+  if (node == 0 || node == this->RootNode)
+    {
+    return QModelIndex();
+    }
+  return q->createIndex(node->Row, 0, node);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMModelPrivate::isAsynchronous()const
+{
+  return !this->Worker.isNull();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::updateWorker()
+{
+  Q_Q(ctkDICOMModel);
+  QString databaseFilename = this->DataBase.databaseName();
+  // the worker opens its own connection to the database file
+  bool workerNeeded = this->AsynchronousFetch
+    && this->DataBase.driverName() == "QSQLITE"
+    && !databaseFilename.isEmpty() && databaseFilename != ":memory:";
+  if (!workerNeeded)
+    {
+    this->Worker.reset();
+    return;
+    }
+  if (this->Worker && this->Worker->databaseFilename() == databaseFilename)
+    {
+    return;
+    }
+  this->Worker.reset(new ctkDICOMDatabaseQueryWorker(databaseFilename));
+  QObject::connect(this->Worker.data(), SIGNAL(rowsFetched(int,QVariantList)),
+                   q, SLOT(onRowsFetched(int,QVariantList)));
+  QObject::connect(this->Worker.data(), SIGNAL(executed(int,bool,QVariantList)),
+                   q, SLOT(onFetchFinished(int,bool,QVariantList)));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::cancelFetches()
+{
+  if (this->Worker)
+    {
+    this->Worker->cancel();
+    }
+  foreach(Node* node, this->FetchRequests)
+    {
+    // the rows can be fetched again later
+    node->Fetching = false;
+    }
+  this->FetchRequests.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModelPrivate::appendRows(Node* node, const QVariantList& rows)
+{
+  Q_Q(ctkDICOMModel);
+  node->ReceivedRowCount += rows.size();
+  if (rows.isEmpty())
+    {
+    return;
+    }
+  q->beginInsertRows(this->indexFromNode(node), node->RowCount, node->RowCount + rows.size() - 1);
+  foreach(const QVariant& row, rows)
+    {
+    node->Rows << row.toList();
+    }
+  node->RowCount = node->Rows.size();
+  q->endInsertRows();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMModelPrivate::fetch(const QModelIndex& indexValue, int limit)
 {
@@ -380,6 +545,19 @@ void ctkDICOMModelPrivate::fetch(const QModelIndex& indexValue, int limit)
     }
   node->Fetching = true;
 
+  if (this->isAsynchronous())
+    {
+    // Rows are inserted when the worker sends them
+    node->RequestedRowCount = qMax(limit - node->RowCount, ASYNCHRONOUS_FETCH_CHUNK_ROW_COUNT);
+    node->ReceivedRowCount = 0;
+    QVariantList bindValues = node->BindValues;
+    bindValues << node->RequestedRowCount << node->RowCount;
+    int requestId = this->Worker->execute(node->QueryString + " LIMIT ? OFFSET ?",
+                                          bindValues, ASYNCHRONOUS_FETCH_CHUNK_ROW_COUNT);
+    this->FetchRequests[requestId] = node;
+    return;
+    }
+
   int newRowCount;
   const int oldRowCount = node->RowCount;
 
@@ -492,7 +670,7 @@ QVariant ctkDICOMModel::data ( const QModelIndex & dataIndex, int role ) const
     const_cast<ctkDICOMModelPrivate *>(d)->fetch(dataIndex, dataIndex.row());
     }
   QString columnName = d->Headers[dataIndex.column()][Qt::DisplayRole].toString();
-  int field = parentNode->Query.record().indexOf(columnName);
+  int field = d->fieldIndex(parentNode, columnName);
   if (field < 0)
     {
     // Not all the columns are in the record, it's ok to have no field here.
@@ -610,6 +788,11 @@ bool ctkDICOMModel::hasChildren ( const QModelIndex & parentIndex ) const
   // just means that the children haven't been fetched yet
   if (node->RowCount == 0 && !node->AtEnd)
     {
+    if (d->isAsynchronous())
+      {
+      // the answer is known when the first rows are fetched
+      return !node->QueryString.isEmpty();
+      }
     // We don't want to fetch the data because we don't want to add children
     // to the index yet (it would be a mess to add rows inside a hasChildren)
     //const_cast<qCTKDCMTKModelPrivate*>(d)->fetch(parentIndex, 1);
@@ -847,7 +1030,9 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
   Q_D(ctkDICOMModel);
 
   this->beginResetModel();
+  d->cancelFetches();
   d->DataBase = db;
+  d->updateWorker();
 
   delete d->RootNode;
   d->RootNode = 0;
@@ -864,7 +1049,7 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db)
   this->endResetModel();
 
   // TODO, use hasQuerySize everywhere, not only in setDataBase()
-  bool hasQuerySize = d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
+  bool hasQuerySize = !d->isAsynchronous() && d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
   if (hasQuerySize && d->RootNode->Query.size() > 0)
     {
     int newRowCount= d->RootNode->Query.size();
@@ -882,8 +1067,10 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db,const QMap<QString, QVari
   Q_D(ctkDICOMModel);
 
   this->beginResetModel();
+  d->cancelFetches();
   d->DataBase = db;
   d->SearchParameters = parameters;
+  d->updateWorker();
 
   delete d->RootNode;
   d->RootNode = 0;
@@ -900,7 +1087,7 @@ void ctkDICOMModel::setDatabase(const QSqlDatabase &db,const QMap<QString, QVari
   this->endResetModel();
 
   // TODO, use hasQuerySize everywhere, not only in setDataBase()
-  bool hasQuerySize = d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
+  bool hasQuerySize = !d->isAsynchronous() && d->RootNode->Query.driver()->hasFeature(QSqlDriver::QuerySize);
   if (hasQuerySize && d->RootNode->Query.size() > 0)
     {
     int newRowCount= d->RootNode->Query.size();
@@ -926,6 +1113,78 @@ void ctkDICOMModel::setEndLevel(ctkDICOMModel::IndexType level)
   d->EndLevel = level;
 }
 
+//------------------------------------------------------------------------------
+bool ctkDICOMModel::asynchronousFetch()const
+{
+  Q_D(const ctkDICOMModel);
+  return d->AsynchronousFetch;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::setAsynchronousFetch(bool enable)
+{
+  Q_D(ctkDICOMModel);
+  if (d->AsynchronousFetch == enable)
+    {
+    return;
+    }
+  d->AsynchronousFetch = enable;
+  if (d->RootNode)
+    {
+    this->reset();
+    }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMModel::isFetching()const
+{
+  Q_D(const ctkDICOMModel);
+  return !d->FetchRequests.isEmpty();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::cancelFetch()
+{
+  Q_D(ctkDICOMModel);
+  d->cancelFetches();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::onRowsFetched(int requestId, const QVariantList& rows)
+{
+  Q_D(ctkDICOMModel);
+  Node* node = d->FetchRequests.value(requestId);
+  if (!node)
+    {
+    return;
+    }
+  d->appendRows(node, rows);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMModel::onFetchFinished(int requestId, bool success, const QVariantList& rows)
+{
+  Q_D(ctkDICOMModel);
+  Node* node = d->FetchRequests.take(requestId);
+  if (!node)
+    {
+    return;
+    }
+  d->appendRows(node, rows);
+  node->Fetching = false;
+  if (!success || node->ReceivedRowCount < node->RequestedRowCount)
+    {
+    node->AtEnd = true;
+    }
+  QModelIndex parentIndex = d->indexFromNode(node);
+  if (node->RowCount == 0 && parentIndex.isValid())
+    {
+    // hasChildren() changed
+    emit dataChanged(parentIndex, parentIndex);
+    }
+  emit fetchFinished(parentIndex);
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMModel::reset()
 {
@@ -954,6 +1213,7 @@ void ctkDICOMModel::sort(int column, Qt::SortOrder order)
   emit layoutChanged();
   */
   this->beginResetModel();
+  d->cancelFetches();
   delete d->RootNode;
   d->RootNode = 0;
   d->Sort = QString("\"%1\" %2")
@@ -32,6 +32,13 @@
 class ctkDICOMModelPrivate;
 
 /// \ingroup DICOM_Core
+///
+/// If asynchronousFetch is enabled and the database is stored in a file then
+/// the rows are fetched by a read-only connection in a background thread:
+/// fetchMore() returns immediately and the rows are inserted in chunks when
+/// they arrive. fetchFinished() is emitted when a fetch is complete.
+/// Fetches are cancelled when the database, the search parameters or the sort
+/// order change, or by cancelFetch().
 class CTK_DICOM_CORE_EXPORT ctkDICOMModel
 //  : public QStandardItemModel
   : public QAbstractItemModel
@@ -41,6 +48,8 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMModel
   Q_ENUMS(IndexType)
   /// startLevel contains the hierarchy depth the model contains
   Q_PROPERTY(IndexType endLevel READ endLevel WRITE setEndLevel);
+  /// Fetch the rows in a background thread. Disabled by default.
+  Q_PROPERTY(bool asynchronousFetch READ asynchronousFetch WRITE setAsynchronousFetch);
 public:
 
   enum {
@@ -66,6 +75,14 @@ public:
   ctkDICOMModel::IndexType endLevel()const;
   void setEndLevel(ctkDICOMModel::IndexType level);
 
+  /// The model is reset if asynchronousFetch is changed after the database is set.
+  /// In-memory databases are always fetched synchronously.
+  bool asynchronousFetch()const;
+  void setAsynchronousFetch(bool enable);
+
+  /// Return true if rows are being fetched in the background
+  bool isFetching()const;
+
   virtual bool canFetchMore ( const QModelIndex & parent ) const;
   virtual int columnCount ( const QModelIndex & parent = QModelIndex() ) const;
   virtual QVariant data ( const QModelIndex & index, int role = Qt::DisplayRole ) const;
@@ -84,6 +101,18 @@ public:
   virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 public Q_SLOTS:
   virtual void reset();
+  /// Cancel the background fetches in progress, e.g. when they are superseded
+  /// by a new selection. Cancelled rows can be fetched again with fetchMore().
+  void cancelFetch();
+
+Q_SIGNALS:
+  /// Emitted in asynchronous mode when the rows requested for parent are fetched
+  void fetchFinished(const QModelIndex& parent);
+
+protected Q_SLOTS:
+  void onRowsFetched(int requestId, const QVariantList& rows);
+  void onFetchFinished(int requestId, bool success, const QVariantList& rows);
+
 protected:
   QScopedPointer<ctkDICOMModelPrivate> d_ptr;
 
@@ -28,9 +28,13 @@
 #include <QFile>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QThreadPool>
 #include <QDebug>
 
 // ctkDICOMCore includes
+#include "ctkDICOMItem.h"
 #include "ctkDICOMQuery.h"
 #include "ctkDICOMUtil.h"
 #include "ctkLogger.h"
@@ -89,6 +93,18 @@ public:
   /// Add a StudyInstanceUID to be queried
   void addStudyInstanceUIDAndDataset(const QString& StudyInstanceUID, DcmDataset* dataset );
 
+  /// Set association parameters from the query settings
+  void initializeSCU(DcmSCU& scu);
+
+  /// Get the index of the next study of which series must be queried.
+  /// Returns false if there are no more studies or the query is canceled.
+  bool takeNextSeriesQueryStudy(int& studyIndex);
+  /// Store series query responses of a study
+  void addSeriesQueryResults(int studyIndex, bool success, const QList<ctkDICOMDatabase::IndexingResult>& results);
+
+  /// Return true if cancel() was called, can be used from any thread
+  bool isCanceled();
+
   QString                 CallingAETitle;
   QString                 CalledAETitle;
   QString                 Host;
@@ -99,9 +115,97 @@ public:
   DcmDataset*             Query;
   QStringList             StudyInstanceUIDList;
   QList<DcmDataset*>      StudyDatasetList;
-  bool                    Canceled;
+  /// Set by cancel() while the query tasks may be reading it
+  QAtomicInt              Canceled;
+  int                     MaximumNumberOfAssociations;
+
+  // State of concurrent series level queries, shared between the query tasks
+  QMutex                  SeriesQueryMutex;
+  int                     NextSeriesQueryStudyIndex;
+  int                     CompletedSeriesQueryStudyCount;
+  QStringList             FailedSeriesQueryStudies;
+  QList<ctkDICOMDatabase::IndexingResult> SeriesQueryResults;
+  /// Patient name and ID of each study, as they are not returned by series level queries
+  QList<OFString>         StudyPatientNames;
+  QList<OFString>         StudyPatientIDs;
+};
+
+//------------------------------------------------------------------------------
+/// Queries the series of studies using its own association.
+/// Studies are taken from the shared list of studies in ctkDICOMQueryPrivate,
+/// therefore several tasks can run concurrently, each reusing its association
+/// for many studies.
+class ctkDICOMQuerySeriesTask : public QRunnable
+{
+public:
+  ctkDICOMQuerySeriesTask(ctkDICOMQueryPrivate* queryPrivate, const DcmDataset& seriesQuery);
+  virtual void run();
+
+protected:
+  ctkDICOMQueryPrivate* QueryPrivate;
+  DcmDataset SeriesQuery;
 };
 
+//------------------------------------------------------------------------------
+// ctkDICOMQuerySeriesTask methods
+
+//------------------------------------------------------------------------------
+ctkDICOMQuerySeriesTask::ctkDICOMQuerySeriesTask(ctkDICOMQueryPrivate* queryPrivate, const DcmDataset& seriesQuery)
+  : QueryPrivate(queryPrivate)
+  , SeriesQuery(seriesQuery)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQuerySeriesTask::run()
+{
+  DcmSCU scu;
+  this->QueryPrivate->initializeSCU(scu);
+  if (!scu.initNetwork().good())
+    {
+    logger.error("Error initializing the network for series query");
+    return;
+    }
+  OFCondition result = scu.negotiateAssociation();
+  if (result.bad())
+    {
+    logger.error("Error negotiating the association for series query: " + QString(result.text()));
+    return;
+    }
+  Uint16 presentationContext = scu.findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, "");
+
+  int studyIndex = 0;
+  while (this->QueryPrivate->takeNextSeriesQueryStudy(studyIndex))
+    {
+    this->SeriesQuery.putAndInsertString(DCM_StudyInstanceUID,
+      this->QueryPrivate->StudyInstanceUIDList[studyIndex].toStdString().c_str());
+    OFList<QRResponse*> responses;
+    OFCondition status = scu.sendFINDRequest(presentationContext, &this->SeriesQuery, &responses);
+    QList<ctkDICOMDatabase::IndexingResult> results;
+    for (OFListIterator(QRResponse*) it = responses.begin(); it != responses.end(); it++)
+      {
+      DcmDataset* dataset = (*it)->m_dataset;
+      if (status.good() && dataset != NULL)
+        {
+        ctkDICOMDatabase::IndexingResult indexingResult;
+        DcmDataset* seriesDataset = new DcmDataset(*dataset);
+        // add the patient elements not provided for the series level query
+        seriesDataset->putAndInsertOFStringArray(DCM_PatientName, this->QueryPrivate->StudyPatientNames[studyIndex]);
+        seriesDataset->putAndInsertOFStringArray(DCM_PatientID, this->QueryPrivate->StudyPatientIDs[studyIndex]);
+        indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+        indexingResult.dataset->InitializeFromItem(seriesDataset, true /* take ownership */);
+        indexingResult.copyFile = false;
+        indexingResult.overwriteExistingDataset = false;
+        results << indexingResult;
+        }
+      delete *it;
+      }
+    this->QueryPrivate->addSeriesQueryResults(studyIndex, status.good(), results);
+    }
+
+  scu.closeAssociation(DCMSCU_RELEASE_ASSOCIATION);
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMQueryPrivate methods
 
@@ -110,8 +214,10 @@ ctkDICOMQueryPrivate::ctkDICOMQueryPrivate()
 {
   this->Query = new DcmDataset();
   this->Port = 0;
-  this->Canceled = false;
   this->PreferCGET = false;
+  this->MaximumNumberOfAssociations = 1;
+  this->NextSeriesQueryStudyIndex = 0;
+  this->CompletedSeriesQueryStudyCount = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -127,6 +233,55 @@ void ctkDICOMQueryPrivate::addStudyInstanceUIDAndDataset( const QString& s, DcmD
   this->StudyDatasetList.append ( dataset );
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMQueryPrivate::initializeSCU(DcmSCU& scu)
+{
+  scu.setAETitle ( OFString(this->CallingAETitle.toStdString().c_str()) );
+  scu.setPeerAETitle ( OFString(this->CalledAETitle.toStdString().c_str()) );
+  scu.setPeerHostName ( OFString(this->Host.toStdString().c_str()) );
+  scu.setPeerPort ( this->Port );
+
+  OFList<OFString> transferSyntaxes;
+  transferSyntaxes.push_back ( UID_LittleEndianExplicitTransferSyntax );
+  transferSyntaxes.push_back ( UID_BigEndianExplicitTransferSyntax );
+  transferSyntaxes.push_back ( UID_LittleEndianImplicitTransferSyntax );
+  scu.addPresentationContext ( UID_FINDStudyRootQueryRetrieveInformationModel, transferSyntaxes );
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMQueryPrivate::isCanceled()
+{
+  return this->Canceled.fetchAndAddOrdered(0) != 0;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMQueryPrivate::takeNextSeriesQueryStudy(int& studyIndex)
+{
+  QMutexLocker locker(&this->SeriesQueryMutex);
+  if (this->isCanceled() || this->NextSeriesQueryStudyIndex >= this->StudyInstanceUIDList.count())
+    {
+    return false;
+    }
+  studyIndex = this->NextSeriesQueryStudyIndex++;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQueryPrivate::addSeriesQueryResults(int studyIndex, bool success,
+  const QList<ctkDICOMDatabase::IndexingResult>& results)
+{
+  QMutexLocker locker(&this->SeriesQueryMutex);
+  this->CompletedSeriesQueryStudyCount++;
+  if (success)
+    {
+    this->SeriesQueryResults << results;
+    }
+  else
+    {
+    this->FailedSeriesQueryStudies << this->StudyInstanceUIDList[studyIndex];
+    }
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMQuery methods
 
@@ -215,6 +370,20 @@ bool ctkDICOMQuery::preferCGET()const
   return d->PreferCGET;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMQuery::setMaximumNumberOfAssociations ( int count )
+{
+  Q_D(ctkDICOMQuery);
+  d->MaximumNumberOfAssociations = qMax(1, count);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMQuery::maximumNumberOfAssociations()const
+{
+  Q_D(const ctkDICOMQuery);
+  return d->MaximumNumberOfAssociations;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMQuery::setFilters( const QMap<QString,QVariant>& filters )
 {
@@ -258,7 +427,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
     emit progress("DB not open in Query");
     }
   emit progress(0);
-  if (d->Canceled) {return false;}
+  if (d->isCanceled()) {return false;}
 
   d->StudyInstanceUIDList.clear();
   d->SCU.setAETitle ( OFString(this->callingAETitle().toStdString().c_str()) );
@@ -269,7 +438,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   logger.error ( "Setting Transfer Syntaxes" );
   emit progress("Setting Transfer Syntaxes");
   emit progress(10);
-  if (d->Canceled) {return false;}
+  if (d->isCanceled()) {return false;}
 
   OFList<OFString> transferSyntaxes;
   transferSyntaxes.push_back ( UID_LittleEndianExplicitTransferSyntax );
@@ -288,7 +457,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   logger.debug ( "Negotiating Association" );
   emit progress("Negotiating Association");
   emit progress(20);
-  if (d->Canceled) {return false;}
+  if (d->isCanceled()) {return false;}
 
   OFCondition result = d->SCU.negotiateAssociation();
   if (result.bad())
@@ -379,7 +548,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
     logger.debug("Query on study date " + dateRange);
     }
   emit progress(30);
-  if (d->Canceled) {return false;}
+  if (d->isCanceled()) {return false;}
 
   OFList<QRResponse *> responses;
 
@@ -397,7 +566,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
     emit progress("Found useful presentation context");
     }
   emit progress(40);
-  if (d->Canceled) {return false;}
+  if (d->isCanceled()) {return false;}
 
   OFCondition status = d->SCU.sendFINDRequest ( presentationContext, d->Query, &responses );
   if ( !status.good() )
@@ -411,7 +580,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
   logger.debug ( "Find succeded");
   emit progress("Find succeded");
   emit progress(50);
-  if (d->Canceled) {return false;}
+  if (d->isCanceled()) {return false;}
 
   for ( OFListIterator(QRResponse*) it = responses.begin(); it != responses.end(); it++ )
     {
@@ -424,7 +593,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
       d->addStudyInstanceUIDAndDataset ( StudyInstanceUID.c_str(), dataset );
       emit progress(QString("Processing: ") + QString(StudyInstanceUID.c_str()));
       emit progress(50);
-      if (d->Canceled) {return false;}
+      if (d->isCanceled()) {return false;}
       }
     }
 
@@ -443,6 +612,75 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
 
   // Now search each within each Study that was identified
   d->Query->putAndInsertString ( DCM_QueryRetrieveLevel, "SERIES" );
+
+  if ( d->MaximumNumberOfAssociations > 1 && d->StudyInstanceUIDList.count() > 1 )
+    {
+    // Series of the studies are queried concurrently, using a pool of associations
+    d->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
+
+    d->NextSeriesQueryStudyIndex = 0;
+    d->CompletedSeriesQueryStudyCount = 0;
+    d->FailedSeriesQueryStudies.clear();
+    d->SeriesQueryResults.clear();
+    d->StudyPatientNames.clear();
+    d->StudyPatientIDs.clear();
+    foreach ( DcmDataset* studyDataset, d->StudyDatasetList )
+      {
+      OFString patientName, patientID;
+      studyDataset->findAndGetOFStringArray(DCM_PatientName, patientName);
+      studyDataset->findAndGetOFStringArray(DCM_PatientID, patientID);
+      d->StudyPatientNames << patientName;
+      d->StudyPatientIDs << patientID;
+      }
+
+    int studyCount = d->StudyInstanceUIDList.count();
+    int associationCount = qMin(d->MaximumNumberOfAssociations, studyCount);
+    logger.debug ( QString("Starting Series C-FIND for %1 studies using %2 associations").arg(studyCount).arg(associationCount) );
+    emit progress(QString("Starting Series C-FIND for %1 studies").arg(studyCount));
+    emit progress(50);
+
+    QThreadPool seriesQueryPool;
+    seriesQueryPool.setMaxThreadCount(associationCount);
+    for (int associationIndex = 0; associationIndex < associationCount; ++associationIndex)
+      {
+      seriesQueryPool.start(new ctkDICOMQuerySeriesTask(d, *d->Query));
+      }
+    // Report progress while waiting, which also allows the application to cancel the query
+    while ( !seriesQueryPool.waitForDone(100) )
+      {
+      int completedStudyCount = 0;
+      {
+        QMutexLocker locker(&d->SeriesQueryMutex);
+        completedStudyCount = d->CompletedSeriesQueryStudyCount;
+      }
+      emit progress(QString("Series C-FIND completed for %1 of %2 studies").arg(completedStudyCount).arg(studyCount));
+      emit progress(50 + (45 * completedStudyCount) / studyCount);
+      }
+
+    // Responses of all the studies are inserted into the database at once.
+    // Responses received before the query was canceled are inserted as well.
+    emit progress(QString("Inserting %1 series into the database").arg(d->SeriesQueryResults.count()));
+    emit progress(95);
+    database.insert ( d->SeriesQueryResults );
+    d->SeriesQueryResults.clear();
+
+    foreach ( const QString& failedStudyInstanceUID, d->FailedSeriesQueryStudies )
+      {
+      logger.error ( "Find on Series level failed for Study: " + failedStudyInstanceUID );
+      emit progress(QString("Find on Series level failed for Study: ") + failedStudyInstanceUID);
+      }
+    bool success = !d->isCanceled();
+    if ( d->CompletedSeriesQueryStudyCount < studyCount && !d->isCanceled() )
+      {
+      // None of the associations could be established
+      logger.error ( QString("Find on Series level was not performed for %1 studies").arg(studyCount - d->CompletedSeriesQueryStudyCount) );
+      emit progress("Failed to establish association for series level queries");
+      success = false;
+      }
+    emit progress(100);
+    return success;
+    }
+
   float progressRatio = 25. / d->StudyInstanceUIDList.count();
   int i = 0; 
 
@@ -457,7 +695,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
     logger.debug ( "Starting Series C-FIND for Study: " + StudyInstanceUID );
     emit progress(QString("Starting Series C-FIND for Study: ") + StudyInstanceUID);
     emit progress(50 + (progressRatio * i++));
-    if (d->Canceled) {return false;}
+    if (d->isCanceled()) {return false;}
 
     d->Query->putAndInsertString ( DCM_StudyInstanceUID, StudyInstanceUID.toStdString().c_str() );
     OFList<QRResponse *> responses;
@@ -479,7 +717,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
       logger.debug ( "Find succeded on Series level for Study: " + StudyInstanceUID );
       emit progress(QString("Find succeded on Series level for Study: ") + StudyInstanceUID);
       emit progress(50 + (progressRatio * i++));
-      if (d->Canceled) {return false;}
+      if (d->isCanceled()) {return false;}
       }
     else
       {
@@ -487,7 +725,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
       emit progress(QString("Find on Series level failed for Study: ") + StudyInstanceUID);
       }
     emit progress(50 + (progressRatio * i++));
-    if (d->Canceled) {return false;}
+    if (d->isCanceled()) {return false;}
     }
   d->SCU.closeAssociation ( DCMSCU_RELEASE_ASSOCIATION );
   emit progress(100);
@@ -498,5 +736,5 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database )
 void ctkDICOMQuery::cancel()
 {
   Q_D(ctkDICOMQuery);
-  d->Canceled = true;
+  d->Canceled.fetchAndStoreOrdered(1);
 }
@@ -46,6 +46,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMQuery : public QObject
   Q_PROPERTY(bool preferCGET READ preferCGET WRITE setPreferCGET);
   Q_PROPERTY(QStringList studyInstanceUIDQueried READ studyInstanceUIDQueried);
   Q_PROPERTY(QMap<QString, QVariant> filters READ filters WRITE setFilters);
+  Q_PROPERTY(int maximumNumberOfAssociations READ maximumNumberOfAssociations WRITE setMaximumNumberOfAssociations);
 
 public:
   explicit ctkDICOMQuery(QObject* parent = 0);
@@ -71,6 +72,14 @@ public:
   void setPreferCGET ( bool preferCGET );
   bool preferCGET()const;
 
+  /// Maximum number of associations that are opened concurrently for
+  /// series level queries. If more than one then the series of the found studies
+  /// are queried concurrently and all series query responses are inserted into
+  /// the database at once. Useful for queries that find many studies.
+  /// 1 by default (series of each study are queried one after the other).
+  void setMaximumNumberOfAssociations(int count);
+  int maximumNumberOfAssociations()const;
+
   /// Query a remote DICOM Image Store SCP
   /// You must at least set the host and port before calling query()
   Q_INVOKABLE bool query(ctkDICOMDatabase& database);
@@ -21,8 +21,12 @@
 #include <stdexcept>
 
 // Qt includes
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
 
 // ctkDICOMCore includes
+#include "ctkDICOMItem.h"
 #include "ctkDICOMRetrieve.h"
 #include "ctkLogger.h"
 
@@ -49,6 +53,199 @@
 
 static ctkLogger logger("org.commontk.dicom.DICOMRetrieve");
 
+/// Maximum number of received datasets waiting to be stored in the database.
+/// Receiving is paused when it is reached, to limit memory usage.
+static const int STORAGE_QUEUE_MAXIMUM_SIZE = 200;
+
+//------------------------------------------------------------------------------
+// Stores received datasets into the database in a background thread, so that
+// the association does not have to wait for files and database records to be written.
+// Datasets that are received while the previous group is stored are inserted in one batch.
+class ctkDICOMRetrieveStorageWriter : public QThread
+{
+public:
+  ctkDICOMRetrieveStorageWriter(ctkDICOMDatabase& database);
+  ~ctkDICOMRetrieveStorageWriter();
+
+  /// Wait until the database is opened in the background thread.
+  /// Returns false if it could not be opened, datasets must then be inserted directly.
+  bool waitForDatabase();
+
+  /// Queue a copy of the dataset for storage.
+  /// Blocks if there are too many datasets waiting to be stored.
+  void addDataset(DcmDataset* dataset);
+
+  /// Wait until all queued datasets are stored and stop the thread.
+  /// Returns the number of stored datasets.
+  int finish();
+
+  /// Instances that were not in the database before and have been stored.
+  /// Only valid after finish() returned.
+  QStringList addedInstances()const;
+
+protected:
+  virtual void run();
+
+  // Storage settings of the retrieve database
+  QString DatabaseFilename;
+  QStringList TagsToPrecache;
+  QStringList TagsToExcludeFromStorage;
+  bool UseShortStoragePath;
+  bool UseWriteAheadLogging;
+  bool UseCompactTagCache;
+  ctkDICOMDatabase::ImportStoragePolicy ImportStoragePolicy;
+  int FileTransferThreadCount;
+
+  QMutex Mutex;
+  QWaitCondition DatabaseOpened;
+  QWaitCondition DatasetAdded;
+  QWaitCondition DatasetsTaken;
+  QList<ctkDICOMDatabase::IndexingResult> Queue;
+  /// 0 while the database is being opened, 1 if it is open, -1 if it could not be opened
+  int DatabaseState;
+  bool Finishing;
+  int StoredDatasetCount;
+  QStringList AddedSOPInstanceUIDs;
+};
+
+//------------------------------------------------------------------------------
+ctkDICOMRetrieveStorageWriter::ctkDICOMRetrieveStorageWriter(ctkDICOMDatabase& database)
+  : DatabaseFilename(database.databaseFilename())
+  , TagsToPrecache(database.tagsToPrecache())
+  , TagsToExcludeFromStorage(database.tagsToExcludeFromStorage())
+  , UseShortStoragePath(database.useShortStoragePath())
+  , UseWriteAheadLogging(database.useWriteAheadLogging())
+  , UseCompactTagCache(database.useCompactTagCache())
+  , ImportStoragePolicy(database.importStoragePolicy())
+  , FileTransferThreadCount(database.fileTransferThreadCount())
+  , DatabaseState(0)
+  , Finishing(false)
+  , StoredDatasetCount(0)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMRetrieveStorageWriter::~ctkDICOMRetrieveStorageWriter()
+{
+  this->finish();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMRetrieveStorageWriter::waitForDatabase()
+{
+  QMutexLocker locker(&this->Mutex);
+  while (this->DatabaseState == 0)
+    {
+    this->DatabaseOpened.wait(&this->Mutex);
+    }
+  return this->DatabaseState > 0;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveStorageWriter::addDataset(DcmDataset* dataset)
+{
+  // The received dataset is deleted by DcmSCU after it is handled, therefore a copy is stored
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
+  indexingResult.dataset->InitializeFromItem(new DcmDataset(*dataset), true /* take ownership */);
+  indexingResult.copyFile = true;
+  indexingResult.overwriteExistingDataset = false;
+
+  QMutexLocker locker(&this->Mutex);
+  while (this->Queue.size() >= STORAGE_QUEUE_MAXIMUM_SIZE)
+    {
+    this->DatasetsTaken.wait(&this->Mutex);
+    }
+  this->Queue << indexingResult;
+  this->DatasetAdded.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMRetrieveStorageWriter::finish()
+{
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->Finishing = true;
+    this->DatasetAdded.wakeAll();
+  }
+  this->wait();
+  return this->StoredDatasetCount;
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMRetrieveStorageWriter::addedInstances()const
+{
+  return this->AddedSOPInstanceUIDs;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveStorageWriter::run()
+{
+  // Database connections cannot be shared between threads, therefore
+  // the database is opened again in this thread.
+  ctkDICOMDatabase database;
+  database.setUseShortStoragePath(this->UseShortStoragePath);
+  database.setUseWriteAheadLogging(this->UseWriteAheadLogging);
+  database.setUseCompactTagCache(this->UseCompactTagCache);
+  database.setImportStoragePolicy(this->ImportStoragePolicy);
+  database.setFileTransferThreadCount(this->FileTransferThreadCount);
+  database.openDatabase(this->DatabaseFilename);
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->DatabaseState = database.isOpen() ? 1 : -1;
+    this->DatabaseOpened.wakeAll();
+  }
+  if (!database.isOpen())
+    {
+    logger.error("Failed to open database " + this->DatabaseFilename + " for storing received datasets");
+    return;
+    }
+  database.setTagsToPrecache(this->TagsToPrecache);
+  database.setTagsToExcludeFromStorage(this->TagsToExcludeFromStorage);
+
+  while (true)
+    {
+    QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+    {
+      QMutexLocker locker(&this->Mutex);
+      while (this->Queue.isEmpty() && !this->Finishing)
+        {
+        this->DatasetAdded.wait(&this->Mutex);
+        }
+      if (this->Queue.isEmpty())
+        {
+        break;
+        }
+      indexingResults = this->Queue;
+      this->Queue.clear();
+      this->DatasetsTaken.wakeAll();
+    }
+
+    // The signals of this database connection cannot be received by the users
+    // of the retrieve database, therefore added instances are collected
+    QStringList newSOPInstanceUIDs;
+    foreach(const ctkDICOMDatabase::IndexingResult& indexingResult, indexingResults)
+      {
+      QString sopInstanceUID = indexingResult.dataset->GetElementAsString(DCM_SOPInstanceUID);
+      if (!newSOPInstanceUIDs.contains(sopInstanceUID) && database.fileForInstance(sopInstanceUID).isEmpty())
+        {
+        newSOPInstanceUIDs << sopInstanceUID;
+        }
+      }
+    database.insert(indexingResults);
+    this->StoredDatasetCount += indexingResults.size();
+    foreach(const QString& sopInstanceUID, newSOPInstanceUIDs)
+      {
+      if (!database.fileForInstance(sopInstanceUID).isEmpty())
+        {
+        this->AddedSOPInstanceUIDs << sopInstanceUID;
+        }
+      }
+    }
+
+  database.closeDatabase();
+}
+
 //------------------------------------------------------------------------------
 // A customized local implemenation of the DcmSCU so that Qt signals can be emitted
 // when retrieve results are obtained
@@ -56,9 +253,12 @@ class ctkDICOMRetrieveSCUPrivate : public DcmSCU
 {
 public:
   ctkDICOMRetrieve *retrieve;
+  /// If set then received datasets are stored by this writer in a background thread
+  ctkDICOMRetrieveStorageWriter *storageWriter;
   ctkDICOMRetrieveSCUPrivate()
     {
     this->retrieve = 0;
+    this->storageWriter = 0;
     };
   ~ctkDICOMRetrieveSCUPrivate() {};
 
@@ -94,7 +294,12 @@ public:
         emit this->retrieve->progress("Got STORE request for " + qInstanceUID);
         emit this->retrieve->progress(0);
         continueCGETSession = !this->retrieve->wasCanceled();
-        if (this->retrieve && this->retrieve->database())
+        if (this->storageWriter)
+          {
+          this->storageWriter->addDataset(incomingObject);
+          return EC_Normal;
+          }
+        else if (this->retrieve && this->retrieve->database())
           {
           this->retrieve->database()->insert(incomingObject);
           return EC_Normal;
@@ -145,6 +350,7 @@ public:
   bool          KeepAssociationOpen;
   bool          ConnectionParamsChanged;
   bool          LastRetrieveType;
+  bool          BackgroundStorageEnabled;
   QSharedPointer<ctkDICOMDatabase> Database;
   ctkDICOMRetrieveSCUPrivate        SCU;
   QString MoveDestinationAETitle;
@@ -174,6 +380,7 @@ ctkDICOMRetrievePrivate::ctkDICOMRetrievePrivate(ctkDICOMRetrieve& obj)
   this->KeepAssociationOpen = true;
   this->ConnectionParamsChanged = false;
   this->LastRetrieveType = RetrieveNone;
+  this->BackgroundStorageEnabled = true;
 
   // Register the JPEG libraries in case we need them
   // (registration only happens once, so it's okay to call repeatedly)
@@ -411,6 +618,24 @@ bool ctkDICOMRetrievePrivate::get ( const QString& studyInstanceUID,
   emit q->progress("Found Presentation Context");
   emit q->progress(1);
 
+  // Received datasets are stored in a background thread. In-memory databases
+  // cannot be opened from another thread, therefore they are updated directly.
+  QScopedPointer<ctkDICOMRetrieveStorageWriter> storageWriter;
+  if (this->BackgroundStorageEnabled && this->Database && this->Database->isOpen() && !this->Database->isInMemory())
+    {
+    storageWriter.reset(new ctkDICOMRetrieveStorageWriter(*this->Database));
+    storageWriter->start();
+    if (storageWriter->waitForDatabase())
+      {
+      this->SCU.storageWriter = storageWriter.data();
+      }
+    else
+      {
+      logger.warn("Received datasets are inserted directly into the database");
+      storageWriter.reset();
+      }
+    }
+
   // do the actual move request
   OFCondition status = this->SCU.sendCGETRequest ( 
                           presID, retrieveParameters, &responses );
@@ -418,6 +643,29 @@ bool ctkDICOMRetrievePrivate::get ( const QString& studyInstanceUID,
   emit q->progress("Sent Get Request");
   emit q->progress(2);
 
+  if (storageWriter)
+    {
+    this->SCU.storageWriter = 0;
+    emit q->progress("Storing received datasets");
+    int storedDatasetCount = storageWriter->finish();
+    if (storedDatasetCount > 0)
+      {
+      // Data was written through a different database connection
+      this->Database->clearInMemoryTagCache();
+      // Thumbnails and notifications of the added instances, as if they were inserted directly
+      bool generateThumbnails = (this->Database->thumbnailGenerator() != 0);
+      foreach(const QString& sopInstanceUID, storageWriter->addedInstances())
+        {
+        if (generateThumbnails)
+          {
+          this->Database->generateThumbnailForInstance(sopInstanceUID);
+          }
+        emit this->Database->instanceAdded(sopInstanceUID);
+        }
+      emit this->Database->databaseChanged();
+      }
+    }
+
   // Close association if we do not want to explicitly keep it open
   if (!this->KeepAssociationOpen)
     {
@@ -648,6 +896,20 @@ bool ctkDICOMRetrieve::keepAssociationOpen()
   return d->KeepAssociationOpen;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieve::setBackgroundStorageEnabled(const bool enabled)
+{
+  Q_D(ctkDICOMRetrieve);
+  d->BackgroundStorageEnabled = enabled;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMRetrieve::isBackgroundStorageEnabled()const
+{
+  Q_D(const ctkDICOMRetrieve);
+  return d->BackgroundStorageEnabled;
+}
+
 void ctkDICOMRetrieve::setWasCanceled(const bool wasCanceled)
 {
   Q_D(ctkDICOMRetrieve);
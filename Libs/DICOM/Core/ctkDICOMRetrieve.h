@@ -45,6 +45,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMRetrieve : public QObject
   Q_PROPERTY(QString moveDestinationAETitle READ moveDestinationAETitle WRITE setMoveDestinationAETitle);
   Q_PROPERTY(bool keepAssociationOpen READ keepAssociationOpen WRITE setKeepAssociationOpen);
   Q_PROPERTY(bool wasCanceled READ wasCanceled WRITE setWasCanceled);
+  Q_PROPERTY(bool backgroundStorageEnabled READ isBackgroundStorageEnabled WRITE setBackgroundStorageEnabled);
 
 public:
   explicit ctkDICOMRetrieve(QObject* parent = 0);
@@ -74,6 +75,14 @@ public:
   /// multiple requests (default true)
   Q_INVOKABLE void setKeepAssociationOpen(const bool keepOpen);
   Q_INVOKABLE bool keepAssociationOpen();
+  /// store datasets received by get in a background thread, so that
+  /// receiving is not slowed down by writing files and database records.
+  /// Datasets are inserted into the database in batches and all of them
+  /// are stored when getSeries or getStudy returns.
+  /// Not used for in-memory databases.
+  /// (default true)
+  Q_INVOKABLE void setBackgroundStorageEnabled(const bool enabled);
+  Q_INVOKABLE bool isBackgroundStorageEnabled()const;
   /// did someone cancel us during operation?
   /// (default false)
   Q_INVOKABLE void setWasCanceled(const bool wasCanceled);
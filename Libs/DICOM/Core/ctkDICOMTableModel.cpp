@@ -0,0 +1,914 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCache>
+#include <QPair>
+#include <QPointer>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseQueryWorker_p.h"
+#include "ctkDICOMTableModel.h"
+#include "ctkLogger.h"
+
+static ctkLogger logger("org.commontk.dicom.DICOMTableModel");
+
+/// Conditions with more values are written in the query instead of
+/// being bound, to stay below the maximum number of bound parameters of SQLite
+static const int MAXIMUM_BOUND_CONDITION_VALUE_COUNT = 500;
+
+//------------------------------------------------------------------------------
+class ctkDICOMTableModelPrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMTableModel);
+
+protected:
+  ctkDICOMTableModel* const q_ptr;
+
+public:
+  ctkDICOMTableModelPrivate(ctkDICOMTableModel& obj);
+  ~ctkDICOMTableModelPrivate();
+
+  /// Convert the filter text to a LIKE pattern (with '\' escape character)
+  static QString likePattern(const QString& filterText);
+
+  QString qualifiedColumnName(int column)const;
+  /// FROM and WHERE clauses selecting the rows of the table.
+  /// Values that must be bound to the placeholders are appended to bindValues.
+  QString fromWhereClause(bool applyFilter, QVariantList& bindValues)const;
+  QString orderByClause()const;
+  /// Query counting the rows, and the rows without the filter if a filter text is set
+  QString countQuery(QVariantList& bindValues)const;
+  /// Store the result row of the count query
+  void storeCounts(const QVariantList& counts);
+  /// Count the rows in the current thread
+  bool countRows(QVariantList& counts);
+  /// Query selecting the rows of a page. The row id is appended to the columns of the table.
+  QString pageQuery(int page, QVariantList& bindValues)const;
+
+  /// Store the fetched rows of a page. Rows contain the row id as last value.
+  void storePage(int page, const QList<QVariantList>& rows, bool notify);
+  /// Fetch a page in the current thread
+  bool fetchPage(int page, bool notify);
+  /// Fetch a page in the background, or immediately if there is no worker
+  void requestPage(int page);
+  QList<QVariantList>* cachedPage(int page);
+
+  /// Create, replace or remove the worker according to the database and backgroundFetch
+  void updateWorker();
+  /// Discard all fetched and pending pages
+  void clearPages();
+
+  QPointer<ctkDICOMDatabase> Database;
+  QString TableName;
+  QHash<QString, QStringList> Conditions;
+  QHash<QString, QPair<QString, QVariantList> > SubqueryConditions;
+  QString FilterText;
+  int SortColumn;
+  Qt::SortOrder SortOrder;
+  int PageSize;
+  bool BackgroundFetch;
+
+  QStringList ColumnNames;
+  int RowCount;
+  int UnfilteredRowCount;
+  QHash<int, QHash<int, QVariant> > HorizontalHeaderData;
+
+  QCache<int, QList<QVariantList> > Pages;
+  /// Sort value and row id of the last row of the fetched full pages.
+  /// Kept when pages are removed from the cache, they are used for keyset pagination.
+  QHash<int, QPair<QVariant, QVariant> > PageLastKeys;
+  /// Pages requested to the worker
+  QSet<int> PendingPages;
+  /// Page of each request id of the worker
+  QHash<int, int> PendingPageRequests;
+  /// Request id of the count query requested to the worker, 0 if none
+  int CountRequestId;
+
+  QScopedPointer<ctkDICOMDatabaseQueryWorker> Worker;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMTableModelPrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMTableModelPrivate::ctkDICOMTableModelPrivate(ctkDICOMTableModel& obj)
+  : q_ptr(&obj)
+  , SortColumn(-1)
+  , SortOrder(Qt::AscendingOrder)
+  , PageSize(200)
+  , BackgroundFetch(true)
+  , RowCount(0)
+  , UnfilteredRowCount(0)
+  , Pages(50)
+  , CountRequestId(0)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMTableModelPrivate::~ctkDICOMTableModelPrivate()
+{
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModelPrivate::likePattern(const QString& filterText)
+{
+  QString pattern("%");
+  foreach (const QChar& character, filterText)
+  {
+    if (character == QLatin1Char('*'))
+    {
+      pattern += QLatin1Char('%');
+    }
+    else if (character == QLatin1Char('?'))
+    {
+      pattern += QLatin1Char('_');
+    }
+    else if (character == QLatin1Char('%') || character == QLatin1Char('_') || character == QLatin1Char('\\'))
+    {
+      pattern += QLatin1Char('\\');
+      pattern += character;
+    }
+    else
+    {
+      pattern += character;
+    }
+  }
+  pattern += QLatin1Char('%');
+  return pattern;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModelPrivate::qualifiedColumnName(int column)const
+{
+  return this->TableName + "." + this->ColumnNames[column];
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModelPrivate::fromWhereClause(bool applyFilter, QVariantList& bindValues)const
+{
+  QStringList conditions;
+  for (QHash<QString, QStringList>::const_iterator conditionIt = this->Conditions.constBegin();
+    conditionIt != this->Conditions.constEnd(); ++conditionIt)
+  {
+    const QStringList& values = conditionIt.value();
+    if (values.isEmpty())
+    {
+      continue;
+    }
+    QStringList valueStrings;
+    if (values.size() <= MAXIMUM_BOUND_CONDITION_VALUE_COUNT)
+    {
+      foreach (const QString& value, values)
+      {
+        valueStrings << "?";
+        bindValues << value;
+      }
+    }
+    else
+    {
+      foreach (QString value, values)
+      {
+        valueStrings << "'" + value.replace("'", "''") + "'";
+      }
+    }
+    conditions << QString("%1 IN (%2)").arg(conditionIt.key()).arg(valueStrings.join(", "));
+  }
+  for (QHash<QString, QPair<QString, QVariantList> >::const_iterator conditionIt = this->SubqueryConditions.constBegin();
+    conditionIt != this->SubqueryConditions.constEnd(); ++conditionIt)
+  {
+    if (conditionIt.value().first.isEmpty())
+    {
+      continue;
+    }
+    conditions << QString("%1 IN (%2)").arg(conditionIt.key()).arg(conditionIt.value().first);
+    bindValues << conditionIt.value().second;
+  }
+
+  QStringList whereConditions;
+  QStringList joinedTables;
+  joinedTables << "Patients" << "Studies" << "Series";
+  if (joinedTables.removeAll(this->TableName) > 0)
+  {
+    // Only include rows that have at least one series. Conditions may refer to any of the tables.
+    // EXISTS is used instead of SELECT DISTINCT on a join so that indexes of the table can be used for sorting.
+    QStringList existsConditions;
+    existsConditions << "Patients.UID = Studies.PatientsUID"
+      << "Studies.StudyInstanceUID = Series.StudyInstanceUID";
+    existsConditions << conditions;
+    whereConditions << QString("EXISTS (SELECT 1 FROM %1 WHERE %2)")
+      .arg(joinedTables.join(", ")).arg(existsConditions.join(" AND "));
+  }
+  else
+  {
+    whereConditions << conditions;
+  }
+
+  if (applyFilter && !this->FilterText.isEmpty() && !this->ColumnNames.isEmpty())
+  {
+    QString pattern = ctkDICOMTableModelPrivate::likePattern(this->FilterText);
+    QStringList filterConditions;
+    for (int column = 0; column < this->ColumnNames.size(); ++column)
+    {
+      filterConditions << this->qualifiedColumnName(column) + " LIKE ? ESCAPE '\\'";
+      bindValues << pattern;
+    }
+    whereConditions << "(" + filterConditions.join(" OR ") + ")";
+  }
+
+  if (whereConditions.isEmpty())
+  {
+    whereConditions << "1";
+  }
+  return QString("FROM %1 WHERE %2").arg(this->TableName).arg(whereConditions.join(" AND "));
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModelPrivate::orderByClause()const
+{
+  QString order = (this->SortOrder == Qt::AscendingOrder ? "ASC" : "DESC");
+  if (this->SortColumn < 0 || this->SortColumn >= this->ColumnNames.size())
+  {
+    return QString("ORDER BY %1.rowid").arg(this->TableName);
+  }
+  return QString("ORDER BY %1 %2, %3.rowid %2")
+    .arg(this->qualifiedColumnName(this->SortColumn)).arg(order).arg(this->TableName);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModelPrivate::countQuery(QVariantList& bindValues)const
+{
+  if (this->FilterText.isEmpty())
+  {
+    return "SELECT COUNT(*) " + this->fromWhereClause(true, bindValues);
+  }
+  QString filteredCount = "SELECT COUNT(*) " + this->fromWhereClause(true, bindValues);
+  QString unfilteredCount = "SELECT COUNT(*) " + this->fromWhereClause(false, bindValues);
+  return QString("SELECT (%1), (%2)").arg(filteredCount).arg(unfilteredCount);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModelPrivate::storeCounts(const QVariantList& counts)
+{
+  this->RowCount = counts.value(0).toInt();
+  this->UnfilteredRowCount = (counts.size() > 1 ? counts.value(1).toInt() : this->RowCount);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableModelPrivate::countRows(QVariantList& counts)
+{
+  QVariantList bindValues;
+  QSqlQuery query(this->Database->database());
+  query.prepare(this->countQuery(bindValues));
+  foreach (const QVariant& bindValue, bindValues)
+  {
+    query.addBindValue(bindValue);
+  }
+  if (!query.exec() || !query.next())
+  {
+    logger.error(QString("Failed to count rows of %1: %2")
+      .arg(this->TableName).arg(query.lastError().text()));
+    return false;
+  }
+  for (int column = 0; column < query.record().count(); ++column)
+  {
+    counts << query.value(column);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModelPrivate::pageQuery(int page, QVariantList& bindValues)const
+{
+  QString query = QString("SELECT %1.*, %1.rowid ").arg(this->TableName)
+    + this->fromWhereClause(true, bindValues);
+
+  QHash<int, QPair<QVariant, QVariant> >::const_iterator previousPageLastKeyIt = this->PageLastKeys.constFind(page - 1);
+  if (page > 0 && previousPageLastKeyIt != this->PageLastKeys.constEnd())
+  {
+    // Keyset pagination: select the rows that follow the last row of the previous page
+    // in the (sort value, row id) order. NULL values come first in ascending order.
+    QString rowId = this->TableName + ".rowid";
+    const QVariant& lastValue = previousPageLastKeyIt.value().first;
+    const QVariant& lastRowId = previousPageLastKeyIt.value().second;
+    if (this->SortColumn < 0 || this->SortColumn >= this->ColumnNames.size())
+    {
+      query += QString(" AND %1 > ?").arg(rowId);
+      bindValues << lastRowId;
+    }
+    else
+    {
+      QString column = this->qualifiedColumnName(this->SortColumn);
+      bool ascending = (this->SortOrder == Qt::AscendingOrder);
+      QString comparison = (ascending ? ">" : "<");
+      if (lastValue.isNull())
+      {
+        query += QString(ascending ? " AND ((%1 IS NULL AND %2 %3 ?) OR %1 IS NOT NULL)" : " AND (%1 IS NULL AND %2 %3 ?)")
+          .arg(column).arg(rowId).arg(comparison);
+        bindValues << lastRowId;
+      }
+      else
+      {
+        query += QString(ascending ? " AND (%1 %3 ? OR (%1 = ? AND %2 %3 ?))" : " AND (%1 %3 ? OR (%1 = ? AND %2 %3 ?) OR %1 IS NULL)")
+          .arg(column).arg(rowId).arg(comparison);
+        bindValues << lastValue << lastValue << lastRowId;
+      }
+    }
+    query += " " + this->orderByClause() + " LIMIT ?";
+    bindValues << this->PageSize;
+  }
+  else
+  {
+    query += " " + this->orderByClause() + " LIMIT ? OFFSET ?";
+    bindValues << this->PageSize << page * this->PageSize;
+  }
+  return query;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModelPrivate::storePage(int page, const QList<QVariantList>& rows, bool notify)
+{
+  Q_Q(ctkDICOMTableModel);
+  if (rows.size() == this->PageSize)
+  {
+    const QVariantList& lastRow = rows.last();
+    QVariant lastValue;
+    if (this->SortColumn >= 0 && this->SortColumn < this->ColumnNames.size())
+    {
+      lastValue = lastRow.value(this->SortColumn);
+    }
+    this->PageLastKeys[page] = qMakePair(lastValue, lastRow.last());
+  }
+
+  QList<QVariantList>* pageRows = new QList<QVariantList>;
+  foreach (QVariantList row, rows)
+  {
+    // remove row id
+    row.removeLast();
+    pageRows->append(row);
+  }
+  this->Pages.insert(page, pageRows);
+  this->PendingPages.remove(page);
+
+  int firstRow = page * this->PageSize;
+  int lastRow = qMin(firstRow + this->PageSize, this->RowCount) - 1;
+  if (notify && firstRow <= lastRow && !this->ColumnNames.isEmpty())
+  {
+    emit q->dataChanged(q->index(firstRow, 0), q->index(lastRow, this->ColumnNames.size() - 1));
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableModelPrivate::fetchPage(int page, bool notify)
+{
+  if (!this->Database || !this->Database->isOpen())
+  {
+    return false;
+  }
+  QVariantList bindValues;
+  QString queryString = this->pageQuery(page, bindValues);
+  QSqlQuery query(this->Database->database());
+  query.setForwardOnly(true);
+  query.prepare(queryString);
+  foreach (const QVariant& bindValue, bindValues)
+  {
+    query.addBindValue(bindValue);
+  }
+  if (!query.exec())
+  {
+    logger.error(QString("Failed to fetch page %1 of %2: %3")
+      .arg(page).arg(this->TableName).arg(query.lastError().text()));
+    return false;
+  }
+  // columns of the table and the row id
+  int columnCount = this->ColumnNames.size() + 1;
+  QList<QVariantList> rows;
+  while (query.next())
+  {
+    QVariantList row;
+    for (int column = 0; column < columnCount; ++column)
+    {
+      row << query.value(column);
+    }
+    rows << row;
+  }
+  this->storePage(page, rows, notify);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModelPrivate::requestPage(int page)
+{
+  if (this->PendingPages.contains(page))
+  {
+    return;
+  }
+  if (!this->Worker)
+  {
+    // data() must not emit dataChanged
+    this->fetchPage(page, false);
+    return;
+  }
+  QVariantList bindValues;
+  QString queryString = this->pageQuery(page, bindValues);
+  int requestId = this->Worker->execute(queryString, bindValues);
+  this->PendingPageRequests[requestId] = page;
+  this->PendingPages.insert(page);
+}
+
+//------------------------------------------------------------------------------
+QList<QVariantList>* ctkDICOMTableModelPrivate::cachedPage(int page)
+{
+  return this->Pages.object(page);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModelPrivate::updateWorker()
+{
+  Q_Q(ctkDICOMTableModel);
+  QString databaseFilename;
+  if (this->BackgroundFetch && this->Database && this->Database->isOpen() && !this->Database->isInMemory())
+  {
+    databaseFilename = this->Database->databaseFilename();
+  }
+  if (databaseFilename.isEmpty())
+  {
+    this->Worker.reset();
+    return;
+  }
+  if (this->Worker && this->Worker->databaseFilename() == databaseFilename)
+  {
+    return;
+  }
+  this->Worker.reset(new ctkDICOMDatabaseQueryWorker(databaseFilename));
+  QObject::connect(this->Worker.data(), SIGNAL(executed(int,bool,QVariantList)),
+    q, SLOT(onQueryExecuted(int,bool,QVariantList)));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModelPrivate::clearPages()
+{
+  if (this->Worker)
+  {
+    this->Worker->cancel();
+  }
+  this->Pages.clear();
+  this->PageLastKeys.clear();
+  this->PendingPages.clear();
+  this->PendingPageRequests.clear();
+  this->CountRequestId = 0;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMTableModel methods
+
+//------------------------------------------------------------------------------
+ctkDICOMTableModel::ctkDICOMTableModel(QObject* parent)
+  : Superclass(parent)
+  , d_ptr(new ctkDICOMTableModelPrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMTableModel::~ctkDICOMTableModel()
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setDatabase(ctkDICOMDatabase* database)
+{
+  Q_D(ctkDICOMTableModel);
+  d->Database = database;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase* ctkDICOMTableModel::database()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->Database;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setTableName(const QString& tableName)
+{
+  Q_D(ctkDICOMTableModel);
+  d->TableName = tableName;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModel::tableName()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->TableName;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setConditions(const QHash<QString, QStringList>& conditions)
+{
+  Q_D(ctkDICOMTableModel);
+  d->Conditions = conditions;
+}
+
+//------------------------------------------------------------------------------
+QHash<QString, QStringList> ctkDICOMTableModel::conditions()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->Conditions;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setSubqueryConditions(const QHash<QString, QPair<QString, QVariantList> >& conditions)
+{
+  Q_D(ctkDICOMTableModel);
+  d->SubqueryConditions = conditions;
+}
+
+//------------------------------------------------------------------------------
+QHash<QString, QPair<QString, QVariantList> > ctkDICOMTableModel::subqueryConditions()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->SubqueryConditions;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setFilterText(const QString& filterText)
+{
+  Q_D(ctkDICOMTableModel);
+  d->FilterText = filterText;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModel::filterText()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->FilterText;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setPageSize(int rowCount)
+{
+  Q_D(ctkDICOMTableModel);
+  rowCount = qMax(1, rowCount);
+  if (rowCount == d->PageSize)
+  {
+    return;
+  }
+  d->PageSize = rowCount;
+  d->clearPages();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTableModel::pageSize()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->PageSize;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setMaximumCachedPageCount(int pageCount)
+{
+  Q_D(ctkDICOMTableModel);
+  d->Pages.setMaxCost(qMax(1, pageCount));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTableModel::maximumCachedPageCount()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->Pages.maxCost();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::setBackgroundFetch(bool enable)
+{
+  Q_D(ctkDICOMTableModel);
+  if (enable == d->BackgroundFetch)
+  {
+    return;
+  }
+  d->BackgroundFetch = enable;
+  d->clearPages();
+  d->updateWorker();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableModel::backgroundFetch()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->BackgroundFetch;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableModel::select()
+{
+  Q_D(ctkDICOMTableModel);
+  this->beginResetModel();
+  d->clearPages();
+  d->RowCount = 0;
+  d->UnfilteredRowCount = 0;
+
+  bool success = true;
+  if (d->Database && d->Database->isOpen() && !d->TableName.isEmpty())
+  {
+    QSqlDatabase database = d->Database->database();
+    QSqlRecord tableRecord = database.record(d->TableName);
+    QStringList columnNames;
+    for (int column = 0; column < tableRecord.count(); ++column)
+    {
+      columnNames << tableRecord.fieldName(column);
+    }
+    if (columnNames != d->ColumnNames)
+    {
+      d->ColumnNames = columnNames;
+      d->HorizontalHeaderData.clear();
+    }
+
+    d->updateWorker();
+    if (d->Worker)
+    {
+      // Rows are inserted when they are counted. The first page is requested
+      // right away, so that it is usually available by then.
+      QVariantList bindValues;
+      d->CountRequestId = d->Worker->execute(d->countQuery(bindValues), bindValues);
+      d->requestPage(0);
+    }
+    else
+    {
+      QVariantList counts;
+      success = d->countRows(counts);
+      d->storeCounts(counts);
+      if (d->RowCount > 0)
+      {
+        success = d->fetchPage(0, false) && success;
+      }
+    }
+  }
+  else
+  {
+    d->ColumnNames.clear();
+    d->HorizontalHeaderData.clear();
+    d->Worker.reset();
+  }
+
+  this->endResetModel();
+  if (!d->CountRequestId)
+  {
+    emit rowCountChanged(d->RowCount);
+  }
+  return success;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::clear()
+{
+  Q_D(ctkDICOMTableModel);
+  this->beginResetModel();
+  d->clearPages();
+  d->RowCount = 0;
+  d->ColumnNames.clear();
+  d->HorizontalHeaderData.clear();
+  this->endResetModel();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTableModel::unfilteredRowCount()const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->UnfilteredRowCount;
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMTableModel::columnValues(int column)const
+{
+  Q_D(const ctkDICOMTableModel);
+  QStringList values;
+  if (column < 0 || column >= d->ColumnNames.size() || d->RowCount == 0
+    || !d->Database || !d->Database->isOpen())
+  {
+    return values;
+  }
+  QVariantList bindValues;
+  QString queryString = this->columnValuesQuery(column, bindValues) + " " + d->orderByClause();
+  QSqlQuery query(d->Database->database());
+  query.setForwardOnly(true);
+  query.prepare(queryString);
+  foreach (const QVariant& bindValue, bindValues)
+  {
+    query.addBindValue(bindValue);
+  }
+  if (!query.exec())
+  {
+    logger.error(QString("Failed to get column values of %1: %2")
+      .arg(d->TableName).arg(query.lastError().text()));
+    return values;
+  }
+  while (query.next())
+  {
+    values << query.value(0).toString();
+  }
+  return values;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMTableModel::columnValuesQuery(int column, QVariantList& bindValues)const
+{
+  Q_D(const ctkDICOMTableModel);
+  if (column < 0 || column >= d->ColumnNames.size())
+  {
+    return QString();
+  }
+  return QString("SELECT %1 ").arg(d->qualifiedColumnName(column)) + d->fromWhereClause(true, bindValues);
+}
+
+//------------------------------------------------------------------------------
+QVariant ctkDICOMTableModel::value(int row, int column)const
+{
+  Q_D(const ctkDICOMTableModel);
+  if (row < 0 || row >= d->RowCount || column < 0 || column >= d->ColumnNames.size())
+  {
+    return QVariant();
+  }
+  ctkDICOMTableModelPrivate* mutableD = const_cast<ctkDICOMTableModelPrivate*>(d);
+  int page = row / d->PageSize;
+  QList<QVariantList>* rows = mutableD->cachedPage(page);
+  if (!rows)
+  {
+    mutableD->fetchPage(page, false);
+    rows = mutableD->cachedPage(page);
+  }
+  int pageRow = row % d->PageSize;
+  if (!rows || pageRow >= rows->size())
+  {
+    return QVariant();
+  }
+  return rows->at(pageRow).value(column);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableModel::isRowFetched(int row)const
+{
+  Q_D(const ctkDICOMTableModel);
+  return d->Pages.contains(row / d->PageSize);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTableModel::rowCount(const QModelIndex& parent)const
+{
+  Q_D(const ctkDICOMTableModel);
+  return parent.isValid() ? 0 : d->RowCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTableModel::columnCount(const QModelIndex& parent)const
+{
+  Q_D(const ctkDICOMTableModel);
+  return parent.isValid() ? 0 : d->ColumnNames.size();
+}
+
+//------------------------------------------------------------------------------
+QVariant ctkDICOMTableModel::data(const QModelIndex& index, int role)const
+{
+  Q_D(const ctkDICOMTableModel);
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)
+    || index.row() >= d->RowCount || index.column() >= d->ColumnNames.size())
+  {
+    return QVariant();
+  }
+  ctkDICOMTableModelPrivate* mutableD = const_cast<ctkDICOMTableModelPrivate*>(d);
+  int page = index.row() / d->PageSize;
+  QList<QVariantList>* rows = mutableD->cachedPage(page);
+  if (!rows)
+  {
+    mutableD->requestPage(page);
+    // available if the page was fetched immediately
+    rows = mutableD->cachedPage(page);
+  }
+  int pageRow = index.row() % d->PageSize;
+  if (!rows || pageRow >= rows->size())
+  {
+    return QVariant();
+  }
+  return rows->at(pageRow).value(index.column());
+}
+
+//------------------------------------------------------------------------------
+QVariant ctkDICOMTableModel::headerData(int section, Qt::Orientation orientation, int role)const
+{
+  Q_D(const ctkDICOMTableModel);
+  if (orientation == Qt::Horizontal && section >= 0 && section < d->ColumnNames.size())
+  {
+    if (role == Qt::EditRole)
+    {
+      role = Qt::DisplayRole;
+    }
+    QHash<int, QHash<int, QVariant> >::const_iterator sectionIt = d->HorizontalHeaderData.constFind(section);
+    if (sectionIt != d->HorizontalHeaderData.constEnd() && sectionIt.value().contains(role))
+    {
+      return sectionIt.value().value(role);
+    }
+    if (role == Qt::DisplayRole)
+    {
+      return d->ColumnNames[section];
+    }
+  }
+  return this->Superclass::headerData(section, orientation, role);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableModel::setHeaderData(int section, Qt::Orientation orientation, const QVariant& value, int role)
+{
+  Q_D(ctkDICOMTableModel);
+  if (orientation != Qt::Horizontal || section < 0 || section >= d->ColumnNames.size())
+  {
+    return false;
+  }
+  if (role == Qt::EditRole)
+  {
+    role = Qt::DisplayRole;
+  }
+  d->HorizontalHeaderData[section][role] = value;
+  emit headerDataChanged(orientation, section, section);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::sort(int column, Qt::SortOrder order)
+{
+  Q_D(ctkDICOMTableModel);
+  d->SortColumn = column;
+  d->SortOrder = order;
+  this->select();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableModel::onQueryExecuted(int requestId, bool success, const QVariantList& rows)
+{
+  Q_D(ctkDICOMTableModel);
+  if (requestId == d->CountRequestId)
+  {
+    d->CountRequestId = 0;
+    QVariantList counts;
+    if (success && !rows.isEmpty())
+    {
+      counts = rows.first().toList();
+    }
+    else if (d->Database && d->Database->isOpen())
+    {
+      // the background connection may fail (e.g., database locked), retry in the main thread
+      d->countRows(counts);
+    }
+    int rowCount = counts.value(0).toInt();
+    if (rowCount > 0)
+    {
+      this->beginInsertRows(QModelIndex(), 0, rowCount - 1);
+    }
+    d->storeCounts(counts);
+    if (rowCount > 0)
+    {
+      this->endInsertRows();
+    }
+    emit rowCountChanged(d->RowCount);
+    return;
+  }
+  if (!d->PendingPageRequests.contains(requestId))
+  {
+    return;
+  }
+  int page = d->PendingPageRequests.take(requestId);
+  if (!success)
+  {
+    // the background connection may fail (e.g., database locked), retry in the main thread
+    d->PendingPages.remove(page);
+    d->fetchPage(page, true);
+    return;
+  }
+  QList<QVariantList> pageRows;
+  foreach (const QVariant& row, rows)
+  {
+    pageRows << row.toList();
+  }
+  d->storePage(page, pageRows, true);
+}
@@ -0,0 +1,157 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMTableModel_h
+#define __ctkDICOMTableModel_h
+
+// Qt includes
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QPair>
+#include <QStringList>
+#include <QVariant>
+
+#include "ctkDICOMCoreExport.h"
+
+class ctkDICOMDatabase;
+class ctkDICOMTableModelPrivate;
+
+/// \ingroup DICOM_Core
+///
+/// \brief Lazy table model of the Patients, Studies or Series table of a ctkDICOMDatabase
+///
+/// Filtering, sorting and counting of the rows are done by SQL queries, so the
+/// model never holds all the rows of the table. Rows are fetched in pages when
+/// they are displayed, using keyset pagination when the previous page is known
+/// (the sort value and row id of the last row of a page are used for selecting
+/// the next page instead of an offset). Only the most recently used pages are
+/// kept in memory.
+///
+/// If backgroundFetch is enabled and the database is stored in a file then
+/// the rows are counted and the pages are fetched by a read-only connection in
+/// a background thread: select() returns with no rows, the rows are inserted
+/// and rowCountChanged() is emitted when they are counted, data() returns an
+/// invalid value for the rows that are not fetched yet and dataChanged() is
+/// emitted when they arrive. Otherwise select() counts the rows and fetches
+/// the first page immediately.
+///
+/// Only rows that have at least one series are included, as in ctkDICOMTableView.
+/// The model is read-only. Parameters are applied when select() is called.
+class CTK_DICOM_CORE_EXPORT ctkDICOMTableModel : public QAbstractTableModel
+{
+  Q_OBJECT
+  Q_PROPERTY(QString tableName READ tableName WRITE setTableName)
+  Q_PROPERTY(QString filterText READ filterText WRITE setFilterText)
+  Q_PROPERTY(int pageSize READ pageSize WRITE setPageSize)
+  Q_PROPERTY(int maximumCachedPageCount READ maximumCachedPageCount WRITE setMaximumCachedPageCount)
+  Q_PROPERTY(bool backgroundFetch READ backgroundFetch WRITE setBackgroundFetch)
+
+public:
+  typedef QAbstractTableModel Superclass;
+  explicit ctkDICOMTableModel(QObject* parent = 0);
+  virtual ~ctkDICOMTableModel();
+
+  void setDatabase(ctkDICOMDatabase* database);
+  ctkDICOMDatabase* database()const;
+
+  /// Name of the displayed table: Patients, Studies or Series
+  void setTableName(const QString& tableName);
+  QString tableName()const;
+
+  /// Only rows that match all the conditions are included.
+  /// Keys are column names (qualified with the Patients, Studies or Series table name),
+  /// values are the list of accepted values. Conditions with an empty list are ignored.
+  void setConditions(const QHash<QString, QStringList>& conditions);
+  QHash<QString, QStringList> conditions()const;
+
+  /// Only rows whose column value is returned by a subquery are included.
+  /// Keys are column names (as in conditions), values are a query selecting a
+  /// single column (see columnValuesQuery()) and the values bound to its placeholders.
+  void setSubqueryConditions(const QHash<QString, QPair<QString, QVariantList> >& conditions);
+  QHash<QString, QPair<QString, QVariantList> > subqueryConditions()const;
+
+  /// Only rows that contain the filter text in any of their columns are included.
+  /// Case insensitive, '*' and '?' wildcards can be used.
+  void setFilterText(const QString& filterText);
+  QString filterText()const;
+
+  /// Number of rows fetched by a query. Default is 200.
+  void setPageSize(int rowCount);
+  int pageSize()const;
+
+  /// Maximum number of pages kept in memory. Default is 50.
+  void setMaximumCachedPageCount(int pageCount);
+  int maximumCachedPageCount()const;
+
+  /// Fetch the pages in a background thread. Enabled by default.
+  /// Pages of in-memory databases are always fetched in the main thread.
+  void setBackgroundFetch(bool enable);
+  bool backgroundFetch()const;
+
+  /// Count the rows and fetch the first page with the current parameters.
+  /// Counting and fetching are done in the background if backgroundFetch is enabled.
+  Q_INVOKABLE bool select();
+  /// Remove all rows
+  Q_INVOKABLE void clear();
+
+  /// Number of rows that match the conditions, ignoring the filter text.
+  /// Counted together with the rows by select().
+  Q_INVOKABLE int unfilteredRowCount()const;
+
+  /// Values of a column in all the rows, in the current sort order.
+  /// Retrieved by a single query, without fetching the pages.
+  Q_INVOKABLE QStringList columnValues(int column)const;
+
+  /// Query selecting the values of a column in all the rows (not sorted),
+  /// with the current conditions and filter text. Values that must be bound to
+  /// the placeholders of the query are appended to bindValues.
+  /// It can be used as a subquery condition of another model.
+  QString columnValuesQuery(int column, QVariantList& bindValues)const;
+
+  /// Value of a cell. The page of the row is fetched immediately if needed.
+  Q_INVOKABLE QVariant value(int row, int column)const;
+
+  /// Return true if the page containing the row is fetched
+  Q_INVOKABLE bool isRowFetched(int row)const;
+
+  virtual int rowCount(const QModelIndex& parent = QModelIndex())const;
+  virtual int columnCount(const QModelIndex& parent = QModelIndex())const;
+  virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole)const;
+  virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole)const;
+  virtual bool setHeaderData(int section, Qt::Orientation orientation, const QVariant& value, int role = Qt::EditRole);
+  /// Sorting is done by the database, the first page is fetched again
+  virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+Q_SIGNALS:
+  /// Emitted when the rows selected by select() are counted
+  void rowCountChanged(int rowCount);
+
+protected Q_SLOTS:
+  void onQueryExecuted(int requestId, bool success, const QVariantList& rows);
+
+protected:
+  QScopedPointer<ctkDICOMTableModelPrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMTableModel);
+  Q_DISABLE_COPY(ctkDICOMTableModel);
+};
+
+#endif
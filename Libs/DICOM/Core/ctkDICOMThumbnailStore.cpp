@@ -0,0 +1,1110 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QtEndian>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 1, 0))
+#define HAVE_QT_QSAVEFILE
+#include <QSaveFile>
+#endif
+
+// ctkDICOMCore includes
+#include "ctkDICOMThumbnailStore.h"
+#include "ctkLogger.h"
+
+// STD includes
+#include <cstdio>
+#include <cstring>
+
+static ctkLogger logger("org.commontk.dicom.DICOMThumbnailStore");
+
+// Series file: magic, version (32-bit), then the tile records
+static const char SERIES_FILE_MAGIC[] = "CTKTHUMB";
+static const int SERIES_FILE_MAGIC_SIZE = 8;
+static const quint32 SERIES_FILE_VERSION = 1;
+static const int SERIES_FILE_HEADER_SIZE = 12;
+static const char SERIES_FILE_SUFFIX[] = ".thumbs";
+
+// Tile record: magic (32-bit), UID size (16-bit), format (8-bit), flags (8-bit),
+// width (16-bit), height (16-bit), time (64-bit), data size (32-bit), UID, data.
+// All values are little endian. A record without data (invalid format) removes
+// the thumbnail of the instance.
+static const quint32 TILE_RECORD_MAGIC = 0x454c4954; // "TILE"
+static const int TILE_RECORD_HEADER_SIZE = 24;
+static const quint8 TILE_COMPRESSED_FLAG = 0x1;
+
+// Series files are compacted when outdated records take more space than this
+// and more than the thumbnails themselves.
+static const qint64 MINIMUM_STALE_BYTES_TO_COMPACT = 1024 * 1024;
+
+//------------------------------------------------------------------------------
+struct ctkDICOMThumbnailStoreTile
+{
+  qint64 RecordOffset;
+  qint64 RecordSize;
+  qint64 DataOffset;
+  quint32 DataSize;
+  quint8 Format;
+  bool Compressed;
+  int Width;
+  int Height;
+  qint64 Time;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMThumbnailStoreSeriesFile
+{
+public:
+  ctkDICOMThumbnailStoreSeriesFile(const QString& path)
+    : File(path)
+    , Map(0)
+    , ValidSize(0)
+    , StaleBytes(0)
+    , LiveBytes(0)
+    , FileSize(0)
+  {
+  }
+
+  ~ctkDICOMThumbnailStoreSeriesFile()
+  {
+    this->close();
+  }
+
+  void unmap()
+  {
+    if (this->Map)
+    {
+      this->File.unmap(this->Map);
+      this->Map = 0;
+    }
+  }
+
+  void close()
+  {
+    this->unmap();
+    this->File.close();
+    this->Tiles.clear();
+    this->ValidSize = 0;
+    this->StaleBytes = 0;
+    this->LiveBytes = 0;
+    this->FileSize = 0;
+    this->LastModified = QDateTime();
+  }
+
+  QFile File;
+  uchar* Map;
+  /// Size of the file up to the end of the last complete record
+  qint64 ValidSize;
+  /// Current thumbnail of each instance
+  QHash<QString, ctkDICOMThumbnailStoreTile> Tiles;
+  /// Size of the records that were replaced or removed
+  qint64 StaleBytes;
+  /// Size of the current records
+  qint64 LiveBytes;
+  /// Size and modification time of the file at its path when it was last read or written,
+  /// they change when another store appends to the file or replaces it by compacting it.
+  qint64 FileSize;
+  QDateTime LastModified;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMThumbnailStorePrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMThumbnailStore);
+
+protected:
+  ctkDICOMThumbnailStore* const q_ptr;
+
+public:
+  ctkDICOMThumbnailStorePrivate(ctkDICOMThumbnailStore& obj);
+
+  /// Return the series file to write in, opened and indexed up to date.
+  /// Thumbnails of the former layout are moved into the series file if their file names are
+  /// the instance UIDs (see UseShortStoragePath), migratedCount is incremented by their number.
+  /// Returns 0 if the file does not exist and create is false.
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile(const QString& studyInstanceUID,
+    const QString& seriesInstanceUID, bool create, int* migratedCount = 0);
+  /// Return the series file to read from, opened and indexed, or 0 if it does not exist.
+  /// Thumbnails of the former layout are not migrated, see legacyThumbnailFile().
+  ctkDICOMThumbnailStoreSeriesFile* existingSeriesFile(const QString& studyInstanceUID,
+    const QString& seriesInstanceUID);
+  bool openSeriesFile(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  bool readIndex(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  /// Remember the size and modification time of the file at its path
+  void updateFileInfo(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  /// Open the file and read the index again if another store modified or replaced it.
+  /// Returns false if the file was removed, the series file is then deleted.
+  bool refreshIndex(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  const uchar* mappedData(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  bool appendRecord(ctkDICOMThumbnailStoreSeriesFile* seriesFile, const QString& sopInstanceUID,
+    quint8 format, quint8 flags, int width, int height, qint64 time, const QByteArray& data);
+  bool compact(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  void compactIfNeeded(ctkDICOMThumbnailStoreSeriesFile* seriesFile);
+  /// Move the thumbnail files of the former layout of the listed instances into the series file
+  int migrateThumbnailFiles(ctkDICOMThumbnailStoreSeriesFile* seriesFile,
+    const QString& studyInstanceUID, const QString& seriesInstanceUID, const QStringList& sopInstanceUIDs);
+  /// Instances of the thumbnail files of the former layout of a series, only known if
+  /// the file names are the instance UIDs.
+  QStringList legacyInstanceUIDs(const QString& studyInstanceUID, const QString& seriesInstanceUID)const;
+  bool removeSeriesFile(const QString& studyInstanceUID, const QString& seriesInstanceUID);
+
+  /// Thumbnail files of the former layout are stored in the same folders as the DICOM files
+  /// of the database, see ctkDICOMDatabase::setUseShortStoragePath().
+  static QString legacyPathComponent(const QString& uid, bool useShortStoragePath, int shortLength);
+  QString legacyStudyDirectory(const QString& studyInstanceUID)const;
+  QString legacySeriesDirectory(const QString& studyInstanceUID, const QString& seriesInstanceUID)const;
+  /// Thumbnail file of the former layout, which is read as is until it is migrated
+  QFileInfo legacyThumbnailFile(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QString& sopInstanceUID)const;
+  /// Read the image size from the IHDR chunk of a PNG file
+  static bool pngSize(const QByteArray& png, int* width, int* height);
+  QString seriesFilePath(const QString& studyInstanceUID, const QString& seriesInstanceUID)const;
+
+  QString Directory;
+  int CompressionLevel;
+  bool UseShortStoragePath;
+  mutable QMutex Mutex;
+  QCache<QString, ctkDICOMThumbnailStoreSeriesFile> OpenSeriesFiles;
+};
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailStorePrivate::ctkDICOMThumbnailStorePrivate(ctkDICOMThumbnailStore& obj)
+  : q_ptr(&obj)
+  , CompressionLevel(1)
+  , UseShortStoragePath(true)
+  , OpenSeriesFiles(32)
+{
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailStorePrivate::legacyPathComponent(const QString& uid, bool useShortStoragePath, int shortLength)
+{
+  if (!useShortStoragePath)
+  {
+    return uid;
+  }
+  // same hash as ctkDICOMDatabasePrivate::internalStoragePath
+  return QString(QCryptographicHash::hash(uid.toUtf8(), QCryptographicHash::Md5).toHex()).left(shortLength);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailStorePrivate::legacyStudyDirectory(const QString& studyInstanceUID)const
+{
+  return this->Directory + "/" + legacyPathComponent(studyInstanceUID, this->UseShortStoragePath, 8);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailStorePrivate::legacySeriesDirectory(
+  const QString& studyInstanceUID, const QString& seriesInstanceUID)const
+{
+  return this->legacyStudyDirectory(studyInstanceUID) + "/"
+    + legacyPathComponent(seriesInstanceUID, this->UseShortStoragePath, 8);
+}
+
+//------------------------------------------------------------------------------
+QFileInfo ctkDICOMThumbnailStorePrivate::legacyThumbnailFile(const QString& studyInstanceUID,
+  const QString& seriesInstanceUID, const QString& sopInstanceUID)const
+{
+  return QFileInfo(this->legacySeriesDirectory(studyInstanceUID, seriesInstanceUID) + "/"
+    + legacyPathComponent(sopInstanceUID, this->UseShortStoragePath, -1) + ".png");
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMThumbnailStorePrivate::legacyInstanceUIDs(
+  const QString& studyInstanceUID, const QString& seriesInstanceUID)const
+{
+  QStringList sopInstanceUIDs;
+  if (this->UseShortStoragePath)
+  {
+    // file names are hashes of the UIDs
+    return sopInstanceUIDs;
+  }
+  QDir legacyDirectory(this->legacySeriesDirectory(studyInstanceUID, seriesInstanceUID));
+  foreach(const QFileInfo& fileInfo, legacyDirectory.entryInfoList(QStringList() << "*.png", QDir::Files))
+  {
+    sopInstanceUIDs << fileInfo.completeBaseName();
+  }
+  return sopInstanceUIDs;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::pngSize(const QByteArray& png, int* width, int* height)
+{
+  // The IHDR chunk follows the 8 bytes signature
+  if (png.size() < 24 || !png.startsWith("\x89PNG") || png.mid(12, 4) != "IHDR")
+  {
+    return false;
+  }
+  const uchar* ihdr = reinterpret_cast<const uchar*>(png.constData()) + 16;
+  *width = static_cast<int>(qFromBigEndian<quint32>(ihdr));
+  *height = static_cast<int>(qFromBigEndian<quint32>(ihdr + 4));
+  return true;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailStorePrivate::seriesFilePath(
+  const QString& studyInstanceUID, const QString& seriesInstanceUID)const
+{
+  return this->Directory + "/" + studyInstanceUID + "/" + seriesInstanceUID + SERIES_FILE_SUFFIX;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailStoreSeriesFile* ctkDICOMThumbnailStorePrivate::seriesFile(
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, bool create, int* migratedCount)
+{
+  if (this->Directory.isEmpty() || studyInstanceUID.isEmpty() || seriesInstanceUID.isEmpty())
+  {
+    return 0;
+  }
+  QStringList legacySOPInstanceUIDs = this->legacyInstanceUIDs(studyInstanceUID, seriesInstanceUID);
+  bool hasLegacyThumbnails = !legacySOPInstanceUIDs.isEmpty();
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = this->existingSeriesFile(studyInstanceUID, seriesInstanceUID);
+  // Records appended by other stores must be indexed before appending
+  if (seriesFile && !this->refreshIndex(seriesFile))
+  {
+    seriesFile = 0;
+  }
+  if (!seriesFile)
+  {
+    if (!create && !hasLegacyThumbnails)
+    {
+      return 0;
+    }
+    QString path = this->seriesFilePath(studyInstanceUID, seriesInstanceUID);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    seriesFile = new ctkDICOMThumbnailStoreSeriesFile(path);
+    if (!this->openSeriesFile(seriesFile))
+    {
+      delete seriesFile;
+      return 0;
+    }
+    this->OpenSeriesFiles.insert(path, seriesFile);
+  }
+  if (hasLegacyThumbnails)
+  {
+    int migrated = this->migrateThumbnailFiles(seriesFile, studyInstanceUID, seriesInstanceUID, legacySOPInstanceUIDs);
+    if (migratedCount)
+    {
+      *migratedCount += migrated;
+    }
+  }
+  return seriesFile;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailStoreSeriesFile* ctkDICOMThumbnailStorePrivate::existingSeriesFile(
+  const QString& studyInstanceUID, const QString& seriesInstanceUID)
+{
+  if (this->Directory.isEmpty() || studyInstanceUID.isEmpty() || seriesInstanceUID.isEmpty())
+  {
+    return 0;
+  }
+  QString path = this->seriesFilePath(studyInstanceUID, seriesInstanceUID);
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = this->OpenSeriesFiles.object(path);
+  if (seriesFile)
+  {
+    return seriesFile;
+  }
+  if (!QFile::exists(path))
+  {
+    return 0;
+  }
+  seriesFile = new ctkDICOMThumbnailStoreSeriesFile(path);
+  if (!this->openSeriesFile(seriesFile))
+  {
+    delete seriesFile;
+    return 0;
+  }
+  this->OpenSeriesFiles.insert(path, seriesFile);
+  return seriesFile;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::openSeriesFile(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  if (!seriesFile->File.open(QIODevice::ReadWrite))
+  {
+    logger.error("Failed to open thumbnail file " + seriesFile->File.fileName()
+      + ": " + seriesFile->File.errorString());
+    return false;
+  }
+  QByteArray header = seriesFile->File.read(SERIES_FILE_HEADER_SIZE);
+  if (header.size() == SERIES_FILE_HEADER_SIZE)
+  {
+    quint32 version = qFromLittleEndian<quint32>(
+      reinterpret_cast<const uchar*>(header.constData()) + SERIES_FILE_MAGIC_SIZE);
+    if (!header.startsWith(QByteArray(SERIES_FILE_MAGIC, SERIES_FILE_MAGIC_SIZE)) ||
+        version != SERIES_FILE_VERSION)
+    {
+      logger.error("Unsupported thumbnail file " + seriesFile->File.fileName());
+      seriesFile->File.close();
+      return false;
+    }
+    bool success = this->readIndex(seriesFile);
+    this->updateFileInfo(seriesFile);
+    return success;
+  }
+  if (header.size() > 0)
+  {
+    logger.warn("Truncated thumbnail file " + seriesFile->File.fileName() + " is reset");
+  }
+  // New file
+  uchar newHeader[SERIES_FILE_HEADER_SIZE];
+  memcpy(newHeader, SERIES_FILE_MAGIC, SERIES_FILE_MAGIC_SIZE);
+  qToLittleEndian<quint32>(SERIES_FILE_VERSION, newHeader + SERIES_FILE_MAGIC_SIZE);
+  if (!seriesFile->File.resize(0) ||
+      !seriesFile->File.seek(0) ||
+      seriesFile->File.write(reinterpret_cast<const char*>(newHeader), SERIES_FILE_HEADER_SIZE) != SERIES_FILE_HEADER_SIZE)
+  {
+    logger.error("Failed to write thumbnail file " + seriesFile->File.fileName());
+    seriesFile->File.close();
+    return false;
+  }
+  seriesFile->File.flush();
+  seriesFile->ValidSize = SERIES_FILE_HEADER_SIZE;
+  this->updateFileInfo(seriesFile);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::readIndex(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  seriesFile->unmap();
+  seriesFile->Tiles.clear();
+  seriesFile->StaleBytes = 0;
+  seriesFile->LiveBytes = 0;
+
+  const qint64 fileSize = seriesFile->File.size();
+  seriesFile->ValidSize = SERIES_FILE_HEADER_SIZE;
+  if (fileSize <= SERIES_FILE_HEADER_SIZE)
+  {
+    return true;
+  }
+  const uchar* data = seriesFile->File.map(0, fileSize);
+  if (!data)
+  {
+    logger.error("Failed to map thumbnail file " + seriesFile->File.fileName());
+    return false;
+  }
+  qint64 offset = SERIES_FILE_HEADER_SIZE;
+  while (offset + TILE_RECORD_HEADER_SIZE <= fileSize)
+  {
+    const uchar* record = data + offset;
+    if (qFromLittleEndian<quint32>(record) != TILE_RECORD_MAGIC)
+    {
+      break;
+    }
+    ctkDICOMThumbnailStoreTile tile;
+    const quint16 uidSize = qFromLittleEndian<quint16>(record + 4);
+    tile.Format = record[6];
+    tile.Compressed = (record[7] & TILE_COMPRESSED_FLAG) != 0;
+    tile.Width = qFromLittleEndian<quint16>(record + 8);
+    tile.Height = qFromLittleEndian<quint16>(record + 10);
+    tile.Time = qFromLittleEndian<qint64>(record + 12);
+    tile.DataSize = qFromLittleEndian<quint32>(record + 20);
+    tile.RecordOffset = offset;
+    tile.RecordSize = TILE_RECORD_HEADER_SIZE + uidSize + tile.DataSize;
+    tile.DataOffset = offset + TILE_RECORD_HEADER_SIZE + uidSize;
+    if (offset + tile.RecordSize > fileSize)
+    {
+      // incomplete record, the application was probably interrupted while writing
+      break;
+    }
+    QString sopInstanceUID = QString::fromUtf8(
+      reinterpret_cast<const char*>(record + TILE_RECORD_HEADER_SIZE), uidSize);
+    if (seriesFile->Tiles.contains(sopInstanceUID))
+    {
+      qint64 replacedSize = seriesFile->Tiles[sopInstanceUID].RecordSize;
+      seriesFile->StaleBytes += replacedSize;
+      seriesFile->LiveBytes -= replacedSize;
+    }
+    if (tile.Format == ctkDICOMThumbnailStore::InvalidFormat)
+    {
+      seriesFile->Tiles.remove(sopInstanceUID);
+      seriesFile->StaleBytes += tile.RecordSize;
+    }
+    else
+    {
+      seriesFile->Tiles[sopInstanceUID] = tile;
+      seriesFile->LiveBytes += tile.RecordSize;
+    }
+    offset += tile.RecordSize;
+  }
+  seriesFile->ValidSize = offset;
+  if (offset < fileSize)
+  {
+    logger.warn(QString("Ignoring %1 bytes at the end of thumbnail file %2")
+      .arg(fileSize - offset).arg(seriesFile->File.fileName()));
+  }
+  seriesFile->File.unmap(const_cast<uchar*>(data));
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStorePrivate::updateFileInfo(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  QFileInfo fileInfo(seriesFile->File.fileName());
+  seriesFile->FileSize = fileInfo.size();
+  seriesFile->LastModified = fileInfo.lastModified();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::refreshIndex(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  // The file at the path is checked, not the open one: a compacted file replaces it
+  QFileInfo fileInfo(seriesFile->File.fileName());
+  if (!fileInfo.exists())
+  {
+    // deletes the series file object
+    this->OpenSeriesFiles.remove(seriesFile->File.fileName());
+    return false;
+  }
+  if (fileInfo.size() == seriesFile->FileSize && fileInfo.lastModified() == seriesFile->LastModified)
+  {
+    return true;
+  }
+  seriesFile->close();
+  if (!this->openSeriesFile(seriesFile))
+  {
+    this->OpenSeriesFiles.remove(seriesFile->File.fileName());
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+const uchar* ctkDICOMThumbnailStorePrivate::mappedData(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  if (!seriesFile->Map)
+  {
+    seriesFile->Map = seriesFile->File.map(0, seriesFile->ValidSize);
+    if (!seriesFile->Map)
+    {
+      logger.error("Failed to map thumbnail file " + seriesFile->File.fileName());
+    }
+  }
+  return seriesFile->Map;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::appendRecord(ctkDICOMThumbnailStoreSeriesFile* seriesFile,
+  const QString& sopInstanceUID, quint8 format, quint8 flags, int width, int height, qint64 time,
+  const QByteArray& data)
+{
+  QByteArray uid = sopInstanceUID.toUtf8();
+  QByteArray record(TILE_RECORD_HEADER_SIZE, '\0');
+  uchar* header = reinterpret_cast<uchar*>(record.data());
+  qToLittleEndian<quint32>(TILE_RECORD_MAGIC, header);
+  qToLittleEndian<quint16>(static_cast<quint16>(uid.size()), header + 4);
+  header[6] = format;
+  header[7] = flags;
+  qToLittleEndian<quint16>(static_cast<quint16>(width), header + 8);
+  qToLittleEndian<quint16>(static_cast<quint16>(height), header + 10);
+  qToLittleEndian<qint64>(time, header + 12);
+  qToLittleEndian<quint32>(static_cast<quint32>(data.size()), header + 20);
+  record.append(uid);
+  record.append(data);
+
+  // The file cannot be resized while it is mapped on some platforms
+  seriesFile->unmap();
+  if (seriesFile->File.size() != seriesFile->ValidSize)
+  {
+    // Index the records appended by another store, only an incomplete record is removed
+    if (!this->readIndex(seriesFile))
+    {
+      return false;
+    }
+    if (seriesFile->File.size() > seriesFile->ValidSize)
+    {
+      seriesFile->File.resize(seriesFile->ValidSize);
+    }
+  }
+  if (!seriesFile->File.seek(seriesFile->ValidSize) ||
+      seriesFile->File.write(record) != record.size() ||
+      !seriesFile->File.flush())
+  {
+    logger.error("Failed to write thumbnail file " + seriesFile->File.fileName()
+      + ": " + seriesFile->File.errorString());
+    seriesFile->File.resize(seriesFile->ValidSize);
+    return false;
+  }
+
+  ctkDICOMThumbnailStoreTile tile;
+  tile.RecordOffset = seriesFile->ValidSize;
+  tile.RecordSize = record.size();
+  tile.DataOffset = tile.RecordOffset + TILE_RECORD_HEADER_SIZE + uid.size();
+  tile.DataSize = data.size();
+  tile.Format = format;
+  tile.Compressed = (flags & TILE_COMPRESSED_FLAG) != 0;
+  tile.Width = width;
+  tile.Height = height;
+  tile.Time = time;
+  seriesFile->ValidSize += record.size();
+  this->updateFileInfo(seriesFile);
+
+  if (seriesFile->Tiles.contains(sopInstanceUID))
+  {
+    qint64 replacedSize = seriesFile->Tiles[sopInstanceUID].RecordSize;
+    seriesFile->StaleBytes += replacedSize;
+    seriesFile->LiveBytes -= replacedSize;
+  }
+  if (format == ctkDICOMThumbnailStore::InvalidFormat)
+  {
+    seriesFile->Tiles.remove(sopInstanceUID);
+    seriesFile->StaleBytes += tile.RecordSize;
+  }
+  else
+  {
+    seriesFile->Tiles[sopInstanceUID] = tile;
+    seriesFile->LiveBytes += tile.RecordSize;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::compact(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  const uchar* data = this->mappedData(seriesFile);
+  if (!data)
+  {
+    return false;
+  }
+  QString path = seriesFile->File.fileName();
+  // The records are written into a temporary file, which then replaces the series file
+  // in a single rename: readers see either the former or the compacted file.
+#ifdef HAVE_QT_QSAVEFILE
+  QSaveFile compactedFile(path);
+#else
+  QString compactedPath = path + ".tmp";
+  QFile compactedFile(compactedPath);
+#endif
+  if (!compactedFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    logger.error("Failed to compact thumbnail file " + path + ": " + compactedFile.errorString());
+    return false;
+  }
+  bool success = (compactedFile.write(reinterpret_cast<const char*>(data), SERIES_FILE_HEADER_SIZE) == SERIES_FILE_HEADER_SIZE);
+  foreach(const ctkDICOMThumbnailStoreTile& tile, seriesFile->Tiles)
+  {
+    if (!success)
+    {
+      break;
+    }
+    success = (compactedFile.write(reinterpret_cast<const char*>(data + tile.RecordOffset), tile.RecordSize) == tile.RecordSize);
+  }
+  if (!success)
+  {
+    logger.error("Failed to compact thumbnail file " + path);
+#ifndef HAVE_QT_QSAVEFILE
+    compactedFile.close();
+    QFile::remove(compactedPath);
+#endif
+    // QSaveFile discards the temporary file when it is not committed
+    return false;
+  }
+  // The series file cannot be replaced while it is open on some platforms
+  seriesFile->close();
+#ifdef HAVE_QT_QSAVEFILE
+  success = compactedFile.commit();
+#else
+  compactedFile.close();
+  // Unlike QFile::rename, rename() replaces an existing file (on POSIX systems)
+  success = (std::rename(QFile::encodeName(compactedPath).constData(), QFile::encodeName(path).constData()) == 0);
+  if (!success)
+  {
+    QFile::remove(compactedPath);
+  }
+#endif
+  if (!success)
+  {
+    logger.error("Failed to replace thumbnail file " + path + " by its compacted version");
+  }
+  return this->openSeriesFile(seriesFile);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStorePrivate::compactIfNeeded(ctkDICOMThumbnailStoreSeriesFile* seriesFile)
+{
+  if (seriesFile->StaleBytes >= MINIMUM_STALE_BYTES_TO_COMPACT &&
+      seriesFile->StaleBytes > seriesFile->LiveBytes)
+  {
+    this->compact(seriesFile);
+  }
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailStorePrivate::migrateThumbnailFiles(ctkDICOMThumbnailStoreSeriesFile* seriesFile,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, const QStringList& sopInstanceUIDs)
+{
+  int migratedCount = 0;
+  foreach(const QString& sopInstanceUID, sopInstanceUIDs)
+  {
+    QFileInfo fileInfo = this->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+    if (!fileInfo.exists())
+    {
+      continue;
+    }
+    QFile file(fileInfo.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly))
+    {
+      continue;
+    }
+    QByteArray png = file.readAll();
+    file.close();
+    int width = 0;
+    int height = 0;
+    if (!ctkDICOMThumbnailStorePrivate::pngSize(png, &width, &height))
+    {
+      logger.warn("Invalid thumbnail file " + fileInfo.absoluteFilePath() + " is not migrated");
+      continue;
+    }
+    qint64 time = fileInfo.lastModified().toMSecsSinceEpoch();
+    bool newer = !seriesFile->Tiles.contains(sopInstanceUID)
+      || seriesFile->Tiles[sopInstanceUID].Time < time;
+    if (newer && !this->appendRecord(seriesFile, sopInstanceUID, ctkDICOMThumbnailStore::PNG, 0,
+                                     width, height, time, png))
+    {
+      continue;
+    }
+    QFile::remove(fileInfo.absoluteFilePath());
+    ++migratedCount;
+  }
+  // the folder is kept if it still contains files (of other instances or series)
+  QDir().rmdir(this->legacySeriesDirectory(studyInstanceUID, seriesInstanceUID));
+  if (migratedCount > 0)
+  {
+    logger.info(QString("Migrated %1 thumbnails into %2").arg(migratedCount).arg(seriesFile->File.fileName()));
+  }
+  return migratedCount;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStorePrivate::removeSeriesFile(const QString& studyInstanceUID, const QString& seriesInstanceUID)
+{
+  QString path = this->seriesFilePath(studyInstanceUID, seriesInstanceUID);
+  // deletes the series file object, which closes the file
+  this->OpenSeriesFiles.remove(path);
+  bool success = true;
+  if (QFile::exists(path) && !QFile::remove(path))
+  {
+    logger.error("Failed to remove thumbnail file " + path);
+    success = false;
+  }
+  // With short storage paths, files of the former layout cannot be attributed to the series
+  // (several series may share a folder), they are removed with the DICOM files by the database.
+  foreach(const QString& sopInstanceUID, this->legacyInstanceUIDs(studyInstanceUID, seriesInstanceUID))
+  {
+    QFile::remove(this->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID).filePath());
+  }
+  QDir().rmdir(this->legacySeriesDirectory(studyInstanceUID, seriesInstanceUID));
+  // Remove study directories if it was the last series
+  QDir().rmdir(this->legacyStudyDirectory(studyInstanceUID));
+  QDir(this->Directory).rmdir(studyInstanceUID);
+  return success;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailStore::ctkDICOMThumbnailStore(const QString& directory)
+  : d_ptr(new ctkDICOMThumbnailStorePrivate(*this))
+{
+  Q_D(ctkDICOMThumbnailStore);
+  d->Directory = directory;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailStore::~ctkDICOMThumbnailStore()
+{
+  this->close();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStore::setDirectory(const QString& directory)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  if (d->Directory == directory)
+  {
+    return;
+  }
+  d->OpenSeriesFiles.clear();
+  d->Directory = directory;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailStore::directory()const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  return d->Directory;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStore::setCompressionLevel(int level)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  d->CompressionLevel = qBound(0, level, 9);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailStore::compressionLevel()const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  return d->CompressionLevel;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStore::setUseShortStoragePath(bool useShort)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  d->UseShortStoragePath = useShort;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStore::useShortStoragePath()const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  return d->UseShortStoragePath;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStore::setMaximumOpenSeriesCount(int count)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  d->OpenSeriesFiles.setMaxCost(qMax(1, count));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailStore::maximumOpenSeriesCount()const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  return d->OpenSeriesFiles.maxCost();
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailStore::seriesFilePath(const QString& studyInstanceUID, const QString& seriesInstanceUID)const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  return d->seriesFilePath(studyInstanceUID, seriesInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStore::contains(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+  const QString& sopInstanceUID)const
+{
+  return this->thumbnailTime(studyInstanceUID, seriesInstanceUID, sopInstanceUID).isValid();
+}
+
+//------------------------------------------------------------------------------
+QDateTime ctkDICOMThumbnailStore::thumbnailTime(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+  const QString& sopInstanceUID)const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  ctkDICOMThumbnailStorePrivate* mutableD = const_cast<ctkDICOMThumbnailStorePrivate*>(d);
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = mutableD->existingSeriesFile(studyInstanceUID, seriesInstanceUID);
+  if (seriesFile && !seriesFile->Tiles.contains(sopInstanceUID) && !mutableD->refreshIndex(seriesFile))
+  {
+    seriesFile = 0;
+  }
+  if (seriesFile && seriesFile->Tiles.contains(sopInstanceUID))
+  {
+    return QDateTime::fromMSecsSinceEpoch(seriesFile->Tiles[sopInstanceUID].Time);
+  }
+  // Thumbnails of the former layout are only migrated when the series is written
+  QFileInfo legacyFile = d->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+  return legacyFile.exists() ? legacyFile.lastModified() : QDateTime();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStore::setThumbnail(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+  const QString& sopInstanceUID, TileFormat format, int width, int height, const QByteArray& data)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  if (format == InvalidFormat || sopInstanceUID.isEmpty()
+    || width <= 0 || height <= 0 || width > 0xffff || height > 0xffff)
+  {
+    logger.error("Invalid thumbnail for instance " + sopInstanceUID);
+    return false;
+  }
+  const int pixelSize = ctkDICOMThumbnailStore::bytesPerPixel(format);
+  if (pixelSize > 0 && data.size() != width * height * pixelSize)
+  {
+    logger.error(QString("Thumbnail of instance %1 has %2 bytes instead of %3")
+      .arg(sopInstanceUID).arg(data.size()).arg(width * height * pixelSize));
+    return false;
+  }
+
+  QMutexLocker locker(&d->Mutex);
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = d->seriesFile(studyInstanceUID, seriesInstanceUID, true);
+  if (!seriesFile)
+  {
+    return false;
+  }
+  quint8 flags = 0;
+  QByteArray storedData = data;
+  if (pixelSize > 0 && d->CompressionLevel > 0)
+  {
+    QByteArray compressedData = qCompress(data, d->CompressionLevel);
+    if (compressedData.size() < data.size())
+    {
+      storedData = compressedData;
+      flags |= TILE_COMPRESSED_FLAG;
+    }
+  }
+  if (!d->appendRecord(seriesFile, sopInstanceUID, static_cast<quint8>(format), flags, width, height,
+                       QDateTime::currentDateTime().toMSecsSinceEpoch(), storedData))
+  {
+    return false;
+  }
+  // A thumbnail file of the former layout that was not migrated is outdated
+  QFileInfo legacyFile = d->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+  if (legacyFile.exists())
+  {
+    QFile::remove(legacyFile.filePath());
+  }
+  d->compactIfNeeded(seriesFile);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+QByteArray ctkDICOMThumbnailStore::thumbnail(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+  const QString& sopInstanceUID, TileFormat* format, int* width, int* height)const
+{
+  Q_D(const ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  ctkDICOMThumbnailStorePrivate* mutableD = const_cast<ctkDICOMThumbnailStorePrivate*>(d);
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = mutableD->existingSeriesFile(studyInstanceUID, seriesInstanceUID);
+  if (seriesFile && !seriesFile->Tiles.contains(sopInstanceUID) && !mutableD->refreshIndex(seriesFile))
+  {
+    seriesFile = 0;
+  }
+  if (!seriesFile || !seriesFile->Tiles.contains(sopInstanceUID))
+  {
+    // Thumbnails of the former layout are only migrated when the series is written
+    QFile legacyFile(d->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID).filePath());
+    if (!legacyFile.open(QIODevice::ReadOnly))
+    {
+      return QByteArray();
+    }
+    QByteArray png = legacyFile.readAll();
+    int pngWidth = 0;
+    int pngHeight = 0;
+    if (!ctkDICOMThumbnailStorePrivate::pngSize(png, &pngWidth, &pngHeight))
+    {
+      return QByteArray();
+    }
+    if (format)
+    {
+      *format = PNG;
+    }
+    if (width)
+    {
+      *width = pngWidth;
+    }
+    if (height)
+    {
+      *height = pngHeight;
+    }
+    return png;
+  }
+  const ctkDICOMThumbnailStoreTile tile = seriesFile->Tiles[sopInstanceUID];
+  const uchar* mappedData = mutableD->mappedData(seriesFile);
+  if (!mappedData)
+  {
+    return QByteArray();
+  }
+  // Copy the tile: the mapping does not outlive the next write in the series file
+  QByteArray data(reinterpret_cast<const char*>(mappedData + tile.DataOffset), tile.DataSize);
+  if (tile.Compressed)
+  {
+    data = qUncompress(data);
+  }
+  if (format)
+  {
+    *format = static_cast<TileFormat>(tile.Format);
+  }
+  if (width)
+  {
+    *width = tile.Width;
+  }
+  if (height)
+  {
+    *height = tile.Height;
+  }
+  return data;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStore::removeThumbnail(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+  const QString& sopInstanceUID)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  // Otherwise the thumbnail file of the former layout would be read instead
+  QFileInfo legacyFile = d->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+  if (legacyFile.exists() && !QFile::remove(legacyFile.filePath()))
+  {
+    logger.error("Failed to remove thumbnail file " + legacyFile.filePath());
+    return false;
+  }
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = d->seriesFile(studyInstanceUID, seriesInstanceUID, false);
+  if (!seriesFile)
+  {
+    return true;
+  }
+  if (!seriesFile->Tiles.contains(sopInstanceUID))
+  {
+    return true;
+  }
+  if (seriesFile->Tiles.count() == 1)
+  {
+    return d->removeSeriesFile(studyInstanceUID, seriesInstanceUID);
+  }
+  if (!d->appendRecord(seriesFile, sopInstanceUID, InvalidFormat, 0, 0, 0,
+                       QDateTime::currentDateTime().toMSecsSinceEpoch(), QByteArray()))
+  {
+    return false;
+  }
+  d->compactIfNeeded(seriesFile);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStore::removeSeries(const QString& studyInstanceUID, const QString& seriesInstanceUID)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  if (d->Directory.isEmpty() || studyInstanceUID.isEmpty() || seriesInstanceUID.isEmpty())
+  {
+    return false;
+  }
+  return d->removeSeriesFile(studyInstanceUID, seriesInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailStore::compactSeries(const QString& studyInstanceUID, const QString& seriesInstanceUID)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = d->seriesFile(studyInstanceUID, seriesInstanceUID, false);
+  if (!seriesFile)
+  {
+    return false;
+  }
+  if (seriesFile->StaleBytes == 0)
+  {
+    return true;
+  }
+  return d->compact(seriesFile);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailStore::migrateThumbnailFiles()
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  if (d->Directory.isEmpty())
+  {
+    return 0;
+  }
+  if (d->UseShortStoragePath)
+  {
+    logger.warn("Thumbnail files named by hashes of the UIDs can only be migrated by series");
+    return 0;
+  }
+  int migratedCount = 0;
+  QDir directory(d->Directory);
+  foreach(const QString& studyInstanceUID, directory.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+  {
+    QDir studyDirectory(directory.filePath(studyInstanceUID));
+    foreach(const QString& seriesInstanceUID, studyDirectory.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+      d->seriesFile(studyInstanceUID, seriesInstanceUID, true, &migratedCount);
+    }
+  }
+  return migratedCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailStore::migrateThumbnailFiles(const QString& studyInstanceUID,
+  const QString& seriesInstanceUID, const QStringList& sopInstanceUIDs)
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  QStringList legacySOPInstanceUIDs;
+  foreach(const QString& sopInstanceUID, sopInstanceUIDs)
+  {
+    if (d->legacyThumbnailFile(studyInstanceUID, seriesInstanceUID, sopInstanceUID).exists())
+    {
+      legacySOPInstanceUIDs << sopInstanceUID;
+    }
+  }
+  if (legacySOPInstanceUIDs.isEmpty())
+  {
+    return 0;
+  }
+  int migratedCount = 0;
+  ctkDICOMThumbnailStoreSeriesFile* seriesFile = d->seriesFile(studyInstanceUID, seriesInstanceUID, true, &migratedCount);
+  if (!seriesFile)
+  {
+    return migratedCount;
+  }
+  return migratedCount + d->migrateThumbnailFiles(seriesFile, studyInstanceUID, seriesInstanceUID, legacySOPInstanceUIDs);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailStore::close()
+{
+  Q_D(ctkDICOMThumbnailStore);
+  QMutexLocker locker(&d->Mutex);
+  d->OpenSeriesFiles.clear();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailStore::bytesPerPixel(TileFormat format)
+{
+  switch (format)
+  {
+    case Grayscale8:
+      return 1;
+    case RGB888:
+      return 3;
+    case ARGB32:
+      return 4;
+    default:
+      return 0;
+  }
+}
@@ -0,0 +1,151 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMThumbnailStore_h
+#define __ctkDICOMThumbnailStore_h
+
+// Qt includes
+#include <QByteArray>
+#include <QDateTime>
+#include <QScopedPointer>
+#include <QString>
+#include <QStringList>
+
+#include "ctkDICOMCoreExport.h"
+
+class ctkDICOMThumbnailStorePrivate;
+
+/// \ingroup DICOM_Core
+///
+/// \brief Store of the thumbnails of a DICOM database
+///
+/// Thumbnails of all the instances of a series are packed into a single
+/// file, <directory>/<StudyInstanceUID>/<SeriesInstanceUID>.thumbs, instead
+/// of one PNG file per instance.
+/// A series file is a header followed by tile records that are only appended:
+/// replacing or removing a thumbnail appends a new record, and the file is
+/// compacted when most of it is made of outdated records.
+/// Series files are memory mapped when read, the index of a series is read
+/// once and cached for the most recently used series.
+///
+/// Tiles are stored as raw pixels, compressed with zlib (see
+/// setCompressionLevel), and they are only decoded when requested. Thumbnails
+/// of the former layout (one PNG file per instance, in the same folders as the
+/// DICOM files of the database, see setUseShortStoragePath) are read as they
+/// are, and they are moved into the series file without decoding.
+/// See also migrateThumbnailFiles().
+///
+/// All methods are thread-safe. Only one store object should write in a
+/// directory at a time.
+class CTK_DICOM_CORE_EXPORT ctkDICOMThumbnailStore
+{
+public:
+  enum TileFormat
+  {
+    InvalidFormat = 0,
+    /// One byte per pixel
+    Grayscale8 = 1,
+    /// Three bytes per pixel: red, green, blue
+    RGB888 = 2,
+    /// One 32-bit 0xAARRGGBB value per pixel in native byte order
+    ARGB32 = 3,
+    /// PNG encoded image (thumbnails migrated from PNG files)
+    PNG = 4
+  };
+
+  explicit ctkDICOMThumbnailStore(const QString& directory = QString());
+  virtual ~ctkDICOMThumbnailStore();
+
+  /// Directory of the series files. Changing it closes all the series files.
+  void setDirectory(const QString& directory);
+  QString directory()const;
+
+  /// zlib compression level of the raw tiles (0: not compressed, 9: best).
+  /// Default is 1 (fastest).
+  void setCompressionLevel(int level);
+  int compressionLevel()const;
+
+  /// Must match ctkDICOMDatabase::useShortStoragePath() of the database, it determines
+  /// the path of the thumbnail files of the former layout: UIDs are replaced by their hashes
+  /// in <directory>/<StudyInstanceUID>/<SeriesInstanceUID>/<SOPInstanceUID>.png.
+  /// Default is true.
+  void setUseShortStoragePath(bool useShort);
+  bool useShortStoragePath()const;
+
+  /// Maximum number of series files that are kept open and mapped.
+  /// Default is 32.
+  void setMaximumOpenSeriesCount(int count);
+  int maximumOpenSeriesCount()const;
+
+  /// Path of the file containing the thumbnails of a series
+  QString seriesFilePath(const QString& studyInstanceUID, const QString& seriesInstanceUID)const;
+
+  /// Return true if the store contains a thumbnail for the instance
+  bool contains(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QString& sopInstanceUID)const;
+  /// Time the thumbnail was stored. Invalid if there is no thumbnail.
+  QDateTime thumbnailTime(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QString& sopInstanceUID)const;
+
+  /// Store the thumbnail of an instance, replacing the existing one if any.
+  /// For raw formats, data contains the pixels line by line without padding.
+  bool setThumbnail(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QString& sopInstanceUID, TileFormat format, int width, int height, const QByteArray& data);
+
+  /// Get the thumbnail of an instance. The returned data is uncompressed.
+  /// Returns an empty array if there is no thumbnail.
+  QByteArray thumbnail(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QString& sopInstanceUID, TileFormat* format = 0, int* width = 0, int* height = 0)const;
+
+  /// Remove the thumbnail of an instance
+  bool removeThumbnail(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QString& sopInstanceUID);
+  /// Remove the thumbnails of all the instances of a series
+  bool removeSeries(const QString& studyInstanceUID, const QString& seriesInstanceUID);
+
+  /// Rewrite the series file without outdated records
+  bool compactSeries(const QString& studyInstanceUID, const QString& seriesInstanceUID);
+
+  /// Move all the thumbnail files of the former layout into series files.
+  /// Only possible if useShortStoragePath is false: the UIDs cannot be found from the hashes,
+  /// see ctkDICOMDatabase::migrateThumbnailFiles(). In that case the thumbnail files of a
+  /// series are also migrated the first time the series is written.
+  /// Returns the number of migrated thumbnails.
+  int migrateThumbnailFiles();
+  /// Move the thumbnail files of the former layout of the listed instances into the series file.
+  /// Returns the number of migrated thumbnails.
+  int migrateThumbnailFiles(const QString& studyInstanceUID, const QString& seriesInstanceUID,
+    const QStringList& sopInstanceUIDs);
+
+  /// Unmap and close all the series files
+  void close();
+
+  /// Number of bytes of a pixel in a raw format, 0 for other formats.
+  static int bytesPerPixel(TileFormat format);
+
+protected:
+  QScopedPointer<ctkDICOMThumbnailStorePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMThumbnailStore);
+  Q_DISABLE_COPY(ctkDICOMThumbnailStore);
+};
+
+#endif
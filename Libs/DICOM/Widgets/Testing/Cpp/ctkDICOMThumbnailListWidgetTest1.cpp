@@ -21,11 +21,13 @@
 // Qt includes
 #include <QApplication>
 #include <QDir>
+#include <QSignalSpy>
 #include <QTimer>
 
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMModel.h"
+#include "ctkDICOMThumbnailGenerator.h"
 #include "ctkDICOMThumbnailListWidget.h"
 
 // STD includes
@@ -57,8 +59,29 @@ int ctkDICOMThumbnailListWidgetTest1( int argc, char * argv [] )
     ctkDICOMModel model;
     model.setDatabase(myCTK.database());
 
+    ctkDICOMThumbnailGenerator generator;
+    generator.setMaximumThreadCount(2);
+    if (generator.maximumThreadCount() != 2)
+      {
+      std::cerr << "ctkDICOMThumbnailGenerator::setMaximumThreadCount failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+    // A failed thumbnail generation is reported with an empty path
+    QSignalSpy generatedSpy(&generator, SIGNAL(seriesThumbnailGenerated(QString,QString)));
+    generator.queueSeriesThumbnail("1.2.3", "nonexistent.dcm",
+      QDir::temp().filePath("ctkDICOMThumbnailListWidgetTest1.png"));
+    if (!generator.waitForQueuedThumbnails(10000) ||
+        generatedSpy.count() != 1 ||
+        generatedSpy.at(0).at(0).toString() != "1.2.3" ||
+        !generatedSpy.at(0).at(1).toString().isEmpty())
+      {
+      std::cerr << "ctkDICOMThumbnailGenerator::queueSeriesThumbnail failed" << std::endl;
+      return EXIT_FAILURE;
+      }
+
     ctkDICOMThumbnailListWidget widget;
     widget.setDatabaseDirectory(databasePath.absolutePath());
+    widget.setThumbnailGenerator(&generator);
     widget.addThumbnails(model.index(0,0));
     widget.show();
 
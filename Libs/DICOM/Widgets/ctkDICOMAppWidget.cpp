@@ -264,6 +264,8 @@ ctkDICOMAppWidget::ctkDICOMAppWidget(QWidget* _parent):Superclass(_parent),
 
   d->ThumbnailsWidget->setThumbnailSize(
     QSize(d->ThumbnailWidthSlider->value(), d->ThumbnailWidthSlider->value()));
+  d->ThumbnailsWidget->setThumbnailGenerator(d->ThumbnailGenerator.data());
+  d->ThumbnailsWidget->setThumbnailStore(d->DICOMDatabase->thumbnailStore());
 
   // Treeview signals
   connect(d->TreeView, SIGNAL(collapsed(QModelIndex)), this, SLOT(onTreeCollapsed(QModelIndex)));
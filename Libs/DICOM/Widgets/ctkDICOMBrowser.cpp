@@ -232,6 +232,8 @@ ctkDICOMBrowserPrivate::ctkDICOMBrowserPrivate(ctkDICOMBrowser* parent, QSharedP
   if (this->DICOMDatabase.isNull())
   {
     this->DICOMDatabase = QSharedPointer<ctkDICOMDatabase>(new ctkDICOMDatabase);
+    // Keep browsing responsive while the indexer is writing to the database
+    this->DICOMDatabase->setUseWriteAheadLogging(true);
   }
 }
 
@@ -329,6 +331,10 @@ void ctkDICOMBrowserPrivate::init()
   this->QueryRetrieveWidget->useProgressDialog(true);
   
   this->dicomTableManager->setDICOMDatabase(this->DICOMDatabase.data());
+  // Filter, sort and fetch rows in the database so that large databases can be browsed
+  this->dicomTableManager->patientsTable()->setLazyLoading(true);
+  this->dicomTableManager->studiesTable()->setLazyLoading(true);
+  this->dicomTableManager->seriesTable()->setLazyLoading(true);
 
   // TableView signals
   q->connect(this->dicomTableManager, SIGNAL(patientsSelectionChanged(const QItemSelection&, const QItemSelection&)),
@@ -1228,11 +1234,8 @@ void ctkDICOMBrowser::onStudiesRightClicked(const QPoint &point)
   else if (selectedAction == deleteAction
       && this->confirmDeleteSelectedUIDs(selectedStudiesUIDs))
   {
-    foreach (const QString& uid, selectedStudiesUIDs)
-    {
-      d->DICOMDatabase->removeStudy(uid);
-      d->dicomTableManager->updateTableViews();
-    }
+    d->DICOMDatabase->removeStudyList(selectedStudiesUIDs);
+    d->dicomTableManager->updateTableViews();
   }
   else if (selectedAction == exportAction)
   {
@@ -1299,11 +1302,8 @@ void ctkDICOMBrowser::onSeriesRightClicked(const QPoint &point)
   else if (selectedAction == deleteAction
       && this->confirmDeleteSelectedUIDs(selectedSeriesUIDs))
   {
-    foreach (const QString& uid, selectedSeriesUIDs)
-    {
-      d->DICOMDatabase->removeSeries(uid);
-      d->dicomTableManager->updateTableViews();
-    }
+    d->DICOMDatabase->removeSeriesList(selectedSeriesUIDs);
+    d->dicomTableManager->updateTableViews();
   }
   else if (selectedAction == exportAction)
   {
@@ -1652,18 +1652,10 @@ void ctkDICOMBrowser::removeSelectedItems(ctkDICOMModel::IndexType level)
     }
   }
 
-  foreach(const QString & uid, selectedSeriesUIDs)
-  {
-    d->DICOMDatabase->removeSeries(uid);
-  }
-  foreach(const QString & uid, selectedStudyUIDs)
-  {
-    d->DICOMDatabase->removeStudy(uid);
-  }
-  foreach(const QString & uid, selectedPatientUIDs)
-  {
-    d->DICOMDatabase->removePatient(uid);
-  }
+  // Files are deleted in the background
+  d->DICOMDatabase->removeSeriesList(selectedSeriesUIDs);
+  d->DICOMDatabase->removeStudyList(selectedStudyUIDs);
+  d->DICOMDatabase->removePatientList(selectedPatientUIDs);
   // Update the table views
   d->dicomTableManager->updateTableViews();
 }
@@ -112,6 +112,12 @@ void ctkDICOMTableManagerPrivate::init()
   QObject::connect(this->seriesTable, SIGNAL(showFilterActiveWarning(bool)),
     q, SLOT(showSeriesFilterActiveWarning(bool)));
 
+  // In lazy loading mode the dependent tables get the query of the rows instead of their uids
+  QObject::connect(this->patientsTable, SIGNAL(uidsQueryChanged(QString,QVariantList)),
+    this->studiesTable, SLOT(onUpdateUidsQuery(QString,QVariantList)));
+  QObject::connect(this->studiesTable, SIGNAL(uidsQueryChanged(QString,QVariantList)),
+    this->seriesTable, SLOT(onUpdateUidsQuery(QString,QVariantList)));
+
   // For propagating patient selection changes
   QObject::connect(this->patientsTable, SIGNAL(selectionChanged(const QItemSelection&, const QItemSelection&)),
                    q, SIGNAL(patientsSelectionChanged(const QItemSelection&, const QItemSelection&)));
@@ -278,10 +284,11 @@ void ctkDICOMTableManager::onPatientsSelectionChanged(const QStringList &uids)
   {
     patientCondition.second = uids;
   }
-  else
+  else if (!d->patientsTable->isLazyLoading())
   {
     patientCondition.second = d->patientsTable->uidsForAllRows();
   }
+  // else the dependent tables are restricted by the query of the patients table
   d->studiesTable->addSqlWhereCondition(patientCondition);
   d->seriesTable->addSqlWhereCondition(patientCondition);
 }
@@ -296,10 +303,11 @@ void ctkDICOMTableManager::onStudiesSelectionChanged(const QStringList &uids)
   {
     studiesCondition.second = uids;
   }
-  else
+  else if (!d->studiesTable->isLazyLoading())
   {
     studiesCondition.second = d->studiesTable->uidsForAllRows();
   }
+  // else the series table is restricted by the query of the studies table
   d->seriesTable->addSqlWhereCondition(studiesCondition);
 }
 
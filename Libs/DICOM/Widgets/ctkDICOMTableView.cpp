@@ -18,6 +18,9 @@
 
 =========================================================================*/
 
+// ctkDICOMCore includes
+#include "ctkDICOMTableModel.h"
+
 // ctkDICOMWidget includes
 #include "ctkDICOMTableView.h"
 #include "ui_ctkDICOMTableView.h"
@@ -48,9 +51,17 @@ public:
 
   void applyColumnProperties();
 
+  /// Model containing the rows of the table (without filtering)
+  QAbstractItemModel* sourceModel();
+  /// Set the model displayed by the table view
+  void setViewModel(QAbstractItemModel* model);
+
   ctkDICOMDatabase* dicomDatabase;
   QSqlQueryModel dicomSQLModel;
   QSortFilterProxyModel* dicomSQLFilterModel;
+  /// Model used instead of dicomSQLModel and dicomSQLFilterModel in lazy loading mode
+  ctkDICOMTableModel* dicomTableModel;
+  bool lazyLoading;
   QString queryTableName;
   QString queryForeignKey;
 
@@ -64,6 +75,10 @@ public:
   /// Key = QString for columns, Values = QStringList
   QHash<QString, QStringList> sqlWhereConditions;
 
+  /// Query selecting the accepted values of queryForeignKey, in lazy loading mode
+  QString foreignKeyUidsQuery;
+  QVariantList foreignKeyUidsQueryBindValues;
+
 };
 
 //------------------------------------------------------------------------------
@@ -72,6 +87,9 @@ ctkDICOMTableViewPrivate::ctkDICOMTableViewPrivate(ctkDICOMTableView &obj)
 {
   this->dicomSQLFilterModel = new QSortFilterProxyModel(&obj);
   this->dicomDatabase = new ctkDICOMDatabase(&obj);
+  this->dicomTableModel = new ctkDICOMTableModel(&obj);
+  this->dicomTableModel->setDatabase(this->dicomDatabase);
+  this->lazyLoading = false;
   this->batchUpdate = false;
   this->batchUpdateModificationPending = false;
   this->batchUpdateInstanceAddedPending = false;
@@ -83,6 +101,9 @@ ctkDICOMTableViewPrivate::ctkDICOMTableViewPrivate(ctkDICOMTableView &obj, ctkDI
   , dicomDatabase(db)
 {
   this->dicomSQLFilterModel = new QSortFilterProxyModel(&obj);
+  this->dicomTableModel = new ctkDICOMTableModel(&obj);
+  this->dicomTableModel->setDatabase(this->dicomDatabase);
+  this->lazyLoading = false;
 }
 
 //------------------------------------------------------------------------------
@@ -104,7 +125,7 @@ void ctkDICOMTableViewPrivate::init()
   this->dicomSQLFilterModel->setSourceModel(&this->dicomSQLModel);
   this->dicomSQLFilterModel->setFilterKeyColumn(-1);
   this->dicomSQLFilterModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
-  this->tblDicomDatabaseView->setModel(this->dicomSQLFilterModel);
+  this->setViewModel(this->dicomSQLFilterModel);
   this->tblDicomDatabaseView->setSortingEnabled(true);
 #if QT_VERSION < QT_VERSION_CHECK(5,0,0)
   this->tblDicomDatabaseView->horizontalHeader()->setResizeMode(QHeaderView::Interactive);
@@ -115,14 +136,6 @@ void ctkDICOMTableViewPrivate::init()
 #endif
   this->tblDicomDatabaseView->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft);
 
-  QObject::connect(this->tblDicomDatabaseView->selectionModel(),
-                   SIGNAL(selectionChanged(const QItemSelection&,const QItemSelection&)),
-                   q, SLOT(onSelectionChanged()));
-
-  QObject::connect(this->tblDicomDatabaseView->selectionModel(),
-                   SIGNAL(selectionChanged(const QItemSelection&,const QItemSelection&)),
-                   q, SIGNAL(selectionChanged(const QItemSelection&,const QItemSelection&)));
-
   QObject::connect(this->tblDicomDatabaseView, SIGNAL(doubleClicked(const QModelIndex&)),
                    q, SIGNAL(doubleClicked(const QModelIndex&)));
 
@@ -133,6 +146,35 @@ void ctkDICOMTableViewPrivate::init()
                    q, SLOT(onCustomContextMenuRequested(const QPoint&)));
 
   QObject::connect(this->leSearchBox, SIGNAL(textChanged(QString)), q, SLOT(onFilterChanged(QString)));
+  QObject::connect(this->dicomTableModel, SIGNAL(rowCountChanged(int)), q, SLOT(onLazyRowCountChanged()));
+}
+
+//----------------------------------------------------------------------------
+QAbstractItemModel* ctkDICOMTableViewPrivate::sourceModel()
+{
+  if (this->lazyLoading)
+  {
+    return this->dicomTableModel;
+  }
+  return &this->dicomSQLModel;
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMTableViewPrivate::setViewModel(QAbstractItemModel* model)
+{
+  Q_Q(ctkDICOMTableView);
+  // The view does not delete its previous selection model
+  QItemSelectionModel* oldSelectionModel = this->tblDicomDatabaseView->selectionModel();
+  this->tblDicomDatabaseView->setModel(model);
+  delete oldSelectionModel;
+
+  QObject::connect(this->tblDicomDatabaseView->selectionModel(),
+                   SIGNAL(selectionChanged(const QItemSelection&,const QItemSelection&)),
+                   q, SLOT(onSelectionChanged()));
+
+  QObject::connect(this->tblDicomDatabaseView->selectionModel(),
+                   SIGNAL(selectionChanged(const QItemSelection&,const QItemSelection&)),
+                   q, SIGNAL(selectionChanged(const QItemSelection&,const QItemSelection&)));
 }
 
 //----------------------------------------------------------------------------
@@ -161,17 +203,18 @@ void ctkDICOMTableViewPrivate::applyColumnProperties()
   Qt::SortOrder defaultSortOrder = Qt::AscendingOrder;
 
   QHeaderView* header = this->tblDicomDatabaseView->horizontalHeader();
-  int columnCount = this->dicomSQLModel.columnCount();
+  QAbstractItemModel* sourceModel = this->sourceModel();
+  int columnCount = sourceModel->columnCount();
   QList<int> columnWeights;
   QMap<int,int> visualIndexToColumnIndexMap;
   for (int col=0; col<columnCount; ++col)
   {
-    QString columnName = this->dicomSQLModel.headerData(col, Qt::Horizontal).toString();
-    QString originalColumnName = this->dicomSQLModel.headerData(col, Qt::Horizontal, Qt::WhatsThisRole).toString();
+    QString columnName = sourceModel->headerData(col, Qt::Horizontal).toString();
+    QString originalColumnName = sourceModel->headerData(col, Qt::Horizontal, Qt::WhatsThisRole).toString();
     if (originalColumnName.isEmpty())
     {
       // Save original column name for future referencing the database fields
-      this->dicomSQLModel.setHeaderData(col, Qt::Horizontal, columnName, Qt::WhatsThisRole);
+      sourceModel->setHeaderData(col, Qt::Horizontal, columnName, Qt::WhatsThisRole);
     }
     else
     {
@@ -181,7 +224,7 @@ void ctkDICOMTableViewPrivate::applyColumnProperties()
 
     // Apply displayed name
     QString displayedName = this->dicomDatabase->displayedNameForField(this->queryTableName, columnName);
-    this->dicomSQLModel.setHeaderData(col, Qt::Horizontal, displayedName, Qt::DisplayRole);
+    sourceModel->setHeaderData(col, Qt::Horizontal, displayedName, Qt::DisplayRole);
 
     // Apply visibility
     bool visibility = this->dicomDatabase->visibilityForField(this->queryTableName, columnName);
@@ -366,6 +409,7 @@ void ctkDICOMTableView::setDicomDataBase(ctkDICOMDatabase *dicomDatabase)
   }
 
   d->dicomDatabase = dicomDatabase;
+  d->dicomTableModel->setDatabase(d->dicomDatabase);
   if (d->dicomDatabase)
   {
     //Create connections for new database
@@ -465,9 +509,20 @@ void ctkDICOMTableView::onUpdateQuery(const QStringList& uids)
 {
   Q_D(ctkDICOMTableView);
 
+  d->foreignKeyUidsQuery.clear();
+  d->foreignKeyUidsQueryBindValues.clear();
   this->setQuery(uids);
 
-  bool showWarning = d->dicomSQLFilterModel->rowCount() == 0 &&
+  if (d->lazyLoading)
+  {
+    // filter warning is updated when the rows are counted
+    QVariantList bindValues;
+    QString uidsQuery = this->uidsForAllRowsQuery(bindValues);
+    emit uidsQueryChanged(uidsQuery, bindValues);
+    return;
+  }
+
+  bool showWarning = d->tblDicomDatabaseView->model()->rowCount() == 0 &&
     d->leSearchBox->text().length() != 0;
   d->showFilterActiveWarning(showWarning);
   emit showFilterActiveWarning(showWarning);
@@ -476,6 +531,23 @@ void ctkDICOMTableView::onUpdateQuery(const QStringList& uids)
   emit queryChanged(newUIDS);
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMTableView::onUpdateUidsQuery(const QString& uidsQuery, const QVariantList& bindValues)
+{
+  Q_D(ctkDICOMTableView);
+  if (!d->lazyLoading)
+  {
+    return;
+  }
+  d->foreignKeyUidsQuery = uidsQuery;
+  d->foreignKeyUidsQueryBindValues = bindValues;
+  this->setQuery();
+
+  QVariantList newBindValues;
+  QString newUidsQuery = this->uidsForAllRowsQuery(newBindValues);
+  emit uidsQueryChanged(newUidsQuery, newBindValues);
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMTableView::setFilterText(const QString& filterText)
 {
@@ -488,12 +560,26 @@ void ctkDICOMTableView::onFilterChanged(const QString& filterText)
 {
   Q_D(ctkDICOMTableView);
 
+  if (d->lazyLoading)
+  {
+    // Rows are counted in the background, filter warning is updated then.
+    // Dependent tables get the query of the rows instead of their uids.
+    d->dicomTableModel->setFilterText(filterText);
+    d->dicomTableModel->select();
+    d->tblDicomDatabaseView->clearSelection();
+    QVariantList bindValues;
+    QString uidsQuery = this->uidsForAllRowsQuery(bindValues);
+    emit uidsQueryChanged(uidsQuery, bindValues);
+    emit filterTextChanged(filterText);
+    return;
+  }
+
   d->dicomSQLFilterModel->setFilterWildcard(filterText);
+  bool showWarning = d->dicomSQLFilterModel->rowCount() == 0 &&
+    d->dicomSQLModel.rowCount() != 0;
 
   const QStringList uids = this->uidsForAllRows();
 
-  bool showWarning = d->dicomSQLFilterModel->rowCount() == 0 &&
-    d->dicomSQLModel.rowCount() != 0;
   d->showFilterActiveWarning(showWarning);
   emit showFilterActiveWarning(showWarning);
 
@@ -517,6 +603,20 @@ void ctkDICOMTableView::onInstanceAdded()
   this->setQuery();
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMTableView::onLazyRowCountChanged()
+{
+  Q_D(ctkDICOMTableView);
+  if (!d->lazyLoading)
+  {
+    return;
+  }
+  bool showWarning = d->dicomTableModel->rowCount() == 0 &&
+    !d->leSearchBox->text().isEmpty() && d->dicomTableModel->unfilteredRowCount() != 0;
+  d->showFilterActiveWarning(showWarning);
+  emit showFilterActiveWarning(showWarning);
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMTableView::selectAll()
 {
@@ -564,6 +664,43 @@ bool ctkDICOMTableView::eventFilter(QObject *obj, QEvent *event)
 void ctkDICOMTableView::setQuery(const QStringList &uids)
 {
   Q_D(ctkDICOMTableView);
+  if (d->lazyLoading)
+  {
+    // Conditions, filter and sorting are applied by the database
+    if (d->dicomDatabase != 0 && d->dicomDatabase->isOpen()
+      && (d->queryForeignKey.isEmpty() || !uids.empty() || !d->foreignKeyUidsQuery.isEmpty()) )
+    {
+      QHash<QString, QStringList> conditions = d->sqlWhereConditions;
+      QHash<QString, QPair<QString, QVariantList> > subqueryConditions;
+      if (!uids.empty() && d->queryForeignKey.length() != 0)
+      {
+        conditions.insert(d->queryTableName + "." + d->queryForeignKey, uids);
+      }
+      else if (!d->foreignKeyUidsQuery.isEmpty() && d->queryForeignKey.length() != 0)
+      {
+        subqueryConditions.insert(d->queryTableName + "." + d->queryForeignKey,
+          qMakePair(d->foreignKeyUidsQuery, d->foreignKeyUidsQueryBindValues));
+      }
+      int columnCountBefore = d->dicomTableModel->columnCount();
+      d->dicomTableModel->setTableName(d->queryTableName);
+      d->dicomTableModel->setConditions(conditions);
+      d->dicomTableModel->setSubqueryConditions(subqueryConditions);
+      d->dicomTableModel->setFilterText(d->leSearchBox->text());
+      d->dicomTableModel->select();
+      if (columnCountBefore == 0)
+      {
+        // columns have not been initialized yet
+        d->dicomDatabase->createDisplayedFieldIndexes(d->queryTableName);
+        d->applyColumnProperties();
+      }
+    }
+    else
+    {
+      d->dicomTableModel->clear();
+    }
+    return;
+  }
+
   QString query = ("select distinct %1.* from Patients, Series, Studies where "
                    "Patients.UID = Studies.PatientsUID and Studies.StudyInstanceUID = Series.StudyInstanceUID");
   int columnCountBefore = d->dicomSQLModel.columnCount();
@@ -622,7 +759,17 @@ QStringList ctkDICOMTableView::uidsForAllRows() const
   QAbstractItemModel* tableModel = d->tblDicomDatabaseView->model();
   int numberOfRows = tableModel->rowCount();
   QStringList uids;
-  if (numberOfRows == 0)
+  if (d->lazyLoading)
+  {
+    // Get all the values by a single query instead of fetching all the rows
+    uids = d->dicomTableModel->columnValues(0);
+    if (uids.isEmpty())
+    {
+      //Return invalid UID if there are no rows
+      uids << QString("#");
+    }
+  }
+  else if (numberOfRows == 0)
   {
     //Return invalid UID if there are no rows
     uids << QString("#");
@@ -637,6 +784,17 @@ QStringList ctkDICOMTableView::uidsForAllRows() const
   return uids;
 }
 
+//------------------------------------------------------------------------------
+QString ctkDICOMTableView::uidsForAllRowsQuery(QVariantList& bindValues) const
+{
+  Q_D(const ctkDICOMTableView);
+  if (!d->lazyLoading || d->dicomTableModel->columnCount() == 0)
+  {
+    return QString();
+  }
+  return d->dicomTableModel->columnValuesQuery(0, bindValues);
+}
+
 //------------------------------------------------------------------------------
 QStringList ctkDICOMTableView::currentSelection() const
 {
@@ -645,6 +803,20 @@ QStringList ctkDICOMTableView::currentSelection() const
   QModelIndexList currentSelection = d->tblDicomDatabaseView->selectionModel()->selectedRows(0);
   QStringList uids;
 
+  if (d->lazyLoading)
+  {
+    // Selected rows may not be fetched yet
+    if (!currentSelection.isEmpty() && currentSelection.count() == d->dicomTableModel->rowCount())
+    {
+      return d->dicomTableModel->columnValues(0);
+    }
+    foreach(QModelIndex i, currentSelection)
+    {
+      uids << d->dicomTableModel->value(i.row(), 0).toString();
+    }
+    return uids;
+  }
+
   foreach(QModelIndex i, currentSelection)
   {
     uids << i.data().toString();
@@ -724,3 +896,40 @@ void ctkDICOMTableView::setHeaderVisible(bool visible)
   Q_D(ctkDICOMTableView);
   return d->headerWidget->setVisible(visible);
 }
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTableView::isLazyLoading()const
+{
+  Q_D(const ctkDICOMTableView);
+  return d->lazyLoading;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTableView::setLazyLoading(bool enable)
+{
+  Q_D(ctkDICOMTableView);
+  if (enable == d->lazyLoading)
+  {
+    return;
+  }
+  d->lazyLoading = enable;
+  d->tblDicomDatabaseView->clearSelection();
+  if (d->lazyLoading)
+  {
+    d->dicomSQLModel.clear();
+    d->setViewModel(d->dicomTableModel);
+  }
+  else
+  {
+    d->dicomTableModel->clear();
+    d->setViewModel(d->dicomSQLFilterModel);
+  }
+  // Resizing rows to contents would require all the rows to be fetched
+  QHeaderView::ResizeMode rowResizeMode = d->lazyLoading ? QHeaderView::Fixed : QHeaderView::ResizeToContents;
+#if QT_VERSION < QT_VERSION_CHECK(5,0,0)
+  d->tblDicomDatabaseView->verticalHeader()->setResizeMode(rowResizeMode);
+#else
+  d->tblDicomDatabaseView->verticalHeader()->setSectionResizeMode(rowResizeMode);
+#endif
+  this->setQuery();
+}
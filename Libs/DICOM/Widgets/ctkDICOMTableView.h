@@ -23,6 +23,7 @@
 
 // Qt includes
 #include <QItemSelection>
+#include <QVariant>
 #include <QWidget>
 
 // ctkDICOMCore includes
@@ -46,6 +47,7 @@ class CTK_DICOM_WIDGETS_EXPORT ctkDICOMTableView : public QWidget
   Q_PROPERTY(bool filterActive READ filterActive)
   Q_PROPERTY(bool batchUpdate READ isBatchUpdate WRITE setBatchUpdate)
   Q_PROPERTY(bool headerVisible READ isHeaderVisible WRITE setHeaderVisible)
+  Q_PROPERTY(bool lazyLoading READ isLazyLoading WRITE setLazyLoading)
   Q_PROPERTY(QTableView* tblDicomDatabaseView READ tableView)
   Q_PROPERTY(QString queryTableName READ queryTableName WRITE setQueryTableName)
   Q_PROPERTY(QString queryForeignKey READ queryForeignKey WRITE setQueryForeignKey)
@@ -135,6 +137,14 @@ public:
    */
   QStringList uidsForAllRows() const;
 
+  /**
+   * @brief Getting a query that selects the UIDs of all rows, in lazy loading mode.
+   * The query is built from the current conditions and filter text, without executing it.
+   * @param bindValues values that must be bound to the placeholders of the query are appended to it
+   * @return the query, or an empty string if lazy loading is disabled
+   */
+  QString uidsForAllRowsQuery(QVariantList& bindValues) const;
+
   bool filterActive();
 
   /**
@@ -164,6 +174,18 @@ public:
   void setHeaderVisible(bool state);
   bool isHeaderVisible() const;
 
+  /**
+  * @brief Enable/disable lazy loading of the table.
+  * If enabled, filtering, sorting and counting of the rows are done by the database
+  * (see ctkDICOMTableModel) and only the displayed rows are fetched, in pages,
+  * by a background connection. This keeps the view responsive for large databases.
+  * If disabled (default), all the rows are loaded and filtered by the view.
+  * In lazy loading mode uidsQueryChanged() is emitted instead of queryChanged(),
+  * so that the rows of the table are not retrieved for updating the dependent tables.
+  */
+  void setLazyLoading(bool enable);
+  bool isLazyLoading() const;
+
 public Q_SLOTS:
   /**
    * @brief slot is called if the selection of the tableview is changed
@@ -177,6 +199,13 @@ public Q_SLOTS:
    */
   void onUpdateQuery(const QStringList &uids);
 
+  /**
+   * @brief Updates the query which is used for displaying the table content, in lazy loading mode
+   * @param uidsQuery query selecting the uids of the table entries which shall be displayed
+   * @param bindValues values bound to the placeholders of uidsQuery
+   */
+  void onUpdateUidsQuery(const QString& uidsQuery, const QVariantList& bindValues);
+
   /**
    * @brief Translates the local point to a global one
    * @param point the local point to translate to global
@@ -235,6 +264,11 @@ protected Q_SLOTS:
    */
   void onInstanceAdded();
 
+  /**
+   * @brief Called when the rows are counted in lazy loading mode
+   */
+  void onLazyRowCountChanged();
+
 protected:
   virtual bool eventFilter(QObject *obj, QEvent *event);
 
@@ -268,6 +302,13 @@ Q_SIGNALS:
    */
   void queryChanged(const QStringList &uids);
 
+  /**
+   * @brief Is emitted when the query has changed, in lazy loading mode
+   * @param uidsQuery query selecting the uids of the objects included in the query
+   * @param bindValues values bound to the placeholders of uidsQuery
+   */
+  void uidsQueryChanged(const QString& uidsQuery, const QVariantList& bindValues);
+
   void doubleClicked(const QModelIndex&);
 
 protected:
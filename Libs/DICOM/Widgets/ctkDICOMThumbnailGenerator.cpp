@@ -21,18 +21,47 @@
 
 // ctkDICOMCore includes
 #include "ctkDICOMThumbnailGenerator.h"
+#include "ctkDICOMThumbnailStore.h"
 #include "ctkLogger.h"
 
 // Qt includes
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
+#include <QHash>
 #include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QStringList>
+#include <QThreadPool>
+
+// STD includes
+#include <cstring>
 
 // DCMTK includes
 #include "dcmtk/dcmimgle/dcmimage.h"
 
 static ctkLogger logger ( "org.commontk.dicom.DICOMThumbnailGenerator" );
 
+//------------------------------------------------------------------------------
+/// Thumbnail request waiting in the generator queue.
+/// Thumbnail size settings are captured at the time the request is queued
+/// so the worker threads do not have to access the generator properties.
+struct ctkDICOMThumbnailGeneratorRequest
+{
+  QString SeriesInstanceUID;
+  QString DcmImagePath;
+  /// Thumbnail is saved in the store if set, in ThumbnailPath otherwise
+  QString ThumbnailPath;
+  ctkDICOMThumbnailStore* Store;
+  QString StudyInstanceUID;
+  QString SOPInstanceUID;
+  int Width;
+  int Height;
+  bool SmoothResize;
+};
+
 //------------------------------------------------------------------------------
 class ctkDICOMThumbnailGeneratorPrivate
 {
@@ -42,6 +71,18 @@ public:
   ctkDICOMThumbnailGeneratorPrivate(ctkDICOMThumbnailGenerator&);
   virtual ~ctkDICOMThumbnailGeneratorPrivate();
 
+  /// Render the image into a QImage that fits into width x height.
+  /// Thread-safe, it does not access any member variable.
+  static QImage renderImage(DicomImage* dcmImage, int width, int height, bool smoothResize);
+  /// Load only the first frame of the file
+  static DicomImage* loadFirstFrame(const QString& dcmImagePath);
+
+  /// Take the next request from the queue. Returns false if there is none,
+  /// in which case the calling task is considered finished.
+  bool takeNextRequest(ctkDICOMThumbnailGeneratorRequest& request);
+  /// Add the request to the queue and start a task if needed
+  void queueRequest(ctkDICOMThumbnailGeneratorRequest& request);
+
 protected:
   ctkDICOMThumbnailGenerator* const q_ptr;
 
@@ -49,6 +90,13 @@ protected:
   int Height;
   bool SmoothResize;
 
+  QThreadPool ThreadPool;
+  QMutex QueueMutex;
+  /// Series instance UIDs in the order they were requested
+  QStringList QueuedSeries;
+  QHash<QString, ctkDICOMThumbnailGeneratorRequest> QueuedRequests;
+  int ActiveTaskCount;
+
 private:
   Q_DISABLE_COPY( ctkDICOMThumbnailGeneratorPrivate );
 };
@@ -59,6 +107,7 @@ ctkDICOMThumbnailGeneratorPrivate::ctkDICOMThumbnailGeneratorPrivate(ctkDICOMThu
   , Width(256)
   , Height(256)
   , SmoothResize(false)
+  , ActiveTaskCount(0)
 {
 }
 
@@ -67,6 +116,191 @@ ctkDICOMThumbnailGeneratorPrivate::~ctkDICOMThumbnailGeneratorPrivate()
 {
 }
 
+//------------------------------------------------------------------------------
+QImage ctkDICOMThumbnailGeneratorPrivate::renderImage(DicomImage* dcmImage, int width, int height, bool smoothResize)
+{
+  // Check whether we have a valid image
+  EI_Status result = dcmImage->getStatus();
+  if (result != EIS_Normal)
+  {
+    qCritical() << Q_FUNC_INFO << QString("Rendering of DICOM image failed for thumbnail failed: ") + DicomImage::getString(result);
+    return QImage();
+  }
+  // Select first window defined in image. If none, compute min/max window as best guess.
+  // Only relevant for monochrome.
+  if (dcmImage->isMonochrome())
+  {
+    if (dcmImage->getWindowCount() > 0)
+    {
+      dcmImage->setWindow(0);
+    }
+    else
+    {
+      dcmImage->setMinMaxWindow(OFTrue /* ignore extreme values */);
+    }
+  }
+
+  const unsigned long imageWidth = dcmImage->getWidth();
+  const unsigned long imageHeight = dcmImage->getHeight();
+  if (imageWidth == 0 || imageHeight == 0 || width <= 0 || height <= 0)
+  {
+    return QImage();
+  }
+
+  // Let DCMTK downsample the (windowed) pixel data so that only
+  // thumbnail size pixels are rendered to 8-bit.
+  // The scaled image inherits the window settings of the original image.
+  DicomImage* renderedImage = dcmImage;
+  QScopedPointer<DicomImage> scaledImage;
+  const double scale = qMin(static_cast<double>(width) / imageWidth,
+                            static_cast<double>(height) / imageHeight);
+  if (scale < 1.)
+  {
+    const unsigned long scaledWidth = qMax(1UL, static_cast<unsigned long>(imageWidth * scale + 0.5));
+    const unsigned long scaledHeight = qMax(1UL, static_cast<unsigned long>(imageHeight * scale + 0.5));
+    // interpolation 1 is the pbmplus algorithm, which averages pixels when reducing
+    scaledImage.reset(dcmImage->createScaledImage(scaledWidth, scaledHeight, smoothResize ? 1 : 0));
+    if (scaledImage.isNull() || scaledImage->getStatus() != EIS_Normal)
+    {
+      logger.warn("Downsampling of DICOM image failed, rendering thumbnail from full resolution image");
+      scaledImage.reset();
+    }
+    else
+    {
+      renderedImage = scaledImage.data();
+    }
+  }
+
+  const unsigned long renderedWidth = renderedImage->getWidth();
+  const unsigned long renderedHeight = renderedImage->getHeight();
+  const bool monochrome = renderedImage->isMonochrome();
+  const unsigned long bytesPerPixel = monochrome ? 1 : 3 /* RGB */;
+  const unsigned long length = renderedWidth * renderedHeight * bytesPerPixel;
+
+  /* render pixel data to buffer */
+  QByteArray buffer;
+  buffer.resize(length);
+  if (!renderedImage->getOutputData(static_cast<void *>(buffer.data()), length, 8, 0))
+  {
+    qCritical() << Q_FUNC_INFO << "QImage couldn't created";
+    return QImage();
+  }
+
+  // Copy line by line, QImage lines are 32-bit aligned
+  QImage image(renderedWidth, renderedHeight, monochrome ? QImage::Format_Indexed8 : QImage::Format_RGB888);
+  if (monochrome)
+  {
+    QVector<QRgb> grayscaleTable(256);
+    for (int i = 0; i < 256; ++i)
+    {
+      grayscaleTable[i] = qRgb(i, i, i);
+    }
+    image.setColorTable(grayscaleTable);
+  }
+  const unsigned long bytesPerLine = renderedWidth * bytesPerPixel;
+  for (unsigned long y = 0; y < renderedHeight; ++y)
+  {
+    memcpy(image.scanLine(y), buffer.constData() + y * bytesPerLine, bytesPerLine);
+  }
+
+  if (image.width() != width || image.height() != height)
+  {
+    // Image is smaller than the thumbnail (or downsampling failed)
+    image = image.scaled(width, height, Qt::KeepAspectRatio,
+      (smoothResize ? Qt::SmoothTransformation : Qt::FastTransformation));
+  }
+  return image;
+}
+
+//------------------------------------------------------------------------------
+DicomImage* ctkDICOMThumbnailGeneratorPrivate::loadFirstFrame(const QString& dcmImagePath)
+{
+  // Partial access avoids decompressing all the frames of multi-frame images
+  return new DicomImage(QDir::toNativeSeparators(dcmImagePath).toUtf8(),
+    CIF_UsePartialAccessToPixelData, 0 /* first frame */, 1 /* frame count */);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailGeneratorPrivate::takeNextRequest(ctkDICOMThumbnailGeneratorRequest& request)
+{
+  QMutexLocker locker(&this->QueueMutex);
+  if (this->QueuedSeries.isEmpty())
+  {
+    --this->ActiveTaskCount;
+    return false;
+  }
+  QString seriesInstanceUID = this->QueuedSeries.takeFirst();
+  request = this->QueuedRequests.take(seriesInstanceUID);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+/// Generates queued thumbnails until the queue is empty
+class ctkDICOMThumbnailGeneratorTask : public QRunnable
+{
+public:
+  ctkDICOMThumbnailGeneratorTask(ctkDICOMThumbnailGenerator* generator)
+    : Generator(generator)
+  {
+  }
+
+  virtual void run()
+  {
+    ctkDICOMThumbnailGeneratorPrivate* d = this->Generator->d_func();
+    ctkDICOMThumbnailGeneratorRequest request;
+    while (d->takeNextRequest(request))
+    {
+      QScopedPointer<DicomImage> dcmImage(ctkDICOMThumbnailGeneratorPrivate::loadFirstFrame(request.DcmImagePath));
+      QImage image = ctkDICOMThumbnailGeneratorPrivate::renderImage(dcmImage.data(),
+        request.Width, request.Height, request.SmoothResize);
+      dcmImage.reset();
+      bool success = false;
+      if (!image.isNull() && request.Store)
+      {
+        success = ctkDICOMThumbnailGenerator::saveThumbnailImage(image, request.Store,
+          request.StudyInstanceUID, request.SeriesInstanceUID, request.SOPInstanceUID);
+      }
+      else if (!image.isNull())
+      {
+        QDir().mkpath(QFileInfo(request.ThumbnailPath).absolutePath());
+        success = image.save(request.ThumbnailPath, "PNG");
+      }
+      if (!success)
+      {
+        logger.warn("Failed to generate thumbnail for series " + request.SeriesInstanceUID
+          + " from " + request.DcmImagePath);
+      }
+      emit this->Generator->seriesThumbnailGenerated(request.SeriesInstanceUID,
+        success ? request.ThumbnailPath : QString());
+    }
+  }
+
+protected:
+  ctkDICOMThumbnailGenerator* Generator;
+};
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailGeneratorPrivate::queueRequest(ctkDICOMThumbnailGeneratorRequest& request)
+{
+  Q_Q(ctkDICOMThumbnailGenerator);
+  request.Width = this->Width;
+  request.Height = this->Height;
+  request.SmoothResize = this->SmoothResize;
+
+  QMutexLocker locker(&this->QueueMutex);
+  if (!this->QueuedRequests.contains(request.SeriesInstanceUID))
+  {
+    this->QueuedSeries.append(request.SeriesInstanceUID);
+  }
+  // A series needs only one thumbnail, the latest request replaces the previous one
+  this->QueuedRequests[request.SeriesInstanceUID] = request;
+  if (this->ActiveTaskCount < this->ThreadPool.maxThreadCount()
+    && this->ActiveTaskCount < this->QueuedSeries.count())
+  {
+    ++this->ActiveTaskCount;
+    this->ThreadPool.start(new ctkDICOMThumbnailGeneratorTask(q));
+  }
+}
 
 //------------------------------------------------------------------------------
 ctkDICOMThumbnailGenerator::ctkDICOMThumbnailGenerator(QObject* parentValue)
@@ -78,6 +312,24 @@ ctkDICOMThumbnailGenerator::ctkDICOMThumbnailGenerator(QObject* parentValue)
 //------------------------------------------------------------------------------
 ctkDICOMThumbnailGenerator::~ctkDICOMThumbnailGenerator()
 {
+  Q_D(ctkDICOMThumbnailGenerator);
+  // Tasks access the generator, they must be finished before it is deleted
+  this->cancelQueuedThumbnails();
+  d->ThreadPool.waitForDone();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailGenerator::maximumThreadCount()const
+{
+  Q_D(const ctkDICOMThumbnailGenerator);
+  return d->ThreadPool.maxThreadCount();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailGenerator::setMaximumThreadCount(int count)
+{
+  Q_D(ctkDICOMThumbnailGenerator);
+  d->ThreadPool.setMaxThreadCount(qMax(1, count));
 }
 
 //------------------------------------------------------------------------------
@@ -123,75 +375,196 @@ void ctkDICOMThumbnailGenerator::setSmoothResize(bool on)
 }
 
 //------------------------------------------------------------------------------
-bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const QString &path)
+QImage ctkDICOMThumbnailGenerator::renderThumbnailImage(DicomImage* dcmImage)
 {
   Q_D(ctkDICOMThumbnailGenerator);
+  return ctkDICOMThumbnailGeneratorPrivate::renderImage(dcmImage, d->Width, d->Height, d->SmoothResize);
+}
 
-  QImage image;
-  // Check whether we have a valid image
-  EI_Status result = dcmImage->getStatus();
-  if (result != EIS_Normal)
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const QString &path)
+{
+  QImage image = this->renderThumbnailImage(dcmImage);
+  if (image.isNull())
   {
-    qCritical() << Q_FUNC_INFO << QString("Rendering of DICOM image failed for thumbnail failed: ") + DicomImage::getString(result);
     return false;
   }
-  // Select first window defined in image. If none, compute min/max window as best guess.
-  // Only relevant for monochrome.
-  if (dcmImage->isMonochrome())
+  return image.save(path, "PNG");
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailGenerator::generateStoredThumbnail(DicomImage* dcmImage, ctkDICOMThumbnailStore* store,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID)
+{
+  QImage image = this->renderThumbnailImage(dcmImage);
+  if (image.isNull())
   {
-    if (dcmImage->getWindowCount() > 0)
+    return false;
+  }
+  return ctkDICOMThumbnailGenerator::saveThumbnailImage(image, store,
+    studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailGenerator::saveThumbnailImage(const QImage& image, ctkDICOMThumbnailStore* store,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID)
+{
+  if (!store || image.isNull())
+  {
+    return false;
+  }
+  ctkDICOMThumbnailStore::TileFormat format = ctkDICOMThumbnailStore::RGB888;
+  QImage tileImage;
+  if (image.format() == QImage::Format_Indexed8 && image.isGrayscale())
+  {
+    format = ctkDICOMThumbnailStore::Grayscale8;
+    tileImage = image;
+  }
+  else if (image.hasAlphaChannel())
+  {
+    format = ctkDICOMThumbnailStore::ARGB32;
+    tileImage = image.convertToFormat(QImage::Format_ARGB32);
+  }
+  else
+  {
+    tileImage = image.convertToFormat(QImage::Format_RGB888);
+  }
+  const int width = tileImage.width();
+  const int height = tileImage.height();
+  const int bytesPerLine = width * ctkDICOMThumbnailStore::bytesPerPixel(format);
+  QByteArray data;
+  data.resize(bytesPerLine * height);
+  for (int y = 0; y < height; ++y)
+  {
+    char* line = data.data() + y * bytesPerLine;
+    if (format == ctkDICOMThumbnailStore::Grayscale8)
     {
-      dcmImage->setWindow(0);
+      // Gray value of the color table entries
+      const uchar* indices = tileImage.constScanLine(y);
+      for (int x = 0; x < width; ++x)
+      {
+        line[x] = static_cast<char>(qGray(tileImage.color(indices[x])));
+      }
     }
     else
     {
-      dcmImage->setMinMaxWindow(OFTrue /* ignore extreme values */);
+      memcpy(line, tileImage.constScanLine(y), bytesPerLine);
     }
   }
-  /* get image extension and prepare image header */
-  const unsigned long width = dcmImage->getWidth();
-  const unsigned long height = dcmImage->getHeight();
-  unsigned long offset = 0;
-  unsigned long length = 0;
-  QString header;
+  return store->setThumbnail(studyInstanceUID, seriesInstanceUID, sopInstanceUID,
+    format, width, height, data);
+}
 
-  if (dcmImage->isMonochrome())
+//------------------------------------------------------------------------------
+QImage ctkDICOMThumbnailGenerator::loadThumbnailImage(ctkDICOMThumbnailStore* store,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID)
+{
+  if (!store)
   {
-    // write PGM header (binary monochrome image format)
-    header = QString("P5 %1 %2 255\n").arg(width).arg(height);
-    offset = header.length();
-    length = width * height + offset;
+    return QImage();
   }
-  else
+  ctkDICOMThumbnailStore::TileFormat format = ctkDICOMThumbnailStore::InvalidFormat;
+  int width = 0;
+  int height = 0;
+  QByteArray data = store->thumbnail(studyInstanceUID, seriesInstanceUID, sopInstanceUID,
+    &format, &width, &height);
+  if (data.isEmpty())
   {
-    // write PPM header (binary color image format)
-    header = QString("P6 %1 %2 255\n").arg(width).arg(height);
-    offset = header.length();
-    length = width * height * 3 /* RGB */ + offset;
+    return QImage();
   }
-  /* create output buffer for DicomImage class */
-  QByteArray buffer;
-  /* copy header to output buffer and resize it for pixel data */
-  buffer.append(header);
-  buffer.resize(length);
-
-  /* render pixel data to buffer */
-  if (dcmImage->getOutputData(static_cast<void *>(buffer.data() + offset), length - offset, 8, 0))
-  {  
-    if (!image.loadFromData( buffer ))
+  QImage image;
+  switch (format)
+  {
+    case ctkDICOMThumbnailStore::PNG:
+      image.loadFromData(data, "PNG");
+      return image;
+    case ctkDICOMThumbnailStore::Grayscale8:
     {
-      qCritical() << Q_FUNC_INFO << "QImage couldn't created";
-      return false;
+      image = QImage(width, height, QImage::Format_Indexed8);
+      QVector<QRgb> grayscaleTable(256);
+      for (int i = 0; i < 256; ++i)
+      {
+        grayscaleTable[i] = qRgb(i, i, i);
+      }
+      image.setColorTable(grayscaleTable);
+      break;
     }
+    case ctkDICOMThumbnailStore::RGB888:
+      image = QImage(width, height, QImage::Format_RGB888);
+      break;
+    case ctkDICOMThumbnailStore::ARGB32:
+      image = QImage(width, height, QImage::Format_ARGB32);
+      break;
+    default:
+      logger.error("Unsupported thumbnail format for instance " + sopInstanceUID);
+      return QImage();
   }
-  image.scaled( d->Width, d->Height, Qt::KeepAspectRatio,
-    (d->SmoothResize ? Qt::SmoothTransformation : Qt::FastTransformation) ).save(path,"PNG");
-  return true;
+  const int bytesPerLine = width * ctkDICOMThumbnailStore::bytesPerPixel(format);
+  if (data.size() != bytesPerLine * height)
+  {
+    logger.error("Invalid thumbnail size for instance " + sopInstanceUID);
+    return QImage();
+  }
+  // QImage lines are 32-bit aligned
+  for (int y = 0; y < height; ++y)
+  {
+    memcpy(image.scanLine(y), data.constData() + y * bytesPerLine, bytesPerLine);
+  }
+  return image;
 }
 
 //------------------------------------------------------------------------------
 bool ctkDICOMThumbnailGenerator::generateThumbnail(const QString dcmImagePath, const QString& thumbnailPath)
 {
-  DicomImage dcmImage(QDir::toNativeSeparators(dcmImagePath).toUtf8());
-  return this->generateThumbnail(&dcmImage, thumbnailPath); 
+  QScopedPointer<DicomImage> dcmImage(ctkDICOMThumbnailGeneratorPrivate::loadFirstFrame(dcmImagePath));
+  return this->generateThumbnail(dcmImage.data(), thumbnailPath);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailGenerator::queueSeriesThumbnail(const QString& seriesInstanceUID,
+  const QString& dcmImagePath, const QString& thumbnailPath)
+{
+  Q_D(ctkDICOMThumbnailGenerator);
+  ctkDICOMThumbnailGeneratorRequest request;
+  request.SeriesInstanceUID = seriesInstanceUID;
+  request.DcmImagePath = dcmImagePath;
+  request.ThumbnailPath = thumbnailPath;
+  request.Store = 0;
+  d->queueRequest(request);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailGenerator::queueSeriesThumbnail(ctkDICOMThumbnailStore* store,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID,
+  const QString& sopInstanceUID, const QString& dcmImagePath)
+{
+  Q_D(ctkDICOMThumbnailGenerator);
+  if (!store)
+  {
+    return;
+  }
+  ctkDICOMThumbnailGeneratorRequest request;
+  request.SeriesInstanceUID = seriesInstanceUID;
+  request.DcmImagePath = dcmImagePath;
+  request.ThumbnailPath = store->seriesFilePath(studyInstanceUID, seriesInstanceUID);
+  request.Store = store;
+  request.StudyInstanceUID = studyInstanceUID;
+  request.SOPInstanceUID = sopInstanceUID;
+  d->queueRequest(request);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailGenerator::cancelQueuedThumbnails()
+{
+  Q_D(ctkDICOMThumbnailGenerator);
+  QMutexLocker locker(&d->QueueMutex);
+  d->QueuedSeries.clear();
+  d->QueuedRequests.clear();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailGenerator::waitForQueuedThumbnails(int msecTimeout)
+{
+  Q_D(ctkDICOMThumbnailGenerator);
+  return d->ThreadPool.waitForDone(msecTimeout);
 }
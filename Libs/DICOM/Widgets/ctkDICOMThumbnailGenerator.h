@@ -22,6 +22,9 @@
 #ifndef __ctkDICOMThumbnailGenerator_h
 #define __ctkDICOMThumbnailGenerator_h
 
+// Qt includes
+#include <QImage>
+
 // CTK includes
 #include "ctkDICOMWidgetsExport.h"
 #include "ctkDICOMAbstractThumbnailGenerator.h"
@@ -39,6 +42,7 @@ class CTK_DICOM_WIDGETS_EXPORT ctkDICOMThumbnailGenerator : public ctkDICOMAbstr
   Q_PROPERTY(int width READ width WRITE setWidth)
   Q_PROPERTY(int height READ height WRITE setHeight)
   Q_PROPERTY(bool smoothResize READ smoothResize WRITE setSmoothResize)
+  Q_PROPERTY(int maximumThreadCount READ maximumThreadCount WRITE setMaximumThreadCount)
 
 public:
   ///  \brief Construct a ctkDICOMThumbnailGenerator object
@@ -47,8 +51,50 @@ public:
 
   virtual bool generateThumbnail(DicomImage* dcmImage, const QString& path);
 
+  /// Generate thumbnail and save it in the thumbnail store
+  virtual bool generateStoredThumbnail(DicomImage* dcmImage, ctkDICOMThumbnailStore* store,
+    const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID);
+
+  /// Generate thumbnail from the first frame of a DICOM file.
+  /// Only the first frame is decoded.
   Q_INVOKABLE bool generateThumbnail(const QString dcmImagePath, const QString& thumbnailPath);
 
+  /// Render the image directly into a QImage of thumbnail size.
+  /// The image is downsampled by DCMTK before rendering, so the full
+  /// resolution image is never converted to 8-bit pixels.
+  /// Returns a null image if rendering failed.
+  QImage renderThumbnailImage(DicomImage* dcmImage);
+
+  /// Generate a thumbnail in a background thread.
+  /// Requests are keyed by series: if a thumbnail of the same series is already
+  /// waiting to be generated then only the latest request is kept.
+  /// seriesThumbnailGenerated is emitted when the thumbnail is written.
+  Q_INVOKABLE void queueSeriesThumbnail(const QString& seriesInstanceUID,
+    const QString& dcmImagePath, const QString& thumbnailPath);
+  /// Generate a thumbnail in a background thread and save it in the thumbnail store.
+  /// The thumbnailPath of seriesThumbnailGenerated is the series file of the store.
+  /// The store must remain valid until the thumbnail is generated.
+  void queueSeriesThumbnail(ctkDICOMThumbnailStore* store, const QString& studyInstanceUID,
+    const QString& seriesInstanceUID, const QString& sopInstanceUID, const QString& dcmImagePath);
+  /// Remove all thumbnail requests that are not started yet
+  Q_INVOKABLE void cancelQueuedThumbnails();
+  /// Wait until all queued thumbnails are generated.
+  /// Returns false if msecTimeout (if >=0) elapsed before.
+  Q_INVOKABLE bool waitForQueuedThumbnails(int msecTimeout = -1);
+
+  /// Number of threads that generate queued thumbnails.
+  /// Default is the number of processor cores.
+  void setMaximumThreadCount(int count);
+  int maximumThreadCount() const;
+
+  /// Save an image in a thumbnail store
+  static bool saveThumbnailImage(const QImage& image, ctkDICOMThumbnailStore* store,
+    const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID);
+  /// Load an image from a thumbnail store.
+  /// Returns a null image if the store has no thumbnail for the instance.
+  static QImage loadThumbnailImage(ctkDICOMThumbnailStore* store,
+    const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID);
+
   /// Set thumbnail width
   void setWidth(int width);
   /// Get thumbnail width
@@ -63,9 +109,16 @@ public:
   /// Get thumbnail height
   bool smoothResize() const;
 
+Q_SIGNALS:
+  /// Emitted from the generator thread when a queued thumbnail has been written.
+  /// thumbnailPath is empty if the thumbnail could not be generated.
+  void seriesThumbnailGenerated(const QString& seriesInstanceUID, const QString& thumbnailPath);
+
 protected:
   QScopedPointer<ctkDICOMThumbnailGeneratorPrivate> d_ptr;
 
+  friend class ctkDICOMThumbnailGeneratorTask;
+
 private:
   Q_DECLARE_PRIVATE(ctkDICOMThumbnailGenerator);
   Q_DISABLE_COPY(ctkDICOMThumbnailGenerator);
@@ -27,8 +27,11 @@
 #include <QMetaType>
 #include <QPersistentModelIndex>
 #include <QPixmap>
+#include <QPointer>
 #include <QPushButton>
 #include <QResizeEvent>
+#include <QScrollBar>
+#include <QTimer>
 
 // ctk includes
 #include "ctkLogger.h"
@@ -42,8 +45,10 @@
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMFilterProxyModel.h"
 #include "ctkDICOMModel.h"
+#include "ctkDICOMThumbnailStore.h"
 
 // ctkDICOMWidgets includes
+#include "ctkDICOMThumbnailGenerator.h"
 #include "ctkDICOMThumbnailListWidget.h"
 #include "ctkThumbnailLabel.h"
 
@@ -68,8 +73,14 @@ public:
 
   QString DatabaseDirectory;
   QModelIndex CurrentSelectedModel;
+  QPointer<ctkDICOMThumbnailGenerator> ThumbnailGenerator;
+  ctkDICOMThumbnailStore* ThumbnailStore;
 
-  void addThumbnailWidget(const QModelIndex &imageIndex, const QModelIndex& sourceIndex, const QString& text);
+  /// Add the thumbnail of the image.
+  /// If the thumbnail file is missing and queueMissingThumbnail is true, an empty
+  /// thumbnail is added and the thumbnail of the series is queued in the generator.
+  void addThumbnailWidget(const QModelIndex &imageIndex, const QModelIndex& sourceIndex, const QString& text,
+                          bool queueMissingThumbnail = false);
 
   void addPatientThumbnails(const QModelIndex& patientIndex);
   void addStudyThumbnails(const QModelIndex& studyIndex);
@@ -86,6 +97,7 @@ private:
 ctkDICOMThumbnailListWidgetPrivate
 ::ctkDICOMThumbnailListWidgetPrivate(ctkDICOMThumbnailListWidget* parent)
   : Superclass(parent)
+  , ThumbnailStore(0)
 {
 
 }
@@ -112,7 +124,7 @@ void ctkDICOMThumbnailListWidgetPrivate
       const int imageCount = model->rowCount(seriesIndex);
       QModelIndex imageIndex = seriesIndex.child(imageCount/2, 0);
       QString study = model->data(studyIndex, Qt::DisplayRole).toString();
-      this->addThumbnailWidget(imageIndex, studyIndex, study);
+      this->addThumbnailWidget(imageIndex, studyIndex, study, true);
       }
     }
 }
@@ -138,7 +150,7 @@ void ctkDICOMThumbnailListWidgetPrivate
     model->fetchMore(seriesIndex);
     int imageCount = model->rowCount(seriesIndex);
     QModelIndex imageIndex = seriesIndex.child(imageCount/2, 0);
-    this->addThumbnailWidget(imageIndex, seriesIndex, model->data(seriesIndex, Qt::DisplayRole).toString());
+    this->addThumbnailWidget(imageIndex, seriesIndex, model->data(seriesIndex, Qt::DisplayRole).toString(), true);
     }
 }
 
@@ -169,7 +181,8 @@ void ctkDICOMThumbnailListWidgetPrivate
 //----------------------------------------------------------------------------
 void ctkDICOMThumbnailListWidgetPrivate
 ::addThumbnailWidget(const QModelIndex& imageIndex,
-                     const QModelIndex& sourceIndex, const QString &text)
+                     const QModelIndex& sourceIndex, const QString &text,
+                     bool queueMissingThumbnail)
 {
   ctkDICOMModel* model = const_cast<ctkDICOMModel*>(
     qobject_cast<const ctkDICOMModel*>(imageIndex.model()));
@@ -181,11 +194,17 @@ void ctkDICOMThumbnailListWidgetPrivate
   QModelIndex seriesIndex = imageIndex.parent();
   QModelIndex studyIndex = seriesIndex.parent();
 
+  QString studyInstanceUID = model->data(studyIndex ,ctkDICOMModel::UIDRole).toString();
+  QString seriesInstanceUID = model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString();
+  QString sopInstanceUID = model->data(imageIndex, ctkDICOMModel::UIDRole).toString();
   QString thumbnailPath = this->DatabaseDirectory +
-                          "/thumbs/" + model->data(studyIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                          model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                          model->data(imageIndex, ctkDICOMModel::UIDRole).toString() + ".png";
-  if(!QFileInfo(thumbnailPath).exists())
+                          "/thumbs/" + studyInstanceUID + "/" +
+                          seriesInstanceUID + "/" +
+                          sopInstanceUID + ".png";
+  bool thumbnailStored = this->ThumbnailStore &&
+    this->ThumbnailStore->contains(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+  bool thumbnailExists = thumbnailStored || QFileInfo(thumbnailPath).exists();
+  if(!thumbnailExists && (!queueMissingThumbnail || this->ThumbnailGenerator.isNull()))
     {
     return;
     }
@@ -193,13 +212,44 @@ void ctkDICOMThumbnailListWidgetPrivate
 
   QString widgetLabel = text;
   widget->setText( widgetLabel );
-  QPixmap pix(thumbnailPath);
-  logger.debug("Setting pixmap to " + thumbnailPath);
   if(this->ThumbnailSize.isValid())
     {
     widget->setFixedSize(this->ThumbnailSize);
     }
-  widget->setPixmap(pix);
+  widget->setProperty("studyInstanceUID", studyInstanceUID);
+  widget->setProperty("seriesInstanceUID", seriesInstanceUID);
+  widget->setProperty("sopInstanceUID", sopInstanceUID);
+  if(thumbnailStored)
+    {
+    // Decoded by loadVisibleThumbnails() when the widget is scrolled into view
+    widget->setProperty("thumbnailPending", true);
+    }
+  else if(thumbnailExists)
+    {
+    QPixmap pix(thumbnailPath);
+    logger.debug("Setting pixmap to " + thumbnailPath);
+    widget->setPixmap(pix);
+    }
+  else
+    {
+    // Only the displayed image of the series is decoded, the pixmap
+    // is set when the generator is done.
+    QString imagePath = model->data(imageIndex, Qt::DisplayRole).toString();
+    if (QFileInfo(imagePath).isRelative())
+      {
+      imagePath = this->DatabaseDirectory + "/" + imagePath;
+      }
+    widget->setProperty("thumbnailQueued", true);
+    if (this->ThumbnailStore)
+      {
+      this->ThumbnailGenerator->queueSeriesThumbnail(this->ThumbnailStore,
+        studyInstanceUID, seriesInstanceUID, sopInstanceUID, imagePath);
+      }
+    else
+      {
+      this->ThumbnailGenerator->queueSeriesThumbnail(seriesInstanceUID, imagePath, thumbnailPath);
+      }
+    }
 
   QVariant var;
   var.setValue(QPersistentModelIndex(sourceIndex));
@@ -215,7 +265,11 @@ void ctkDICOMThumbnailListWidgetPrivate
 ctkDICOMThumbnailListWidget::ctkDICOMThumbnailListWidget(QWidget* _parent)
   : Superclass(new ctkDICOMThumbnailListWidgetPrivate(this), _parent)
 {
-
+  Q_D(ctkDICOMThumbnailListWidget);
+  connect(d->ScrollArea->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          this, SLOT(loadVisibleThumbnails()));
+  connect(d->ScrollArea->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+          this, SLOT(loadVisibleThumbnails()));
 }
 
 //----------------------------------------------------------------------------
@@ -231,6 +285,115 @@ void ctkDICOMThumbnailListWidget::setDatabaseDirectory(const QString &directory)
   d->DatabaseDirectory = directory;
 }
 
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::setThumbnailGenerator(ctkDICOMThumbnailGenerator* generator)
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+  if (d->ThumbnailGenerator == generator)
+    {
+    return;
+    }
+  if (d->ThumbnailGenerator)
+    {
+    disconnect(d->ThumbnailGenerator, SIGNAL(seriesThumbnailGenerated(QString,QString)),
+               this, SLOT(onSeriesThumbnailGenerated(QString,QString)));
+    }
+  d->ThumbnailGenerator = generator;
+  if (d->ThumbnailGenerator)
+    {
+    connect(d->ThumbnailGenerator, SIGNAL(seriesThumbnailGenerated(QString,QString)),
+            this, SLOT(onSeriesThumbnailGenerated(QString,QString)));
+    }
+}
+
+//----------------------------------------------------------------------------
+ctkDICOMThumbnailGenerator* ctkDICOMThumbnailListWidget::thumbnailGenerator()const
+{
+  Q_D(const ctkDICOMThumbnailListWidget);
+  return d->ThumbnailGenerator;
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::setThumbnailStore(ctkDICOMThumbnailStore* store)
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+  d->ThumbnailStore = store;
+}
+
+//----------------------------------------------------------------------------
+ctkDICOMThumbnailStore* ctkDICOMThumbnailListWidget::thumbnailStore()const
+{
+  Q_D(const ctkDICOMThumbnailListWidget);
+  return d->ThumbnailStore;
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::loadVisibleThumbnails()
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+  if (!d->ThumbnailStore)
+    {
+    return;
+    }
+  QLayout* layout = d->ScrollAreaContentWidget->layout();
+  for (int i = 0; i < layout->count(); ++i)
+    {
+    ctkThumbnailLabel* thumbnailWidget = qobject_cast<ctkThumbnailLabel*>(layout->itemAt(i)->widget());
+    if (!thumbnailWidget ||
+        !thumbnailWidget->property("thumbnailPending").toBool() ||
+        thumbnailWidget->visibleRegion().isEmpty())
+      {
+      continue;
+      }
+    QImage image = ctkDICOMThumbnailGenerator::loadThumbnailImage(d->ThumbnailStore,
+      thumbnailWidget->property("studyInstanceUID").toString(),
+      thumbnailWidget->property("seriesInstanceUID").toString(),
+      thumbnailWidget->property("sopInstanceUID").toString());
+    thumbnailWidget->setPixmap(QPixmap::fromImage(image));
+    thumbnailWidget->setProperty("thumbnailPending", QVariant());
+    }
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::resizeEvent(QResizeEvent* event)
+{
+  this->Superclass::resizeEvent(event);
+  // More thumbnails may be visible once the layout is updated
+  QTimer::singleShot(0, this, SLOT(loadVisibleThumbnails()));
+}
+
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::onSeriesThumbnailGenerated(const QString& seriesInstanceUID,
+                                                             const QString& thumbnailPath)
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+  if (thumbnailPath.isEmpty())
+    {
+    return;
+    }
+  QLayout* layout = d->ScrollAreaContentWidget->layout();
+  for (int i = 0; i < layout->count(); ++i)
+    {
+    ctkThumbnailLabel* thumbnailWidget = qobject_cast<ctkThumbnailLabel*>(layout->itemAt(i)->widget());
+    if (thumbnailWidget &&
+        thumbnailWidget->property("thumbnailQueued").toBool() &&
+        thumbnailWidget->property("seriesInstanceUID").toString() == seriesInstanceUID)
+      {
+      thumbnailWidget->setProperty("thumbnailQueued", QVariant());
+      if (d->ThumbnailStore)
+        {
+        thumbnailWidget->setProperty("thumbnailPending", true);
+        }
+      else
+        {
+        logger.debug("Setting pixmap to " + thumbnailPath);
+        thumbnailWidget->setPixmap(QPixmap(thumbnailPath));
+        }
+      }
+    }
+  this->loadVisibleThumbnails();
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMThumbnailListWidget::selectThumbnailFromIndex(const QModelIndex &index){
   Q_D(ctkDICOMThumbnailListWidget);
@@ -272,6 +435,11 @@ void ctkDICOMThumbnailListWidget::addThumbnails(const QModelIndex &index)
   Q_D(ctkDICOMThumbnailListWidget);
 
   this->clearThumbnails();
+  if (d->ThumbnailGenerator)
+    {
+    // Thumbnails of the previous selection are not displayed anymore
+    d->ThumbnailGenerator->cancelQueuedThumbnails();
+    }
 
   ctkDICOMModel* model = const_cast<ctkDICOMModel*>(qobject_cast<const ctkDICOMModel*>(index.model()));
 
@@ -296,4 +464,5 @@ void ctkDICOMThumbnailListWidget::addThumbnails(const QModelIndex &index)
     }
 
   this->setCurrentThumbnail(0);
+  QTimer::singleShot(0, this, SLOT(loadVisibleThumbnails()));
 }
@@ -25,6 +25,8 @@
 #include "ctkThumbnailListWidget.h"
 
 class QModelIndex;
+class ctkDICOMThumbnailGenerator;
+class ctkDICOMThumbnailStore;
 class ctkDICOMThumbnailListWidgetPrivate;
 class ctkThumbnailWidget;
 
@@ -39,6 +41,20 @@ public:
 
   void setDatabaseDirectory(const QString& directory);
 
+  /// Generator used to create the missing series thumbnails of patients
+  /// and studies in the background. The thumbnails are displayed as soon
+  /// as they are generated. If no generator is set (default), images
+  /// without thumbnail are not displayed.
+  void setThumbnailGenerator(ctkDICOMThumbnailGenerator* generator);
+  ctkDICOMThumbnailGenerator* thumbnailGenerator()const;
+
+  /// Store from which thumbnails are read and into which missing thumbnails
+  /// are generated. Stored thumbnails are only decoded when they become visible.
+  /// Thumbnail files in the database directory are still displayed.
+  /// The store is not owned by the widget.
+  void setThumbnailStore(ctkDICOMThumbnailStore* store);
+  ctkDICOMThumbnailStore* thumbnailStore()const;
+
   void selectThumbnailFromIndex(const QModelIndex& index);
 
 private:
@@ -47,6 +63,14 @@ private:
 
 public Q_SLOTS:
   void addThumbnails(const QModelIndex& index);
+
+protected Q_SLOTS:
+  void onSeriesThumbnailGenerated(const QString& seriesInstanceUID, const QString& thumbnailPath);
+  /// Decode the stored thumbnails that are in the visible part of the widget
+  void loadVisibleThumbnails();
+
+protected:
+  virtual void resizeEvent(QResizeEvent* event);
 };
 
 #endif
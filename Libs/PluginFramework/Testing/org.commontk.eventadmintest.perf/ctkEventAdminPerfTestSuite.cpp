@@ -43,12 +43,58 @@ void TestEventHandler::handleEvent(const ctkEvent& )
   counter++;
 }
 
+//----------------------------------------------------------------------------
+OrderCheckingEventHandler::OrderCheckingEventHandler()
+  : ordered(true), counter(0)
+{}
+
+//----------------------------------------------------------------------------
+bool OrderCheckingEventHandler::isOrdered()
+{
+  QMutexLocker l(&mutex);
+  return ordered;
+}
+
+//----------------------------------------------------------------------------
+void OrderCheckingEventHandler::handleEvent(const ctkEvent& event)
+{
+  int publisher = event.getProperty("publisher").toInt();
+  int level = event.getProperty("level").toInt();
+  {
+    QMutexLocker l(&mutex);
+    if (level != lastLevels.value(publisher, -1) + 1)
+    {
+      ordered = false;
+    }
+    lastLevels.insert(publisher, level);
+  }
+  counter.fetchAndAddOrdered(1);
+}
+
+//----------------------------------------------------------------------------
+PostEventsThread::PostEventsThread(ctkEventAdmin* eventAdmin, int publisher, int nEvents)
+  : eventAdmin(eventAdmin), publisher(publisher), nEvents(nEvents)
+{}
+
+//----------------------------------------------------------------------------
+void PostEventsThread::run()
+{
+  for (int i = 0; i < nEvents; ++i)
+  {
+    ctkDictionary props;
+    props.insert("publisher", publisher);
+    props.insert("level", i);
+    eventAdmin->postEvent(ctkEvent("org/bla/concurrent", props));
+  }
+}
+
 //----------------------------------------------------------------------------
 ctkEventAdminPerfTestSuite::ctkEventAdminPerfTestSuite(ctkPluginContext *context, int pluginId)
   : pc(context)
   , pluginId(pluginId)
   , nSendEvents(400)
   , nHandlers(40)
+  , nPublishers(4)
   , nEvent1Handled(0)
   , nEvent2Handled(0)
   , eventAdmin(0)
@@ -172,6 +218,50 @@ void ctkEventAdminPerfTestSuite::testPostEvents()
   QTest::qWait(10000);
 }
 
+//----------------------------------------------------------------------------
+void ctkEventAdminPerfTestSuite::testPostEventsConcurrently()
+{
+  OrderCheckingEventHandler handler;
+  ctkDictionary props;
+  props.insert(ctkEventConstants::EVENT_TOPIC, "org/bla/concurrent");
+  ctkServiceRegistration registration = pc->registerService<ctkEventHandler>(&handler, props);
+
+  const int nEvents = nPublishers * nSendEvents * 10;
+  QList<PostEventsThread*> publishers;
+  for (int i = 0; i < nPublishers; ++i)
+  {
+    publishers.push_back(new PostEventsThread(eventAdmin, i, nSendEvents * 10));
+  }
+
+  QTime t;
+  t.start();
+  foreach(PostEventsThread* publisher, publishers)
+  {
+    publisher->start();
+  }
+  foreach(PostEventsThread* publisher, publishers)
+  {
+    publisher->wait();
+  }
+  int postMs = t.elapsed();
+
+  // wait for the asynchronous handling of all events
+  while (handler.counter.fetchAndAddOrdered(0) < nEvents && t.elapsed() < 30000)
+  {
+    QTest::qWait(1);
+  }
+  int ms = t.elapsed();
+
+  registration.unregister();
+  qDeleteAll(publishers);
+
+  QCOMPARE(handler.counter.fetchAndAddOrdered(0), nEvents);
+  QVERIFY2(handler.isOrdered(), "Events of a publisher were delivered out of order");
+  qDebug() << nPublishers << "threads posting" << nEvents << "asynchronous events took"
+           << postMs << "ms, delivering them took" << ms << "ms ("
+           << (ms > 0 ? nEvents * 1000 / ms : nEvents) << "events/s)";
+}
+
 //----------------------------------------------------------------------------
 void ctkEventAdminPerfTestSuite::cleanupTestCase()
 {
@@ -28,7 +28,11 @@
 #include <service/event/ctkEventHandler.h>
 #include <ctkServiceRegistration.h>
 
+#include <QAtomicInt>
 #include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
 
 struct ctkEventAdmin;
 
@@ -44,6 +48,7 @@ private:
 
   int nSendEvents;
   int nHandlers;
+  int nPublishers;
 
   int nEvent1Handled;
   int nEvent2Handled;
@@ -70,6 +75,7 @@ private Q_SLOTS:
   void initTestCase();
   void testSendEvents();
   void testPostEvents();
+  void testPostEventsConcurrently();
   void cleanupTestCase();
 };
 
@@ -84,4 +90,37 @@ public:
   void handleEvent(const ctkEvent& );
 };
 
+/**
+ * Counts the received events and checks that the events posted by
+ * each publisher are received in the order they were posted.
+ */
+class OrderCheckingEventHandler : public QObject, public ctkEventHandler
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkEventHandler)
+private:
+  QMutex mutex;
+  QHash<int, int> lastLevels;
+  bool ordered;
+public:
+  QAtomicInt counter;
+  OrderCheckingEventHandler();
+  bool isOrdered();
+  void handleEvent(const ctkEvent& event);
+};
+
+/**
+ * Posts events tagged with a publisher number and a level.
+ */
+class PostEventsThread : public QThread
+{
+private:
+  ctkEventAdmin* eventAdmin;
+  int publisher;
+  int nEvents;
+public:
+  PostEventsThread(ctkEventAdmin* eventAdmin, int publisher, int nEvents);
+  void run();
+};
+
 #endif // CTKEAPERFTESTSUITE_P_H
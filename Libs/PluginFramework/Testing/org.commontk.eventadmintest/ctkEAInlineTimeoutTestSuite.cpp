@@ -0,0 +1,160 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#include "ctkEAInlineTimeoutTestSuite_p.h"
+
+#include <ctkPluginContext.h>
+#include <ctkPluginConstants.h>
+
+#include <service/event/ctkEventAdmin.h>
+#include <service/event/ctkEventConstants.h>
+
+#include <QTest>
+#include <QThread>
+
+// The topics "a/b/*" are delivered inline (see ctkEventAdminImplTestMain.cpp)
+// and the default timeout of handlers is 5000 ms.
+static const int HANDLER_TIMEOUT = 5000;
+static const QString SYNC_MASTER_THREAD_NAME = "ctkEASyncMasterThread";
+
+//----------------------------------------------------------------------------
+ctkEAInlineTimeoutTestHelper::ctkEAInlineTimeoutTestHelper(
+  ctkEventAdmin* eventAdmin, const QString& nestedTopic, int sleepTime)
+  : eventAdmin(eventAdmin), nestedTopic(nestedTopic), sleepTime(sleepTime),
+    count(0)
+{
+
+}
+
+//----------------------------------------------------------------------------
+void ctkEAInlineTimeoutTestHelper::handleEvent(const ctkEvent& event)
+{
+  Q_UNUSED(event)
+
+  {
+    QMutexLocker l(&mutex);
+    ++count;
+    threadName = QThread::currentThread()->objectName();
+  }
+
+  if (sleepTime > 0)
+  {
+    QTest::qSleep(sleepTime);
+  }
+
+  if (eventAdmin && !nestedTopic.isEmpty())
+  {
+    eventAdmin->sendEvent(ctkEvent(nestedTopic));
+  }
+}
+
+//----------------------------------------------------------------------------
+int ctkEAInlineTimeoutTestHelper::eventCount() const
+{
+  QMutexLocker l(&mutex);
+  return count;
+}
+
+//----------------------------------------------------------------------------
+QString ctkEAInlineTimeoutTestHelper::lastThreadName() const
+{
+  QMutexLocker l(&mutex);
+  return threadName;
+}
+
+//----------------------------------------------------------------------------
+ctkEAInlineTimeoutTestSuite::ctkEAInlineTimeoutTestSuite(
+  ctkPluginContext* pc, long eventPluginId)
+  : context(pc), eventPluginId(eventPluginId), eventAdmin(0)
+{
+
+}
+
+//----------------------------------------------------------------------------
+void ctkEAInlineTimeoutTestSuite::init()
+{
+  // restarting the EventAdmin also forgets the slow handler classes
+  context->getPlugin(eventPluginId)->start();
+  reference = context->getServiceReference<ctkEventAdmin>();
+  eventAdmin = context->getService<ctkEventAdmin>(reference);
+}
+
+//----------------------------------------------------------------------------
+void ctkEAInlineTimeoutTestSuite::cleanup()
+{
+  context->ungetService(reference);
+  context->getPlugin(eventPluginId)->stop();
+}
+
+//----------------------------------------------------------------------------
+void ctkEAInlineTimeoutTestSuite::testNestedSendEvent()
+{
+  ctkDictionary outerProperties;
+  outerProperties.insert(ctkEventConstants::EVENT_TOPIC, "a/b/inline/outer");
+  ctkEAInlineTimeoutTestHelper outerHandler(eventAdmin, "a/b/inline/inner");
+  ctkServiceRegistration outerRegistration = context->registerService<ctkEventHandler>(&outerHandler, outerProperties);
+
+  ctkDictionary innerProperties;
+  innerProperties.insert(ctkEventConstants::EVENT_TOPIC, "a/b/inline/inner");
+  ctkEAInlineTimeoutTestHelper innerHandler;
+  ctkServiceRegistration innerRegistration = context->registerService<ctkEventHandler>(&innerHandler, innerProperties);
+
+  eventAdmin->sendEvent(ctkEvent("a/b/inline/outer"));
+
+  QCOMPARE(outerHandler.eventCount(), 1);
+  QCOMPARE(outerHandler.lastThreadName(), SYNC_MASTER_THREAD_NAME);
+  QVERIFY2(innerHandler.eventCount() == 1, "Did not receive the event sent by a handler called inline");
+  QCOMPARE(innerHandler.lastThreadName(), SYNC_MASTER_THREAD_NAME);
+
+  innerRegistration.unregister();
+  outerRegistration.unregister();
+}
+
+//----------------------------------------------------------------------------
+void ctkEAInlineTimeoutTestSuite::testSlowInlineHandler()
+{
+  ctkDictionary properties;
+  properties.insert(ctkEventConstants::EVENT_TOPIC, "a/b/inline/slow");
+  ctkEAInlineTimeoutTestHelper slowHandler(0, QString(), HANDLER_TIMEOUT + 500);
+  ctkServiceRegistration slowRegistration = context->registerService<ctkEventHandler>(&slowHandler, properties);
+
+  // the handler is called inline and the watchdog blacklists it
+  eventAdmin->sendEvent(ctkEvent("a/b/inline/slow"));
+  QCOMPARE(slowHandler.eventCount(), 1);
+  QCOMPARE(slowHandler.lastThreadName(), SYNC_MASTER_THREAD_NAME);
+
+  eventAdmin->sendEvent(ctkEvent("a/b/inline/slow"));
+  QVERIFY2(slowHandler.eventCount() == 1, "Received an event after exceeding the timeout");
+
+  // other handlers of the same class are now called from a pooled thread
+  ctkEAInlineTimeoutTestHelper handler;
+  ctkServiceRegistration registration = context->registerService<ctkEventHandler>(&handler, properties);
+  eventAdmin->sendEvent(ctkEvent("a/b/inline/slow"));
+  QCOMPARE(handler.eventCount(), 1);
+  QVERIFY2(handler.lastThreadName() != SYNC_MASTER_THREAD_NAME,
+           "Handler of a class which exceeded the timeout was called inline");
+  QCOMPARE(slowHandler.eventCount(), 1);
+
+  registration.unregister();
+  slowRegistration.unregister();
+}
@@ -0,0 +1,110 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#ifndef CTKEAINLINETIMEOUTTESTSUITE_P_H
+#define CTKEAINLINETIMEOUTTESTSUITE_P_H
+
+#include <QObject>
+#include <QMutex>
+
+#include <ctkServiceReference.h>
+#include <ctkTestSuiteInterface.h>
+
+#include <service/event/ctkEventHandler.h>
+
+class ctkPluginContext;
+struct ctkEventAdmin;
+
+class ctkEAInlineTimeoutTestHelper : public QObject, public ctkEventHandler
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkEventHandler)
+
+private:
+
+  ctkEventAdmin* eventAdmin;
+  QString nestedTopic;
+  int sleepTime;
+
+  mutable QMutex mutex;
+  int count;
+  QString threadName;
+
+public Q_SLOTS:
+
+  void handleEvent(const ctkEvent& event);
+
+public:
+
+  /*
+   * Creates a handler which sleeps for <code>sleepTime</code> milliseconds
+   * and then sends an event to <code>nestedTopic</code>, if not empty.
+   */
+  ctkEAInlineTimeoutTestHelper(ctkEventAdmin* eventAdmin = 0,
+                               const QString& nestedTopic = QString(),
+                               int sleepTime = 0);
+
+  int eventCount() const;
+
+  QString lastThreadName() const;
+
+};
+
+
+class ctkEAInlineTimeoutTestSuite : public QObject,
+    public ctkTestSuiteInterface
+{
+  Q_OBJECT
+  Q_INTERFACES(ctkTestSuiteInterface)
+
+public:
+
+  ctkEAInlineTimeoutTestSuite(ctkPluginContext* pc, long eventPluginId);
+
+private Q_SLOTS:
+
+  void init();
+  void cleanup();
+
+  /*
+   * Ensures an event sent by a handler called inline is delivered, although
+   * the handler is called from the sync master thread.
+   */
+  void testNestedSendEvent();
+
+  /*
+   * Ensures a handler called inline which exceeds the timeout is blacklisted
+   * by the watchdog and that other handlers of the same class are called
+   * from a pooled thread from then on.
+   */
+  void testSlowInlineHandler();
+
+private:
+
+  ctkPluginContext* context;
+  long eventPluginId;
+  ctkEventAdmin* eventAdmin;
+  ctkServiceReference reference;
+};
+
+#endif // CTKEAINLINETIMEOUTTESTSUITE_P_H
@@ -32,6 +32,7 @@
 #include "ctkEAScenario2TestSuite_p.h"
 #include "ctkEAScenario3TestSuite_p.h"
 #include "ctkEAScenario4TestSuite_p.h"
+#include "ctkEAInlineTimeoutTestSuite_p.h"
 
 //----------------------------------------------------------------------------
 ctkEventAdminTestActivator::ctkEventAdminTestActivator()
@@ -42,6 +43,7 @@ ctkEventAdminTestActivator::ctkEventAdminTestActivator()
   , scenario2TestSuite(0)
   , scenario3TestSuite(0)
   , scenario4TestSuite(0)
+  , inlineTimeoutTestSuite(0)
 {
 
 }
@@ -56,6 +58,7 @@ ctkEventAdminTestActivator::~ctkEventAdminTestActivator()
   delete scenario2TestSuite;
   delete scenario3TestSuite;
   delete scenario4TestSuite;
+  delete inlineTimeoutTestSuite;
 }
 
 //----------------------------------------------------------------------------
@@ -105,6 +108,9 @@ void ctkEventAdminTestActivator::start(ctkPluginContext* context)
 
   scenario4TestSuite = new ctkEAScenario4TestSuite(context, eventPluginId);
   context->registerService<ctkTestSuiteInterface>(scenario4TestSuite);
+
+  inlineTimeoutTestSuite = new ctkEAInlineTimeoutTestSuite(context, eventPluginId);
+  context->registerService<ctkTestSuiteInterface>(inlineTimeoutTestSuite);
 }
 
 //----------------------------------------------------------------------------
@@ -119,6 +125,7 @@ void ctkEventAdminTestActivator::stop(ctkPluginContext* context)
   delete scenario2TestSuite;
   delete scenario3TestSuite;
   delete scenario4TestSuite;
+  delete inlineTimeoutTestSuite;
 
   topicWildcardTestSuite = 0;
   topicWildcardTestSuiteSS = 0;
@@ -127,6 +134,7 @@ void ctkEventAdminTestActivator::stop(ctkPluginContext* context)
   scenario2TestSuite = 0;
   scenario3TestSuite = 0;
   scenario4TestSuite = 0;
+  inlineTimeoutTestSuite = 0;
 }
 
 #if QT_VERSION < QT_VERSION_CHECK(5,0,0)
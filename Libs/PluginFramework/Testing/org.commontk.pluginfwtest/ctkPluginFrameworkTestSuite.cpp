@@ -25,6 +25,7 @@
 #include <ctkPluginContext.h>
 #include <ctkPluginConstants.h>
 #include <ctkPluginException.h>
+#include <ctkLDAPSearchFilter.h>
 #include <ctkServiceException.h>
 
 #include <QDir>
@@ -455,6 +456,86 @@ void ctkPluginFrameworkTestSuite::frame045a()
   }
 }
 
+//----------------------------------------------------------------------------
+// Parse the same LDAP filters several times, parsed filters are cached
+// but broken filters must throw each time they are used
+void ctkPluginFrameworkTestSuite::frame046a()
+{
+  ctkDictionary props;
+  props.insert("name", "frame046a");
+  props.insert("count", 46);
+  QString filter = "(&(name=frame046a)(count>=40))";
+  for (int i = 0; i < 3; ++i)
+  {
+    ctkLDAPSearchFilter ldapFilter(filter);
+    QVERIFY2(ldapFilter.match(props), "framework test plugin, LDAP filter did not match:FRAME046A:FAIL");
+    QVERIFY(ldapFilter == ctkLDAPSearchFilter(filter));
+    QVERIFY2(!ctkLDAPSearchFilter("(count<=40)").match(props),
+             "framework test plugin, LDAP filter should not match:FRAME046A:FAIL");
+  }
+
+  for (int i = 0; i < 2; ++i)
+  {
+    try
+    {
+      ctkLDAPSearchFilter brokenFilter("A broken LDAP filter");
+      QFAIL("framework test plugin, no exception on broken LDAP filter:FRAME046A:FAIL");
+    }
+    catch (const ctkInvalidArgumentException& /*ia*/)
+    {
+    }
+  }
+
+  QString serviceFilter = QString("(%1>=0)").arg(ctkPluginConstants::SERVICE_ID);
+  QList<ctkServiceReference> srs1 = pc->getServiceReferences("", serviceFilter);
+  QList<ctkServiceReference> srs2 = pc->getServiceReferences("", serviceFilter);
+  QCOMPARE(srs1.size(), srs2.size());
+}
+
+//----------------------------------------------------------------------------
+// Look up services by indexed properties, with and without class name,
+// after the properties are modified and after the services are unregistered
+void ctkPluginFrameworkTestSuite::frame047a()
+{
+  QString pid1 = "org.commontk.pluginfwtest.frame047a.1";
+  QString pid2 = "org.commontk.pluginfwtest.frame047a.2";
+  QString pid3 = "org.commontk.pluginfwtest.frame047a.3";
+  QObject service1;
+  QObject service2;
+  ctkDictionary props1;
+  props1.insert(ctkPluginConstants::SERVICE_PID, pid1);
+  ctkDictionary props2;
+  props2.insert(ctkPluginConstants::SERVICE_PID, pid2);
+  props2.insert("name", "frame047a");
+  ctkServiceRegistration reg1 = pc->registerService("QObject", &service1, props1);
+  ctkServiceRegistration reg2 = pc->registerService("QObject", &service2, props2);
+
+  QString filter1 = QString("(%1=%2)").arg(ctkPluginConstants::SERVICE_PID).arg(pid1);
+  QString filter2 = QString("(%1=%2)").arg(ctkPluginConstants::SERVICE_PID).arg(pid2);
+  QString filter3 = QString("(%1=%2)").arg(ctkPluginConstants::SERVICE_PID).arg(pid3);
+  QString filter12 = QString("(|%1%2)").arg(filter1).arg(filter2);
+
+  QList<ctkServiceReference> srs = pc->getServiceReferences("", filter1);
+  QCOMPARE(srs.size(), 1);
+  QVERIFY(pc->getService(srs.front()) == &service1);
+  pc->ungetService(srs.front());
+  QCOMPARE(pc->getServiceReferences("QObject", filter12).size(), 2);
+  QCOMPARE(pc->getServiceReferences("", QString("(&%1(name=frame047a))").arg(filter2)).size(), 1);
+  QCOMPARE(pc->getServiceReferences("", QString("(&%1(name=frame047a))").arg(filter1)).size(), 0);
+  QCOMPARE(pc->getServiceReferences("ctkPluginFrameworkTestSuite", filter1).size(), 0);
+
+  props2.insert(ctkPluginConstants::SERVICE_PID, pid3);
+  reg2.setProperties(props2);
+  QCOMPARE(pc->getServiceReferences("", filter2).size(), 0);
+  QCOMPARE(pc->getServiceReferences("", filter3).size(), 1);
+  QCOMPARE(pc->getServiceReferences("QObject", filter12).size(), 1);
+
+  reg1.unregister();
+  reg2.unregister();
+  QCOMPARE(pc->getServiceReferences("", filter1).size(), 0);
+  QCOMPARE(pc->getServiceReferences("QObject", filter3).size(), 0);
+}
+
 //----------------------------------------------------------------------------
 // Reinstalls and the updates testbundle_A.
 // The version is checked to see if an update has been made.
@@ -240,6 +240,58 @@ bool ctkLDAPExpr::getMatchedObjectClasses(QSet<QString>& objClasses) const
   return false;
 }
 
+//----------------------------------------------------------------------------
+bool ctkLDAPExpr::getIndexedValues(const QStringList& indexedKeys, QString& key, QSet<QString>& values) const
+{
+  if (d->m_operator == EQ)
+  {
+    QString attrName = d->m_attrName.toLower();
+    if (indexedKeys.contains(attrName) && d->m_attrValue.indexOf(WILDCARD) < 0)
+    {
+      key = attrName;
+      values.insert(d->m_attrValue);
+      return true;
+    }
+    return false;
+  }
+  else if (d->m_operator == AND)
+  {
+    // any indexable operand restricts the result, use the most selective one
+    bool result = false;
+    for (int i = 0; i < d->m_args.size(); i++)
+    {
+      QString k;
+      QSet<QString> r;
+      if (d->m_args[i].getIndexedValues(indexedKeys, k, r) &&
+          (!result || r.size() < values.size()))
+      {
+        result = true;
+        key = k;
+        values = r;
+      }
+    }
+    return result;
+  }
+  else if (d->m_operator == OR)
+  {
+    for (int i = 0; i < d->m_args.size(); i++)
+    {
+      QString k;
+      QSet<QString> r;
+      if (!d->m_args[i].getIndexedValues(indexedKeys, k, r) || (i > 0 && k != key))
+      {
+        key.clear();
+        values.clear();
+        return false;
+      }
+      key = k;
+      values += r;
+    }
+    return !d->m_args.isEmpty();
+  }
+  return false;
+}
+
 //----------------------------------------------------------------------------
 bool ctkLDAPExpr::isSimple( 
   const QStringList& keywords,
@@ -0,0 +1,83 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+#include "ctkLDAPExprCache_p.h"
+
+#include "ctkPluginFrameworkDebug_p.h"
+
+const int ctkLDAPExprCache::DEFAULT_MAX_SIZE = 512;
+
+//----------------------------------------------------------------------------
+ctkLDAPExprCache::ctkLDAPExprCache()
+  : cache(DEFAULT_MAX_SIZE)
+{
+}
+
+//----------------------------------------------------------------------------
+ctkLDAPExprCache* ctkLDAPExprCache::getDefault()
+{
+  static ctkLDAPExprCache singleton;
+  return &singleton;
+}
+
+//----------------------------------------------------------------------------
+ctkLDAPExpr ctkLDAPExprCache::get(const QString& filter)
+{
+  {
+    QMutexLocker lock(&mutex); Q_UNUSED(lock);
+    // object() marks the entry as most recently used
+    if (ctkLDAPExpr* expr = cache.object(filter))
+    {
+      ctkPluginFrameworkDebug::ldap_cache_hits.ref();
+      return *expr;
+    }
+  }
+
+  ctkPluginFrameworkDebug::ldap_cache_misses.ref();
+
+  // Parse without holding the lock, throws on invalid filters
+  ctkLDAPExpr expr(filter);
+
+  QMutexLocker lock(&mutex); Q_UNUSED(lock);
+  cache.insert(filter, new ctkLDAPExpr(expr));
+  return expr;
+}
+
+//----------------------------------------------------------------------------
+void ctkLDAPExprCache::setMaxSize(int maxSize)
+{
+  QMutexLocker lock(&mutex); Q_UNUSED(lock);
+  cache.setMaxCost(maxSize);
+}
+
+//----------------------------------------------------------------------------
+int ctkLDAPExprCache::maxSize() const
+{
+  QMutexLocker lock(&mutex); Q_UNUSED(lock);
+  return cache.maxCost();
+}
+
+//----------------------------------------------------------------------------
+void ctkLDAPExprCache::clear()
+{
+  QMutexLocker lock(&mutex); Q_UNUSED(lock);
+  cache.clear();
+}
@@ -0,0 +1,78 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKLDAPEXPRCACHE_P_H
+#define CTKLDAPEXPRCACHE_P_H
+
+#include "ctkLDAPExpr_p.h"
+
+#include <QCache>
+#include <QMutex>
+
+/**
+ * \ingroup PluginFramework
+ *
+ * Thread-safe cache of parsed LDAP filters.
+ *
+ * Service lookups and listeners use the same filter strings again and
+ * again, so the parsed ctkLDAPExpr objects are kept in a least recently
+ * used cache shared by all framework instances. ctkLDAPExpr objects are
+ * implicitly shared and never modified after parsing, so a cached
+ * expression can be evaluated by several threads at the same time.
+ *
+ * Filters which cannot be parsed are not cached.
+ * Hits and misses are counted in ctkPluginFrameworkDebug.
+ */
+class ctkLDAPExprCache
+{
+
+public:
+
+  static const int DEFAULT_MAX_SIZE; // = 512
+
+  static ctkLDAPExprCache* getDefault();
+
+  /**
+   * Returns the parsed expression of the filter.
+   *
+   * \throws ctkInvalidArgumentException if the filter cannot be parsed.
+   */
+  ctkLDAPExpr get(const QString& filter);
+
+  /**
+   * Maximum number of cached expressions.
+   */
+  void setMaxSize(int maxSize);
+  int maxSize() const;
+
+  void clear();
+
+private:
+
+  ctkLDAPExprCache();
+
+  mutable QMutex mutex;
+  QCache<QString, ctkLDAPExpr> cache;
+
+};
+
+#endif // CTKLDAPEXPRCACHE_P_H
@@ -84,6 +84,28 @@ public:
    */
   bool getMatchedObjectClasses(QSet<QString>& objClasses) const;
 
+  /**
+   * Plans an indexed lookup of this LDAP expression. This works like
+   * getMatchedObjectClasses() for any of the given property keys:
+   * <ul>
+   *  <li><code>(<it>key</it>=<it>value</it>)</code> is indexable if
+   *      <it>key</it> is a member of <code>indexedKeys</code> and
+   *      <it>value</it> does not contain a wildcard character;</li>
+   *  <li><code>(& EXPR+ )</code> is indexable if one of the <code>EXPR</code>
+   *      expressions is indexable, the one with the fewest values is used;</li>
+   *  <li><code>(| EXPR+ )</code> is indexable if all <code>EXPR</code>
+   *      expressions are indexable with the same key.</li>
+   * </ul>
+   *
+   * \param indexedKeys The indexed property keys, in lower case.
+   * \param key Set to the (lower case) key to use for the lookup.
+   * \param values Set to the values of <code>key</code> accepted by this expression.
+   * \return <code>true</code> if every object matched by this expression has one
+   *         of <code>values</code> as value of <code>key</code>,
+   *         <code>false</code> if the expression must be evaluated on all objects.
+   */
+  bool getIndexedValues(const QStringList& indexedKeys, QString& key, QSet<QString>& values) const;
+
   /**
    * Checks if this LDAP expression is "simple". The definition of
    * a simple filter is:
@@ -21,7 +21,7 @@
 
 #include "ctkLDAPSearchFilter.h"
 
-#include "ctkLDAPExpr_p.h"
+#include "ctkLDAPExprCache_p.h"
 #include "ctkServiceReference_p.h"
 
 //----------------------------------------------------------------------------
@@ -33,7 +33,7 @@ public:
   {}
 
   ctkLDAPSearchFilterData(const QString& filter)
-    : ldapExpr(filter)
+    : ldapExpr(ctkLDAPExprCache::getDefault()->get(filter))
   {}
 
   ctkLDAPSearchFilterData(const ctkLDAPSearchFilterData& other)
@@ -122,6 +122,20 @@ struct CTK_PLUGINFW_EXPORT ctkPluginConstants {
    */
   static const QString FRAMEWORK_PRELOAD_LIBRARIES; // = "org.commontk.pluginfw.preloadlibs"
 
+  /**
+   * Specifies additional service property keys for which the framework
+   * maintains an index of the registered services. The value of this property
+   * must be either of type QString or QStringList.
+   *
+   * Service lookups with a filter testing an indexed property for equality
+   * (e.g. <code>(service.pid=my.pid)</code>, possibly combined with other
+   * expressions by AND, or combined with tests of the same property by OR) only
+   * evaluate the filter on the services having one of the requested values,
+   * instead of all registered services. The SERVICE_PID and
+   * ctkEventConstants::EVENT_TOPIC properties are always indexed.
+   */
+  static const QString FRAMEWORK_SERVICE_INDEXED_KEYS; // = "org.commontk.pluginfw.service.indexedkeys"
+
   /**
    * Manifest header identifying the plugin's symbolic name.
    *
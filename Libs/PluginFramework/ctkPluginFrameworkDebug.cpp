@@ -38,6 +38,9 @@ QString ctkPluginFrameworkDebug::OPTION_DEBUG_STARTLEVEL = CTK_OSGI + "/debug/st
 QString ctkPluginFrameworkDebug::OPTION_DEBUG_URL = CTK_OSGI + "/debug/url";
 QString ctkPluginFrameworkDebug::OPTION_DEBUG_RESOLVE = CTK_OSGI + "/debug/resolve";
 
+QAtomicInt ctkPluginFrameworkDebug::ldap_cache_hits(0);
+QAtomicInt ctkPluginFrameworkDebug::ldap_cache_misses(0);
+
 //----------------------------------------------------------------------------
 ctkPluginFrameworkDebug::ctkPluginFrameworkDebug()
 {
@@ -56,3 +59,13 @@ ctkPluginFrameworkDebug::ctkPluginFrameworkDebug()
     resolve = dbgOptions->getBooleanOption(OPTION_DEBUG_RESOLVE, false);
   }
 }
+
+//----------------------------------------------------------------------------
+QString ctkPluginFrameworkDebug::ldapCacheStatistics()
+{
+  int hits = ldap_cache_hits.fetchAndAddOrdered(0);
+  int misses = ldap_cache_misses.fetchAndAddOrdered(0);
+  int lookups = hits + misses;
+  return QString("%1 hits, %2 misses (hit rate %3%)").arg(hits).arg(misses)
+      .arg(lookups > 0 ? 100.0 * hits / lookups : 0.0, 0, 'f', 1);
+}
@@ -25,6 +25,8 @@
 
 #include "ctkPluginFramework_global.h"
 
+#include <QAtomicInt>
+
 /**
  * Variables that control debugging of the pluginfw code.
  */
@@ -67,6 +69,19 @@ public:
   static QString OPTION_DEBUG_LDAP;
   bool ldap;
 
+  /**
+   * Hits and misses of the parsed LDAP filter cache (ctkLDAPExprCache).
+   * The cache is shared by all framework instances, so are the counters.
+   */
+  static QAtomicInt ldap_cache_hits;
+  static QAtomicInt ldap_cache_misses;
+
+  /**
+   * Returns the LDAP filter cache counters and hit rate as a string
+   * suitable for debug output.
+   */
+  static QString ldapCacheStatistics();
+
   /**
    * Print information about service reference lookups
    * and rejections due to missing permissions
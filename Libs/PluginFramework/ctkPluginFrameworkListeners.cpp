@@ -131,6 +131,7 @@ QSet<ctkServiceSlotEntry> ctkPluginFrameworkListeners::getMatchingServiceSlots(
   {
     qDebug() << "Added" << set.size() << "out of" << n
       << "listeners with complicated filters";
+    qDebug() << "LDAP filter cache:" << ctkPluginFrameworkDebug::ldapCacheStatistics();
   }
 
   // Check the cache
@@ -120,7 +120,9 @@ void ctkServiceRegistration::setProperties(const ctkDictionary& props)
       before = d->plugin->fwCtx->listeners.getMatchingServiceSlots(d->reference, false);
       QStringList classes = d->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
       qlonglong sid = d->properties.value(ctkPluginConstants::SERVICE_ID).toLongLong();
+      ctkServiceProperties oldProperties = d->properties;
       d->properties = ctkServices::createServiceProperties(props, classes, sid);
+      d->plugin->fwCtx->services->updateServiceRegistrationProperties(*this, oldProperties);
       int new_rank = d->properties.value(ctkPluginConstants::SERVICE_RANKING).toInt();
       if (old_rank != new_rank)
       {
@@ -22,7 +22,7 @@
 
 #include "ctkServiceSlotEntry_p.h"
 
-#include "ctkLDAPExpr_p.h"
+#include "ctkLDAPExprCache_p.h"
 #include "ctkPlugin.h"
 #include "ctkException.h"
 
@@ -80,7 +80,7 @@ ctkServiceSlotEntry::ctkServiceSlotEntry(
 {
   if (!filter.isNull())
   {
-    d->ldap = ctkLDAPExpr(filter);
+    d->ldap = ctkLDAPExprCache::getDefault()->get(filter);
   }
 }
 
@@ -32,7 +32,8 @@
 #include "ctkPluginFrameworkContext_p.h"
 #include "ctkServiceException.h"
 #include "ctkServiceRegistration_p.h"
-#include "ctkLDAPExpr_p.h"
+#include "ctkLDAPExprCache_p.h"
+#include "service/event/ctkEventConstants.h"
 
 //----------------------------------------------------------------------------
 struct ServiceRegistrationComparator
@@ -65,7 +66,18 @@ ctkDictionary ctkServices::createServiceProperties(const ctkDictionary& in,
 ctkServices::ctkServices(ctkPluginFrameworkContext* fwCtx)
   : mutex(), framework(fwCtx)
 {
-
+  QStringList keys;
+  keys << ctkPluginConstants::SERVICE_PID << ctkEventConstants::EVENT_TOPIC;
+  keys << fwCtx->props.value(ctkPluginConstants::FRAMEWORK_SERVICE_INDEXED_KEYS).toStringList();
+  foreach (QString key, keys)
+  {
+    key = key.toLower();
+    if (!key.isEmpty() && key != ctkPluginConstants::OBJECTCLASS.toLower() &&
+        !indexedKeys.contains(key))
+    {
+      indexedKeys.push_back(key);
+    }
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -79,6 +91,8 @@ void ctkServices::clear()
 {
   services.clear();
   classServices.clear();
+  propertyServices.clear();
+  unindexedPropertyServices.clear();
   framework = 0;
 }
 
@@ -126,6 +140,7 @@ ctkServiceRegistration ctkServices::registerService(ctkPluginPrivate* plugin,
           std::lower_bound(s.begin(), s.end(), res, ServiceRegistrationComparator());
       s.insert(ip, res);
     }
+    addToPropertyIndex_unlocked(res, res.d_func()->properties);
   }
 
   ctkServiceReference r = res.getReference();
@@ -148,6 +163,15 @@ void ctkServices::updateServiceRegistrationOrder(const ctkServiceRegistration& s
   }
 }
 
+//----------------------------------------------------------------------------
+void ctkServices::updateServiceRegistrationProperties(const ctkServiceRegistration& sr,
+                                                      const ctkServiceProperties& oldProperties)
+{
+  QMutexLocker lock(&mutex);
+  removeFromPropertyIndex_unlocked(sr, oldProperties);
+  addToPropertyIndex_unlocked(sr, sr.d_func()->properties);
+}
+
 //----------------------------------------------------------------------------
 bool ctkServices::checkServiceClass(QObject* service, const QString& cls) const
 {
@@ -199,11 +223,13 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
   QListIterator<ctkServiceRegistration>* s = 0;
   QList<ctkServiceRegistration> v;
   ctkLDAPExpr ldap;
+  QString indexedKey;
+  QSet<QString> indexedValues;
   if (clazz.isEmpty())
   {
     if (!filter.isEmpty())
     {
-      ldap = ctkLDAPExpr(filter);
+      ldap = ctkLDAPExprCache::getDefault()->get(filter);
       QSet<QString> matched;
       if (ldap.getMatchedObjectClasses(matched))
       {
@@ -222,6 +248,23 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
           return QList<ctkServiceReference>();
         }
       }
+      else if (ldap.getIndexedValues(indexedKeys, indexedKey, indexedValues))
+      {
+        v = getIndexed_unlocked(indexedKey, indexedValues).toList();
+        if (framework->debug.service_reference)
+        {
+          qDebug() << "indexed lookup of" << filter << "on" << indexedKey
+                   << "=" << v.size() << "candidates out of" << services.size();
+        }
+        if (!v.isEmpty())
+        {
+          s = new QListIterator<ctkServiceRegistration>(v);
+        }
+        else
+        {
+          return QList<ctkServiceReference>();
+        }
+      }
       else
       {
         s = new QListIterator<ctkServiceRegistration>(services.keys());
@@ -235,18 +278,36 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
   else
   {
     QList<ctkServiceRegistration> v = classServices.value(clazz);
-    if (!v.isEmpty())
-    {
-      s = new QListIterator<ctkServiceRegistration>(v);
-    }
-    else
+    if (v.isEmpty())
     {
       return QList<ctkServiceReference>();
     }
     if (!filter.isEmpty())
     {
-      ldap = ctkLDAPExpr(filter);
+      ldap = ctkLDAPExprCache::getDefault()->get(filter);
+      if (ldap.getIndexedValues(indexedKeys, indexedKey, indexedValues))
+      {
+        QSet<ctkServiceRegistration> candidates = getIndexed_unlocked(indexedKey, indexedValues);
+        if (candidates.size() < v.size())
+        {
+          // Only keep the candidates registered under clazz, in ranking order
+          v.clear();
+          foreach (const ctkServiceRegistration& sr, candidates)
+          {
+            if (services.value(sr).contains(clazz))
+            {
+              v.push_back(sr);
+            }
+          }
+          std::sort(v.begin(), v.end(), ServiceRegistrationComparator());
+          if (v.isEmpty())
+          {
+            return QList<ctkServiceReference>();
+          }
+        }
+      }
     }
+    s = new QListIterator<ctkServiceRegistration>(v);
   }
 
   QList<ctkServiceReference> res;
@@ -266,6 +327,109 @@ QList<ctkServiceReference> ctkServices::get_unlocked(const QString& clazz, const
   return res;
 }
 
+//----------------------------------------------------------------------------
+void ctkServices::addToPropertyIndex_unlocked(const ctkServiceRegistration& sr,
+                                              const ctkServiceProperties& props)
+{
+  foreach (const QString& key, indexedKeys)
+  {
+    int index = props.find(key);
+    if (index < 0) continue;
+
+    QSet<QString> indexValues;
+    if (getIndexValues(props.value(index), indexValues))
+    {
+      QHash<QString, QSet<ctkServiceRegistration> >& valueServices = propertyServices[key];
+      foreach (const QString& value, indexValues)
+      {
+        valueServices[value].insert(sr);
+      }
+    }
+    else
+    {
+      unindexedPropertyServices[key].insert(sr);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void ctkServices::removeFromPropertyIndex_unlocked(const ctkServiceRegistration& sr,
+                                                   const ctkServiceProperties& props)
+{
+  foreach (const QString& key, indexedKeys)
+  {
+    int index = props.find(key);
+    if (index < 0) continue;
+
+    QSet<QString> indexValues;
+    if (getIndexValues(props.value(index), indexValues))
+    {
+      QHash<QString, QSet<ctkServiceRegistration> >& valueServices = propertyServices[key];
+      foreach (const QString& value, indexValues)
+      {
+        QSet<ctkServiceRegistration>& s = valueServices[value];
+        s.remove(sr);
+        if (s.isEmpty())
+        {
+          valueServices.remove(value);
+        }
+      }
+    }
+    else
+    {
+      unindexedPropertyServices[key].remove(sr);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+QSet<ctkServiceRegistration> ctkServices::getIndexed_unlocked(const QString& key,
+                                                              const QSet<QString>& values) const
+{
+  QSet<ctkServiceRegistration> res = unindexedPropertyServices.value(key);
+  QHash<QString, QHash<QString, QSet<ctkServiceRegistration> > >::const_iterator valueServices =
+      propertyServices.find(key);
+  if (valueServices != propertyServices.end())
+  {
+    foreach (const QString& value, values)
+    {
+      res.unite(valueServices.value().value(value));
+    }
+  }
+  return res;
+}
+
+//----------------------------------------------------------------------------
+bool ctkServices::getIndexValues(const QVariant& value, QSet<QString>& indexValues)
+{
+  // This must give all the strings a value is compared with by
+  // ctkLDAPExpr::evaluate() for equality: values convertible to a
+  // string are compared as a string, other lists element-wise.
+  if (value.isNull())
+  {
+    // never matches
+    return true;
+  }
+  bool indexable = false;
+  if (value.canConvert<QString>())
+  {
+    indexValues.insert(value.toString());
+    indexable = true;
+  }
+  if (value.canConvert<QVariantList>())
+  {
+    foreach (const QVariant& element, value.toList())
+    {
+      if (!getIndexValues(element, indexValues))
+      {
+        return false;
+      }
+    }
+    indexable = true;
+  }
+  return indexable;
+}
+
 //----------------------------------------------------------------------------
 void ctkServices::removeServiceRegistration(const ctkServiceRegistration& sr)
 {
@@ -273,6 +437,7 @@ void ctkServices::removeServiceRegistration(const ctkServiceRegistration& sr)
 
   QStringList classes = sr.d_func()->properties.value(ctkPluginConstants::OBJECTCLASS).toStringList();
   services.remove(sr);
+  removeFromPropertyIndex_unlocked(sr, sr.d_func()->properties);
   for (QStringListIterator i(classes); i.hasNext(); )
   {
     QString currClass = i.next();
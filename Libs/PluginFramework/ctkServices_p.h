@@ -26,11 +26,13 @@
 #include <QHash>
 #include <QObject>
 #include <QMutex>
+#include <QSet>
 #include <QStringList>
 
 #include "ctkPlugin_p.h"
 #include "ctkServiceRegistration.h"
 
+class ctkServiceProperties;
 
 /**
  * \ingroup PluginFramework
@@ -70,6 +72,27 @@ public:
    */
   QHash<QString, QList<ctkServiceRegistration> > classServices;
 
+  /**
+   * Keys (in lower case) of the service properties which are indexed
+   * in propertyServices, see ctkPluginConstants::FRAMEWORK_SERVICE_INDEXED_KEYS.
+   * The object class is indexed by classServices.
+   */
+  QStringList indexedKeys;
+
+  /**
+   * Mapping of indexed property key to the mapping of property value
+   * to the registered services having that value. Values which are
+   * lists are indexed under each of their elements.
+   */
+  QHash<QString, QHash<QString, QSet<ctkServiceRegistration> > > propertyServices;
+
+  /**
+   * Mapping of indexed property key to the registered services having a
+   * value for that key which cannot be indexed. These services are
+   * candidates of all the lookups using the key.
+   */
+  QHash<QString, QSet<ctkServiceRegistration> > unindexedPropertyServices;
+
 
   ctkPluginFrameworkContext* framework;
 
@@ -111,6 +134,16 @@ public:
                                       const QStringList& classes);
 
 
+  /**
+   * Service properties changed, update the property indexes.
+   *
+   * @param sr The ctkServiceRegistration object, containing the new properties.
+   * @param oldProperties The properties of the service before the change.
+   */
+  void updateServiceRegistrationProperties(const ctkServiceRegistration& sr,
+                                           const ctkServiceProperties& oldProperties);
+
+
   /**
    * Checks that a given service object is an instance of the given
    * class name.
@@ -184,6 +217,25 @@ private:
   QList<ctkServiceReference> get_unlocked(const QString& clazz, const QString& filter,
                                           ctkPluginPrivate* plugin) const;
 
+  void addToPropertyIndex_unlocked(const ctkServiceRegistration& sr,
+                                   const ctkServiceProperties& props);
+
+  void removeFromPropertyIndex_unlocked(const ctkServiceRegistration& sr,
+                                        const ctkServiceProperties& props);
+
+  /**
+   * Get the registered services which may have one of the given
+   * values for an indexed property key.
+   */
+  QSet<ctkServiceRegistration> getIndexed_unlocked(const QString& key,
+                                                   const QSet<QString>& values) const;
+
+  /**
+   * Collects the strings under which a property value is indexed.
+   * Returns <code>false</code> if the value cannot be indexed.
+   */
+  static bool getIndexValues(const QVariant& value, QSet<QString>& indexValues);
+
 };
 
 
@@ -64,6 +64,9 @@ int main(int argc, char** argv)
   fwProps.insert("event.impl", "org.commontk.eventadmin");
 
   fwProps.insert("org.commontk.eventadmin.ThreadPoolSize", 10);
+  // deliver the events of the topic wildcard tests inline, the other
+  // tests use the pooled timeout handling
+  fwProps.insert("org.commontk.eventadmin.InlineTimeoutTopics", "a/b/*");
 
   testRunner.init(fwProps);
   return testRunner.run(argc, argv);
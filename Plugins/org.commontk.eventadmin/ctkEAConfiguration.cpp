@@ -41,7 +41,9 @@ const QString ctkEAConfiguration::PROP_THREAD_POOL_SIZE = "org.commontk.eventadm
 const QString ctkEAConfiguration::PROP_TIMEOUT = "org.commontk.eventadmin.Timeout";
 const QString ctkEAConfiguration::PROP_REQUIRE_TOPIC = "org.commontk.eventadmin.RequireTopic";
 const QString ctkEAConfiguration::PROP_IGNORE_TIMEOUT = "org.commontk.eventadmin.IgnoreTimeout";
+const QString ctkEAConfiguration::PROP_INLINE_TIMEOUT_TOPICS = "org.commontk.eventadmin.InlineTimeoutTopics";
 const QString ctkEAConfiguration::PROP_LOG_LEVEL = "org.commontk.eventadmin.LogLevel";
+const QString ctkEAConfiguration::PROP_WORK_STEALING = "org.commontk.eventadmin.WorkStealing";
 
 
 ctkEAConfiguration::ctkEAConfiguration(ctkPluginContext* pluginContext )
@@ -133,10 +135,25 @@ void ctkEAConfiguration::configure(const ctkDictionary& config )
     {
       ignoreTimeout.clear();
     }
+    // The topics of synchronous events delivered in the sending thread while
+    // a watchdog checks the timeout - The default is none, i.e. handlers with
+    // a timeout are always called from the thread pool.
+    value = pluginContext->getProperty(PROP_INLINE_TIMEOUT_TOPICS);
+    if (value.isValid())
+    {
+      inlineTimeoutTopics = value.toStringList();
+    }
+    else
+    {
+      inlineTimeoutTopics.clear();
+    }
     logLevel = getIntProperty(PROP_LOG_LEVEL,
                               pluginContext->getProperty(PROP_LOG_LEVEL),
                               ctkLogService::LOG_WARNING, // default log level is WARNING
                               ctkLogService::LOG_ERROR);
+    // Use a work-stealing pool for the asynchronous delivery? - The default
+    // is false. Only read when the asynchronous thread pool is created.
+    workStealing = getBoolProperty(pluginContext->getProperty(PROP_WORK_STEALING), false);
   }
   else
   {
@@ -155,10 +172,22 @@ void ctkEAConfiguration::configure(const ctkDictionary& config )
       CTK_WARN(ctkEventAdminActivator::getLogService())
           << "Value for property:" << PROP_IGNORE_TIMEOUT << " cannot be converted to QStringList - Using default";
     }
+    inlineTimeoutTopics.clear();
+    value = config.value(PROP_INLINE_TIMEOUT_TOPICS);
+    if (value.canConvert<QStringList>())
+    {
+      inlineTimeoutTopics = value.toStringList();
+    }
+    else if (value.isValid())
+    {
+      CTK_WARN(ctkEventAdminActivator::getLogService())
+          << "Value for property:" << PROP_INLINE_TIMEOUT_TOPICS << " cannot be converted to QStringList - Using default";
+    }
     logLevel = getIntProperty(PROP_LOG_LEVEL,
                               config.value(PROP_LOG_LEVEL),
                               ctkLogService::LOG_WARNING, // default log level is WARNING
                               ctkLogService::LOG_ERROR);
+    workStealing = getBoolProperty(config.value(PROP_WORK_STEALING), false);
   }
   // a timeout less or equals to 100 means : disable timeout
   if (timeout <= 100)
@@ -222,10 +251,11 @@ void ctkEAConfiguration::startOrUpdate()
       << PROP_TIMEOUT << "=" << timeout;
   CTK_DEBUG(ctkEventAdminActivator::getLogService())
       << PROP_REQUIRE_TOPIC << "=" << requireTopic;
+  CTK_DEBUG(ctkEventAdminActivator::getLogService())
+      << PROP_WORK_STEALING << "=" << workStealing;
 
-  ctkEventAdminService::TopicHandlerFiltersInterface* topicHandlerFilters =
-      new ctkEventAdminService::TopicHandlerFilters(
-        new ctkEventAdminService::TopicCacheMap(cacheSize), requireTopic);
+  ctkEventAdminService::TopicHandlersInterface* topicHandlers =
+      new ctkEventAdminService::TopicHandlers(pluginContext, requireTopic);
 
   ctkEventAdminService::FiltersInterface* filters =
       new ctkEventAdminService::Filters(
@@ -244,10 +274,14 @@ void ctkEAConfiguration::startOrUpdate()
     sync_pool->configure(threadPoolSize);
   }
 
+  // The asynchronous pool either hands off its tasks to a lazily growing set of
+  // threads or, if configured, uses a fixed number of work-stealing threads.
+  // The delivery order per posting thread is ensured by the async deliver tasks
+  // and does not depend on the pool.
   int asyncThreadPoolSize = threadPoolSize > 5 ? threadPoolSize / 2 : 2;
   if (async_pool == 0)
   {
-    async_pool = new ctkEADefaultThreadPool(asyncThreadPoolSize, false);
+    async_pool = new ctkEADefaultThreadPool(asyncThreadPoolSize, false, workStealing);
   }
   else
   {
@@ -260,12 +294,12 @@ void ctkEAConfiguration::startOrUpdate()
   // below (and not in this HandlerTasks object!)
   ctkEventAdminService::HandlerTasksInterface* handlerTasks =
       new ctkEventAdminService::BlacklistingHandlerTasks(
-        pluginContext, new ctkEventAdminService::BlackList(), topicHandlerFilters, filters);
+        pluginContext, new ctkEventAdminService::BlackList(), topicHandlers, filters);
 
   if (admin == 0)
   {
     admin = new ctkEventAdminService(pluginContext, handlerTasks, sync_pool, async_pool,
-                                     timeout, ignoreTimeout);
+                                     timeout, ignoreTimeout, inlineTimeoutTopics);
 
     // Finally, adapt the outside events to our kind of events as per spec
     adaptEvents(admin);
@@ -280,7 +314,7 @@ void ctkEAConfiguration::startOrUpdate()
   }
   else
   {
-    admin->update(handlerTasks, timeout, ignoreTimeout);
+    admin->update(handlerTasks, timeout, ignoreTimeout, inlineTimeoutTopics);
   }
 
 }
@@ -89,6 +89,32 @@ class ctkEAAbstractAdapter;
  * pure optimization!
  * The value is a list of strings (separated by comma) which is assumed to define
  * exact class names.
+ * </p>
+ * <p>
+ * <p>
+ *      <tt>org.commontk.eventadmin.InlineTimeoutTopics</tt> - Configure topics of
+ *         synchronous events for which <tt>ctkEventHandler</tt>s are called in the
+ *         sending thread while a watchdog checks the timeout.
+ * </p>
+ * By default, the timeout handling calls each handler in a thread of the thread pool
+ * and lets the sending thread wait for it. For the configured topics, handlers are
+ * called directly and a single watchdog thread blacklists them if they exceed the
+ * timeout. This avoids two thread switches per handler, but a handler which blocks
+ * also blocks the sender until it returns. Handler classes which exceeded the timeout
+ * once are called from the thread pool again afterwards.
+ * The value is a list of strings (separated by comma) which define exact topics or,
+ * with a trailing <tt>*</tt>, topic prefixes (<tt>*</tt> alone matches all topics).
+ * <p>
+ * <p>
+ *      <tt>org.commontk.eventadmin.WorkStealing</tt> - Use a work-stealing thread
+ *          pool for the asynchronous event delivery.
+ * </p>
+ * The default is <tt>false</tt>. If set to <tt>true</tt>, posted events are delivered
+ * by a fixed number of threads which take their tasks from a lock-free queue and
+ * steal tasks from each other when idle. This reduces the lock contention when many
+ * threads post events. Events posted by the same thread are still delivered in order.
+ * This property is only read when the thread pool is created, i.e. a change requires
+ * to restart the event admin plugin.
  *
  * These properties are read at startup and serve as a default configuration.
  * If a configuration admin is configured, the event admin can be configured
@@ -109,7 +135,9 @@ public:
   static const QString PROP_TIMEOUT; // = "org.commontk.eventadmin.Timeout"
   static const QString PROP_REQUIRE_TOPIC; // = "org.commontk.eventadmin.RequireTopic"
   static const QString PROP_IGNORE_TIMEOUT; // = "org.commontk.eventadmin.IgnoreTimeout"
+  static const QString PROP_INLINE_TIMEOUT_TOPICS; // = "org.commontk.eventadmin.InlineTimeoutTopics"
   static const QString PROP_LOG_LEVEL; // = "org.commontk.eventadmin.LogLevel"
+  static const QString PROP_WORK_STEALING; // = "org.commontk.eventadmin.WorkStealing"
 
 private:
 
@@ -128,8 +156,12 @@ private:
 
   QStringList ignoreTimeout;
 
+  QStringList inlineTimeoutTopics;
+
   int logLevel;
 
+  bool workStealing;
+
   // The thread pool used - this is a member because we need to close it on stop
   ctkEADefaultThreadPool* sync_pool;
   ctkEADefaultThreadPool* async_pool;
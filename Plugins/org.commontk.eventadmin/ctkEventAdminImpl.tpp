@@ -27,16 +27,16 @@ template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
 ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::ctkEventAdminImpl(
   HandlerTasksInterface* managers, ctkEADefaultThreadPool* syncPool,
   ctkEADefaultThreadPool* asyncPool, int timeout,
-  const QStringList& ignoreTimeout)
+  const QStringList& ignoreTimeout, const QStringList& inlineTimeoutTopics)
   : managers(managers)
 {
   checkNull(managers, "Managers");
   checkNull(syncPool, "syncPool");
   checkNull(asyncPool, "asyncPool");
 
-  sendManager = new SyncDeliverTasks(syncPool, &syncMasterThread,
+  sendManager = new SyncDeliverTasks(syncPool, &syncMasterThread, &watchdog,
                                      (timeout > 100 ? timeout : 0),
-                                     ignoreTimeout);
+                                     ignoreTimeout, inlineTimeoutTopics);
 
   postManager = new AsyncDeliverTasks(asyncPool, sendManager);
 }
@@ -87,15 +87,17 @@ void ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::stop()
       this->managers.fetchAndStoreOrdered(&stoppedHandlerTasks);
   delete oldManagers;
   syncMasterThread.stop();
+  watchdog.stop();
 }
 
 template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
 void ctkEventAdminImpl<HandlerTasks,SyncDeliverTasks,AsyncDeliverTasks>::update(HandlerTasksInterface* managers, int timeout,
-                               const QStringList& ignoreTimeout)
+                               const QStringList& ignoreTimeout,
+                               const QStringList& inlineTimeoutTopics)
 {
   HandlerTasksInterface* oldManagers = this->managers.fetchAndStoreOrdered(managers);
   delete oldManagers;
-  this->sendManager->update(timeout, ignoreTimeout);
+  this->sendManager->update(timeout, ignoreTimeout, inlineTimeoutTopics);
 }
 
 template<class HandlerTasks, class SyncDeliverTasks, class AsyncDeliverTasks>
@@ -26,6 +26,7 @@
 #include "handler/ctkEAHandlerTasks_p.h"
 #include "tasks/ctkEADeliverTask_p.h"
 #include "dispatch/ctkEASyncMasterThread_p.h"
+#include "dispatch/ctkEAWatchdog_p.h"
 
 class ctkEADefaultThreadPool;
 
@@ -63,6 +64,9 @@ private:
   // The (interruptible) thread where sync events are handled
   ctkEASyncMasterThread syncMasterThread;
 
+  // The thread checking the timeout of handlers called inline
+  ctkEAWatchdog watchdog;
+
   // The synchronous event dispatcher
   SyncDeliverTasks* sendManager;
 
@@ -98,12 +102,17 @@ public:
    * @param managers The factory used to determine applicable <tt>ctkEventHandler</tt>
    * @param syncPool The synchronous thread pool
    * @param asyncPool The asynchronous thread pool
+   * @param timeout The timeout for event handlers
+   * @param ignoreTimeout The class names of handlers called without timeout
+   * @param inlineTimeoutTopics The topics of events delivered in the calling
+   *        thread under the control of a watchdog
    */
   ctkEventAdminImpl(HandlerTasksInterface* managers,
                     ctkEADefaultThreadPool* syncPool,
                     ctkEADefaultThreadPool* asyncPool,
                     int timeout,
-                    const QStringList& ignoreTimeout);
+                    const QStringList& ignoreTimeout,
+                    const QStringList& inlineTimeoutTopics);
 
   ~ctkEventAdminImpl();
 
@@ -144,7 +153,8 @@ public:
    * Update the event admin with new configuration.
    */
   void update(HandlerTasksInterface* managers, int timeout,
-              const QStringList& ignoreTimeout);
+              const QStringList& ignoreTimeout,
+              const QStringList& inlineTimeoutTopics);
 
 private:
 
@@ -31,8 +31,9 @@ ctkEventAdminService::ctkEventAdminService(ctkPluginContext* context,
                                            ctkEADefaultThreadPool* syncPool,
                                            ctkEADefaultThreadPool* asyncPool,
                                            int timeout,
-                                           const QStringList& ignoreTimeout)
-  : impl(managers, syncPool, asyncPool, timeout, ignoreTimeout),
+                                           const QStringList& ignoreTimeout,
+                                           const QStringList& inlineTimeoutTopics)
+  : impl(managers, syncPool, asyncPool, timeout, ignoreTimeout, inlineTimeoutTopics),
     context(context)
 {
 
@@ -197,8 +198,9 @@ void ctkEventAdminService::stop()
 }
 
 void ctkEventAdminService::update(HandlerTasksInterface* managers, int timeout,
-                                  const QStringList& ignoreTimeout)
+                                  const QStringList& ignoreTimeout,
+                                  const QStringList& inlineTimeoutTopics)
 {
-  impl.update(managers, timeout, ignoreTimeout);
+  impl.update(managers, timeout, ignoreTimeout, inlineTimeoutTopics);
 }
 
@@ -31,7 +31,7 @@
 
 #include "handler/ctkEACleanBlackList_p.h"
 #include "util/ctkEALeastRecentlyUsedCacheMap_p.h"
-#include "handler/ctkEACacheTopicHandlerFilters_p.h"
+#include "handler/ctkEATopicHandlerIndex_p.h"
 #include "handler/ctkEACacheFilters_p.h"
 #include "tasks/ctkEASyncDeliverTasks_p.h"
 #include "tasks/ctkEAAsyncDeliverTasks_p.h"
@@ -49,14 +49,13 @@ public:
   typedef ctkEACleanBlackList BlackList;
   typedef ctkEABlackList<BlackList> BlackListInterface;
 
-  typedef ctkEALeastRecentlyUsedCacheMap<QString, QString> TopicCacheMap;
-  typedef ctkEACacheTopicHandlerFilters<TopicCacheMap> TopicHandlerFilters;
-  typedef ctkEATopicHandlerFilters<TopicHandlerFilters> TopicHandlerFiltersInterface;
+  typedef ctkEATopicHandlerIndex TopicHandlers;
+  typedef ctkEATopicHandlers<TopicHandlers> TopicHandlersInterface;
   typedef ctkEALeastRecentlyUsedCacheMap<QString, ctkLDAPSearchFilter> LDAPCacheMap;
   typedef ctkEACacheFilters<LDAPCacheMap> Filters;
   typedef ctkEAFilters<Filters> FiltersInterface;
 
-  typedef ctkEABlacklistingHandlerTasks<BlackList, TopicHandlerFilters, Filters> BlacklistingHandlerTasks;
+  typedef ctkEABlacklistingHandlerTasks<BlackList, TopicHandlers, Filters> BlacklistingHandlerTasks;
   typedef ctkEAHandlerTasks<BlacklistingHandlerTasks> HandlerTasksInterface;
 
   typedef ctkEAHandlerTask<BlacklistingHandlerTasks> HandlerTask;
@@ -80,7 +79,8 @@ public:
                        ctkEADefaultThreadPool* syncPool,
                        ctkEADefaultThreadPool* asyncPool,
                        int timeout,
-                       const QStringList& ignoreTimeout);
+                       const QStringList& ignoreTimeout,
+                       const QStringList& inlineTimeoutTopics);
 
   ~ctkEventAdminService();
 
@@ -113,7 +113,8 @@ public:
    * Update the event admin with new configuration.
    */
   void update(HandlerTasksInterface* managers, int timeout,
-              const QStringList& ignoreTimeout);
+              const QStringList& ignoreTimeout,
+              const QStringList& inlineTimeoutTopics);
 
 };
 
@@ -0,0 +1,130 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#include "ctkEABoundedQueue_p.h"
+
+#include <ctkException.h>
+
+ctkEABoundedQueue::ctkEABoundedQueue(int capacity)
+  : buffer_(0), mask_(0), enqueuePos_(0), dequeuePos_(0)
+{
+  if (capacity < 2) throw ctkInvalidArgumentException("Capacity must be at least 2");
+
+  uint size = 2;
+  while (size < static_cast<uint>(capacity)) size <<= 1;
+
+  buffer_ = new Cell[size];
+  for (uint i = 0; i < size; ++i)
+  {
+    buffer_[i].sequence.fetchAndStoreOrdered(i);
+    buffer_[i].value = 0;
+  }
+  mask_ = size - 1;
+}
+
+ctkEABoundedQueue::~ctkEABoundedQueue()
+{
+  delete[] buffer_;
+}
+
+int ctkEABoundedQueue::capacity() const
+{
+  return static_cast<int>(mask_ + 1);
+}
+
+bool ctkEABoundedQueue::offer(ctkEARunnable* x)
+{
+  if (x == 0) throw ctkInvalidArgumentException("QRunnable cannot be null");
+
+  // positions are compared as unsigned differences, so wrapping
+  // around the int range is harmless
+  Cell* cell = 0;
+  uint pos = enqueuePos_.fetchAndAddOrdered(0);
+  forever
+  {
+    cell = &buffer_[pos & mask_];
+    const uint seq = cell->sequence.fetchAndAddOrdered(0);
+    const int diff = static_cast<int>(seq - pos);
+    if (diff == 0)
+    {
+      // the slot is free for this lap, try to claim it
+      if (enqueuePos_.testAndSetOrdered(pos, pos + 1)) break;
+      pos = enqueuePos_.fetchAndAddOrdered(0);
+    }
+    else if (diff < 0)
+    {
+      // the slot still holds the item of the previous lap
+      return false;
+    }
+    else
+    {
+      // another producer claimed the slot
+      pos = enqueuePos_.fetchAndAddOrdered(0);
+    }
+  }
+
+  cell->value = x;
+  // publish the item to the consumers
+  cell->sequence.fetchAndStoreOrdered(pos + 1);
+  return true;
+}
+
+ctkEARunnable* ctkEABoundedQueue::poll()
+{
+  Cell* cell = 0;
+  uint pos = dequeuePos_.fetchAndAddOrdered(0);
+  forever
+  {
+    cell = &buffer_[pos & mask_];
+    const uint seq = cell->sequence.fetchAndAddOrdered(0);
+    const int diff = static_cast<int>(seq - (pos + 1));
+    if (diff == 0)
+    {
+      // the slot holds an item, try to claim it
+      if (dequeuePos_.testAndSetOrdered(pos, pos + 1)) break;
+      pos = dequeuePos_.fetchAndAddOrdered(0);
+    }
+    else if (diff < 0)
+    {
+      // nothing has been published in this slot yet
+      return 0;
+    }
+    else
+    {
+      // another consumer claimed the slot
+      pos = dequeuePos_.fetchAndAddOrdered(0);
+    }
+  }
+
+  ctkEARunnable* x = cell->value;
+  cell->value = 0;
+  // hand the slot over to the producers of the next lap
+  cell->sequence.fetchAndStoreOrdered(pos + mask_ + 1);
+  return x;
+}
+
+bool ctkEABoundedQueue::isEmpty() const
+{
+  const uint pos = dequeuePos_.fetchAndAddOrdered(0);
+  const uint seq = buffer_[pos & mask_].sequence.fetchAndAddOrdered(0);
+  return static_cast<int>(seq - (pos + 1)) < 0;
+}
@@ -0,0 +1,101 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKEABOUNDEDQUEUE_P_H
+#define CTKEABOUNDEDQUEUE_P_H
+
+#include <QAtomicInt>
+
+class ctkEARunnable;
+
+/**
+ * A bounded multi-producer multi-consumer queue which does not use locks.
+ * <p>
+ * Each slot of the ring buffer carries a sequence number which tells
+ * producers and consumers whether the slot is free or holds an item for
+ * the current lap. Producers and consumers claim a position with a single
+ * compare-and-swap on the enqueue or dequeue counter, so they only contend
+ * with threads of the same kind and never block each other.
+ * <p>
+ * The queue does not wait: offer() returns <code>false</code> if the queue
+ * is full and poll() returns null if it is empty. The queue does not touch
+ * the reference count of the items it holds.
+ */
+class ctkEABoundedQueue
+{
+
+public:
+
+  /**
+   * Creates a queue which can hold at least <code>capacity</code> items.
+   * The capacity is rounded up to the next power of two.
+   */
+  ctkEABoundedQueue(int capacity);
+  ~ctkEABoundedQueue();
+
+  /**
+   * Returns the capacity of this queue.
+   */
+  int capacity() const;
+
+  /**
+   * Inserts an item at the tail of the queue.
+   *
+   * @return <code>false</code> if the queue is full.
+   */
+  bool offer(ctkEARunnable* x);
+
+  /**
+   * Removes the item at the head of the queue.
+   *
+   * @return The item or null if the queue is empty.
+   */
+  ctkEARunnable* poll();
+
+  /**
+   * Returns <code>true</code> if the queue did not contain any item
+   * at the time of the call.
+   */
+  bool isEmpty() const;
+
+private:
+
+  struct Cell
+  {
+    mutable QAtomicInt sequence;
+    ctkEARunnable* value;
+  };
+
+  Cell* buffer_;
+  uint mask_;
+
+  // keep the counters of producers and consumers on different cache lines
+  char pad0_[64];
+  QAtomicInt enqueuePos_;
+  char pad1_[64];
+  mutable QAtomicInt dequeuePos_;
+  char pad2_[64];
+
+  Q_DISABLE_COPY(ctkEABoundedQueue)
+};
+
+#endif // CTKEABOUNDEDQUEUE_P_H
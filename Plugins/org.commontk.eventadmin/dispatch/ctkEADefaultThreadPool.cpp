@@ -24,6 +24,7 @@
 
 #include "ctkEALinkedQueue_p.h"
 #include "ctkEAInterruptedException_p.h"
+#include "ctkEAWorkStealingExecutor_p.h"
 
 #include <ctkEventAdminActivator_p.h>
 #include <tasks/ctkEASyncThread_p.h>
@@ -52,8 +53,8 @@ struct _AsyncThreadFactory : public ctkEAThreadFactory
   }
 };
 
-ctkEADefaultThreadPool::ctkEADefaultThreadPool(int poolSize, bool syncThreads)
-  : ctkEAPooledExecutor(new ctkEALinkedQueue())
+ctkEADefaultThreadPool::ctkEADefaultThreadPool(int poolSize, bool syncThreads, bool workStealing)
+  : ctkEAPooledExecutor(new ctkEALinkedQueue()), workStealingExecutor(0)
 {
   if (syncThreads)
   {
@@ -64,19 +65,49 @@ ctkEADefaultThreadPool::ctkEADefaultThreadPool(int poolSize, bool syncThreads)
     delete this->setThreadFactory(new _AsyncThreadFactory());
   }
 
+  if (workStealing)
+  {
+    workStealingExecutor = new ctkEAWorkStealingExecutor(poolSize);
+    if (syncThreads)
+    {
+      delete workStealingExecutor->setThreadFactory(new _SyncThreadFactory());
+    }
+    else
+    {
+      delete workStealingExecutor->setThreadFactory(new _AsyncThreadFactory());
+    }
+  }
+
   configure(poolSize);
   setKeepAliveTime(60000);
   runWhenBlocked();
 }
 
+ctkEADefaultThreadPool::~ctkEADefaultThreadPool()
+{
+  delete workStealingExecutor;
+}
+
 void ctkEADefaultThreadPool::configure(int poolSize)
 {
   setMinimumPoolSize(poolSize);
   setMaximumPoolSize(poolSize + 10);
 }
 
+bool ctkEADefaultThreadPool::isWorkStealing() const
+{
+  return workStealingExecutor != 0;
+}
+
 void ctkEADefaultThreadPool::close()
 {
+  if (workStealingExecutor)
+  {
+    workStealingExecutor->shutdownNow();
+    workStealingExecutor->awaitTerminationAfterShutdown();
+    return;
+  }
+
   shutdownNow();
 
   try
@@ -93,7 +124,14 @@ void ctkEADefaultThreadPool::executeTask(ctkEARunnable* task)
 {
   try
   {
-    this->execute(task);
+    if (workStealingExecutor)
+    {
+      workStealingExecutor->execute(task);
+    }
+    else
+    {
+      this->execute(task);
+    }
   }
   catch (const std::exception& e)
   {
@@ -25,25 +25,44 @@
 
 #include "ctkEAPooledExecutor_p.h"
 
+class ctkEAWorkStealingExecutor;
+
 /**
  * A thread pool that allows to execute tasks using pooled threads in order
  * to ease the thread creation overhead.
+ *
+ * By default, tasks are handed off to the pooled threads through a
+ * ctkEALinkedQueue. If <code>workStealing</code> is <code>true</code>, tasks
+ * are executed by a ctkEAWorkStealingExecutor with a fixed number of threads
+ * instead, which does not lock when tasks are queued.
  */
 class ctkEADefaultThreadPool : public ctkEAPooledExecutor
 {
 
+private:
+
+  ctkEAWorkStealingExecutor* workStealingExecutor;
+
 public:
 
   /**
    * Create a new pool.
    */
-  ctkEADefaultThreadPool(int poolSize, bool syncThreads);
+  ctkEADefaultThreadPool(int poolSize, bool syncThreads, bool workStealing = false);
+
+  ~ctkEADefaultThreadPool();
 
   /**
-   * Configure a new pool size.
+   * Configure a new pool size. The number of threads of a work-stealing
+   * pool is fixed when the pool is created.
    */
   void configure(int poolSize);
 
+  /**
+   * Returns <code>true</code> if this pool uses work stealing.
+   */
+  bool isWorkStealing() const;
+
   /**
    * Close the pool i.e, stop pooling threads. Note that subsequently, task will
    * still be executed but no pooling is taking place anymore.
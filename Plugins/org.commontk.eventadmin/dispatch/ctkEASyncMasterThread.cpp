@@ -23,7 +23,6 @@
 #include "ctkEASyncMasterThread_p.h"
 
 #include <QRunnable>
-#include <QDebug>
 
 ctkEASyncMasterThread::ctkEASyncMasterThread()
   : command(0)
@@ -44,7 +43,9 @@ void ctkEASyncMasterThread::syncRun(QRunnable* command)
   }
   else
   {
-    qWarning() << "This method is not intended to be called from thread" << thread.objectName();
+    // an event sent by a handler which is called inline in this thread,
+    // the outer command still holds the mutex
+    command->run();
   }
 }
 
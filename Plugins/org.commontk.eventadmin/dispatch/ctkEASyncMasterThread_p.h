@@ -40,6 +40,11 @@ class ctkEASyncMasterThread : public QObject
 public:
   ctkEASyncMasterThread();
 
+  /**
+   * Run the command in the sync master thread and wait until it finished.
+   * If called from the sync master thread itself, i.e. for an event sent
+   * by a handler called inline, the command is run directly.
+   */
   void syncRun(QRunnable* command);
 
   void stop();
@@ -0,0 +1,133 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#include "ctkEAWatchdog_p.h"
+
+#include <ctkEventAdminActivator_p.h>
+
+#include <QRunnable>
+
+#include <climits>
+
+ctkEAWatchdog::ctkEAWatchdog()
+  : nextTicket(0), runningTicket(-1), stopped(false)
+{
+  this->setObjectName("ctkEAWatchdog");
+  clock.start();
+}
+
+ctkEAWatchdog::~ctkEAWatchdog()
+{
+  stop();
+}
+
+int ctkEAWatchdog::watch(long timeout, QRunnable* command)
+{
+  QMutexLocker l(&mutex);
+
+  // the thread is only started when it is needed
+  if (!stopped && !this->isRunning())
+  {
+    this->start();
+  }
+
+  // tickets are never negative, -1 marks that no command is running
+  int ticket = nextTicket;
+  nextTicket = (nextTicket == INT_MAX) ? 0 : nextTicket + 1;
+
+  Deadline deadline = { clock.elapsedMilli() + timeout, command };
+  deadlines.insert(ticket, deadline);
+  deadlinesChanged.wakeOne();
+  return ticket;
+}
+
+bool ctkEAWatchdog::unwatch(int ticket)
+{
+  QMutexLocker l(&mutex);
+  if (deadlines.remove(ticket))
+  {
+    // no need to wake the watchdog, it just wakes up for nothing
+    return true;
+  }
+  while (runningTicket == ticket)
+  {
+    commandFinished.wait(&mutex);
+  }
+  return false;
+}
+
+void ctkEAWatchdog::stop()
+{
+  {
+    QMutexLocker l(&mutex);
+    stopped = true;
+    deadlines.clear();
+    deadlinesChanged.wakeOne();
+  }
+  this->wait();
+}
+
+void ctkEAWatchdog::run()
+{
+  QMutexLocker l(&mutex);
+  while (!stopped)
+  {
+    if (deadlines.isEmpty())
+    {
+      deadlinesChanged.wait(&mutex);
+      continue;
+    }
+
+    // there are only a few nested deadlines at a time
+    QHash<int, Deadline>::iterator next = deadlines.begin();
+    for (QHash<int, Deadline>::iterator it = deadlines.begin(); it != deadlines.end(); ++it)
+    {
+      if (it.value().time < next.value().time) next = it;
+    }
+
+    const qint64 now = clock.elapsedMilli();
+    if (next.value().time > now)
+    {
+      deadlinesChanged.wait(&mutex, static_cast<unsigned long>(next.value().time - now));
+      continue;
+    }
+
+    runningTicket = next.key();
+    QRunnable* command = next.value().command;
+    deadlines.erase(next);
+
+    l.unlock();
+    try
+    {
+      command->run();
+    }
+    catch (const std::exception& e)
+    {
+      CTK_WARN_EXC(ctkEventAdminActivator::getLogService(), &e)
+          << "Exception: " << e.what();
+    }
+    l.relock();
+
+    runningTicket = -1;
+    commandFinished.wakeAll();
+  }
+}
@@ -0,0 +1,103 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKEAWATCHDOG_P_H
+#define CTKEAWATCHDOG_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <ctkHighPrecisionTimer.h>
+
+class QRunnable;
+
+/**
+ * A single thread which checks the deadlines of watched operations.
+ * <p>
+ * A caller registers a deadline together with a command before starting
+ * an operation and unregisters it when the operation finished. If the
+ * deadline passes before that, the command is run in the watchdog thread.
+ * The watched operation itself is not interrupted.
+ * <p>
+ * This allows to enforce a timeout on an operation executed in the calling
+ * thread, without handing the operation off to another thread.
+ */
+class ctkEAWatchdog : public QThread
+{
+
+public:
+
+  ctkEAWatchdog();
+
+  ~ctkEAWatchdog();
+
+  /**
+   * Run the given command in the watchdog thread if unwatch() is not called
+   * within <code>timeout</code> milliseconds. The command is not deleted and
+   * must stay valid until unwatch() returned.
+   *
+   * @return A ticket identifying the deadline.
+   */
+  int watch(long timeout, QRunnable* command);
+
+  /**
+   * Remove the deadline with the given ticket. If the command of the deadline
+   * is currently running, this waits until it finished.
+   *
+   * @return <code>true</code> if the deadline did not pass, <code>false</code>
+   *         if the command has been run.
+   */
+  bool unwatch(int ticket);
+
+  /**
+   * Stop the watchdog thread. Remaining deadlines are dropped.
+   */
+  void stop();
+
+protected:
+
+  void run();
+
+private:
+
+  struct Deadline
+  {
+    qint64 time;
+    QRunnable* command;
+  };
+
+  QMutex mutex;
+  QWaitCondition deadlinesChanged;
+  QWaitCondition commandFinished;
+
+  ctkHighPrecisionTimer clock;
+  QHash<int, Deadline> deadlines;
+  int nextTicket;
+  int runningTicket;
+  bool stopped;
+
+  Q_DISABLE_COPY(ctkEAWatchdog)
+};
+
+#endif // CTKEAWATCHDOG_P_H
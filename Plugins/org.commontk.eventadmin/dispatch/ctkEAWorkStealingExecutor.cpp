@@ -0,0 +1,247 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#include "ctkEAWorkStealingExecutor_p.h"
+
+#include <ctkEventAdminActivator_p.h>
+
+#include <ctkException.h>
+
+const int ctkEAWorkStealingExecutor::DEFAULT_QUEUECAPACITY = 1024;
+
+ctkEAWorkStealingExecutor::Worker::Worker(ctkEAWorkStealingExecutor* executor, int index)
+  : executor(executor), index(index), thread(0)
+{
+  // the worker is owned by the executor
+  setAutoDelete(false);
+}
+
+void ctkEAWorkStealingExecutor::Worker::run()
+{
+  while (!executor->shutdown_.fetchAndAddOrdered(0))
+  {
+    ctkEARunnable* task = executor->getTask(this);
+    if (task)
+    {
+      executor->runTask(task);
+    }
+    else
+    {
+      executor->waitForTask();
+    }
+  }
+}
+
+ctkEAWorkStealingExecutor::ctkEAWorkStealingExecutor(int workerCount, int queueCapacity)
+  : queue_(queueCapacity), workerCount_(workerCount), started_(0),
+    pendingTasks_(0), idleWorkers_(0), shutdown_(0)
+{
+  if (workerCount < 1) throw ctkInvalidArgumentException("Worker count must be at least 1");
+}
+
+ctkEAWorkStealingExecutor::~ctkEAWorkStealingExecutor()
+{
+  shutdownNow();
+  awaitTerminationAfterShutdown();
+  foreach (Worker* worker, workers_)
+  {
+    delete worker->thread;
+    delete worker;
+  }
+}
+
+int ctkEAWorkStealingExecutor::getWorkerCount() const
+{
+  return workerCount_;
+}
+
+void ctkEAWorkStealingExecutor::execute(ctkEARunnable* command)
+{
+  if (command == 0) throw ctkInvalidArgumentException("QRunnable cannot be null");
+
+  // the reference held by this executor, released by runTask() or discardTask()
+  if (command->autoDelete()) ++command->ref;
+
+  if (shutdown_.fetchAndAddOrdered(0))
+  {
+    runTask(command);
+    return;
+  }
+
+  startWorkers();
+
+  pendingTasks_.fetchAndAddOrdered(1);
+  Worker* worker = workerThreads_.value(QThread::currentThread());
+  if (worker)
+  {
+    // keep tasks created by a worker close to it, idle workers will steal them
+    QMutexLocker l(&worker->dequeMutex);
+    worker->deque.push_back(command);
+  }
+  else if (!queue_.offer(command))
+  {
+    // the queue is full, run the task in the calling thread
+    pendingTasks_.fetchAndAddOrdered(-1);
+    runTask(command);
+    return;
+  }
+
+  if (idleWorkers_.fetchAndAddOrdered(0) > 0)
+  {
+    QMutexLocker l(&idleMutex_);
+    idleWait_.wakeOne();
+  }
+}
+
+void ctkEAWorkStealingExecutor::shutdownNow()
+{
+  if (!shutdown_.testAndSetOrdered(0, 1)) return;
+
+  QMutexLocker l(&idleMutex_);
+  idleWait_.wakeAll();
+}
+
+void ctkEAWorkStealingExecutor::awaitTerminationAfterShutdown()
+{
+  QList<Worker*> workers;
+  {
+    QMutexLocker l(&mutex);
+    workers = workers_;
+  }
+
+  foreach (Worker* worker, workers)
+  {
+    if (worker->thread != QThread::currentThread())
+    {
+      worker->thread->wait();
+    }
+  }
+
+  // discard the tasks which have not been run
+  while (ctkEARunnable* task = queue_.poll())
+  {
+    discardTask(task);
+  }
+  foreach (Worker* worker, workers)
+  {
+    QMutexLocker l(&worker->dequeMutex);
+    foreach (ctkEARunnable* task, worker->deque)
+    {
+      discardTask(task);
+    }
+    worker->deque.clear();
+  }
+  pendingTasks_.fetchAndStoreOrdered(0);
+}
+
+void ctkEAWorkStealingExecutor::startWorkers()
+{
+  if (started_.fetchAndAddOrdered(0)) return;
+
+  QMutexLocker l(&mutex);
+  if (started_.fetchAndAddOrdered(0)) return;
+
+  for (int i = 0; i < workerCount_; ++i)
+  {
+    Worker* worker = new Worker(this, i);
+    worker->thread = getThreadFactory()->newThread(worker);
+    workers_.push_back(worker);
+    workerThreads_.insert(worker->thread, worker);
+  }
+  // the worker list and lookup table are not modified anymore
+  started_.fetchAndStoreOrdered(1);
+
+  foreach (Worker* worker, workers_)
+  {
+    worker->thread->start();
+  }
+}
+
+ctkEARunnable* ctkEAWorkStealingExecutor::getTask(Worker* worker)
+{
+  ctkEARunnable* task = 0;
+
+  // newest task of our own deque first
+  {
+    QMutexLocker l(&worker->dequeMutex);
+    if (!worker->deque.isEmpty())
+    {
+      task = worker->deque.takeLast();
+    }
+  }
+
+  if (task == 0)
+  {
+    task = queue_.poll();
+  }
+
+  // steal the oldest task of another worker
+  for (int i = 1; task == 0 && i < workerCount_; ++i)
+  {
+    Worker* victim = workers_[(worker->index + i) % workerCount_];
+    QMutexLocker l(&victim->dequeMutex);
+    if (!victim->deque.isEmpty())
+    {
+      task = victim->deque.takeFirst();
+    }
+  }
+
+  if (task)
+  {
+    pendingTasks_.fetchAndAddOrdered(-1);
+  }
+  return task;
+}
+
+void ctkEAWorkStealingExecutor::waitForTask()
+{
+  QMutexLocker l(&idleMutex_);
+  // execute() checks the number of idle workers after queueing a task, and we
+  // check the number of queued tasks after announcing that we are idle, so at
+  // least one of both sees the other and no wake-up gets lost
+  idleWorkers_.fetchAndAddOrdered(1);
+  while (!shutdown_.fetchAndAddOrdered(0) && pendingTasks_.fetchAndAddOrdered(0) <= 0)
+  {
+    idleWait_.wait(&idleMutex_);
+  }
+  idleWorkers_.fetchAndAddOrdered(-1);
+}
+
+void ctkEAWorkStealingExecutor::runTask(ctkEARunnable* task)
+{
+  const bool autoDelete = task->autoDelete();
+  try
+  {
+    task->run();
+  }
+  catch (const std::exception& e)
+  {
+    CTK_WARN_EXC(ctkEventAdminActivator::getLogService(), &e)
+        << "Exception: " << e.what();
+  }
+  if (autoDelete && !--task->ref) delete task;
+}
+
+void ctkEAWorkStealingExecutor::discardTask(ctkEARunnable* task)
+{
+  if (task->autoDelete() && !--task->ref) delete task;
+}
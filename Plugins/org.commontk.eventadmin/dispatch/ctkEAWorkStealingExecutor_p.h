@@ -0,0 +1,161 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+#ifndef CTKEAWORKSTEALINGEXECUTOR_P_H
+#define CTKEAWORKSTEALINGEXECUTOR_P_H
+
+#include "ctkEAThreadFactoryUser_p.h"
+#include "ctkEABoundedQueue_p.h"
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * An executor with a fixed number of worker threads which balances the
+ * load by work stealing.
+ * <p>
+ * Tasks executed from a thread which does not belong to the executor are
+ * put into a shared ctkEABoundedQueue, which does not use locks. Tasks
+ * executed from one of the worker threads (e.g. events posted by an event
+ * handler) are pushed onto the deque of that worker instead. A worker takes
+ * tasks from the back of its own deque first, then from the shared queue and
+ * finally steals from the front of the deques of the other workers. Each
+ * deque has its own mutex which is only contended while a task is stolen.
+ * <p>
+ * Workers which do not find any task sleep until new tasks are executed. The
+ * number of sleeping workers is tracked so that executing a task only takes a
+ * lock if a worker has to be woken up.
+ * <p>
+ * If the shared queue is full, or if the executor has been shut down, the task
+ * is run in the calling thread. The executor does not guarantee any order of
+ * execution between tasks; callers which need ordering have to serialize their
+ * tasks themselves (as ctkEAAsyncDeliverTasks does per sending thread).
+ */
+class ctkEAWorkStealingExecutor : public ctkEAThreadFactoryUser
+{
+
+public:
+
+  /** The default capacity of the shared queue. **/
+  static const int DEFAULT_QUEUECAPACITY; // = 1024
+
+  /**
+   * Create a new executor with the given number of worker threads.
+   * The threads are started by the first call to execute().
+   */
+  ctkEAWorkStealingExecutor(int workerCount, int queueCapacity = DEFAULT_QUEUECAPACITY);
+
+  ~ctkEAWorkStealingExecutor();
+
+  /**
+   * Return the number of worker threads.
+   */
+  int getWorkerCount() const;
+
+  /**
+   * Arrange for the given command to be executed by a worker thread.
+   * The command is run in the calling thread if it cannot be queued.
+   */
+  void execute(ctkEARunnable* command);
+
+  /**
+   * Stop the worker threads once they finished their current task and
+   * discard the tasks which are still queued. Subsequent calls to execute()
+   * run the command in the calling thread.
+   */
+  void shutdownNow();
+
+  /**
+   * Wait for the worker threads to terminate after a shutdown.
+   */
+  void awaitTerminationAfterShutdown();
+
+protected:
+
+  class Worker : public ctkEARunnable
+  {
+
+  public:
+
+    Worker(ctkEAWorkStealingExecutor* executor, int index);
+
+    void run();
+
+    ctkEAWorkStealingExecutor* executor;
+    int index;
+    ctkEAInterruptibleThread* thread;
+
+    QMutex dequeMutex;
+    QList<ctkEARunnable*> deque;
+  };
+
+  /**
+   * Create and start the worker threads if this has not been done yet.
+   */
+  void startWorkers();
+
+  /**
+   * Get the next task for the given worker, or null if no task is queued.
+   */
+  ctkEARunnable* getTask(Worker* worker);
+
+  /**
+   * Block the given worker until a task is queued or the executor is
+   * shut down.
+   */
+  void waitForTask();
+
+  /**
+   * Run the task and release the reference held on it.
+   */
+  void runTask(ctkEARunnable* task);
+
+  /**
+   * Release the reference held on a task which is not run.
+   */
+  void discardTask(ctkEARunnable* task);
+
+private:
+
+  ctkEABoundedQueue queue_;
+
+  int workerCount_;
+  QList<Worker*> workers_;
+  QHash<QThread*, Worker*> workerThreads_;
+  QAtomicInt started_;
+
+  /** The number of queued tasks, including those in the deques. **/
+  QAtomicInt pendingTasks_;
+
+  QMutex idleMutex_;
+  QWaitCondition idleWait_;
+  QAtomicInt idleWorkers_;
+
+  QAtomicInt shutdown_;
+
+  Q_DISABLE_COPY(ctkEAWorkStealingExecutor)
+};
+
+#endif // CTKEAWORKSTEALINGEXECUTOR_P_H
@@ -30,28 +30,27 @@
 #include <service/event/ctkEventConstants.h>
 #include <service/event/ctkEventHandler.h>
 
-#include "ctkEATopicHandlerFilters_p.h"
+#include "ctkEATopicHandlers_p.h"
 #include "ctkEAFilters_p.h"
 #include "ctkEABlackList_p.h"
 
 /**
  * This class is an implementation of the ctkEAHandlerTasks interface that does provide
- * blacklisting of event handlers. Furthermore, handlers are determined from the
- * framework on any call to <tt>createHandlerTasks()</tt> hence, there is no
- * book-keeping of <tt>ctkEventHandler</tt> services while they come and go but a
- * query for each sent event. In order to do this, an ldap-filter is created that
- * will match applicable <tt>ctkEventHandler</tt> references. In order to ease some of
- * the overhead pains of this approach some light caching is going on.
+ * blacklisting of event handlers. Furthermore, the handlers of the topic of an
+ * event are determined by an index of the <tt>ctkEventHandler</tt> services which
+ * is maintained while they come and go, hence there is no query of the framework
+ * for each sent event. Only the event filters of the handlers of the topic are
+ * evaluated.
  */
-template<class BlackList, class TopicHandlerFilters, class Filters>
+template<class BlackList, class TopicHandlers, class Filters>
 class ctkEABlacklistingHandlerTasks :
     public ctkEAHandlerTasks<
-    ctkEABlacklistingHandlerTasks<BlackList, TopicHandlerFilters, Filters> >
+    ctkEABlacklistingHandlerTasks<BlackList, TopicHandlers, Filters> >
 {
 
 private:
 
-  typedef ctkEABlacklistingHandlerTasks<BlackList, TopicHandlerFilters, Filters> Self;
+  typedef ctkEABlacklistingHandlerTasks<BlackList, TopicHandlers, Filters> Self;
 
   // The blacklist that holds blacklisted event handler service references
   ctkEABlackList<BlackList>* const blackList;
@@ -59,9 +58,8 @@ private:
   // The context of the plugin used to get the actual event handler services
   ctkPluginContext* const context;
 
-  // Used to create the filters that can determine applicable event handlers for
-  // a given event
-  ctkEATopicHandlerFilters<TopicHandlerFilters>* topicHandlerFilters;
+  // Used to determine applicable event handlers for a given event
+  ctkEATopicHandlers<TopicHandlers>* topicHandlers;
 
   // Used to create the filters that are used to determine whether an applicable
   // event handler is interested in a particular event
@@ -74,12 +72,12 @@ public:
    *
    * @param context The context of the plugin
    * @param blackList The set to use for keeping track of blacklisted references
-   * @param topicHandlerFilters The factory for topic handler filters
+   * @param topicHandlers The index of event handlers by topic
    * @param filters The factory for <tt>ctkLDAPSearchFilter</tt> objects
    */
   ctkEABlacklistingHandlerTasks(ctkPluginContext* context,
                                 ctkEABlackList<BlackList>* blackList,
-                                ctkEATopicHandlerFilters<TopicHandlerFilters>* topicHandlerFilters,
+                                ctkEATopicHandlers<TopicHandlers>* topicHandlers,
                                 ctkEAFilters<Filters>* filters);
 
   ~ctkEABlacklistingHandlerTasks();
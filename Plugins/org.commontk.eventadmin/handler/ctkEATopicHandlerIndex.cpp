@@ -0,0 +1,208 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#include "ctkEATopicHandlerIndex_p.h"
+
+#include <ctkException.h>
+#include <ctkPluginConstants.h>
+#include <ctkPluginContext.h>
+#include <ctkServiceEvent.h>
+#include <service/event/ctkEventConstants.h>
+#include <service/event/ctkEventHandler.h>
+
+#include <algorithm>
+
+ctkEATopicHandlerIndex::TopicNode::~TopicNode()
+{
+  qDeleteAll(children);
+}
+
+bool ctkEATopicHandlerIndex::TopicNode::isEmpty() const
+{
+  return children.isEmpty() && handlers.isEmpty() && wildcardHandlers.isEmpty();
+}
+
+ctkEATopicHandlerIndex::ctkEATopicHandlerIndex(ctkPluginContext* context, bool requireTopic)
+  : context(context), requireTopic(requireTopic)
+{
+  // Connect first, so that no handler registered in between is missed.
+  // Adding a handler twice is harmless.
+  context->connectServiceListener(this, "serviceChanged",
+                                  QString("(%1=%2)").arg(ctkPluginConstants::OBJECTCLASS)
+                                  .arg(qobject_interface_iid<ctkEventHandler*>()));
+
+  foreach (const ctkServiceReference& ref, context->getServiceReferences<ctkEventHandler>())
+  {
+    addHandler(ref);
+  }
+}
+
+ctkEATopicHandlerIndex::~ctkEATopicHandlerIndex()
+{
+  try
+  {
+    context->disconnectServiceListener(this, "serviceChanged");
+  }
+  catch (const ctkIllegalStateException&)
+  {
+    // The plugin is stopped, the framework removes the listener
+    // when this object is destroyed.
+  }
+}
+
+QList<ctkServiceReference> ctkEATopicHandlerIndex::getHandlers(const QString& topic)
+{
+  QSet<ctkServiceReference> handlers;
+  {
+    QMutexLocker lock(&mutex);
+
+    handlers = noTopicHandlers;
+
+    // The wildcard handlers of a node match all topics which continue after the
+    // node, the handlers of the last node only match the complete topic.
+    TopicNode* node = &root;
+    QStringList tokens = topic.split('/');
+    for (int i = 0; i < tokens.size() && node; ++i)
+    {
+      handlers.unite(node->wildcardHandlers);
+      node = node->children.value(tokens[i]);
+    }
+    if (node)
+    {
+      handlers.unite(node->handlers);
+    }
+  }
+
+  QList<ctkServiceReference> result = handlers.toList();
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+void ctkEATopicHandlerIndex::serviceChanged(const ctkServiceEvent& event)
+{
+  switch (event.getType())
+  {
+  case ctkServiceEvent::REGISTERED:
+    addHandler(event.getServiceReference());
+    break;
+  case ctkServiceEvent::MODIFIED:
+    removeHandler(event.getServiceReference());
+    addHandler(event.getServiceReference());
+    break;
+  case ctkServiceEvent::UNREGISTERING:
+    removeHandler(event.getServiceReference());
+    break;
+  default:
+    break;
+  }
+}
+
+void ctkEATopicHandlerIndex::addHandler(const ctkServiceReference& ref)
+{
+  QVariant topicsProperty = ref.getProperty(ctkEventConstants::EVENT_TOPIC);
+
+  QMutexLocker lock(&mutex);
+
+  if (handlerTopics.contains(ref) || noTopicHandlers.contains(ref))
+  {
+    return;
+  }
+
+  if (!topicsProperty.isValid())
+  {
+    if (!requireTopic)
+    {
+      noTopicHandlers.insert(ref);
+    }
+    return;
+  }
+
+  QStringList topics = topicsProperty.toStringList();
+  foreach (const QString& topic, topics)
+  {
+    QStringList tokens = topic.split('/');
+    bool wildcard = (tokens.last() == "*");
+    if (wildcard)
+    {
+      tokens.removeLast();
+    }
+
+    TopicNode* node = &root;
+    foreach (const QString& token, tokens)
+    {
+      TopicNode*& child = node->children[token];
+      if (child == 0)
+      {
+        child = new TopicNode();
+      }
+      node = child;
+    }
+
+    if (wildcard)
+    {
+      node->wildcardHandlers.insert(ref);
+    }
+    else
+    {
+      node->handlers.insert(ref);
+    }
+  }
+  handlerTopics.insert(ref, topics);
+}
+
+void ctkEATopicHandlerIndex::removeHandler(const ctkServiceReference& ref)
+{
+  QMutexLocker lock(&mutex);
+
+  noTopicHandlers.remove(ref);
+
+  QStringList topics = handlerTopics.take(ref);
+  foreach (const QString& topic, topics)
+  {
+    removeTopic(&root, topic.split('/'), 0, ref);
+  }
+}
+
+bool ctkEATopicHandlerIndex::removeTopic(TopicNode* node, const QStringList& tokens, int index,
+                                         const ctkServiceReference& ref)
+{
+  // Returns true if the node became empty and can be removed from its parent
+  if (index == tokens.size() - 1 && tokens[index] == "*")
+  {
+    node->wildcardHandlers.remove(ref);
+  }
+  else if (index == tokens.size())
+  {
+    node->handlers.remove(ref);
+  }
+  else
+  {
+    TopicNode* child = node->children.value(tokens[index]);
+    if (child && removeTopic(child, tokens, index + 1, ref))
+    {
+      node->children.remove(tokens[index]);
+      delete child;
+    }
+  }
+  return node != &root && node->isEmpty();
+}
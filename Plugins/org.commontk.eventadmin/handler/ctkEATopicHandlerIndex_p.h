@@ -0,0 +1,127 @@
+/*=============================================================================
+
+  Library: CTK
+
+  Copyright (c) German Cancer Research Center,
+    Division of Medical and Biological Informatics
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=============================================================================*/
+
+
+
+#ifndef CTKEATOPICHANDLERINDEX_P_H
+#define CTKEATOPICHANDLERINDEX_P_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+#include "ctkEATopicHandlers_p.h"
+
+class ctkPluginContext;
+class ctkServiceEvent;
+
+/**
+ * The index of <tt>ctkEventHandler</tt> services by topic. This implementation
+ * keeps the topics of the registered handlers in a trie with one level per
+ * topic token. Handlers with a wildcard topic (e.g., <tt>org/commontk/&#42;</tt>)
+ * are stored in the node of the topic prefix. Hence, the handlers of a topic are
+ * found by walking down the tokens of the topic, independently of the number
+ * of registered handlers.
+ *
+ * The index registers itself as a listener for <tt>ctkEventHandler</tt> services
+ * and is updated when handlers are registered, modified and unregistered.
+ */
+class ctkEATopicHandlerIndex : public QObject, public ctkEATopicHandlers<ctkEATopicHandlerIndex>
+{
+  Q_OBJECT
+
+public:
+
+  /**
+   * The constructor of the index. Registers the index with the given context
+   * as a listener for <tt>ctkEventHandler</tt> services and adds the handlers
+   * which are already registered.
+   *
+   * @param context The plugin context with which to register as a listener.
+   * @param requireTopic Include handlers that do not provide a topic
+   */
+  ctkEATopicHandlerIndex(ctkPluginContext* context, bool requireTopic);
+
+  ~ctkEATopicHandlerIndex();
+
+  /**
+   * Get the references of all <tt>ctkEventHandler</tt> services that match
+   * the given topic, ordered by service ranking.
+   *
+   * @param topic The topic to match
+   *
+   * @return The references of all the <tt>ctkEventHandler</tt> services
+   *      for the given topic.
+   */
+  QList<ctkServiceReference> getHandlers(const QString& topic);
+
+public Q_SLOTS:
+
+  /**
+   * Updates the index when a <tt>ctkEventHandler</tt> service is registered,
+   * modified or unregistered.
+   *
+   * @param event The service event.
+   */
+  void serviceChanged(const ctkServiceEvent& event);
+
+private:
+
+  struct TopicNode
+  {
+    QHash<QString, TopicNode*> children;
+
+    // Handlers of the topic of this node
+    QSet<ctkServiceReference> handlers;
+
+    // Handlers of the topics starting with the topic of this node
+    QSet<ctkServiceReference> wildcardHandlers;
+
+    ~TopicNode();
+
+    bool isEmpty() const;
+  };
+
+  ctkPluginContext* const context;
+
+  const bool requireTopic;
+
+  QMutex mutex;
+
+  TopicNode root;
+
+  // Handlers which do not provide a topic, only used if requireTopic is false
+  QSet<ctkServiceReference> noTopicHandlers;
+
+  // The topics under which each handler is indexed
+  QHash<ctkServiceReference, QStringList> handlerTopics;
+
+  void addHandler(const ctkServiceReference& ref);
+
+  void removeHandler(const ctkServiceReference& ref);
+
+  bool removeTopic(TopicNode* node, const QStringList& tokens, int index,
+                   const ctkServiceReference& ref);
+};
+
+#endif // CTKEATOPICHANDLERINDEX_P_H
@@ -20,32 +20,37 @@
 =============================================================================*/
 
 
-#ifndef CTKEATOPICHANDLERFILTERS_P_H
-#define CTKEATOPICHANDLERFILTERS_P_H
 
+#ifndef CTKEATOPICHANDLERS_P_H
+#define CTKEATOPICHANDLERS_P_H
+
+#include <QList>
 #include <QString>
 
+#include <ctkServiceReference.h>
+
 /**
- * The factory for <tt>ctkEventHandler</tt> filters based on a certain topic.
+ * The index of <tt>ctkEventHandler</tt> services by the topics they are
+ * interested in.
  */
 template<class Impl>
-struct ctkEATopicHandlerFilters
+struct ctkEATopicHandlers
 {
   /**
-   * Create a filter that will match all <tt>ctkEventHandler</tt> services that match
-   * the given topic.
+   * Get the references of all <tt>ctkEventHandler</tt> services that match
+   * the given topic, ordered by service ranking.
    *
    * @param topic The topic to match
    *
-   * @return A filter that will match all <tt>ctkEventHandler</tt> services for
-   *      the given topic.
+   * @return The references of all the <tt>ctkEventHandler</tt> services
+   *      for the given topic.
    */
-  QString createFilterForTopic(const QString& topic)
+  QList<ctkServiceReference> getHandlers(const QString& topic)
   {
-    return static_cast<Impl*>(this)->createFilterForTopic(topic);
+    return static_cast<Impl*>(this)->getHandlers(topic);
   }
 
-  virtual ~ctkEATopicHandlerFilters() {}
+  virtual ~ctkEATopicHandlers() {}
 };
 
-#endif // CTKEATOPICHANDLERFILTERS_P_H
+#endif // CTKEATOPICHANDLERS_P_H
@@ -88,7 +88,14 @@ template<class BlacklistingHandlerTasks>
 QString ctkEAHandlerTask<BlacklistingHandlerTasks>::getHandlerClassName() const
 {
   QObject* handler = _GetAndUngetEventHandler(handlerTasks, eventHandlerRef).getObject();
-  return handler->metaObject()->className();
+  // the null event handler is used for unregistered or blacklisted handlers
+  return handler ? handler->metaObject()->className() : QString();
+}
+
+template<class BlacklistingHandlerTasks>
+QString ctkEAHandlerTask<BlacklistingHandlerTasks>::getTopic() const
+{
+  return event.getTopic();
 }
 
 template<class BlacklistingHandlerTasks>
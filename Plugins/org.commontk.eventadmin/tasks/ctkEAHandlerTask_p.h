@@ -73,6 +73,11 @@ public:
    */
   QString getHandlerClassName() const;
 
+  /**
+   * Return the topic of the event
+   */
+  QString getTopic() const;
+
   /**
    * Deliver the event to the handler.
    */
@@ -24,6 +24,7 @@
 
 #include <dispatch/ctkEADefaultThreadPool_p.h>
 #include <dispatch/ctkEASyncMasterThread_p.h>
+#include <dispatch/ctkEAWatchdog_p.h>
 #include <util/ctkEARendezvous_p.h>
 #include <util/ctkEATimeoutException_p.h>
 
@@ -65,6 +66,31 @@ private:
   HandlerTask* task;
 };
 
+template<class HandlerTask>
+class _BlackListOnTimeout : public QRunnable
+{
+public:
+
+  QString handlerClassName;
+
+  _BlackListOnTimeout(HandlerTask* task)
+    : task(task)
+  {
+    setAutoDelete(false);
+  }
+
+  void run()
+  {
+    // remember the class before the handler is blacklisted
+    handlerClassName = task->getHandlerClassName();
+    task->blackListHandler();
+  }
+
+private:
+
+  HandlerTask* task;
+};
+
 template<class HandlerTask>
 class _RunInSyncMaster : public QRunnable
 {
@@ -91,44 +117,26 @@ private:
 template<class HandlerTask>
 ctkEASyncDeliverTasks<HandlerTask>::ctkEASyncDeliverTasks(
   ctkEADefaultThreadPool* pool, ctkEASyncMasterThread* syncMasterThread,
-  long timeout, const QList<QString>& ignoreTimeout)
-  : pool(pool), syncMasterThread(syncMasterThread)
+  ctkEAWatchdog* watchdog, long timeout, const QList<QString>& ignoreTimeout,
+  const QList<QString>& inlineTimeoutTopics)
+  : pool(pool), syncMasterThread(syncMasterThread), watchdog(watchdog)
 {
-  update(timeout, ignoreTimeout);
+  update(timeout, ignoreTimeout, inlineTimeoutTopics);
 }
 
 template<class HandlerTask>
-void ctkEASyncDeliverTasks<HandlerTask>::update(long timeout, const QList<QString>& ignoreTimeout)
+void ctkEASyncDeliverTasks<HandlerTask>::update(long timeout, const QList<QString>& ignoreTimeout,
+                                                const QList<QString>& inlineTimeoutTopics)
 {
-  {
-    QMutexLocker l(&mutex);
-    this->timeout = timeout;
-  }
-
-  if (ignoreTimeout.isEmpty())
-  {
-    QMutexLocker l(&mutex);
-    qDeleteAll(ignoreTimeoutMatcher);
-    ignoreTimeoutMatcher.clear();
-  }
-  else
-  {
-    QList<Matcher*> newMatcherList;
-    foreach(QString value, ignoreTimeout)
-    {
-      value = value.trimmed();
-      if (!value.isEmpty())
-      {
-        newMatcherList.push_back(new ClassMatcher(value));
-      }
-    }
-
-    {
-      QMutexLocker l(&mutex);
-      qDeleteAll(ignoreTimeoutMatcher);
-      ignoreTimeoutMatcher = newMatcherList;
-    }
-  }
+  QList<Matcher*> newIgnoreTimeoutMatcher = createMatchers<ClassMatcher>(ignoreTimeout);
+  QList<Matcher*> newInlineTimeoutMatcher = createMatchers<TopicMatcher>(inlineTimeoutTopics);
+
+  QMutexLocker l(&mutex);
+  this->timeout = timeout;
+  qDeleteAll(ignoreTimeoutMatcher);
+  ignoreTimeoutMatcher = newIgnoreTimeoutMatcher;
+  qDeleteAll(inlineTimeoutMatcher);
+  inlineTimeoutMatcher = newInlineTimeoutMatcher;
 }
 
 template<class HandlerTask>
@@ -165,6 +173,24 @@ void ctkEASyncDeliverTasks<HandlerTask>::executeInSyncMaster(const QList<Handler
         task.blackListHandler();
       }
     }
+    else if (useInlineTimeout(task))
+    {
+      // execute in this thread and let the watchdog blacklist
+      // the handler if it does not return in time
+      _BlackListOnTimeout<HandlerTask> blackListOnTimeout(&task);
+      int ticket = watchdog->watch(timeout, &blackListOnTimeout);
+      task.execute();
+      if (!watchdog->unwatch(ticket))
+      {
+        // use the pooled threads for this kind of handler from now on,
+        // unless the handler was already gone when the watchdog fired
+        if (!blackListOnTimeout.handlerClassName.isEmpty())
+        {
+          QMutexLocker l(&mutex);
+          slowHandlerClasses.insert(blackListOnTimeout.handlerClassName);
+        }
+      }
+    }
     else
     {
       _TimeoutRunnable<HandlerTask>* timeoutRunnable
@@ -229,3 +255,60 @@ bool ctkEASyncDeliverTasks<HandlerTask>::useTimeout(const HandlerTask& task)
   }
   return false;
 }
+
+template<class HandlerTask>
+bool ctkEASyncDeliverTasks<HandlerTask>::useInlineTimeout(const HandlerTask& task)
+{
+  QList<Matcher*> currMatcherList;
+  bool checkClassName = false;
+  {
+    QMutexLocker l(&mutex);
+    currMatcherList = inlineTimeoutMatcher;
+    checkClassName = !slowHandlerClasses.isEmpty();
+  }
+  if (currMatcherList.isEmpty())
+  {
+    return false;
+  }
+
+  const QString topic = task.getTopic();
+  bool matched = false;
+  foreach(Matcher* matcher, currMatcherList)
+  {
+    if (matcher->match(topic))
+    {
+      matched = true;
+      break;
+    }
+  }
+  if (!matched)
+  {
+    return false;
+  }
+
+  if (checkClassName)
+  {
+    // the class name is only looked up once a handler was too slow
+    QString className = task.getHandlerClassName();
+    QMutexLocker l(&mutex);
+    return !slowHandlerClasses.contains(className);
+  }
+  return true;
+}
+
+template<class HandlerTask>
+template<class M>
+QList<typename ctkEASyncDeliverTasks<HandlerTask>::Matcher*>
+ctkEASyncDeliverTasks<HandlerTask>::createMatchers(const QList<QString>& names)
+{
+  QList<Matcher*> matchers;
+  foreach(QString value, names)
+  {
+    value = value.trimmed();
+    if (!value.isEmpty())
+    {
+      matchers.push_back(new M(value));
+    }
+  }
+  return matchers;
+}
@@ -26,9 +26,11 @@
 #include "ctkEADeliverTask_p.h"
 
 #include <QMutex>
+#include <QSet>
 
 class ctkEADefaultThreadPool;
 class ctkEASyncMasterThread;
+class ctkEAWatchdog;
 
 /**
  * This class does the actual work of the synchronous event delivery.
@@ -54,6 +56,15 @@ class ctkEASyncMasterThread;
  * If during an event delivery a new event should be delivered from
  * within the event handler, the timeout handler is stopped for the
  * delivery time of the inner event!
+ *
+ * For events with a topic matching one of the inline timeout topics,
+ * handlers are called directly in the delivering thread while a
+ * ctkEAWatchdog checks the deadline. This saves the two thread switches
+ * of the pooled delivery, but a handler exceeding the timeout still blocks
+ * the delivery until it returns (it is blacklisted by the watchdog
+ * nonetheless). Handlers of a class for which this happened before are
+ * therefore always called from a pooled thread again. Events sent by a
+ * handler called inline are delivered directly in the same thread.
  */
 template<class HandlerTask>
 class ctkEASyncDeliverTasks : public ctkEADeliverTask<ctkEASyncDeliverTasks<HandlerTask>, HandlerTask>
@@ -67,18 +78,22 @@ private:
   /** This is a ctkEAInterruptibleThread used to execute the handlers */
   ctkEASyncMasterThread* syncMasterThread;
 
+  /** The watchdog checking the deadlines of handlers called inline */
+  ctkEAWatchdog* watchdog;
+
   /** The timeout for event handlers, 0 = disabled. */
   long timeout;
 
   /**
    * The matcher interface for checking if timeout handling
-   * is disabled for the handler.
-   * Matching is based on the class name of the event handler.
+   * is disabled for the handler or done inline for the event.
+   * Matching is based on the class name of the event handler
+   * or on the topic of the event, respectively.
    */
   struct Matcher
   {
     virtual ~Matcher() {}
-    virtual bool match(const QString& className) const = 0;
+    virtual bool match(const QString& name) const = 0;
   };
 
   /** Match a class name. */
@@ -98,9 +113,38 @@ private:
     }
   };
 
+  /**
+   * Match a topic. A trailing "*" matches any topic starting with
+   * the preceding characters, i.e. "*" matches all topics.
+   */
+  struct TopicMatcher : public Matcher
+  {
+  private:
+    QString topic;
+    bool wildcard;
+
+  public:
+    TopicMatcher(const QString& name)
+      : topic(name), wildcard(name.endsWith('*'))
+    {
+      if (wildcard) topic.chop(1);
+    }
+
+    bool match(const QString& name) const
+    {
+      return wildcard ? name.startsWith(topic) : topic == name;
+    }
+  };
+
   /** The matchers for ignore timeout handling. */
   QList<Matcher*> ignoreTimeoutMatcher;
 
+  /** The matchers for inline timeout handling. */
+  QList<Matcher*> inlineTimeoutMatcher;
+
+  /** The classes of handlers which exceeded the timeout when called inline. */
+  QSet<QString> slowHandlerClasses;
+
   QMutex mutex;
 
 public:
@@ -108,12 +152,17 @@ public:
   /**
    * Construct a new sync deliver tasks.
    * @param pool The thread pool used to spin-off new threads.
+   * @param watchdog The watchdog used for handlers called inline.
    * @param timeout The timeout for an event handler, 0 = disabled
+   * @param ignoreTimeout The class names of handlers called without timeout
+   * @param inlineTimeoutTopics The topics of events delivered inline
    */
   ctkEASyncDeliverTasks(ctkEADefaultThreadPool* pool, ctkEASyncMasterThread* syncMasterThread,
-                        long timeout, const QList<QString>& ignoreTimeout);
+                        ctkEAWatchdog* watchdog, long timeout, const QList<QString>& ignoreTimeout,
+                        const QList<QString>& inlineTimeoutTopics);
 
-  void update(long timeout, const QList<QString>& ignoreTimeout);
+  void update(long timeout, const QList<QString>& ignoreTimeout,
+              const QList<QString>& inlineTimeoutTopics);
 
   /**
    * This blocks an unrelated thread used to send a synchronous event until the
@@ -136,6 +185,19 @@ private:
    */
   bool useTimeout(const HandlerTask& task);
 
+  /**
+   * This method defines if the task should be executed in the calling
+   * thread while the watchdog checks the timeout.
+   * @param tasks The event handler dispatch task to execute
+   */
+  bool useInlineTimeout(const HandlerTask& task);
+
+  /**
+   * Create the matchers for the given list of names.
+   */
+  template<class M>
+  static QList<Matcher*> createMatchers(const QList<QString>& names);
+
 };
 
 #include "ctkEASyncDeliverTasks.tpp"